@@ -2,37 +2,16 @@
 #
 # Project created by QtCreator 2015-09-03T20:20:31
 #
+# The core library, the application and the tests
+# linking it, built in that order.
+#
 #-------------------------------------------------
 
-QT       += core gui
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-TARGET = NeoCDImageSplitter
-TEMPLATE = app
-
-CONFIG += c++11
-
-SOURCES += main.cpp\
-        dialog.cpp \
-    logger.cpp \
-    loggerlistwidget.cpp \
-    cdromtoc.cpp \
-    wavfile.cpp \
-    imagewriterworker.cpp
-
-HEADERS  += dialog.h \
-    wavfile.h \
-    logger.h \
-    loggerlistwidget.h \
-    cdromtoc.h \
-    endian.h \
-    packedstruct.h \
-    trackindex.h \
-    imagewriterworker.h \
-    wavstruct.h
+TEMPLATE = subdirs
 
-FORMS    += dialog.ui
+SUBDIRS += core \
+    app \
+    tests
 
-RESOURCES += \
-    resources.qrc
+app.depends = core
+tests.depends = core
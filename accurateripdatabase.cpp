@@ -0,0 +1,173 @@
+#include "accurateripdatabase.h"
+#include "endian.h"
+#include "packedstruct.h"
+
+#include <QFile>
+#include <QtDebug>
+#include <cstring>
+
+// Sectors of the lead-in before the first track, for the FreeDB disc ID
+constexpr uint32_t LEAD_IN_SECTORS = 150;
+
+constexpr uint32_t SECTORS_PER_SECOND = 75;
+
+#ifdef _MSC_VER
+    #pragma pack(push,1)
+#endif
+
+struct PACKED AccurateRipPressingHeader
+{
+    uint8_t trackCount;
+    uint32_t id1;
+    uint32_t id2;
+    uint32_t cddb;
+};
+
+static_assert(sizeof(AccurateRipPressingHeader) == 13, "Struct AccurateRip Pressing Header should be exactly 13 bytes!");
+
+struct PACKED AccurateRipTrackEntry
+{
+    uint8_t confidence;
+    uint32_t checksum;
+    uint32_t frame450Checksum;
+};
+
+static_assert(sizeof(AccurateRipTrackEntry) == 9, "Struct AccurateRip Track Entry should be exactly 9 bytes!");
+
+#ifdef _MSC_VER
+    #pragma pack(pop)
+#endif
+
+AccurateRipDatabase::AccurateRipDatabase() :
+    m_pressings(),
+    m_firstTrack(1)
+{ }
+
+bool AccurateRipDatabase::load(const QString &fileName, CdromToc *toc)
+{
+    m_pressings.clear();
+    m_firstTrack = toc->firstTrack();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open AccurateRip database file: " << file.errorString();
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    DiscIds ids = discIds(toc);
+    bool idsMatch = false;
+    int position = 0;
+
+    while(position < data.size())
+    {
+        AccurateRipPressingHeader header;
+        if (data.size() - position < static_cast<int>(sizeof(header)))
+            break;
+
+        std::memcpy(&header, data.constData() + position, sizeof(header));
+        position += sizeof(header);
+
+        int entriesSize = header.trackCount * static_cast<int>(sizeof(AccurateRipTrackEntry));
+        if (data.size() - position < entriesSize)
+            break;
+
+        // Files normally hold a single disc, other track counts can not be matched track by track
+        if (header.trackCount == ids.trackCount)
+        {
+            QVector<TrackEntry> entries;
+
+            for(int i = 0; i < header.trackCount; ++i)
+            {
+                AccurateRipTrackEntry entry;
+                std::memcpy(&entry, data.constData() + position + i * static_cast<int>(sizeof(entry)), sizeof(entry));
+                entries.append(TrackEntry{ entry.confidence, LITTLE_ENDIAN_DWORD(entry.checksum) });
+            }
+
+            m_pressings.append(entries);
+
+            if ((LITTLE_ENDIAN_DWORD(header.id1) == ids.id1) && (LITTLE_ENDIAN_DWORD(header.id2) == ids.id2) && (LITTLE_ENDIAN_DWORD(header.cddb) == ids.cddb))
+                idsMatch = true;
+        }
+
+        position += entriesSize;
+    }
+
+    if (position != data.size())
+        qWarning().noquote() << "AccurateRip database file " << fileName << " is truncated.";
+
+    if (m_pressings.isEmpty())
+    {
+        qCritical().noquote() << "AccurateRip database file " << fileName << " has no entry for a disc of " << ids.trackCount << " tracks.";
+        return false;
+    }
+
+    if (!idsMatch)
+        qWarning().noquote() << "AccurateRip database file " << fileName << " may be for another disc, the CUE sheet gives " << AccurateRipDatabase::fileName(ids) << ".";
+
+    return true;
+}
+
+int AccurateRipDatabase::confidence(uint8_t track, uint32_t checksum) const
+{
+    int index = track - m_firstTrack;
+    int best = 0;
+
+    for(const QVector<TrackEntry>& pressing : m_pressings)
+    {
+        if ((index < 0) || (index >= pressing.size()))
+            continue;
+
+        const TrackEntry& entry = pressing.at(index);
+        if (entry.checksum == checksum)
+            best = qMax(best, entry.confidence);
+    }
+
+    return best;
+}
+
+AccurateRipDatabase::DiscIds AccurateRipDatabase::discIds(CdromToc *toc)
+{
+    DiscIds ids = { 0, 0, 0, 0 };
+    uint32_t leadOut = toc->totalSectors();
+    uint32_t firstStart = 0;
+    uint32_t digitSum = 0;
+
+    for(int track = toc->firstTrack(); track <= toc->lastTrack(); ++track)
+    {
+        const CdromToc::Entry* entry = toc->findTocEntry(TrackIndex{static_cast<uint8_t>(track), 1});
+        if (!entry)
+            continue;
+
+        uint32_t start = entry->startSector;
+
+        if (!ids.trackCount)
+            firstStart = start;
+
+        ++ids.trackCount;
+
+        ids.id1 += start;
+        ids.id2 += qMax(start, uint32_t(1)) * static_cast<uint32_t>(ids.trackCount);
+
+        for(uint32_t seconds = (start + LEAD_IN_SECTORS) / SECTORS_PER_SECOND; seconds; seconds /= 10)
+            digitSum += seconds % 10;
+    }
+
+    ids.id1 += leadOut;
+    ids.id2 += leadOut * static_cast<uint32_t>(ids.trackCount + 1);
+
+    uint32_t length = leadOut / SECTORS_PER_SECOND - firstStart / SECTORS_PER_SECOND;
+    ids.cddb = ((digitSum % 255) << 24) | (length << 8) | static_cast<uint32_t>(ids.trackCount);
+
+    return ids;
+}
+
+QString AccurateRipDatabase::fileName(const DiscIds &ids)
+{
+    return QStringLiteral("dBAR-%1-%2-%3-%4.bin")
+            .arg(ids.trackCount, 3, 10, QChar('0'))
+            .arg(ids.id1, 8, 16, QChar('0'))
+            .arg(ids.id2, 8, 16, QChar('0'))
+            .arg(ids.cddb, 8, 16, QChar('0'));
+}
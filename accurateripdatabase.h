@@ -0,0 +1,78 @@
+#ifndef ACCURATERIPDATABASE_H
+#define ACCURATERIPDATABASE_H
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+#include "cdromtoc.h"
+
+// Local copy of the AccurateRip results of a disc, to verify the audio tracks without going online.
+// Files are the binary "dBAR-<tracks>-<id1>-<id2>-<cddb>.bin" responses of the AccurateRip server: a list of
+// pressings, each one giving for every track of the disc a checksum and the number of rips that agree with
+// it (the confidence). Checksums can be v1 or v2, both are matched.
+
+class AccurateRipDatabase
+{
+public:
+    struct DiscIds
+    {
+        /// Number of tracks of the disc, data tracks included
+        int trackCount;
+
+        /// Sum of the track start sectors and the lead-out sector
+        uint32_t id1;
+
+        /// Sum of the track start sectors weighted by the track numbers, and the lead-out
+        uint32_t id2;
+
+        /// FreeDB disc ID
+        uint32_t cddb;
+    };
+
+    explicit AccurateRipDatabase();
+
+    /**
+     * @brief Load the pressings of a disc from a dBAR file.
+     * @return false if the file can not be read or has no pressing with the track count of the disc.
+     */
+    bool load(const QString& fileName, CdromToc* toc);
+
+    inline bool isLoaded() const
+    {
+        return !m_pressings.isEmpty();
+    }
+
+    /**
+     * @brief Find how many rips agree with a track checksum.
+     * @return Highest confidence of the pressings with this checksum for the track, 0 if there is none.
+     */
+    int confidence(uint8_t track, uint32_t checksum) const;
+
+    /**
+     * @brief Compute the identifiers AccurateRip knows a disc by, from its TOC.
+     */
+    static DiscIds discIds(CdromToc* toc);
+
+    /**
+     * @brief Name of the dBAR file of a disc, as on the AccurateRip server.
+     */
+    static QString fileName(const DiscIds& ids);
+
+protected:
+    struct TrackEntry
+    {
+        /// Number of rips with this checksum
+        int confidence;
+
+        /// AccurateRip checksum (v1 or v2)
+        uint32_t checksum;
+    };
+
+    /// Track entries of every pressing
+    QVector<QVector<TrackEntry>> m_pressings;
+
+    uint8_t m_firstTrack;
+};
+
+#endif // ACCURATERIPDATABASE_H
@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2015-09-03T20:20:31
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = NeoCDImageSplitter
+TEMPLATE = app
+
+CONFIG += c++11
+
+SOURCES += ../main.cpp \
+    ../dialog.cpp \
+    ../logger.cpp \
+    ../loggerlistwidget.cpp \
+    ../loggermodel.cpp \
+    ../commandline.cpp
+
+HEADERS  += ../dialog.h \
+    ../logger.h \
+    ../loggerlistwidget.h \
+    ../loggermodel.h \
+    ../commandline.h
+
+FORMS    += ../dialog.ui
+
+# Everything but the dialog, the log view and the command line, built as a library by core/core.pro
+include(../neocdcore.pri)
+
+RESOURCES += \
+    ../resources.qrc
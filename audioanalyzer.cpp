@@ -0,0 +1,461 @@
+#include "audioanalyzer.h"
+#include "endian.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+// Frames decoded and filtered at a time
+constexpr int CHUNK_FRAMES = 4096;
+
+// Input samples used for every oversampled value, and the oversampling factor
+constexpr int TRUE_PEAK_TAPS = 12;
+constexpr int OVERSAMPLING = 4;
+
+// Samples kept from the previous chunk for the oversampling filter
+constexpr int HISTORY = TRUE_PEAK_TAPS - 1;
+
+// Loudness is summed over 100 ms blocks, and gated over 400 ms windows of 4 blocks
+constexpr int BLOCK_FRAMES = 4410;
+constexpr int BLOCKS_PER_WINDOW = 4;
+
+// Gates of the integrated loudness, in LUFS then in LU below the ungated loudness
+constexpr double ABSOLUTE_GATE = -70.0;
+constexpr double RELATIVE_GATE = -10.0;
+
+// Target loudness of ReplayGain 2.0, in LUFS
+constexpr double REPLAYGAIN_REFERENCE = -18.0;
+
+// Sample rate the K-weighting filters are designed for
+constexpr double CD_SAMPLE_RATE = 44100.0;
+
+constexpr double PI = 3.14159265358979323846;
+
+struct Biquad
+{
+    double b0;
+    double b1;
+    double b2;
+    double a1;
+    double a2;
+};
+
+// First stage of the K-weighting: high shelf modelling the acoustic effect of the head
+static Biquad shelfFilter()
+{
+    const double f0 = 1681.974450955533;
+    const double gain = 3.999843853973347;
+    const double q = 0.7071752369554196;
+
+    double k = std::tan(PI * f0 / CD_SAMPLE_RATE);
+    double vh = std::pow(10.0, gain / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+
+    return Biquad{ (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                   2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+}
+
+// Second stage of the K-weighting: RLB high pass
+static Biquad highPassFilter()
+{
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+
+    double k = std::tan(PI * f0 / CD_SAMPLE_RATE);
+    double a0 = 1.0 + k / q + k * k;
+
+    return Biquad{ 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+}
+
+static const Biquad SHELF = shelfFilter();
+static const Biquad HIGH_PASS = highPassFilter();
+
+static inline double energyToLoudness(double energy)
+{
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+static inline double loudnessToEnergy(double loudness)
+{
+    return std::pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+AudioAnalyzer::AudioAnalyzer() :
+    m_frames(0),
+    m_peak(0),
+    m_sumSquares(0),
+    m_clippedSamples(0),
+    m_truePeak(0.0f),
+    m_left(HISTORY + CHUNK_FRAMES, 0.0f),
+    m_right(HISTORY + CHUNK_FRAMES, 0.0f),
+    m_oversamplingFilter(TRUE_PEAK_TAPS * OVERSAMPLING),
+    m_filterState(),
+    m_blockEnergy(0.0),
+    m_blockFrames(0),
+    m_blocks()
+{
+    // Windowed sinc, phase p gives the value at p / 4 of a sample after the middle tap
+    for(int phase = 0; phase < OVERSAMPLING; ++phase)
+    {
+        double sum = 0.0;
+
+        for(int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+        {
+            double distance = tap - TRUE_PEAK_TAPS / 2 + static_cast<double>(phase) / OVERSAMPLING;
+            double x = distance / (TRUE_PEAK_TAPS / 2 + 0.5);
+            double window = 0.42 + 0.5 * std::cos(PI * x) + 0.08 * std::cos(2.0 * PI * x);
+            double sinc = (distance == 0.0) ? 1.0 : std::sin(PI * distance) / (PI * distance);
+
+            m_oversamplingFilter[tap * OVERSAMPLING + phase] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+
+        // Unity gain for every phase, a constant signal must not read higher than its samples
+        for(int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+            m_oversamplingFilter[tap * OVERSAMPLING + phase] /= static_cast<float>(sum);
+    }
+
+    reset();
+}
+
+void AudioAnalyzer::reset()
+{
+    m_frames = 0;
+    m_peak = 0;
+    m_sumSquares = 0;
+    m_clippedSamples = 0;
+    m_truePeak = 0.0f;
+
+    std::fill(m_left.begin(), m_left.begin() + HISTORY, 0.0f);
+    std::fill(m_right.begin(), m_right.begin() + HISTORY, 0.0f);
+    std::fill(std::begin(m_filterState), std::end(m_filterState), 0.0);
+
+    m_blockEnergy = 0.0;
+    m_blockFrames = 0;
+    m_blocks.clear();
+}
+
+void AudioAnalyzer::process(const char *data, qint64 size)
+{
+    qint64 frames = size / 4;
+
+    while(frames > 0)
+    {
+        int count = static_cast<int>(qMin(frames, qint64(CHUNK_FRAMES)));
+
+        measureLevels(data, count);
+        decode(data, count);
+        measureTruePeak(count);
+        measureLoudness(count);
+
+        // The end of the chunk is the history of the next one
+        std::memmove(m_left.data(), m_left.constData() + count, HISTORY * sizeof(float));
+        std::memmove(m_right.data(), m_right.constData() + count, HISTORY * sizeof(float));
+
+        m_frames += count;
+        data += count * 4;
+        frames -= count;
+    }
+}
+
+AudioAnalyzer::Result AudioAnalyzer::result() const
+{
+    Result result;
+    result.frames = m_frames;
+    result.samplePeak = m_peak / 32768.0;
+    result.truePeak = std::max(static_cast<double>(m_truePeak), result.samplePeak);
+    result.rms = m_frames ? std::sqrt(static_cast<double>(m_sumSquares) / (2.0 * m_frames)) / 32768.0 : 0.0;
+    result.loudness = -std::numeric_limits<double>::infinity();
+    result.replayGain = 0.0;
+    result.clippedSamples = m_clippedSamples;
+
+    // Mean square of every 400 ms window, overlapping by 75%
+    QVector<double> windows;
+    for(int i = 0; i + BLOCKS_PER_WINDOW <= m_blocks.size(); ++i)
+    {
+        double energy = 0.0;
+        for(int j = 0; j < BLOCKS_PER_WINDOW; ++j)
+            energy += m_blocks.at(i + j);
+
+        windows.append(energy / BLOCKS_PER_WINDOW);
+    }
+
+    double threshold = loudnessToEnergy(ABSOLUTE_GATE);
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        double sum = 0.0;
+        int count = 0;
+
+        for(double energy : windows)
+        {
+            if (energy > threshold)
+            {
+                sum += energy;
+                ++count;
+            }
+        }
+
+        if (!count)
+            return result;
+
+        // The first pass only gives the level of the relative gate
+        if (pass == 0)
+            threshold = std::max(threshold, loudnessToEnergy(energyToLoudness(sum / count) + RELATIVE_GATE));
+        else
+            result.loudness = energyToLoudness(sum / count);
+    }
+
+    result.replayGain = REPLAYGAIN_REFERENCE - result.loudness;
+
+    return result;
+}
+
+void AudioAnalyzer::measureLevels(const char *data, int frames)
+{
+    int samples = frames * 2;
+    int i = 0;
+    int peak = m_peak;
+    quint64 sumSquares = 0;
+    qint64 clipped = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high = _mm_set1_epi16(32767);
+    const __m128i low = _mm_set1_epi16(-32768);
+    __m128i maximum = zero;
+    __m128i minimum = zero;
+    __m128i squares = zero;
+    __m128i clippedCounts = zero;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+
+        maximum = _mm_max_epi16(maximum, v);
+        minimum = _mm_min_epi16(minimum, v);
+
+        // Each lane sums two squares, which always fits in 32 bits once read as unsigned
+        __m128i square = _mm_madd_epi16(v, v);
+        squares = _mm_add_epi64(squares, _mm_unpacklo_epi32(square, zero));
+        squares = _mm_add_epi64(squares, _mm_unpackhi_epi32(square, zero));
+
+        // Comparisons give -1 for full scale samples, a chunk is too short to overflow the 16-bit counters
+        clippedCounts = _mm_sub_epi16(clippedCounts, _mm_or_si128(_mm_cmpeq_epi16(v, high), _mm_cmpeq_epi16(v, low)));
+    }
+
+    int16_t maximumLanes[8];
+    int16_t minimumLanes[8];
+    uint64_t squareLanes[2];
+    uint16_t clippedLanes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maximumLanes), maximum);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(minimumLanes), minimum);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(squareLanes), squares);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(clippedLanes), clippedCounts);
+
+    for(int lane = 0; lane < 8; ++lane)
+    {
+        peak = std::max(peak, static_cast<int>(maximumLanes[lane]));
+        peak = std::max(peak, -static_cast<int>(minimumLanes[lane]));
+        clipped += clippedLanes[lane];
+    }
+
+    sumSquares = squareLanes[0] + squareLanes[1];
+#endif
+
+    for(; i < samples; ++i)
+    {
+        uint16_t word;
+        std::memcpy(&word, data + i * 2, sizeof(word));
+        int sample = static_cast<int16_t>(LITTLE_ENDIAN_WORD(word));
+
+        peak = std::max(peak, std::abs(sample));
+        sumSquares += static_cast<quint64>(sample * sample);
+
+        if ((sample == 32767) || (sample == -32768))
+            ++clipped;
+    }
+
+    m_peak = peak;
+    m_sumSquares += sumSquares;
+    m_clippedSamples += clipped;
+}
+
+void AudioAnalyzer::decode(const char *data, int frames)
+{
+    float* left = m_left.data() + HISTORY;
+    float* right = m_right.data() + HISTORY;
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+
+    // Four frames at a time, left samples sit in the low half of every 32-bit lane
+    for(; i + 4 <= frames; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 4));
+        __m128i l = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+        __m128i r = _mm_srai_epi32(v, 16);
+
+        _mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(l), scale));
+        _mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(r), scale));
+    }
+#endif
+
+    for(; i < frames; ++i)
+    {
+        uint16_t words[2];
+        std::memcpy(words, data + i * 4, sizeof(words));
+
+        left[i] = static_cast<float>(static_cast<int16_t>(LITTLE_ENDIAN_WORD(words[0]))) * (1.0f / 32768.0f);
+        right[i] = static_cast<float>(static_cast<int16_t>(LITTLE_ENDIAN_WORD(words[1]))) * (1.0f / 32768.0f);
+    }
+}
+
+void AudioAnalyzer::measureTruePeak(int frames)
+{
+    const float* filter = m_oversamplingFilter.constData();
+    float peak = m_truePeak;
+
+    for(const QVector<float>* channel : { &m_left, &m_right })
+    {
+        const float* samples = channel->constData() + HISTORY;
+
+#ifdef __SSE2__
+        // The 4 phases of a sample are computed together, one per lane
+        const __m128 absoluteMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 maximum = _mm_setzero_ps();
+
+        for(int i = 0; i < frames; ++i)
+        {
+            __m128 sum = _mm_setzero_ps();
+
+            for(int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(filter + tap * OVERSAMPLING), _mm_set1_ps(samples[i - tap])));
+
+            maximum = _mm_max_ps(maximum, _mm_and_ps(sum, absoluteMask));
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, maximum);
+        peak = std::max(peak, *std::max_element(lanes, lanes + 4));
+#else
+        for(int i = 0; i < frames; ++i)
+        {
+            for(int phase = 0; phase < OVERSAMPLING; ++phase)
+            {
+                float sum = 0.0f;
+
+                for(int tap = 0; tap < TRUE_PEAK_TAPS; ++tap)
+                    sum += filter[tap * OVERSAMPLING + phase] * samples[i - tap];
+
+                peak = std::max(peak, std::fabs(sum));
+            }
+        }
+#endif
+    }
+
+    m_truePeak = peak;
+}
+
+void AudioAnalyzer::measureLoudness(int frames)
+{
+    const float* left = m_left.constData() + HISTORY;
+    const float* right = m_right.constData() + HISTORY;
+
+#ifdef __SSE2__
+    // Both channels go through the filters together, left in the low lane
+    __m128d shelf1 = _mm_loadu_pd(m_filterState);
+    __m128d shelf2 = _mm_loadu_pd(m_filterState + 2);
+    __m128d highPass1 = _mm_loadu_pd(m_filterState + 4);
+    __m128d highPass2 = _mm_loadu_pd(m_filterState + 6);
+    __m128d energy = _mm_setzero_pd();
+
+    const __m128d shelfB0 = _mm_set1_pd(SHELF.b0);
+    const __m128d shelfB1 = _mm_set1_pd(SHELF.b1);
+    const __m128d shelfB2 = _mm_set1_pd(SHELF.b2);
+    const __m128d shelfA1 = _mm_set1_pd(SHELF.a1);
+    const __m128d shelfA2 = _mm_set1_pd(SHELF.a2);
+    const __m128d highPassB1 = _mm_set1_pd(HIGH_PASS.b1);
+    const __m128d highPassA1 = _mm_set1_pd(HIGH_PASS.a1);
+    const __m128d highPassA2 = _mm_set1_pd(HIGH_PASS.a2);
+
+    for(int i = 0; i < frames; ++i)
+    {
+        __m128d x = _mm_set_pd(right[i], left[i]);
+
+        // Transposed direct form II
+        __m128d y = _mm_add_pd(_mm_mul_pd(shelfB0, x), shelf1);
+        shelf1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(shelfB1, x), _mm_mul_pd(shelfA1, y)), shelf2);
+        shelf2 = _mm_sub_pd(_mm_mul_pd(shelfB2, x), _mm_mul_pd(shelfA2, y));
+
+        x = y;
+        y = _mm_add_pd(x, highPass1);
+        highPass1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(highPassB1, x), _mm_mul_pd(highPassA1, y)), highPass2);
+        highPass2 = _mm_sub_pd(x, _mm_mul_pd(highPassA2, y));
+
+        energy = _mm_add_pd(energy, _mm_mul_pd(y, y));
+
+        if (++m_blockFrames == BLOCK_FRAMES)
+        {
+            double lanes[2];
+            _mm_storeu_pd(lanes, energy);
+            m_blocks.append((m_blockEnergy + lanes[0] + lanes[1]) / BLOCK_FRAMES);
+
+            energy = _mm_setzero_pd();
+            m_blockEnergy = 0.0;
+            m_blockFrames = 0;
+        }
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, energy);
+    m_blockEnergy += lanes[0] + lanes[1];
+
+    _mm_storeu_pd(m_filterState, shelf1);
+    _mm_storeu_pd(m_filterState + 2, shelf2);
+    _mm_storeu_pd(m_filterState + 4, highPass1);
+    _mm_storeu_pd(m_filterState + 6, highPass2);
+#else
+    double* state = m_filterState;
+
+    for(int i = 0; i < frames; ++i)
+    {
+        for(int channel = 0; channel < 2; ++channel)
+        {
+            double x = channel ? right[i] : left[i];
+
+            double y = SHELF.b0 * x + state[channel];
+            state[channel] = SHELF.b1 * x - SHELF.a1 * y + state[2 + channel];
+            state[2 + channel] = SHELF.b2 * x - SHELF.a2 * y;
+
+            x = y;
+            y = x + state[4 + channel];
+            state[4 + channel] = HIGH_PASS.b1 * x - HIGH_PASS.a1 * y + state[6 + channel];
+            state[6 + channel] = x - HIGH_PASS.a2 * y;
+
+            m_blockEnergy += y * y;
+        }
+
+        if (++m_blockFrames == BLOCK_FRAMES)
+        {
+            m_blocks.append(m_blockEnergy / BLOCK_FRAMES);
+            m_blockEnergy = 0.0;
+            m_blockFrames = 0;
+        }
+    }
+#endif
+
+    // Filters ringing down in silence would otherwise end up computing with denormals
+    for(double& value : m_filterState)
+    {
+        if (std::fabs(value) < 1e-30)
+            value = 0.0;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef AUDIOANALYZER_H
+#define AUDIOANALYZER_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Measures the levels and loudness of CD audio (16-bit little endian stereo at 44.1 kHz) as it is exported.
+// Samples are fed in batches, in order, and only looked at once: peaks, clipping and energy are taken from
+// the integer samples, then the true peak is estimated with 4x oversampling and the loudness is measured
+// as described by ITU-R BS.1770 / EBU R128 (K-weighting, 400 ms blocks, absolute and relative gates).
+
+class AudioAnalyzer
+{
+public:
+    struct Result
+    {
+        /// Number of frames (one sample for each channel) analyzed
+        qint64 frames;
+
+        /// Highest absolute sample value, 1.0 being full scale
+        double samplePeak;
+
+        /// Highest absolute value between the samples, estimated with 4x oversampling
+        double truePeak;
+
+        /// Root mean square level of both channels, 1.0 being full scale
+        double rms;
+
+        /// Integrated loudness (in LUFS), minus infinity when the audio is silent or shorter than 400 ms
+        double loudness;
+
+        /// ReplayGain 2.0 gain bringing the audio to -18 LUFS (in dB), zero without a loudness
+        double replayGain;
+
+        /// Number of samples at full scale, positive or negative
+        qint64 clippedSamples;
+    };
+
+    explicit AudioAnalyzer();
+
+    /**
+     * @brief Start the analysis of a new track.
+     */
+    void reset();
+
+    /**
+     * @brief Analyze the next samples of the track. Size is rounded down to whole frames.
+     */
+    void process(const char* data, qint64 size);
+
+    /**
+     * @brief Measures of all the samples processed since the last reset.
+     */
+    Result result() const;
+
+protected:
+    void measureLevels(const char* data, int frames);
+    void decode(const char* data, int frames);
+    void measureTruePeak(int frames);
+    void measureLoudness(int frames);
+
+    qint64 m_frames;
+    int m_peak;
+    quint64 m_sumSquares;
+    qint64 m_clippedSamples;
+    float m_truePeak;
+
+    /// Decoded samples of each channel, preceded by the history needed by the oversampling filter
+    QVector<float> m_left;
+    QVector<float> m_right;
+
+    /// Oversampling filter, 4 phases for every tap
+    QVector<float> m_oversamplingFilter;
+
+    /// State of the two K-weighting filters, left and right channels interleaved
+    double m_filterState[8];
+
+    /// Energy and length of the 100 ms block being summed
+    double m_blockEnergy;
+    int m_blockFrames;
+
+    /// Mean square of every complete 100 ms block
+    QVector<double> m_blocks;
+};
+
+#endif // AUDIOANALYZER_H
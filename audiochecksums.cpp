@@ -0,0 +1,215 @@
+#include "audiochecksums.h"
+#include "endian.h"
+
+#include <array>
+#include <cstring>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+constexpr qint64 BYTES_PER_SAMPLE = 4;
+
+constexpr qint64 SAMPLES_PER_SECTOR = 588;
+
+// AccurateRip ignores the first and last five sectors of the disc, drives can not read them reliably
+constexpr qint64 ACCURATERIP_SKIPPED_SAMPLES = 5 * SAMPLES_PER_SECTOR;
+
+// CTDB leaves out ten sectors at both ends of the disc, and the last partial sector
+constexpr qint64 CTDB_SKIPPED_SAMPLES = 10 * SAMPLES_PER_SECTOR;
+
+// Tables of the reflected CRC32 (polynomial 0x04c11db7), processing 4 bytes per step
+static std::array<std::array<uint32_t, 256>, 4> buildCrcTables()
+{
+    std::array<std::array<uint32_t, 256>, 4> tables;
+
+    for(uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+
+        tables[0][i] = crc;
+    }
+
+    for(uint32_t i = 0; i < 256; ++i)
+    {
+        for(size_t table = 1; table < tables.size(); ++table)
+            tables[table][i] = (tables[table - 1][i] >> 8) ^ tables[0][tables[table - 1][i] & 0xff];
+    }
+
+    return tables;
+}
+
+static const std::array<std::array<uint32_t, 256>, 4> CRCTABLES = buildCrcTables();
+
+AudioChecksums::AudioChecksums() :
+    m_discSamples(0),
+    m_discPosition(0),
+    m_ctdbCrc(0xffffffff),
+    m_tracks(),
+    m_currentTrack(0)
+{ }
+
+void AudioChecksums::beginDisc(qint64 discSamples)
+{
+    m_discSamples = discSamples;
+    m_discPosition = 0;
+    m_ctdbCrc = 0xffffffff;
+    m_tracks.clear();
+    m_currentTrack = 0;
+}
+
+void AudioChecksums::addTrack(uint8_t track, qint64 firstSample, qint64 trackSamples, bool firstTrack, bool lastTrack)
+{
+    qint64 accurateRipFirst = firstTrack ? ACCURATERIP_SKIPPED_SAMPLES - 1 : 0;
+    qint64 accurateRipLast = lastTrack ? trackSamples - ACCURATERIP_SKIPPED_SAMPLES : trackSamples;
+
+    m_tracks.push_back({ track, firstSample, firstSample + trackSamples, accurateRipFirst, accurateRipLast, 0, 0, 0xffffffff });
+}
+
+void AudioChecksums::process(const char *data, qint64 size)
+{
+    qint64 count = size / BYTES_PER_SAMPLE;
+    qint64 batchEnd = m_discPosition + count;
+
+    // Batches follow the output files and may hold the end of a track and the start of the next one
+    for(int i = m_currentTrack; (i < m_tracks.size()) && (m_tracks.at(i).first < batchEnd); ++i)
+    {
+        Track& track = m_tracks[i];
+
+        qint64 start = qMax(m_discPosition, track.first);
+        qint64 end = qMin(batchEnd, track.end);
+
+        if (start < end)
+        {
+            const char* samples = data + (start - m_discPosition) * BYTES_PER_SAMPLE;
+            qint64 trackPosition = start - track.first;
+
+            // Part of the batch within the samples checksummed by AccurateRip
+            qint64 first = qMax(track.accurateRipFirst - trackPosition, qint64(0));
+            qint64 last = qMin(track.accurateRipLast - trackPosition, end - start);
+
+            if (first < last)
+                accumulate(track, samples + first * BYTES_PER_SAMPLE, last - first, static_cast<uint32_t>(trackPosition + first + 1));
+
+            track.crc = updateCrc(track.crc, samples, (end - start) * BYTES_PER_SAMPLE);
+        }
+
+        if (track.end <= batchEnd)
+            m_currentTrack = i + 1;
+    }
+
+    // Part of the batch within the samples checksummed by CTDB
+    qint64 ctdbLast = m_discSamples - CTDB_SKIPPED_SAMPLES - m_discSamples % SAMPLES_PER_SECTOR;
+    qint64 first = qMax(CTDB_SKIPPED_SAMPLES - m_discPosition, qint64(0));
+    qint64 last = qMin(ctdbLast - m_discPosition, count);
+
+    if (first < last)
+        m_ctdbCrc = updateCrc(m_ctdbCrc, data + first * BYTES_PER_SAMPLE, (last - first) * BYTES_PER_SAMPLE);
+
+    m_discPosition = batchEnd;
+}
+
+bool AudioChecksums::hasTrackResult(uint8_t track) const
+{
+    const Track* found = findTrack(track);
+    return found && (m_discPosition >= found->end);
+}
+
+AudioChecksums::TrackResult AudioChecksums::trackResult(uint8_t track) const
+{
+    TrackResult result = { 0, 0, 0 };
+
+    const Track* found = findTrack(track);
+    if (found)
+    {
+        result.accurateRipV1 = static_cast<uint32_t>(found->productSum);
+        result.accurateRipV2 = static_cast<uint32_t>(found->productSum) + static_cast<uint32_t>(found->highSum);
+        result.crc32 = ~found->crc;
+    }
+
+    return result;
+}
+
+uint32_t AudioChecksums::ctdbCrc() const
+{
+    return ~m_ctdbCrc;
+}
+
+const AudioChecksums::Track *AudioChecksums::findTrack(uint8_t track) const
+{
+    for(const Track& candidate : m_tracks)
+    {
+        if (candidate.number == track)
+            return &candidate;
+    }
+
+    return Q_NULLPTR;
+}
+
+void AudioChecksums::accumulate(Track &track, const char *data, qint64 count, uint32_t weight)
+{
+    // Both checksums only need the low 32 bits of their sums, which wrap around freely
+    quint64 productSum = track.productSum;
+    quint64 highSum = track.highSum;
+    qint64 i = 0;
+
+#ifdef __SSE2__
+    const __m128i step = _mm_set1_epi32(4);
+    __m128i weights = _mm_setr_epi32(static_cast<int>(weight), static_cast<int>(weight + 1), static_cast<int>(weight + 2), static_cast<int>(weight + 3));
+    __m128i products = _mm_setzero_si128();
+    __m128i highs = _mm_setzero_si128();
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * BYTES_PER_SAMPLE));
+
+        // Full 64-bit products of the even then odd samples with their positions
+        __m128i even = _mm_mul_epu32(samples, weights);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(samples, 32), _mm_srli_epi64(weights, 32));
+
+        products = _mm_add_epi64(products, _mm_add_epi64(even, odd));
+        highs = _mm_add_epi64(highs, _mm_add_epi64(_mm_srli_epi64(even, 32), _mm_srli_epi64(odd, 32)));
+
+        weights = _mm_add_epi32(weights, step);
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), products);
+    productSum += lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), highs);
+    highSum += lanes[0] + lanes[1];
+
+    weight += static_cast<uint32_t>(i);
+#endif
+
+    for(; i < count; ++i, ++weight)
+    {
+        uint32_t sample;
+        std::memcpy(&sample, data + i * BYTES_PER_SAMPLE, sizeof(sample));
+
+        quint64 product = static_cast<quint64>(LITTLE_ENDIAN_DWORD(sample)) * weight;
+        productSum += product;
+        highSum += product >> 32;
+    }
+
+    track.productSum = productSum;
+    track.highSum = highSum;
+}
+
+uint32_t AudioChecksums::updateCrc(uint32_t crc, const char *data, qint64 size)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+    for(; size >= 4; size -= 4, bytes += 4)
+    {
+        crc ^= static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) | (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        crc = CRCTABLES[3][crc & 0xff] ^ CRCTABLES[2][(crc >> 8) & 0xff] ^ CRCTABLES[1][(crc >> 16) & 0xff] ^ CRCTABLES[0][crc >> 24];
+    }
+
+    for(; size > 0; --size, ++bytes)
+        crc = CRCTABLES[0][(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
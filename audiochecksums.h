@@ -0,0 +1,98 @@
+#ifndef AUDIOCHECKSUMS_H
+#define AUDIOCHECKSUMS_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <cstdint>
+
+// Computes the checksums used to verify audio tracks against online databases, as the tracks are exported.
+// For every track: the AccurateRip v1 and v2 checksums, leaving out the first and last five sectors of the
+// disc like AccurateRip does, and the CRC32 of the track. For the whole disc: the CRC32 used by the
+// CUETools database (CTDB), leaving out its first and last ten sectors. Samples must be fed in disc order.
+// Tracks are ranges of the disc from their index 1 to the index 1 of the next track, as AccurateRip defines
+// them: the pregap of a track is checksummed with the previous track, whatever file it is written to.
+
+class AudioChecksums
+{
+public:
+    struct TrackResult
+    {
+        /// AccurateRip checksum: sum of every sample multiplied by its position in the track
+        uint32_t accurateRipV1;
+
+        /// AccurateRip v2 checksum: same as v1 with the high half of the 64-bit products added in
+        uint32_t accurateRipV2;
+
+        /// CRC32 of all the samples of the track
+        uint32_t crc32;
+    };
+
+    explicit AudioChecksums();
+
+    /**
+     * @brief Start a disc.
+     * @param discSamples Number of audio samples of the whole disc.
+     */
+    void beginDisc(qint64 discSamples);
+
+    /**
+     * @brief Add a track to the disc, after beginDisc and before the samples. Tracks are added in disc order.
+     * @param track Track number.
+     * @param firstSample Position of the index 1 of the track on the disc, in samples.
+     * @param trackSamples Number of samples up to the index 1 of the next track, or the end of the disc.
+     * @param firstTrack Track is the first of the disc, its first samples are not checksummed by AccurateRip.
+     * @param lastTrack Track is the last of the disc, its last samples are not checksummed by AccurateRip.
+     */
+    void addTrack(uint8_t track, qint64 firstSample, qint64 trackSamples, bool firstTrack, bool lastTrack);
+
+    /**
+     * @brief Checksum the next samples of the disc. Size is rounded down to whole samples.
+     */
+    void process(const char* data, qint64 size);
+
+    /**
+     * @brief Check if all the samples of a track were processed, its result is then final.
+     */
+    bool hasTrackResult(uint8_t track) const;
+
+    TrackResult trackResult(uint8_t track) const;
+
+    /**
+     * @brief CTDB CRC of the disc, once all its samples are processed.
+     */
+    uint32_t ctdbCrc() const;
+
+protected:
+    struct Track
+    {
+        uint8_t number;
+
+        /// Range of the track on the disc, in samples
+        qint64 first;
+        qint64 end;
+
+        /// Range of the track checksummed by AccurateRip, relative to its first sample
+        qint64 accurateRipFirst;
+        qint64 accurateRipLast;
+
+        quint64 productSum;
+        quint64 highSum;
+        uint32_t crc;
+    };
+
+    const Track* findTrack(uint8_t track) const;
+
+    static void accumulate(Track& track, const char* data, qint64 count, uint32_t weight);
+    static uint32_t updateCrc(uint32_t crc, const char* data, qint64 size);
+
+    qint64 m_discSamples;
+    qint64 m_discPosition;
+    uint32_t m_ctdbCrc;
+
+    QVector<Track> m_tracks;
+
+    /// First track whose samples are not all processed
+    int m_currentTrack;
+};
+
+#endif // AUDIOCHECKSUMS_H
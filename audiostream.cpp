@@ -0,0 +1,192 @@
+#include "audiostream.h"
+
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+constexpr qint64 CDROM_SECTOR_SIZE = 2352;
+
+AudioStream::AudioStream() :
+    m_toc(Q_NULLPTR),
+    m_segments(),
+    m_size(0),
+    m_file(),
+    m_fileIndex(-1),
+    m_wavFile()
+{ }
+
+void AudioStream::initialize(CdromToc *toc)
+{
+    m_toc = toc;
+    m_segments.clear();
+    m_size = 0;
+    m_wavFile.cleanup();
+    m_file.close();
+    m_fileIndex = -1;
+
+    for(int i = 0; i < toc->toc().size(); ++i)
+    {
+        const CdromToc::Entry& entry = toc->toc().at(i);
+
+        if ((entry.fileIndex == -1) || !isAudio(entry.trackType))
+            continue;
+
+        qint64 size = static_cast<qint64>(entry.trackLength) * CDROM_SECTOR_SIZE;
+        m_segments.push_back({ i, m_size, size });
+        m_size += size;
+    }
+}
+
+qint64 AudioStream::entryPosition(const CdromToc::Entry &entry) const
+{
+    for(const Segment& segment : m_segments)
+    {
+        if (&m_toc->toc().at(segment.entryIndex) == &entry)
+            return segment.position;
+    }
+
+    return -1;
+}
+
+const CdromToc::Entry *AudioStream::findEntry(qint64 position, qint64 &end) const
+{
+    for(const Segment& segment : m_segments)
+    {
+        if ((position >= segment.position) && (position < segment.position + segment.size))
+        {
+            end = segment.position + segment.size;
+            return &m_toc->toc().at(segment.entryIndex);
+        }
+    }
+
+    return Q_NULLPTR;
+}
+
+bool AudioStream::trackRange(uint8_t track, qint64 &position, qint64 &size) const
+{
+    qint64 start = -1;
+    qint64 end = m_size;
+
+    // Entries are in disc order, the first index 1 after the one of the track starts the next track
+    for(const Segment& segment : m_segments)
+    {
+        const TrackIndex& trackIndex = m_toc->toc().at(segment.entryIndex).trackIndex;
+
+        if (trackIndex.index() != 1)
+            continue;
+
+        if (trackIndex.track() == track)
+            start = segment.position;
+        else if (start >= 0)
+        {
+            end = segment.position;
+            break;
+        }
+    }
+
+    if (start < 0)
+        return false;
+
+    position = start;
+    size = end - start;
+
+    return true;
+}
+
+bool AudioStream::read(qint64 position, char *data, qint64 size) const
+{
+    std::memset(data, 0, static_cast<size_t>(size));
+
+    for(const Segment& segment : m_segments)
+    {
+        qint64 start = std::max(position, segment.position);
+        qint64 end = std::min(position + size, segment.position + segment.size);
+
+        if (start >= end)
+            continue;
+
+        const CdromToc::Entry& entry = m_toc->toc().at(segment.entryIndex);
+        const QString& fileName = m_toc->fileList().at(entry.fileIndex).fileName;
+
+        qint64 length = end - start;
+        qint64 done;
+
+        if (!openFile(entry.fileIndex, entry.trackType == CdromToc::TrackType::AudioWav))
+            return false;
+
+        if (entry.trackType == CdromToc::TrackType::AudioWav)
+        {
+            // WAV files may be converted while read, positions are those of the converted audio
+            m_wavFile.seek(entry.fileOffset + (start - segment.position));
+            done = m_wavFile.read(data + (start - position), length);
+        }
+        else if (entry.subchannelSize)
+        {
+            // The subchannel after each sector is skipped, sectors are read one piece at a time
+            qint64 stride = CDROM_SECTOR_SIZE + entry.subchannelSize;
+            qint64 offset = start - segment.position;
+            done = 0;
+
+            while(done < length)
+            {
+                qint64 inSector = offset % CDROM_SECTOR_SIZE;
+                qint64 slice = std::min(length - done, CDROM_SECTOR_SIZE - inSector);
+
+                if (!m_file.seek(entry.fileOffset + (offset / CDROM_SECTOR_SIZE) * stride + inSector) ||
+                    (m_file.read(data + (start - position) + done, slice) != slice))
+                    break;
+
+                offset += slice;
+                done += slice;
+            }
+        }
+        else
+        {
+            m_file.seek(entry.fileOffset + (start - segment.position));
+            done = m_file.read(data + (start - position), length);
+        }
+
+        if (done != length)
+        {
+            qCritical().noquote() << "Read error on input file: " << fileName;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AudioStream::openFile(int fileIndex, bool wave) const
+{
+    if ((fileIndex == m_fileIndex) && m_file.isOpen())
+        return true;
+
+    const QString& fileName = m_toc->fileList().at(fileIndex).fileName;
+
+    // The mapping of the previous WAV file goes before its file
+    m_wavFile.cleanup();
+    m_fileIndex = -1;
+
+    if (!m_file.open(fileName))
+    {
+        qCritical().noquote() << "Could not open input file: " << fileName << endl << m_file.errorString() << endl;
+        return false;
+    }
+
+    if (wave && !m_wavFile.initialize(&m_file))
+    {
+        qCritical().noquote() << "File " << fileName << " is not a valid WAV file.";
+        m_wavFile.cleanup();
+        m_file.close();
+        return false;
+    }
+
+    m_fileIndex = fileIndex;
+    return true;
+}
+
+bool AudioStream::isAudio(CdromToc::TrackType type)
+{
+    // Compressed audio can not be read yet
+    return (type == CdromToc::TrackType::AudioPCM) || (type == CdromToc::TrackType::AudioWav);
+}
@@ -0,0 +1,87 @@
+#ifndef AUDIOSTREAM_H
+#define AUDIOSTREAM_H
+
+#include <QVector>
+#include <cstdint>
+
+#include "cdromtoc.h"
+#include "inputfile.h"
+#include "wavfile.h"
+
+// Audio tracks of a disc seen as a single continuous stream of samples.
+// Only TOC entries with audio data take part in the stream, silence entries are not written out.
+// Used where samples have to be looked up across track boundaries (offset correction and detection).
+// The data file read last is kept open for the next reads, which mostly come in order, WAV files mapped with
+// their chunks indexed.
+
+class AudioStream
+{
+public:
+    explicit AudioStream();
+
+    void initialize(CdromToc* toc);
+
+    inline qint64 size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief Position of a TOC entry in the stream.
+     * @param entry Entry of the TOC the stream was built from.
+     * @return Position in bytes, or -1 if the entry has no audio data.
+     */
+    qint64 entryPosition(const CdromToc::Entry& entry) const;
+
+    /**
+     * @brief Find the TOC entry holding a position of the stream.
+     * @param[in] position Position in bytes.
+     * @param[out] end End of the data of the entry in the stream, in bytes.
+     * @return Entry, or Q_NULLPTR outside of the stream.
+     */
+    const CdromToc::Entry* findEntry(qint64 position, qint64& end) const;
+
+    /**
+     * @brief Find the part of the stream belonging to a track as AccurateRip sees it: from its index 1 to the index 1
+     * of the next audio track, or the end of the stream. The pregap of a track belongs to the previous track.
+     * @param[in] track Track number.
+     * @param[out] position Position of the track in the stream, in bytes.
+     * @param[out] size Size of the track, in bytes.
+     */
+    bool trackRange(uint8_t track, qint64& position, qint64& size) const;
+
+    /**
+     * @brief Read from the stream. Data before the start or past the end of the stream reads as zeros.
+     */
+    bool read(qint64 position, char* data, qint64 size) const;
+
+    static bool isAudio(CdromToc::TrackType type);
+
+protected:
+    struct Segment
+    {
+        /// Index of the entry in the TOC
+        int entryIndex;
+
+        /// Position of the entry data in the stream (in bytes)
+        qint64 position;
+
+        /// Size of the entry data (in bytes)
+        qint64 size;
+    };
+
+    bool openFile(int fileIndex, bool wave) const;
+
+    CdromToc* m_toc;
+    QVector<AudioStream::Segment> m_segments;
+    qint64 m_size;
+
+    /// Data file read last, and its index in the file list
+    mutable InputFile m_file;
+    mutable int m_fileIndex;
+
+    /// Audio of the data file read last when it is a WAV file, released before the file
+    mutable WavFile m_wavFile;
+};
+
+#endif // AUDIOSTREAM_H
@@ -0,0 +1,273 @@
+#include "batchscheduler.h"
+#include "blockdevice.h"
+#include "cdromtoc.h"
+#include "imagewriterworker.h"
+#include "iouringengine.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <QtDebug>
+#include <algorithm>
+
+// Exports at the same time on a device, when not configured
+constexpr int ROTATIONAL_CONCURRENCY = 1;
+constexpr int SOLID_STATE_CONCURRENCY = 4;
+constexpr int DEFAULT_CONCURRENCY = 2;
+
+// Device a disc is read from: the one of its largest data file, the CUE sheet may be on another device.
+// Image descriptors and archives list no data file, their data is next to them or in them.
+static quint64 inputDevice(const QString& cueFile)
+{
+    QString largestFile = cueFile;
+    qint64 largestSize = -1;
+
+    QStringList files;
+    if (CdromToc::listCueFiles(cueFile, files))
+    {
+        for(const QString& file : files)
+        {
+            QFileInfo info(file);
+
+            if (info.exists() && (info.size() > largestSize))
+            {
+                largestFile = file;
+                largestSize = info.size();
+            }
+        }
+    }
+
+    return BlockDevice::ofPath(largestFile);
+}
+
+class BatchJob : public QRunnable
+{
+public:
+    BatchJob(BatchScheduler& scheduler, int index) :
+        m_scheduler(scheduler),
+        m_index(index)
+    { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_scheduler.runJob(m_index);
+    }
+
+protected:
+    BatchScheduler& m_scheduler;
+    int m_index;
+};
+
+BatchScheduler::BatchScheduler() :
+    m_mutex(),
+    m_finished(),
+    m_threadPool(),
+    m_jobs(),
+    m_devices(),
+    m_options(),
+    m_deviceConcurrency(0),
+    m_threadCount(0),
+    m_running(0),
+    m_memoryBudget(0),
+    m_memoryUsed(0)
+{ }
+
+int BatchScheduler::addDirectory(const QString &inputDirectory, const QString &outputDirectory)
+{
+    QStringList cueFiles;
+
+    QDirIterator iterator(inputDirectory, { QStringLiteral("*.cue"), QStringLiteral("*.ccd"), QStringLiteral("*.mds"), QStringLiteral("*.nrg") }, QDir::Files, QDirIterator::Subdirectories);
+    while(iterator.hasNext())
+        cueFiles.append(iterator.next());
+
+    // Discs are queued in a predictable order, whatever the order of the directory entries
+    std::sort(cueFiles.begin(), cueFiles.end());
+
+    QDir input(inputDirectory);
+    QDir output(outputDirectory);
+
+    for(const QString& cueFile : cueFiles)
+        addJob(cueFile, QDir::cleanPath(output.filePath(input.relativeFilePath(QFileInfo(cueFile).path()))));
+
+    return cueFiles.size();
+}
+
+void BatchScheduler::addJob(const QString &cueFile, const QString &outputDirectory)
+{
+    Job job;
+    job.cueFile = cueFile;
+    job.outputDirectory = outputDirectory;
+    job.inputDevice = inputDevice(cueFile);
+    job.outputDevice = BlockDevice::ofPath(outputDirectory);
+    job.succeeded = false;
+
+    int queueDepth = (m_options.queueDepth > 0) ? m_options.queueDepth : IoUringEngine::deviceQueueDepth(job.outputDevice);
+    job.memory = ImageWriterWorker::exportMemory(m_options, queueDepth);
+
+    m_jobs.append(job);
+}
+
+bool BatchScheduler::run()
+{
+    m_threadPool.setMaxThreadCount((m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount());
+
+    QMutexLocker locker(&m_mutex);
+
+    for(int i = 0; i < m_jobs.size(); ++i)
+    {
+        device(m_jobs.at(i).inputDevice).pending.enqueue(i);
+        device(m_jobs.at(i).outputDevice);
+    }
+
+    int waiting = m_jobs.size();
+
+    while(waiting || m_running)
+    {
+        bool started = false;
+
+        // Every device gets a chance to start its next disc, so a slow device does not block the queue
+        for(auto i = m_devices.begin(); i != m_devices.end(); ++i)
+        {
+            Device& current = i.value();
+
+            if (current.pending.isEmpty() || (m_running >= m_threadPool.maxThreadCount()))
+                continue;
+
+            int index = current.pending.head();
+            if (!canStart(m_jobs.at(index)))
+                continue;
+
+            current.pending.dequeue();
+            acquire(m_jobs.at(index));
+            --waiting;
+            started = true;
+
+            m_threadPool.start(new BatchJob(*this, index));
+        }
+
+        if (!started)
+            m_finished.wait(&m_mutex);
+    }
+
+    int succeeded = static_cast<int>(std::count_if(m_jobs.cbegin(), m_jobs.cend(), [](const Job& job) {
+        return job.succeeded;
+    }));
+
+    qInfo().noquote() << "Exported " << succeeded << " of " << m_jobs.size() << " discs.";
+
+    return succeeded == m_jobs.size();
+}
+
+BatchScheduler::Device &BatchScheduler::device(quint64 id)
+{
+    auto i = m_devices.find(id);
+
+    if (i == m_devices.end())
+    {
+        Device device;
+        device.running = 0;
+
+        if (m_deviceConcurrency > 0)
+            device.limit = m_deviceConcurrency;
+        else
+        {
+            switch(BlockDevice::kind(id))
+            {
+            case BlockDevice::Kind::Rotational:
+                device.limit = ROTATIONAL_CONCURRENCY;
+                break;
+
+            case BlockDevice::Kind::SolidState:
+                device.limit = SOLID_STATE_CONCURRENCY;
+                break;
+
+            default:
+                device.limit = DEFAULT_CONCURRENCY;
+                break;
+            }
+        }
+
+        i = m_devices.insert(id, device);
+    }
+
+    return i.value();
+}
+
+bool BatchScheduler::canStart(const Job &job) const
+{
+    const Device& input = m_devices.find(job.inputDevice).value();
+    const Device& output = m_devices.find(job.outputDevice).value();
+
+    if ((input.running >= input.limit) || (output.running >= output.limit))
+        return false;
+
+    // A disc needing more than the whole budget runs on its own
+    if ((m_memoryBudget > 0) && (m_running > 0) && (m_memoryUsed + job.memory > m_memoryBudget))
+        return false;
+
+    return true;
+}
+
+void BatchScheduler::acquire(const Job &job)
+{
+    ++device(job.inputDevice).running;
+
+    if (job.outputDevice != job.inputDevice)
+        ++device(job.outputDevice).running;
+
+    m_memoryUsed += job.memory;
+    ++m_running;
+}
+
+void BatchScheduler::release(const Job &job)
+{
+    --device(job.inputDevice).running;
+
+    if (job.outputDevice != job.inputDevice)
+        --device(job.outputDevice).running;
+
+    m_memoryUsed -= job.memory;
+    --m_running;
+}
+
+void BatchScheduler::runJob(int index)
+{
+    Job job;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        job = m_jobs.at(index);
+    }
+
+    CdromToc toc;
+
+    if (toc.loadImage(job.cueFile))
+    {
+        if (!QDir().mkpath(job.outputDirectory))
+            qCritical().noquote() << "Could not create directory: " << job.outputDirectory;
+        else
+        {
+            ImageWriterWorker worker;
+            worker.setOptions(m_options);
+            worker.start(job.outputDirectory, QFileInfo(job.cueFile).completeBaseName(), &toc);
+
+            job.succeeded = worker.succeeded();
+        }
+    }
+
+    if (job.succeeded)
+        qInfo().noquote() << "Exported " << job.cueFile;
+    else
+        qCritical().noquote() << "Could not export " << job.cueFile;
+
+    QMutexLocker locker(&m_mutex);
+
+    m_jobs[index].succeeded = job.succeeded;
+    release(job);
+
+    m_finished.wakeAll();
+}
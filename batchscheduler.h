@@ -0,0 +1,136 @@
+#ifndef BATCHSCHEDULER_H
+#define BATCHSCHEDULER_H
+
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "exportoptions.h"
+
+// Exports every CUE sheet of a directory tree as a single job.
+// Discs are exported concurrently on a thread pool sized for the CPU stages, while each block device
+// only gets as many exports at a time as it handles well: one for spinning disks, several for flash.
+// Discs waiting for a device are queued per device, so a busy disk does not hold back the others.
+// The export buffers of all running discs stay within a global memory budget.
+
+class BatchScheduler
+{
+public:
+    struct Job
+    {
+        /// CUE sheet of the disc
+        QString cueFile;
+
+        /// Directory receiving the exported files
+        QString outputDirectory;
+
+        /// Devices read from (the one of the largest data file) and written to, see BlockDevice
+        quint64 inputDevice;
+        quint64 outputDevice;
+
+        /// Memory used by the export buffers
+        qint64 memory;
+
+        /// Set once the export is done
+        bool succeeded;
+    };
+
+    BatchScheduler();
+
+    // Non copyable
+    BatchScheduler(const BatchScheduler&) = delete;
+
+    // Non copyable
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    inline void setOptions(const ExportOptions& options)
+    {
+        m_options = options;
+    }
+
+    /**
+     * @brief Number of exports running at the same time on a device, 0 to choose from the kind of device.
+     */
+    inline void setDeviceConcurrency(int concurrency)
+    {
+        m_deviceConcurrency = concurrency;
+    }
+
+    /**
+     * @brief Memory available to the export buffers of all running discs, 0 for no limit.
+     */
+    inline void setMemoryBudget(qint64 bytes)
+    {
+        m_memoryBudget = bytes;
+    }
+
+    /**
+     * @brief Number of discs exported at the same time over all devices, 0 for one per CPU core.
+     */
+    inline void setThreadCount(int count)
+    {
+        m_threadCount = count;
+    }
+
+    /**
+     * @brief Queue every CUE sheet found under a directory.
+     * @param outputDirectory Receives the exported files, in the same tree of directories as the input.
+     * @return Number of CUE sheets found.
+     */
+    int addDirectory(const QString& inputDirectory, const QString& outputDirectory);
+
+    /**
+     * @brief Queue a single CUE sheet, the options must be set before.
+     */
+    void addJob(const QString& cueFile, const QString& outputDirectory);
+
+    /**
+     * @brief Export all queued discs, returning when they are done.
+     * @return True if all of them were exported successfully.
+     */
+    bool run();
+
+    inline const QVector<Job>& jobs() const
+    {
+        return m_jobs;
+    }
+
+protected:
+    struct Device
+    {
+        /// Maximum number of exports on the device at the same time
+        int limit;
+
+        /// Number of exports using the device
+        int running;
+
+        /// Jobs waiting to read from the device
+        QQueue<int> pending;
+    };
+
+    Device& device(quint64 id);
+    bool canStart(const Job& job) const;
+    void acquire(const Job& job);
+    void release(const Job& job);
+    void runJob(int index);
+
+    friend class BatchJob;
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+    QThreadPool m_threadPool;
+    QVector<Job> m_jobs;
+    QMap<quint64, Device> m_devices;
+    ExportOptions m_options;
+    int m_deviceConcurrency;
+    int m_threadCount;
+    int m_running;
+    qint64 m_memoryBudget;
+    qint64 m_memoryUsed;
+};
+
+#endif // BATCHSCHEDULER_H
@@ -0,0 +1,427 @@
+#include "binscanner.h"
+#include "endian.h"
+#include "sectorcoder.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+#endif
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+constexpr int CDROM_SECTOR_SIZE = 2352;
+constexpr int CDROM_DATA_SIZE = 2048;
+constexpr int CDROM_HEADER_SIZE = 16;
+constexpr int CDROM_SYNC_SIZE = 12;
+
+// Position of the EDC in Mode 1 sectors, after the header and user data
+constexpr int MODE1_EDC_OFFSET = CDROM_HEADER_SIZE + CDROM_DATA_SIZE;
+
+// Sectors read at a time
+constexpr int SCAN_SECTORS = 1024;
+
+// Disc position of the first track (00:02:00), the file starts there unless its sectors tell otherwise
+constexpr qint64 FIRST_TRACK_POSITION = 150;
+
+// Runs of digital silence at least this long (two seconds) separate audio tracks
+constexpr qint64 MIN_TRACK_GAP = 150;
+
+// More Mode 2 sectors than this mean the image has Mode 2 tracks, a few may be noise in the audio
+constexpr qint64 MAX_MODE2_SECTORS = 16;
+
+constexpr int MAX_TRACKS = 99;
+
+static const uint8_t SYNC_PATTERN[CDROM_SYNC_SIZE] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+
+// Sectors start every 2352 bytes in a BIN image, so the sync is compared at the start of each sector only
+static inline bool hasSync(const uint8_t* sector)
+{
+#ifdef __SSE2__
+    const __m128i pattern = _mm_setr_epi8(0x00, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0x00, 0, 0, 0, 0);
+    __m128i header = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sector));
+
+    return (_mm_movemask_epi8(_mm_cmpeq_epi8(header, pattern)) & 0x0fff) == 0x0fff;
+#else
+    return std::memcmp(sector, SYNC_PATTERN, CDROM_SYNC_SIZE) == 0;
+#endif
+}
+
+static inline bool isZero(const uint8_t* data, int size)
+{
+    int offset = 0;
+
+#ifdef __SSE2__
+    __m128i accumulator = _mm_setzero_si128();
+
+    for(; offset + 16 <= size; offset += 16)
+        accumulator = _mm_or_si128(accumulator, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset)));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(accumulator, _mm_setzero_si128())) != 0xffff)
+        return false;
+#endif
+
+    for(; offset < size; ++offset)
+    {
+        if (data[offset])
+            return false;
+    }
+
+    return true;
+}
+
+static inline bool decodeBcd(uint8_t value, uint32_t& result)
+{
+    if (((value >> 4) > 9) || ((value & 0x0f) > 9))
+        return false;
+
+    result = (value >> 4) * 10 + (value & 0x0f);
+    return true;
+}
+
+// Disc position of a sector from the minutes, seconds and frames of its header
+static bool readPosition(const uint8_t* sector, qint64& position)
+{
+    uint32_t m;
+    uint32_t s;
+    uint32_t f;
+
+    if (!decodeBcd(sector[12], m) || !decodeBcd(sector[13], s) || !decodeBcd(sector[14], f) || (s >= 60) || (f >= 75))
+        return false;
+
+    position = CdromToc::fromMSF(m, s, f);
+    return true;
+}
+
+static inline bool hasValidEdc(const uint8_t* sector)
+{
+    uint32_t edc;
+    std::memcpy(&edc, sector + MODE1_EDC_OFFSET, sizeof(edc));
+
+    return SectorCoder::edc(0, sector, MODE1_EDC_OFFSET) == LITTLE_ENDIAN_DWORD(edc);
+}
+
+static QString formatMsf(qint64 sectors)
+{
+    uint32_t m;
+    uint32_t s;
+    uint32_t f;
+    CdromToc::toMSF(static_cast<uint32_t>(sectors), m, s, f);
+
+    return QStringLiteral("%1:%2:%3")
+            .arg(m, 2, 10, QChar('0'))
+            .arg(s, 2, 10, QChar('0'))
+            .arg(f, 2, 10, QChar('0'));
+}
+
+bool BinScanner::scan(const QString &fileName, CdromToc &toc)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open image file: " << file.errorString();
+        return false;
+    }
+
+    QString name = QFileInfo(fileName).fileName();
+
+    if (file.size() % CDROM_SECTOR_SIZE)
+        qWarning().noquote() << "Image " << name << " does not end on a whole sector, its last " << (file.size() % CDROM_SECTOR_SIZE) << " bytes are ignored.";
+
+#ifdef Q_OS_LINUX
+    posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<Run> runs;
+    QByteArray buffer(SCAN_SECTORS * CDROM_SECTOR_SIZE, Qt::Uninitialized);
+    qint64 sector = 0;
+    qint64 edcErrors = 0;
+    qint64 mode2Sectors = 0;
+    qint64 reallyRead;
+
+    while((reallyRead = file.read(buffer.data(), buffer.size())) >= CDROM_SECTOR_SIZE)
+    {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.constData());
+        qint64 count = reallyRead / CDROM_SECTOR_SIZE;
+
+        for(qint64 i = 0; i < count; ++i, ++sector, data += CDROM_SECTOR_SIZE)
+        {
+            uint8_t mode = data[15];
+            qint64 position;
+
+            if (hasSync(data) && (mode <= 1) && readPosition(data, position))
+            {
+                Run* last = runs.isEmpty() ? Q_NULLPTR : &runs.last();
+                bool valid = (mode == 1) ? hasValidEdc(data) : isZero(data + CDROM_HEADER_SIZE, CDROM_SECTOR_SIZE - CDROM_HEADER_SIZE);
+
+                // Sectors following the previous one keep the track going even with a bad EDC,
+                // a new data track only starts on a valid sector
+                if (last && (last->type == RunType::Data) && (last->position + last->count == position))
+                {
+                    if ((mode == 0) && (last->leadingMode0 == last->count))
+                        ++last->leadingMode0;
+
+                    if ((mode == 1) && !valid)
+                        ++edcErrors;
+
+                    ++last->count;
+                    continue;
+                }
+
+                if (valid)
+                {
+                    runs.push_back({ RunType::Data, sector, 1, position, (mode == 0) ? 1 : 0 });
+                    continue;
+                }
+            }
+            else if (hasSync(data) && (mode == 2))
+                ++mode2Sectors;
+
+            appendSector(runs, isZero(data, CDROM_SECTOR_SIZE) ? RunType::Silence : RunType::Sound, sector);
+        }
+    }
+
+    if (reallyRead < 0)
+    {
+        qCritical().noquote() << "Read error on image file: " << file.errorString();
+        return false;
+    }
+
+    if (mode2Sectors > MAX_MODE2_SECTORS)
+    {
+        qCritical().noquote() << "Image " << name << " has Mode 2 sectors, only Mode 1 and audio tracks are supported.";
+        return false;
+    }
+
+    mergeShortSilences(runs);
+
+    QVector<Track> tracks;
+    if (!buildTracks(fileName, runs, tracks) || !buildToc(fileName, tracks, toc))
+        return false;
+
+    qint64 elapsed = qMax(timer.elapsed(), qint64(1));
+    qInfo().noquote() << QStringLiteral("Scanned %1: %2 MiB in %3 s (%4 MiB/s), %5 tracks found.")
+                         .arg(name)
+                         .arg(file.size() / (1024 * 1024))
+                         .arg(elapsed / 1000.0, 0, 'f', 1)
+                         .arg(file.size() * 1000.0 / (elapsed * 1024.0 * 1024.0), 0, 'f', 0)
+                         .arg(tracks.size());
+
+    for(const Track& track : tracks)
+    {
+        QString pregap;
+        if (track.pregapLength)
+            pregap = QStringLiteral(", %1 pregap %2").arg(track.pregapStored ? QStringLiteral("stored") : QStringLiteral("missing"), formatMsf(track.pregapLength));
+
+        qInfo().noquote() << QStringLiteral("Track %1: %2, %3%4.")
+                             .arg(track.number, 2, 10, QChar('0'))
+                             .arg((track.trackType == CdromToc::TrackType::AudioPCM) ? QStringLiteral("audio") : QStringLiteral("Mode 1 data"))
+                             .arg(formatMsf(track.length))
+                             .arg(pregap);
+    }
+
+    if (edcErrors)
+        qWarning().noquote() << "Data tracks contain " << edcErrors << " sectors with a bad EDC.";
+
+    return true;
+}
+
+bool BinScanner::writeCueSheet(const CdromToc &toc, const QString &cueFileName)
+{
+    QByteArray cueSheet;
+    QTextStream out(&cueSheet, QIODevice::WriteOnly);
+    out.setCodec("UTF-8");
+
+    QDir cueDirectory(QFileInfo(cueFileName).absolutePath());
+    const QVector<CdromToc::Entry>& entries = toc.toc();
+
+    int currentFile = -1;
+    uint8_t currentTrack = 0;
+
+    for(int i = 0; i < entries.size(); ++i)
+    {
+        const CdromToc::Entry& entry = entries.at(i);
+
+        if (entry.trackIndex.track() != currentTrack)
+        {
+            currentTrack = entry.trackIndex.track();
+
+            // Pregaps may not be stored, the file and type of a track are those of its index 1
+            const CdromToc::Entry* firstEntry = &entry;
+            for(int j = i; (j < entries.size()) && (entries.at(j).trackIndex.track() == currentTrack); ++j)
+            {
+                if (entries.at(j).trackIndex.index() == 1)
+                    firstEntry = &entries.at(j);
+            }
+
+            if ((firstEntry->fileIndex != -1) && (firstEntry->fileIndex != currentFile))
+            {
+                currentFile = firstEntry->fileIndex;
+                out << "FILE \"" << cueDirectory.relativeFilePath(toc.fileList().at(currentFile).fileName) << "\" BINARY" << endl;
+            }
+
+            QString trackType;
+            if (firstEntry->trackType == CdromToc::TrackType::Mode1_2352)
+                trackType = QStringLiteral("MODE1/2352");
+            else if (firstEntry->trackType == CdromToc::TrackType::Mode1_2048)
+                trackType = QStringLiteral("MODE1/2048");
+            else
+                trackType = QStringLiteral("AUDIO");
+
+            out << "  TRACK " << QStringLiteral("%1").arg(currentTrack, 2, 10, QChar('0')) << " " << trackType << endl;
+        }
+
+        if (entry.fileIndex == -1)
+        {
+            out << ((entry.trackIndex.index() == 0) ? "    PREGAP " : "    POSTGAP ") << formatMsf(entry.trackLength) << endl;
+            continue;
+        }
+
+        qint64 sectorSize = (entry.trackType == CdromToc::TrackType::Mode1_2048) ? CDROM_DATA_SIZE : CDROM_SECTOR_SIZE;
+
+        out << "    INDEX " << QStringLiteral("%1").arg(entry.trackIndex.index(), 2, 10, QChar('0')) << " "
+            << formatMsf(entry.fileOffset / sectorSize) << endl;
+    }
+
+    out.flush();
+
+    QFile outFile(cueFileName);
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qCritical().noquote() << "Could not create file: " << cueFileName << endl << outFile.errorString() << endl;
+        return false;
+    }
+
+    if (outFile.write(cueSheet) != cueSheet.size())
+    {
+        qCritical().noquote() << "Write error on file: " << cueFileName << endl << outFile.errorString() << endl;
+        return false;
+    }
+
+    qInfo().noquote() << "Wrote CUE sheet " << QFileInfo(cueFileName).fileName() << ".";
+
+    return true;
+}
+
+void BinScanner::appendSector(QVector<Run> &runs, RunType type, qint64 sector)
+{
+    if (!runs.isEmpty() && (runs.last().type == type))
+        ++runs.last().count;
+    else
+        runs.push_back({ type, sector, 1, 0, 0 });
+}
+
+void BinScanner::mergeShortSilences(QVector<Run> &runs)
+{
+    QVector<Run> merged;
+
+    for(const Run& run : runs)
+    {
+        bool afterSound = !merged.isEmpty() && (merged.last().type == RunType::Sound);
+
+        // Short silences are part of the music, and the music goes on after them
+        if (afterSound && ((run.type == RunType::Sound) || ((run.type == RunType::Silence) && (run.count < MIN_TRACK_GAP))))
+            merged.last().count += run.count;
+        else
+            merged.push_back(run);
+    }
+
+    runs = merged;
+}
+
+bool BinScanner::buildTracks(const QString &fileName, const QVector<Run> &runs, QVector<Track> &tracks)
+{
+    // Disc position of the first sector of the file
+    qint64 shift = FIRST_TRACK_POSITION;
+    if (!runs.isEmpty() && (runs.first().type == RunType::Data))
+        shift = runs.first().position;
+
+    // Silence waiting for the next track, whose pregap it is
+    qint64 silenceFirst = 0;
+    qint64 silenceCount = 0;
+
+    for(const Run& run : runs)
+    {
+        if (run.type == RunType::Silence)
+        {
+            if (!silenceCount)
+                silenceFirst = run.first;
+
+            silenceCount += run.count;
+            continue;
+        }
+
+        if (tracks.size() >= MAX_TRACKS)
+        {
+            qCritical().noquote() << "Image " << QFileInfo(fileName).fileName() << " splits into more than " << MAX_TRACKS << " tracks.";
+            return false;
+        }
+
+        qint64 index1 = run.first;
+
+        if (run.type == RunType::Data)
+        {
+            // Mode 0 sectors, and the sectors before 00:02:00 on the first track, are the pregap of a data track
+            qint64 leading = run.leadingMode0;
+            if (run.position < FIRST_TRACK_POSITION)
+                leading = qMax(leading, FIRST_TRACK_POSITION - run.position);
+
+            index1 += qMin(leading, run.count - 1);
+        }
+
+        qint64 pregapFirst = silenceCount ? silenceFirst : run.first;
+
+        Track track;
+        track.number = static_cast<uint8_t>(tracks.size() + 1);
+        track.trackType = (run.type == RunType::Data) ? CdromToc::TrackType::Mode1_2352 : CdromToc::TrackType::AudioPCM;
+        track.subchannelSize = 0;
+        track.fileName = fileName;
+        track.fileOffset = pregapFirst * CDROM_SECTOR_SIZE;
+        track.pregapLength = static_cast<uint32_t>(index1 - pregapFirst);
+        track.pregapStored = true;
+        track.length = static_cast<uint32_t>(run.first + run.count - index1);
+
+        // Header addresses tell where a data track is on the disc, sectors missing before it are a pregap left out of the file
+        if (run.type == RunType::Data)
+        {
+            qint64 gap = run.position - (run.first + shift);
+
+            if ((gap > 0) && !track.pregapLength)
+            {
+                track.fileOffset = index1 * CDROM_SECTOR_SIZE;
+                track.pregapLength = static_cast<uint32_t>(gap);
+                track.pregapStored = false;
+            }
+            else if (gap)
+            {
+                qWarning().noquote() << "Image " << QFileInfo(fileName).fileName() << ": The header addresses of track " << static_cast<int>(track.number)
+                                     << " are " << gap << " sectors away from its position in the file.";
+            }
+
+            shift += gap;
+        }
+
+        tracks.push_back(track);
+        silenceCount = 0;
+    }
+
+    // Silence at the end of the image stays in the last track
+    if (silenceCount && !tracks.isEmpty())
+        tracks.last().length += static_cast<uint32_t>(silenceCount);
+    else if (silenceCount)
+        tracks.push_back({ 1, CdromToc::TrackType::AudioPCM, 0, fileName, silenceFirst * CDROM_SECTOR_SIZE, 0, true, static_cast<uint32_t>(silenceCount) });
+
+    return true;
+}
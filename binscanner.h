@@ -0,0 +1,57 @@
+#ifndef BINSCANNER_H
+#define BINSCANNER_H
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+#include "cdromtoc.h"
+#include "imagereader.h"
+
+// Rebuilds the TOC of a raw BIN image (2352 byte sectors) whose CUE sheet is lost, from the sectors alone.
+// Mode 1 sectors are found by their sync pattern and kept as data when their EDC is valid or their header
+// address follows the previous sector; the other sectors are audio. Audio is split into tracks at runs of
+// digital silence of two seconds or more, which become the pregap of the next track, and the header
+// addresses of the data tracks tell the pregaps missing from the file. The file is read once, in order.
+
+class BinScanner : public ImageReader
+{
+public:
+    /**
+     * @brief Build the TOC of a BIN image from its sectors.
+     */
+    static bool scan(const QString& fileName, CdromToc& toc);
+
+    /**
+     * @brief Write a CUE sheet describing a TOC, with the data file named relative to the CUE sheet.
+     */
+    static bool writeCueSheet(const CdromToc& toc, const QString& cueFileName);
+
+protected:
+    /// Kind of content of consecutive sectors
+    enum class RunType
+    {
+        Data,     /// Mode 0 / Mode 1 sectors with continuous header addresses
+        Sound,    /// Audio
+        Silence   /// Audio sectors holding only zeros
+    };
+
+    struct Run
+    {
+        RunType type;
+
+        /// First sector of the run in the file, and number of sectors
+        qint64 first;
+        qint64 count;
+
+        /// Data runs: disc position of the first sector from its header, and Mode 0 sectors before the first Mode 1 sector
+        qint64 position;
+        qint64 leadingMode0;
+    };
+
+    static void appendSector(QVector<Run>& runs, RunType type, qint64 sector);
+    static void mergeShortSilences(QVector<Run>& runs);
+    static bool buildTracks(const QString& fileName, const QVector<Run>& runs, QVector<Track>& tracks);
+};
+
+#endif // BINSCANNER_H
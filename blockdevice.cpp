@@ -0,0 +1,76 @@
+#include "blockdevice.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_UNIX
+    #include <sys/stat.h>
+    #include <sys/types.h>
+#endif
+
+#ifdef Q_OS_LINUX
+    #include <sys/sysmacros.h>
+#endif
+
+quint64 BlockDevice::ofPath(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    QString current = QFileInfo(path).absoluteFilePath();
+
+    for(;;)
+    {
+        struct stat info;
+        if (stat(QFile::encodeName(current).constData(), &info) == 0)
+            return static_cast<quint64>(info.st_dev);
+
+        QString parent = QFileInfo(current).path();
+        if (parent == current)
+            return 0;
+
+        current = parent;
+    }
+#else
+    Q_UNUSED(path)
+    return 0;
+#endif
+}
+
+quint64 BlockDevice::ofHandle(int fd)
+{
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if ((fd < 0) || (fstat(fd, &info) != 0))
+        return 0;
+
+    return static_cast<quint64>(info.st_dev);
+#else
+    Q_UNUSED(fd)
+    return 0;
+#endif
+}
+
+BlockDevice::Kind BlockDevice::kind(quint64 device)
+{
+#ifdef Q_OS_LINUX
+    if (!device)
+        return Kind::Unknown;
+
+    dev_t number = static_cast<dev_t>(device);
+    QString path = QStringLiteral("/sys/dev/block/%1:%2").arg(major(number)).arg(minor(number));
+
+    // Partitions do not have a queue directory, their parent device does
+    for(const QString& queue : { path + QStringLiteral("/queue/rotational"), path + QStringLiteral("/../queue/rotational") })
+    {
+        QFile file(queue);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+
+        return (file.readAll().trimmed() == "1") ? Kind::Rotational : Kind::SolidState;
+    }
+#else
+    Q_UNUSED(device)
+#endif
+
+    return Kind::Unknown;
+}
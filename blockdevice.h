@@ -0,0 +1,30 @@
+#ifndef BLOCKDEVICE_H
+#define BLOCKDEVICE_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Identification of the block device holding a file, to tune and schedule I/O per device.
+// Devices are identified by the device number of the files they hold, 0 when it is unknown.
+
+class BlockDevice
+{
+public:
+    enum class Kind
+    {
+        Unknown,
+        Rotational,
+        SolidState
+    };
+
+    /**
+     * @brief Device holding a path. Paths that do not exist yet use the device of their closest existing parent.
+     */
+    static quint64 ofPath(const QString& path);
+
+    static quint64 ofHandle(int fd);
+
+    static Kind kind(quint64 device);
+};
+
+#endif // BLOCKDEVICE_H
@@ -0,0 +1,167 @@
+#include "bufferpool.h"
+
+#include <cstdlib>
+
+#ifdef Q_OS_UNIX
+    #include <sys/mman.h>
+#endif
+
+#ifdef Q_OS_WIN
+    #include <malloc.h>
+#endif
+
+// Buffers are aligned on pages so they can be used for O_DIRECT and registered with io_uring
+constexpr qint64 BUFFER_PAGE_SIZE = 4096;
+
+// Huge pages are 2 MiB on the platforms we care about
+constexpr qint64 HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+BufferPool::Lease::Lease(BufferPool &pool) :
+    m_pool(pool),
+    m_index(pool.acquire()),
+    m_data(pool.buffer(m_index))
+{ }
+
+BufferPool::Lease::~Lease()
+{
+    m_pool.release(m_index);
+}
+
+BufferPool::BufferPool() :
+    m_mutex(),
+    m_released(),
+    m_freeList(),
+    m_slab(Q_NULLPTR),
+    m_slabSize(0),
+    m_bufferSize(0),
+    m_capacity(0),
+    m_hugePages(false),
+    m_mapped(false),
+    m_allocations(0)
+{ }
+
+BufferPool::~BufferPool()
+{
+    cleanup();
+}
+
+bool BufferPool::initialize(int bufferCount, qint64 bufferSize, bool hugePages)
+{
+    cleanup();
+
+    if ((bufferCount <= 0) || (bufferSize <= 0))
+        return false;
+
+    m_bufferSize = (bufferSize + BUFFER_PAGE_SIZE - 1) & ~(BUFFER_PAGE_SIZE - 1);
+    m_slabSize = m_bufferSize * bufferCount;
+
+#if defined(Q_OS_LINUX) && defined(MAP_HUGETLB)
+    if (hugePages)
+    {
+        // Explicit huge pages need to be reserved by the administrator, this fails otherwise
+        qint64 size = (m_slabSize + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        void* memory = mmap(Q_NULLPTR, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (memory != MAP_FAILED)
+        {
+            m_slab = static_cast<char*>(memory);
+            m_slabSize = size;
+            m_mapped = true;
+            m_hugePages = true;
+        }
+    }
+#endif
+
+    if (!m_slab)
+    {
+        void* memory = Q_NULLPTR;
+
+#ifdef Q_OS_WIN
+        memory = _aligned_malloc(static_cast<size_t>(m_slabSize), BUFFER_PAGE_SIZE);
+#else
+        if (posix_memalign(&memory, hugePages ? HUGE_PAGE_SIZE : BUFFER_PAGE_SIZE, static_cast<size_t>(m_slabSize)) != 0)
+            memory = Q_NULLPTR;
+#endif
+
+        if (!memory)
+            return false;
+
+        m_slab = static_cast<char*>(memory);
+
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+        // Fall back to transparent huge pages
+        if (hugePages)
+            m_hugePages = (madvise(m_slab, static_cast<size_t>(m_slabSize), MADV_HUGEPAGE) == 0);
+#endif
+    }
+
+    ++m_allocations;
+
+    m_capacity = bufferCount;
+    m_freeList.reserve(bufferCount);
+
+    for(int i = bufferCount - 1; i >= 0; --i)
+        m_freeList.push_back(i);
+
+    return true;
+}
+
+void BufferPool::cleanup()
+{
+    if (m_slab)
+    {
+#ifdef Q_OS_UNIX
+        if (m_mapped)
+            munmap(m_slab, static_cast<size_t>(m_slabSize));
+        else
+            std::free(m_slab);
+#elif defined(Q_OS_WIN)
+        _aligned_free(m_slab);
+#else
+        std::free(m_slab);
+#endif
+    }
+
+    m_freeList.clear();
+    m_slab = Q_NULLPTR;
+    m_slabSize = 0;
+    m_bufferSize = 0;
+    m_capacity = 0;
+    m_hugePages = false;
+    m_mapped = false;
+}
+
+int BufferPool::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while(m_freeList.isEmpty())
+        m_released.wait(&m_mutex);
+
+    return m_freeList.takeLast();
+}
+
+int BufferPool::tryAcquire()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_freeList.isEmpty())
+        return -1;
+
+    return m_freeList.takeLast();
+}
+
+void BufferPool::release(int index)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_freeList.push_back(index);
+    m_released.wakeOne();
+}
+
+qint64 BufferPool::takeAllocations()
+{
+    qint64 count = m_allocations;
+    m_allocations = 0;
+    return count;
+}
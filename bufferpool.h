@@ -0,0 +1,123 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+#include <QtGlobal>
+
+// Fixed set of page-aligned buffers shared by the export pipeline.
+// All buffers are carved out of a single slab, optionally backed by huge pages, allocated once.
+// The number of buffers bounds the memory used: acquiring blocks until a buffer is released.
+
+class BufferPool
+{
+public:
+    /**
+     * @brief RAII helper holding a buffer for the lifetime of the object.
+     */
+    class Lease
+    {
+    public:
+        explicit Lease(BufferPool& pool);
+        ~Lease();
+
+        // Non copyable
+        Lease(const Lease&) = delete;
+
+        // Non copyable
+        Lease& operator=(const Lease&) = delete;
+
+        inline char* data() const
+        {
+            return m_data;
+        }
+
+        inline int index() const
+        {
+            return m_index;
+        }
+
+    protected:
+        BufferPool& m_pool;
+        int m_index;
+        char* m_data;
+    };
+
+    BufferPool();
+    ~BufferPool();
+
+    // Non copyable
+    BufferPool(const BufferPool&) = delete;
+
+    // Non copyable
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * @brief Allocate the buffers.
+     * @param bufferCount Maximum number of buffers in use at the same time.
+     * @param bufferSize Size of each buffer, rounded up to the page size.
+     * @param hugePages Try to back the buffers with huge pages.
+     */
+    bool initialize(int bufferCount, qint64 bufferSize, bool hugePages);
+
+    void cleanup();
+
+    inline bool isInitialized() const
+    {
+        return m_slab != Q_NULLPTR;
+    }
+
+    inline int capacity() const
+    {
+        return m_capacity;
+    }
+
+    inline qint64 bufferSize() const
+    {
+        return m_bufferSize;
+    }
+
+    inline bool usesHugePages() const
+    {
+        return m_hugePages;
+    }
+
+    inline char* buffer(int index) const
+    {
+        return m_slab + index * m_bufferSize;
+    }
+
+    /**
+     * @brief Take a buffer, waiting for one to be released if they are all in use.
+     * @return Index of the buffer.
+     */
+    int acquire();
+
+    /**
+     * @brief Take a buffer if one is free.
+     * @return Index of the buffer, or -1 if they are all in use.
+     */
+    int tryAcquire();
+
+    void release(int index);
+
+    /**
+     * @brief Return the number of heap allocations done since the last call, for statistics.
+     */
+    qint64 takeAllocations();
+
+protected:
+    QMutex m_mutex;
+    QWaitCondition m_released;
+    QVector<int> m_freeList;
+    char* m_slab;
+    qint64 m_slabSize;
+    qint64 m_bufferSize;
+    int m_capacity;
+    bool m_hugePages;
+    bool m_mapped;
+    qint64 m_allocations;
+};
+
+#endif // BUFFERPOOL_H
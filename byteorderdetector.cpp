@@ -0,0 +1,84 @@
+#include "byteorderdetector.h"
+
+#include <cstring>
+#include <limits>
+
+// Bytes of a stereo frame
+constexpr int FRAME_SIZE = 4;
+
+// Frames measured before the byte order is settled: 300 sectors, about 4 seconds
+constexpr qint64 DETECTION_FRAMES = 300 * 588;
+
+// One order must have this many times less energy than the other to be chosen
+constexpr double DECISION_RATIO = 4.0;
+
+static inline int32_t littleSample(const uint8_t* data)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(data[0] | (data[1] << 8)));
+}
+
+static inline int32_t bigSample(const uint8_t* data)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>((data[0] << 8) | data[1]));
+}
+
+static inline quint64 squaredDifference(int32_t a, int32_t b)
+{
+    int64_t difference = a - b;
+    return static_cast<quint64>(difference * difference);
+}
+
+ByteOrderDetector::ByteOrderDetector() :
+    m_littleEnergy(0),
+    m_bigEnergy(0),
+    m_frames(0),
+    m_previous(),
+    m_hasPrevious(false),
+    m_settled(false)
+{
+}
+
+void ByteOrderDetector::reset()
+{
+    m_littleEnergy = 0;
+    m_bigEnergy = 0;
+    m_frames = 0;
+    m_hasPrevious = false;
+    m_settled = false;
+}
+
+void ByteOrderDetector::process(const char *data, qint64 size)
+{
+    const uint8_t* frame = reinterpret_cast<const uint8_t*>(data);
+    qint64 frameCount = size / FRAME_SIZE;
+
+    for(qint64 i = 0; (i < frameCount) && !m_settled; ++i, frame += FRAME_SIZE)
+    {
+        if (m_hasPrevious && std::memcmp(frame, m_previous, FRAME_SIZE))
+        {
+            for(int channel = 0; channel < FRAME_SIZE; channel += 2)
+            {
+                m_littleEnergy += squaredDifference(littleSample(frame + channel), littleSample(m_previous + channel));
+                m_bigEnergy += squaredDifference(bigSample(frame + channel), bigSample(m_previous + channel));
+            }
+
+            m_settled = (++m_frames >= DETECTION_FRAMES);
+        }
+
+        std::memcpy(m_previous, frame, FRAME_SIZE);
+        m_hasPrevious = true;
+    }
+}
+
+bool ByteOrderDetector::isSwapped() const
+{
+    return static_cast<double>(m_bigEnergy) * DECISION_RATIO < static_cast<double>(m_littleEnergy);
+}
+
+double ByteOrderDetector::ratio() const
+{
+    if (!m_bigEnergy)
+        return m_littleEnergy ? std::numeric_limits<double>::infinity() : 1.0;
+
+    return static_cast<double>(m_littleEnergy) / static_cast<double>(m_bigEnergy);
+}
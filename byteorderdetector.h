@@ -0,0 +1,68 @@
+#ifndef BYTEORDERDETECTOR_H
+#define BYTEORDERDETECTOR_H
+
+#include <QtGlobal>
+#include <cstdint>
+
+// Tells byte swapped (big endian) audio tracks apart from the little endian samples of CD audio. Music changes
+// little from one sample to the next, so the sum of the squared differences between consecutive samples of a
+// channel is much lower when the bytes are read in the right order. Both orders are measured on the first
+// sectors of the track, repeated frames (digital silence) are left out as they read the same in both orders.
+
+class ByteOrderDetector
+{
+public:
+    explicit ByteOrderDetector();
+
+    /**
+     * @brief Start the detection of a new track.
+     */
+    void reset();
+
+    /**
+     * @brief Measure the next samples of the track, until enough of them are known. Size is rounded down to whole frames.
+     */
+    void process(const char* data, qint64 size);
+
+    /**
+     * @brief Settle the detection with the samples measured so far, when the track has no more.
+     */
+    inline void finish()
+    {
+        m_settled = true;
+    }
+
+    /**
+     * @brief Check if enough samples were measured, the next ones are then ignored.
+     */
+    inline bool isSettled() const
+    {
+        return m_settled;
+    }
+
+    /**
+     * @brief Check if the samples measured so far are clearly byte swapped. Undecided tracks are read as little endian.
+     */
+    bool isSwapped() const;
+
+    /**
+     * @brief Ratio of the little endian energy to the big endian energy, above one for swapped tracks.
+     */
+    double ratio() const;
+
+protected:
+    /// Energy of the sample differences, with the samples read as little endian then big endian
+    quint64 m_littleEnergy;
+    quint64 m_bigEnergy;
+
+    /// Frames measured, repeated frames excluded
+    qint64 m_frames;
+
+    /// Last frame of the previous call, the first frame of the next call is compared to it
+    uint8_t m_previous[4];
+    bool m_hasPrevious;
+
+    bool m_settled;
+};
+
+#endif // BYTEORDERDETECTOR_H
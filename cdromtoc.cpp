@@ -5,10 +5,18 @@
 #include <QTextStream>
 #include <QtDebug>
 #include <algorithm>
+#include <limits>
 
+#include "binscanner.h"
 #include "cdromtoc.h"
+#include "inputfile.h"
+#include "imagereader.h"
+#include "streaminput.h"
 #include "wavfile.h"
 
+// FILE command of a CUE sheet, shared by the parser and the file listing
+static const QRegularExpression FILE_REGEX("^\\s*FILE\\s+\"(.*)\"\\s+(\\S+)\\s*$", QRegularExpression::CaseInsensitiveOption);
+
 static QString pathReplaceFilename(const QString& path, const QString& newFilename)
 {
     return QFileInfo(QFileInfo(path).dir(), newFilename).filePath();
@@ -19,31 +27,54 @@ CdromToc::CdromToc() :
     m_fileList(),
     m_firstTrack(0),
     m_lastTrack(0),
-    m_totalSectors(0)
+    m_totalSectors(0),
+    m_standardInputSize(0),
+    m_zipFile(),
+    m_zipCueDirectory(),
+    m_zipMembers()
 { }
 
+bool CdromToc::loadImage(const QString &filename)
+{
+    QString suffix = QFileInfo(filename).suffix();
+
+    if (suffix.compare(QStringLiteral("CCD"), Qt::CaseInsensitive) == 0)
+        return ImageReader::loadCloneCd(filename, *this);
+
+    if (suffix.compare(QStringLiteral("MDS"), Qt::CaseInsensitive) == 0)
+        return ImageReader::loadMds(filename, *this);
+
+    if (suffix.compare(QStringLiteral("NRG"), Qt::CaseInsensitive) == 0)
+        return ImageReader::loadNrg(filename, *this);
+
+    // Without its CUE sheet, the tracks of a BIN image are found from its sectors
+    if (suffix.compare(QStringLiteral("BIN"), Qt::CaseInsensitive) == 0)
+        return BinScanner::scan(filename, *this);
+
+    return loadCueSheet(filename);
+}
+
+bool CdromToc::isImageDescriptor(const QString &filename)
+{
+    static const QStringList SUFFIXES = { QStringLiteral("cue"), QStringLiteral("zip"), QStringLiteral("ccd"), QStringLiteral("mds"), QStringLiteral("nrg") };
+
+    return SUFFIXES.contains(QFileInfo(filename).suffix(), Qt::CaseInsensitive);
+}
+
 bool CdromToc::loadCueSheet(const QString &filename)
 {
-    static const QRegularExpression FILE_REGEX("^\\s*FILE\\s+\"(.*)\"\\s+(\\S+)\\s*$", QRegularExpression::CaseInsensitiveOption);
     static const QRegularExpression TRACK_REGEX("^\\s*TRACK\\s+([0-9]+)\\s+(\\S*)\\s*$", QRegularExpression::CaseInsensitiveOption);
     static const QRegularExpression PREGAP_REGEX("^\\s*PREGAP\\s+([0-9]+):([0-9]+):([0-9]+)\\s*$", QRegularExpression::CaseInsensitiveOption);
     static const QRegularExpression INDEX_REGEX("^\\s*INDEX\\s+([0-9]+)\\s+([0-9]+):([0-9]+):([0-9]+)\\s*$", QRegularExpression::CaseInsensitiveOption);
     static const QRegularExpression POSTGAP_REGEX("^\\s*POSTGAP\\s+([0-9]+):([0-9]+):([0-9]+)\\s*$", QRegularExpression::CaseInsensitiveOption);
 
-    m_toc.clear();
-    m_fileList.clear();
-    m_firstTrack = 0;
-    m_lastTrack = 0;
-    m_totalSectors = 0;
+    clear();
 
-    QFile inFile(filename);
-    if (!inFile.open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        qCritical().noquote() << "Could not open CUE file: " << inFile.errorString();
+    QByteArray cueData;
+    if (!readCueSheet(filename, cueData))
         return false;
-    }
 
-    QTextStream in(&inFile);
+    QTextStream in(&cueData, QIODevice::ReadOnly);
     in.setCodec("UTF-8");
 
     //***********************************
@@ -55,7 +86,6 @@ bool CdromToc::loadCueSheet(const QString &filename)
     // - Make a list of all source files, with their size. (Size of uncompressed audio for audio tracks)
     //***********************************
 
-    QString currentFile;
     int currentFileIndex = -1;
     TrackType currentFileAudioType = TrackType::AudioPCM;
     int currentTrack = -1;
@@ -74,7 +104,6 @@ bool CdromToc::loadCueSheet(const QString &filename)
         match = FILE_REGEX.match(line);
         if (match.hasMatch())
         {
-            currentFile = pathReplaceFilename(filename, match.captured(1));
             currentTrack = -1;
             currentIndex = -1;
             currentType = TrackType::Silence;
@@ -92,30 +121,41 @@ bool CdromToc::loadCueSheet(const QString &filename)
                 return false;
             }
 
-            auto i = std::find_if(m_fileList.cbegin(), m_fileList.cend(), [&](const FileEntry& entry) { return entry.fileName == currentFile; });
-            if (i == m_fileList.cend())
-            {
-                QFile file(currentFile);
-                if (!file.open(QIODevice::ReadOnly))
-                {
-                    qCritical().noquote() << "File " << match.captured(1) << " could not be opened: " << file.errorString();
-                    return false;
-                }
+            FileEntry currentFile;
+            if (!resolveFile(filename, match.captured(1), currentFile))
+                return false;
 
-                qint64 fileSize;
+            // Members of the same archive share its file name
+            auto i = std::find_if(m_fileList.cbegin(), m_fileList.cend(), [&](const FileEntry& entry)
+            {
+                return (entry.fileName == currentFile.fileName) && (entry.sourceOffset == currentFile.sourceOffset);
+            });
 
+            if (i == m_fileList.cend())
+            {
                 if (isBinary)
-                {
-                    fileSize = file.size();
                     currentFileAudioType = TrackType::AudioPCM;
-                }
                 else
                 {
-                    if (!findAudioFileSize(file, fileSize, currentFileAudioType))
+                    // The WAV header is parsed in place, the data is not found by reading forward
+                    if (currentFile.source != FileSource::Plain)
+                    {
+                        qCritical().noquote() << "File " << match.captured(1) << ": WAVE files can only be read from the disk, not from an archive or a pipe.";
+                        return false;
+                    }
+
+                    InputFile file;
+                    if (!file.open(currentFile.fileName))
+                    {
+                        qCritical().noquote() << "File " << match.captured(1) << " could not be opened: " << file.errorString();
+                        return false;
+                    }
+
+                    if (!findAudioFileSize(currentFile.fileName, file, currentFile.fileSize, currentFileAudioType))
                         return false;
                 }
 
-                m_fileList.push_back({currentFile, fileSize});
+                m_fileList.push_back(currentFile);
 
                 currentFileIndex = m_fileList.size() - 1;
             }
@@ -209,7 +249,7 @@ bool CdromToc::loadCueSheet(const QString &filename)
             uint32_t f = match.captured(3).toUInt();
             uint32_t length = fromMSF(m, s, f);
 
-            m_toc.push_back({ -1, { static_cast<uint8_t>(currentTrack), 0 }, TrackType::Silence, 0, 0, 0, length });
+            m_toc.push_back({ -1, { static_cast<uint8_t>(currentTrack), 0 }, TrackType::Silence, 0, 0, 0, length, 0 });
 
             trackHasPregap = true;
 
@@ -261,7 +301,7 @@ bool CdromToc::loadCueSheet(const QString &filename)
             if (currentIndex == 1)
                 trackHasIndexOne = true;
 
-            m_toc.push_back({ currentFileIndex, { static_cast<uint8_t>(currentTrack), static_cast<uint8_t>(currentIndex) }, currentType, indexPosition, 0, 0, 0 });
+            m_toc.push_back({ currentFileIndex, { static_cast<uint8_t>(currentTrack), static_cast<uint8_t>(currentIndex) }, currentType, indexPosition, 0, 0, 0, 0 });
 
             continue;
         }
@@ -293,7 +333,7 @@ bool CdromToc::loadCueSheet(const QString &filename)
             uint32_t f = match.captured(3).toUInt();
             uint32_t length = fromMSF(m, s, f);
 
-            m_toc.push_back({ -1, { static_cast<uint8_t>(currentTrack), static_cast<uint8_t>(currentIndex) }, TrackType::Silence, 0, 0, 0, length });
+            m_toc.push_back({ -1, { static_cast<uint8_t>(currentTrack), static_cast<uint8_t>(currentIndex) }, TrackType::Silence, 0, 0, 0, length, 0 });
 
             trackHasPostgap = true;
 
@@ -354,7 +394,7 @@ bool CdromToc::loadCueSheet(const QString &filename)
             continue;
         }
 
-        size_t currentFileOffset = 0;
+        qint64 currentFileOffset = 0;
 
         auto end = std::next(i, count);
         while(i != end)
@@ -362,7 +402,7 @@ bool CdromToc::loadCueSheet(const QString &filename)
             auto next = std::next(i, 1);
 
             uint32_t trackLength = 0;
-            size_t sectorSize = 0;
+            qint64 sectorSize = 0;
 
             // Find the sector size from enty type
             if ((*i)->trackType == TrackType::Mode1_2048)
@@ -373,7 +413,15 @@ bool CdromToc::loadCueSheet(const QString &filename)
             if (next == end)
             {
                 // Last TOC entry of the file, calculate from the file size instead
-                trackLength = static_cast<uint32_t>((static_cast<size_t>(m_fileList.at(fileIndex).fileSize) - currentFileOffset) / sectorSize);
+                qint64 sectors = (m_fileList.at(fileIndex).fileSize - currentFileOffset) / sectorSize;
+
+                if ((sectors < 0) || (sectors > std::numeric_limits<uint32_t>::max()))
+                {
+                    qCritical().noquote() << "Invalid CUE sheet: Indexes of file " << QFileInfo(m_fileList.at(fileIndex).fileName).fileName() << " do not match its size.";
+                    return false;
+                }
+
+                trackLength = static_cast<uint32_t>(sectors);
             }
             else
             {
@@ -386,7 +434,7 @@ bool CdromToc::loadCueSheet(const QString &filename)
             (*i)->trackLength = trackLength;
 
             // Update the file offset
-            currentFileOffset += (trackLength * sectorSize);
+            currentFileOffset += static_cast<qint64>(trackLength) * sectorSize;
             ++i;
         }
     }
@@ -397,6 +445,25 @@ bool CdromToc::loadCueSheet(const QString &filename)
     // - Calculate the position of everything on our virtual disc
     //***********************
 
+    updatePositions();
+
+    return true;
+}
+
+void CdromToc::clear()
+{
+    m_toc.clear();
+    m_fileList.clear();
+    m_firstTrack = 0;
+    m_lastTrack = 0;
+    m_totalSectors = 0;
+    m_zipFile.clear();
+    m_zipCueDirectory.clear();
+    m_zipMembers.clear();
+}
+
+void CdromToc::updatePositions()
+{
     uint32_t currentSector = 0;
 
     for(CdromToc::Entry& entry : m_toc)
@@ -408,8 +475,11 @@ bool CdromToc::loadCueSheet(const QString &filename)
     m_totalSectors = currentSector;
     m_firstTrack = m_toc.first().trackIndex.track() ;
     m_lastTrack = m_toc.last().trackIndex.track() ;
+}
 
-    return true;
+bool CdromToc::hasSeekableFiles() const
+{
+    return std::all_of(m_fileList.cbegin(), m_fileList.cend(), [](const FileEntry& entry) { return entry.source == FileSource::Plain; });
 }
 
 const CdromToc::Entry *CdromToc::findTocEntry(const TrackIndex &trackIndex)
@@ -425,9 +495,167 @@ const CdromToc::Entry *CdromToc::findTocEntry(const TrackIndex &trackIndex)
     return i;
 }
 
-bool CdromToc::findAudioFileSize(QFile &file, qint64 &fileSize, TrackType &trackType)
+bool CdromToc::listCueFiles(const QString &filename, QStringList &files)
+{
+    files.clear();
+
+    if (QFileInfo(filename).suffix().compare(QStringLiteral("ZIP"), Qt::CaseInsensitive) == 0)
+        return QFileInfo(filename).isFile();
+
+    QFile inFile(filename);
+    if (!inFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream in(&inFile);
+    in.setCodec("UTF-8");
+
+    while(!in.atEnd())
+    {
+        QRegularExpressionMatch match = FILE_REGEX.match(in.readLine());
+
+        if (match.hasMatch())
+        {
+            QString file = findDataFile(pathReplaceFilename(filename, match.captured(1)));
+
+            if (!files.contains(file))
+                files.append(file);
+        }
+    }
+
+    return true;
+}
+
+QString CdromToc::findDataFile(const QString &filename)
+{
+    if (QFileInfo::exists(filename))
+        return filename;
+
+    // Compressed images keep the names of the CUE sheet, with a .gz or .ecm suffix added
+    for(const QString& suffix : { QStringLiteral(".gz"), QStringLiteral(".ecm") })
+    {
+        if (QFileInfo::exists(filename + suffix))
+            return filename + suffix;
+    }
+
+    return filename;
+}
+
+bool CdromToc::readCueSheet(const QString &filename, QByteArray &data)
+{
+    if (QFileInfo(filename).suffix().compare(QStringLiteral("ZIP"), Qt::CaseInsensitive) != 0)
+    {
+        QFile inFile(filename);
+        if (!inFile.open(QIODevice::ReadOnly))
+        {
+            qCritical().noquote() << "Could not open CUE file: " << inFile.errorString();
+            return false;
+        }
+
+        data = inFile.readAll();
+        return true;
+    }
+
+    // The CUE sheet of an archive is its first member with a .cue suffix, the data files are found next to it
+    if (!StreamInput::readZipDirectory(filename, m_zipMembers))
+        return false;
+
+    auto i = std::find_if(m_zipMembers.cbegin(), m_zipMembers.cend(), [](const ZipMember& member)
+    {
+        return member.name.endsWith(QStringLiteral(".cue"), Qt::CaseInsensitive);
+    });
+
+    if (i == m_zipMembers.cend())
+    {
+        qCritical().noquote() << "Archive " << QFileInfo(filename).fileName() << " holds no CUE sheet.";
+        return false;
+    }
+
+    FileEntry entry = { filename, i->size, FileSource::ZipMember, i->dataOffset, i->compressedSize, i->method };
+
+    if (!StreamInput::readFile(entry, data))
+    {
+        qCritical().noquote() << "Could not read CUE sheet " << i->name << " from the archive.";
+        return false;
+    }
+
+    m_zipFile = filename;
+    m_zipCueDirectory = QFileInfo(i->name).path();
+
+    return true;
+}
+
+bool CdromToc::resolveFile(const QString &cueFilename, const QString &name, CdromToc::FileEntry &entry)
+{
+    if (m_standardInputSize > 0)
+    {
+        // The pipe has no name to tell files apart
+        if (!m_fileList.isEmpty())
+        {
+            qCritical().noquote() << "Only CUE sheets with a single data file can be read from the standard input.";
+            return false;
+        }
+
+        entry = { QStringLiteral("-"), m_standardInputSize, FileSource::StandardInput, 0, m_standardInputSize, 0 };
+        return true;
+    }
+
+    if (!m_zipFile.isEmpty())
+    {
+        QString memberName = QDir::cleanPath(m_zipCueDirectory + QChar('/') + name);
+
+        auto i = std::find_if(m_zipMembers.cbegin(), m_zipMembers.cend(), [&](const ZipMember& member)
+        {
+            return member.name.compare(memberName, Qt::CaseInsensitive) == 0;
+        });
+
+        if (i == m_zipMembers.cend())
+        {
+            qCritical().noquote() << "File " << name << " is not in the archive.";
+            return false;
+        }
+
+        entry = { m_zipFile, i->size, FileSource::ZipMember, i->dataOffset, i->compressedSize, i->method };
+        return true;
+    }
+
+    QString fileName = findDataFile(pathReplaceFilename(cueFilename, name));
+
+    // Compressed data files are told by their suffix, named in the CUE sheet or added when looking for the file
+    QString suffix = QFileInfo(fileName).suffix();
+    FileSource source = FileSource::Plain;
+
+    if (suffix.compare(QStringLiteral("GZ"), Qt::CaseInsensitive) == 0)
+        source = FileSource::Gzip;
+    else if (suffix.compare(QStringLiteral("ECM"), Qt::CaseInsensitive) == 0)
+        source = FileSource::Ecm;
+
+    if (source != FileSource::Plain)
+    {
+        qint64 size = (source == FileSource::Gzip) ? StreamInput::gzipSize(fileName) : StreamInput::ecmSize(fileName);
+        if (size < 0)
+        {
+            qCritical().noquote() << "File " << QFileInfo(fileName).fileName() << " is not a valid " << ((source == FileSource::Gzip) ? "gzip" : "ECM") << " file.";
+            return false;
+        }
+
+        entry = { fileName, size, source, 0, QFileInfo(fileName).size(), 0 };
+        return true;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "File " << name << " could not be opened: " << file.errorString();
+        return false;
+    }
+
+    entry = { fileName, file.size(), FileSource::Plain, 0, file.size(), 0 };
+    return true;
+}
+
+bool CdromToc::findAudioFileSize(const QString &fileName, InputFile &file, qint64 &fileSize, TrackType &trackType)
 {
-    QFileInfo fileInfo(file.fileName());
+    QFileInfo fileInfo(fileName);
 
     if (fileInfo.suffix().compare(QStringLiteral("WAV"), Qt::CaseInsensitive) == 0)
     {
@@ -3,11 +3,14 @@
 
 #include <QFile>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 #include <cstdint>
 
 #include "trackindex.h"
 
+class InputFile;
+
 class CdromToc
 {
 public:
@@ -23,6 +26,16 @@ public:
         AudioWav     /// WAV audio
     };
 
+    /// Enum representing where the data of a file is read from
+    enum class FileSource
+    {
+        Plain,          /// File read in place
+        Gzip,           /// gzip compressed file
+        ZipMember,      /// Member of a zip archive, stored or deflate compressed
+        Ecm,            /// ECM file, sectors rebuilt from their address and user data
+        StandardInput   /// Data piped to the standard input
+    };
+
     struct Entry
     {
         /// Index of file holding the track data in the file list
@@ -41,25 +54,99 @@ public:
         uint32_t startSector;
 
         /// Offset to the data of the track in the file (in bytes)
-        size_t fileOffset;
+        qint64 fileOffset;
 
         /// Track length (in sectors)
         uint32_t trackLength;
+
+        /// Subchannel bytes interleaved after each sector in the file (0 or 96)
+        uint32_t subchannelSize;
     };
 
     struct FileEntry
     {
-        /// Path to the data file
+        /// Path to the data file (the archive for zip members, "-" for the standard input)
         QString fileName;
 
         /// Size of the file, in bytes. For audio files this the size of uncompressed audio.
         qint64 fileSize;
+
+        /// Where the data is read from, anything but plain files can only be read forward
+        CdromToc::FileSource source;
+
+        /// Offset of the data in the file (zip members)
+        qint64 sourceOffset;
+
+        /// Size of the data in the file, compressed (zip members)
+        qint64 sourceSize;
+
+        /// Compression method of zip members (0: stored, 8: deflate)
+        int compression;
+    };
+
+    struct ZipMember
+    {
+        /// Path of the member in the archive
+        QString name;
+
+        /// Compression method (0: stored, 8: deflate)
+        int method;
+
+        /// Offset of the member data in the archive
+        qint64 dataOffset;
+
+        /// Size of the member data in the archive (in bytes)
+        qint64 compressedSize;
+
+        /// Size of the member once decompressed (in bytes)
+        qint64 size;
     };
 
     explicit CdromToc();
 
+    /**
+     * @brief Load the TOC of an image, from its CUE sheet or from a CloneCD (.ccd), Alcohol (.mds) or Nero (.nrg) descriptor.
+     * A BIN file given alone is scanned to rebuild its tracks.
+     */
+    bool loadImage(const QString& filename);
+
+    /**
+     * @brief Check if a file describes the tracks of a disc, as opposed to a single data track.
+     */
+    static bool isImageDescriptor(const QString& filename);
+
+    /**
+     * @brief Load a CUE sheet, or the first CUE sheet of a zip archive.
+     * Data files missing next to the CUE sheet are looked for with a .gz or .ecm suffix.
+     */
     bool loadCueSheet(const QString& filename);
 
+    /**
+     * @brief Read the data file of the next CUE sheet loaded from the standard input.
+     * @param size Size of the data piped in, 0 to read the data files from the disk.
+     */
+    inline void setStandardInputSize(qint64 size)
+    {
+        m_standardInputSize = size;
+    }
+
+    /**
+     * @brief Check if all the data files can be read at any position, as needed to detect or correct read offsets.
+     */
+    bool hasSeekableFiles() const;
+
+    /**
+     * @brief List the data files referenced by a CUE sheet as the loader finds them, without checking them.
+     * Archives hold their data files, none is listed for them.
+     */
+    static bool listCueFiles(const QString& filename, QStringList& files);
+
+    /**
+     * @brief Path of a data file as the loader reads it: the file itself, or the same name with a .gz or .ecm suffix
+     * when it is missing.
+     */
+    static QString findDataFile(const QString& filename);
+
     inline const QVector<CdromToc::Entry>& toc() const
     {
         return m_toc;
@@ -132,13 +219,25 @@ public:
     }
 
 protected:
-    bool findAudioFileSize(QFile& file, qint64& fileSize, TrackType& trackType);
+    friend class ImageReader;
+
+    void clear();
+    void updatePositions();
+    bool findAudioFileSize(const QString& fileName, InputFile& file, qint64& fileSize, TrackType& trackType);
+    bool readCueSheet(const QString& filename, QByteArray& data);
+    bool resolveFile(const QString& cueFilename, const QString& name, CdromToc::FileEntry& entry);
 
     QVector<CdromToc::Entry> m_toc;
     QVector<CdromToc::FileEntry> m_fileList;
     uint8_t m_firstTrack;
     uint8_t m_lastTrack;
     uint32_t m_totalSectors;
+    qint64 m_standardInputSize;
+
+    /// Archive the CUE sheet was loaded from, and its members
+    QString m_zipFile;
+    QString m_zipCueDirectory;
+    QVector<CdromToc::ZipMember> m_zipMembers;
 };
 
 #endif // CDROMTOC_H
@@ -0,0 +1,474 @@
+#include "chunkstore.h"
+
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QtDebug>
+#include <array>
+#include <cstring>
+
+// Chunk sizes: cut points are never looked for before the minimum, and forced at the maximum
+constexpr uint32_t MIN_CHUNK_SIZE = 16 * 1024;
+constexpr uint32_t AVERAGE_CHUNK_SIZE = 64 * 1024;
+constexpr uint32_t MAX_CHUNK_SIZE = 256 * 1024;
+
+// Cut masks: more bits before the average size and fewer after keep chunk sizes close to the average
+constexpr uint64_t MASK_SMALL = ~uint64_t(0) << (64 - 18);
+constexpr uint64_t MASK_LARGE = ~uint64_t(0) << (64 - 14);
+
+// Seed of the gear table, changing it changes every cut point
+constexpr uint64_t GEAR_SEED = 0x4e656f4344434443ULL;
+
+// Bytes of a file read and cut into chunks at a time
+constexpr uint32_t READ_SIZE = 16 * 1024 * 1024;
+
+// Bytes of a file written back by a single job when materializing
+constexpr qint64 COPY_GROUP_SIZE = 8 * 1024 * 1024;
+
+constexpr int MANIFEST_VERSION = 1;
+
+class ChunkStoreJob : public QRunnable
+{
+public:
+    ChunkStoreJob(ChunkStore& store, const char* data, uint32_t size, ChunkStore::Chunk& chunk, QAtomicInt& failures) :
+        m_store(store),
+        m_data(data),
+        m_size(size),
+        m_chunk(chunk),
+        m_failures(failures)
+    { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!m_store.storeChunk(m_data, m_size, m_chunk))
+            m_failures.ref();
+    }
+
+protected:
+    ChunkStore& m_store;
+    const char* m_data;
+    uint32_t m_size;
+    ChunkStore::Chunk& m_chunk;
+    QAtomicInt& m_failures;
+};
+
+class ChunkCopyJob : public QRunnable
+{
+public:
+    ChunkCopyJob(const ChunkStore& store, const ChunkStore::File& file, int first, int count, qint64 offset, const QString& fileName, QAtomicInt& failures) :
+        m_store(store),
+        m_file(file),
+        m_first(first),
+        m_count(count),
+        m_offset(offset),
+        m_fileName(fileName),
+        m_failures(failures)
+    { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!m_store.copyChunks(m_file, m_first, m_count, m_offset, m_fileName))
+            m_failures.ref();
+    }
+
+protected:
+    const ChunkStore& m_store;
+    const ChunkStore::File& m_file;
+    int m_first;
+    int m_count;
+    qint64 m_offset;
+    QString m_fileName;
+    QAtomicInt& m_failures;
+};
+
+static const std::array<uint64_t, 256>& gearTable()
+{
+    // Pseudo-random values from a fixed seed (splitmix64), the chunks of a file must be the same on every run
+    static const std::array<uint64_t, 256> table = []()
+    {
+        std::array<uint64_t, 256> values;
+        uint64_t state = GEAR_SEED;
+
+        for(uint64_t& value : values)
+        {
+            state += 0x9e3779b97f4a7c15ULL;
+
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            value = z ^ (z >> 31);
+        }
+
+        return values;
+    }();
+
+    return table;
+}
+
+ChunkStore::ChunkStore() :
+    m_directory(),
+    m_threadPool(),
+    m_storedBytes(0),
+    m_duplicateBytes(0)
+{ }
+
+bool ChunkStore::open(const QString &directory)
+{
+    m_directory = directory;
+
+    // Chunks are spread over 256 directories by the first byte of their hash
+    QDir chunks(QDir(directory).filePath(QStringLiteral("chunks")));
+
+    for(int i = 0; i < 256; ++i)
+    {
+        QString name = QStringLiteral("%1").arg(i, 2, 16, QChar('0'));
+
+        if (!chunks.mkpath(name))
+        {
+            qCritical().noquote() << "Could not create directory: " << chunks.filePath(name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ChunkStore::setThreadCount(int count)
+{
+    if (count > 0)
+        m_threadPool.setMaxThreadCount(count);
+}
+
+bool ChunkStore::addFile(const QString &fileName, ChunkStore::File &file)
+{
+    QFile in(fileName);
+    if (!in.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open input file: " << fileName << endl << in.errorString() << endl;
+        return false;
+    }
+
+    file.size = in.size();
+    file.chunks.clear();
+
+    // While the chunks of a block are hashed, the next block is read in the other buffer
+    QByteArray buffers[2] = {
+        QByteArray(static_cast<int>(READ_SIZE + MAX_CHUNK_SIZE), Qt::Uninitialized),
+        QByteArray(static_cast<int>(READ_SIZE + MAX_CHUNK_SIZE), Qt::Uninitialized)
+    };
+
+    QAtomicInt failures(0);
+    int current = 0;
+    uint32_t available = 0;
+    bool atEnd = false;
+
+    qint64 read = in.read(buffers[current].data(), READ_SIZE);
+    if (read < 0)
+    {
+        qCritical().noquote() << "Read error on input file: " << in.errorString();
+        return false;
+    }
+
+    available = static_cast<uint32_t>(read);
+    atEnd = (read < READ_SIZE);
+
+    while(available)
+    {
+        const char* data = buffers[current].constData();
+        QVector<uint32_t> offsets;
+        uint32_t position = 0;
+
+        // The end of a block is only cut at the end of the file, otherwise it goes with the next block
+        while(position < available)
+        {
+            uint32_t left = available - position;
+            if (!atEnd && (left < MAX_CHUNK_SIZE))
+                break;
+
+            offsets.append(position);
+            position += findCutPoint(reinterpret_cast<const uint8_t*>(data) + position, left);
+        }
+
+        int first = file.chunks.size();
+        file.chunks.resize(first + offsets.size());
+
+        uint32_t pending = available - position;
+        std::memcpy(buffers[current ^ 1].data(), data + position, pending);
+
+        for(int i = 0; i < offsets.size(); ++i)
+        {
+            uint32_t end = (i + 1 < offsets.size()) ? offsets.at(i + 1) : position;
+            m_threadPool.start(new ChunkStoreJob(*this, data + offsets.at(i), end - offsets.at(i), file.chunks[first + i], failures));
+        }
+
+        available = pending;
+
+        if (!atEnd)
+        {
+            read = in.read(buffers[current ^ 1].data() + pending, READ_SIZE);
+            if (read < 0)
+            {
+                qCritical().noquote() << "Read error on input file: " << in.errorString();
+                m_threadPool.waitForDone();
+                return false;
+            }
+
+            available += static_cast<uint32_t>(read);
+            atEnd = (read < READ_SIZE);
+        }
+
+        m_threadPool.waitForDone();
+
+        if (failures.load())
+            return false;
+
+        current ^= 1;
+    }
+
+    return true;
+}
+
+bool ChunkStore::materialize(const QVector<ChunkStore::File> &files, const QString &outputDirectory)
+{
+    QAtomicInt failures(0);
+    QDir output(outputDirectory);
+
+    for(const File& file : files)
+    {
+        QString fileName = output.filePath(file.name);
+
+        // Created at its final size, so the jobs can write their parts in any order
+        QFile out(fileName);
+        if (!out.open(QIODevice::WriteOnly) || !out.resize(file.size))
+        {
+            qCritical().noquote() << "Could not create file: " << fileName << endl << out.errorString() << endl;
+            m_threadPool.waitForDone();
+            return false;
+        }
+
+        out.close();
+
+        int first = 0;
+        qint64 offset = 0;
+        qint64 groupSize = 0;
+
+        for(int i = 0; i < file.chunks.size(); ++i)
+        {
+            groupSize += file.chunks.at(i).size;
+
+            if ((groupSize >= COPY_GROUP_SIZE) || (i + 1 == file.chunks.size()))
+            {
+                m_threadPool.start(new ChunkCopyJob(*this, file, first, i + 1 - first, offset, fileName, failures));
+
+                first = i + 1;
+                offset += groupSize;
+                groupSize = 0;
+            }
+        }
+    }
+
+    m_threadPool.waitForDone();
+
+    return (failures.load() == 0);
+}
+
+bool ChunkStore::writeManifest(const QString &fileName, const QVector<ChunkStore::File> &files)
+{
+    QJsonArray fileArray;
+
+    for(const File& file : files)
+    {
+        QJsonArray chunks;
+        for(const Chunk& chunk : file.chunks)
+        {
+            QJsonArray pair;
+            pair.append(QString::fromLatin1(chunk.hash.toHex()));
+            pair.append(static_cast<double>(chunk.size));
+            chunks.append(pair);
+        }
+
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), file.name);
+        object.insert(QStringLiteral("size"), static_cast<double>(file.size));
+        object.insert(QStringLiteral("chunks"), chunks);
+        fileArray.append(object);
+    }
+
+    QJsonObject manifest;
+    manifest.insert(QStringLiteral("version"), MANIFEST_VERSION);
+    manifest.insert(QStringLiteral("files"), fileArray);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qCritical().noquote() << "Could not write manifest: " << file.errorString();
+        return false;
+    }
+
+    QByteArray json = QJsonDocument(manifest).toJson(QJsonDocument::Compact);
+
+    return (file.write(json) == json.size()) && file.commit();
+}
+
+bool ChunkStore::readManifest(const QString &fileName, QVector<ChunkStore::File> &files)
+{
+    files.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open manifest: " << fileName << endl << file.errorString() << endl;
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    QJsonObject manifest = document.object();
+
+    if ((error.error != QJsonParseError::NoError) || (manifest.value(QStringLiteral("version")).toInt() != MANIFEST_VERSION))
+    {
+        qCritical().noquote() << "Invalid manifest: " << fileName;
+        return false;
+    }
+
+    for(const QJsonValue& value : manifest.value(QStringLiteral("files")).toArray())
+    {
+        QJsonObject object = value.toObject();
+
+        File entry;
+        entry.name = object.value(QStringLiteral("name")).toString();
+        entry.size = static_cast<qint64>(object.value(QStringLiteral("size")).toDouble());
+
+        qint64 total = 0;
+
+        for(const QJsonValue& chunkValue : object.value(QStringLiteral("chunks")).toArray())
+        {
+            QJsonArray chunkArray = chunkValue.toArray();
+
+            Chunk chunk;
+            chunk.hash = QByteArray::fromHex(chunkArray.at(0).toString().toLatin1());
+            chunk.size = static_cast<uint32_t>(chunkArray.at(1).toDouble());
+            entry.chunks.append(chunk);
+
+            total += chunk.size;
+        }
+
+        // Names leaving the output directory are refused along with inconsistent sizes
+        if (entry.name.isEmpty() || QDir::isAbsolutePath(entry.name) || QDir::cleanPath(entry.name).startsWith(QStringLiteral("..")) || (total != entry.size))
+        {
+            qCritical().noquote() << "Invalid manifest: " << fileName;
+            return false;
+        }
+
+        files.append(entry);
+    }
+
+    return true;
+}
+
+bool ChunkStore::storeChunk(const char *data, uint32_t size, ChunkStore::Chunk &chunk)
+{
+    chunk.hash = QCryptographicHash::hash(QByteArray::fromRawData(data, static_cast<int>(size)), QCryptographicHash::Sha256);
+    chunk.size = size;
+
+    QString path = chunkPath(chunk.hash);
+
+    if (QFile::exists(path))
+    {
+        m_duplicateBytes.fetchAndAddRelaxed(size);
+        return true;
+    }
+
+    // Written under a temporary name then renamed, a chunk file is complete as soon as it exists
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || (file.write(data, size) != size) || !file.commit())
+    {
+        qCritical().noquote() << "Could not write chunk: " << path << endl << file.errorString() << endl;
+        return false;
+    }
+
+    m_storedBytes.fetchAndAddRelaxed(size);
+
+    return true;
+}
+
+bool ChunkStore::copyChunks(const ChunkStore::File &file, int first, int count, qint64 offset, const QString &fileName) const
+{
+    QFile out(fileName);
+    if (!out.open(QIODevice::ReadWrite) || !out.seek(offset))
+    {
+        qCritical().noquote() << "Could not open output file: " << fileName << endl << out.errorString() << endl;
+        return false;
+    }
+
+    QByteArray buffer(static_cast<int>(MAX_CHUNK_SIZE), Qt::Uninitialized);
+
+    for(int i = first; i < first + count; ++i)
+    {
+        const Chunk& chunk = file.chunks.at(i);
+        QString path = chunkPath(chunk.hash);
+
+        QFile in(path);
+        if (!in.open(QIODevice::ReadOnly))
+        {
+            qCritical().noquote() << "Missing chunk: " << path;
+            return false;
+        }
+
+        if ((chunk.size > MAX_CHUNK_SIZE) || (in.size() != chunk.size) || (in.read(buffer.data(), chunk.size) != chunk.size))
+        {
+            qCritical().noquote() << "Damaged chunk: " << path;
+            return false;
+        }
+
+        if (out.write(buffer.constData(), chunk.size) != chunk.size)
+        {
+            qCritical().noquote() << "Write error on output file: " << out.errorString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString ChunkStore::chunkPath(const QByteArray &hash) const
+{
+    QString name = QString::fromLatin1(hash.toHex());
+
+    return QStringLiteral("%1/chunks/%2/%3").arg(m_directory, name.left(2), name);
+}
+
+uint32_t ChunkStore::findCutPoint(const uint8_t *data, uint32_t size)
+{
+    if (size <= MIN_CHUNK_SIZE)
+        return size;
+
+    const std::array<uint64_t, 256>& gear = gearTable();
+    uint32_t normalSize = qMin(size, AVERAGE_CHUNK_SIZE);
+    uint32_t maxSize = qMin(size, MAX_CHUNK_SIZE);
+    uint64_t hash = 0;
+    uint32_t i = MIN_CHUNK_SIZE;
+
+    for(; i < normalSize; ++i)
+    {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & MASK_SMALL))
+            return i + 1;
+    }
+
+    for(; i < maxSize; ++i)
+    {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & MASK_LARGE))
+            return i + 1;
+    }
+
+    return maxSize;
+}
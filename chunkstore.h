@@ -0,0 +1,106 @@
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <cstdint>
+
+// Content-addressed store shared by a library of discs, so identical tracks and runs of identical sectors
+// (regional variants of a game, audio tracks shared by several releases) are kept only once.
+// Files are cut into chunks of about 64 KiB at positions chosen from their content (gear hash, as FastCDC),
+// so an insertion or a change only affects the chunks around it. Chunks are named after their SHA-256 and
+// hashed and written in parallel. Each disc gets a manifest listing the chunks of its files, which is all
+// it takes to materialize the files again.
+
+class ChunkStore
+{
+public:
+    struct Chunk
+    {
+        /// SHA-256 of the chunk data
+        QByteArray hash;
+
+        /// Size of the chunk (in bytes)
+        uint32_t size;
+    };
+
+    struct File
+    {
+        /// File name, relative to the directory of the manifest
+        QString name;
+
+        /// Size of the file (in bytes)
+        qint64 size;
+
+        /// Chunks making the file, in order
+        QVector<ChunkStore::Chunk> chunks;
+    };
+
+    explicit ChunkStore();
+
+    // Non copyable
+    ChunkStore(const ChunkStore&) = delete;
+
+    // Non copyable
+    ChunkStore& operator=(const ChunkStore&) = delete;
+
+    /**
+     * @brief Open a store, creating its directory if needed.
+     */
+    bool open(const QString& directory);
+
+    /**
+     * @brief Number of chunks hashed or copied at the same time, 0 for one per CPU core.
+     */
+    void setThreadCount(int count);
+
+    /**
+     * @brief Cut a file into chunks and store the ones not already in the store.
+     * @param[out] file Receives the chunk list, its name is left unchanged.
+     */
+    bool addFile(const QString& fileName, ChunkStore::File& file);
+
+    /**
+     * @brief Write the files of a manifest back from their chunks.
+     * @param outputDirectory Receives the files, named as in the manifest.
+     */
+    bool materialize(const QVector<ChunkStore::File>& files, const QString& outputDirectory);
+
+    static bool writeManifest(const QString& fileName, const QVector<ChunkStore::File>& files);
+    static bool readManifest(const QString& fileName, QVector<ChunkStore::File>& files);
+
+    /**
+     * @brief Bytes of chunks written to the store since it was opened.
+     */
+    inline qint64 storedBytes() const
+    {
+        return m_storedBytes.load();
+    }
+
+    /**
+     * @brief Bytes of chunks found already stored since it was opened.
+     */
+    inline qint64 duplicateBytes() const
+    {
+        return m_duplicateBytes.load();
+    }
+
+protected:
+    friend class ChunkStoreJob;
+    friend class ChunkCopyJob;
+
+    bool storeChunk(const char* data, uint32_t size, ChunkStore::Chunk& chunk);
+    bool copyChunks(const ChunkStore::File& file, int first, int count, qint64 offset, const QString& fileName) const;
+    QString chunkPath(const QByteArray& hash) const;
+    static uint32_t findCutPoint(const uint8_t* data, uint32_t size);
+
+    QString m_directory;
+    QThreadPool m_threadPool;
+    QAtomicInteger<qint64> m_storedBytes;
+    QAtomicInteger<qint64> m_duplicateBytes;
+};
+
+#endif // CHUNKSTORE_H
@@ -0,0 +1,627 @@
+#include "batchscheduler.h"
+#include "binscanner.h"
+#include "cdromtoc.h"
+#include "chunkstore.h"
+#include "commandline.h"
+#include "ecmwriter.h"
+#include "folderwatcher.h"
+#include "imagewriterworker.h"
+#include "isofilesystem.h"
+#include "logger.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QSocketNotifier>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+    #include <csignal>
+    #include <fcntl.h>
+    #include <unistd.h>
+
+// Written to by the handler of the stop signals, read by the event loop which then quits
+static int stopSignalPipe[2] = { -1, -1 };
+
+static void handleStopSignal(int)
+{
+    char byte = 0;
+    ssize_t written = ::write(stopSignalPipe[1], &byte, 1);
+    Q_UNUSED(written)
+}
+#endif
+
+bool CommandLine::isRequested(int argc, char *argv[])
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--", 2) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+int CommandLine::run(QCoreApplication &application)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Split a BIN / CUE CD-ROM image into ISO / WAV / CUE files."));
+    parser.addHelpOption();
+
+    QCommandLineOption exportOption(QStringLiteral("export"), QStringLiteral("Export <cue> to split ISO / WAV / CUE files."), QStringLiteral("cue"));
+    QCommandLineOption benchmarkOption(QStringLiteral("benchmark"), QStringLiteral("Export <cue> once with every I/O backend and compare the timings."), QStringLiteral("cue"));
+    QCommandLineOption batchOption(QStringLiteral("batch"), QStringLiteral("Export every CUE sheet found under <directory>."), QStringLiteral("directory"));
+    QCommandLineOption jobsOption(QStringLiteral("jobs"), QStringLiteral("Number of discs (batch mode) or files (extraction) processed at the same time, 0 for one per CPU core."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption deviceJobsOption(QStringLiteral("device-jobs"), QStringLiteral("Number of discs exported at the same time on a disk in batch mode, 0 for automatic."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption memoryBudgetOption(QStringLiteral("memory-budget"), QStringLiteral("Memory for the export buffers of all discs in batch mode, in MiB."), QStringLiteral("MiB"), QStringLiteral("256"));
+    QCommandLineOption watchOption(QStringLiteral("watch"), QStringLiteral("Export the CUE sheets dropped in <directory>, can be repeated."), QStringLiteral("directory"));
+    QCommandLineOption doneOption(QStringLiteral("done"), QStringLiteral("Directory receiving the watched inputs once exported."), QStringLiteral("directory"));
+    QCommandLineOption failedOption(QStringLiteral("failed"), QStringLiteral("Directory receiving the watched inputs that could not be exported."), QStringLiteral("directory"));
+    QCommandLineOption settleOption(QStringLiteral("settle"), QStringLiteral("Seconds the watched files must stay unchanged before they are exported."), QStringLiteral("seconds"), QStringLiteral("5"));
+    QCommandLineOption pendingTimeoutOption(QStringLiteral("pending-timeout"), QStringLiteral("Seconds a watched disc may stay incomplete with none of its files changing before it is failed, 0 to wait forever."), QStringLiteral("seconds"), QStringLiteral("600"));
+    QCommandLineOption logFileOption(QStringLiteral("log-file"), QStringLiteral("Also write the messages to <file>."), QStringLiteral("file"));
+    QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Output directory."), QStringLiteral("directory"));
+    QCommandLineOption ioBackendOption(QStringLiteral("io-backend"), QStringLiteral("Backend writing the output files: buffered, direct or iouring."), QStringLiteral("backend"), QStringLiteral("buffered"));
+    QCommandLineOption directIoOption(QStringLiteral("direct-io"), QStringLiteral("Bypass the page cache with O_DIRECT, implies --io-backend direct."));
+    QCommandLineOption queueDepthOption(QStringLiteral("queue-depth"), QStringLiteral("Number of buffers in flight for io_uring, 0 for automatic."), QStringLiteral("depth"), QStringLiteral("0"));
+    QCommandLineOption maxBuffersOption(QStringLiteral("max-buffers"), QStringLiteral("Maximum number of sector buffers allocated, 0 for automatic."), QStringLiteral("count"), QStringLiteral("0"));
+    QCommandLineOption hugePagesOption(QStringLiteral("huge-pages"), QStringLiteral("Back the sector buffers with huge pages."));
+    QCommandLineOption sparseOption(QStringLiteral("sparse"), QStringLiteral("Leave runs of zeros as holes in the output files."));
+    QCommandLineOption sampleOffsetOption(QStringLiteral("sample-offset"), QStringLiteral("Read offset correction for audio tracks, in samples."), QStringLiteral("samples"), QStringLiteral("0"));
+    QCommandLineOption noDitherOption(QStringLiteral("no-dither"), QStringLiteral("Do not dither audio files converted to 16 bits."));
+    QCommandLineOption noByteOrderOption(QStringLiteral("no-byte-order-detection"), QStringLiteral("Do not detect byte swapped audio tracks in BIN files."));
+    QCommandLineOption analyzeAudioOption(QStringLiteral("analyze-audio"), QStringLiteral("Measure the levels and loudness of the audio tracks."));
+    QCommandLineOption replayGainTagsOption(QStringLiteral("replaygain-tags"), QStringLiteral("Tag the WAV files with their ReplayGain, implies --analyze-audio."));
+    QCommandLineOption checksumsOption(QStringLiteral("checksums"), QStringLiteral("Compute the AccurateRip and CUETools checksums of the audio tracks."));
+    QCommandLineOption accurateRipDatabaseOption(QStringLiteral("accuraterip-db"), QStringLiteral("Verify the audio tracks against an AccurateRip dBAR <file>, implies --checksums."), QStringLiteral("file"));
+    QCommandLineOption listFilesOption(QStringLiteral("list-files"), QStringLiteral("List the files of the data track of <image> (CUE sheet or ISO)."), QStringLiteral("image"));
+    QCommandLineOption extractFilesOption(QStringLiteral("extract-files"), QStringLiteral("Extract the files of the data track of <image> (CUE sheet or ISO)."), QStringLiteral("image"));
+    QCommandLineOption filesOption(QStringLiteral("files"), QStringLiteral("Only extract the files matching <pattern>, can be repeated."), QStringLiteral("pattern"));
+    QCommandLineOption isoIndexOption(QStringLiteral("iso-index"), QStringLiteral("Keep the file index of the data track in <file>, built on first use."), QStringLiteral("file"));
+    QCommandLineOption prefetchOption(QStringLiteral("prefetch"), QStringLiteral("Number of data files read ahead of the one being exported, 0 to disable."), QStringLiteral("files"), QStringLiteral("2"));
+    QCommandLineOption prefetchBudgetOption(QStringLiteral("prefetch-budget"), QStringLiteral("Data read ahead of the file being exported at most, in MiB."), QStringLiteral("MiB"), QStringLiteral("64"));
+    QCommandLineOption tarOption(QStringLiteral("tar"), QStringLiteral("With --export, stream the CUE sheet and tracks as a tar archive to <file>, - for the standard output."), QStringLiteral("file"));
+    QCommandLineOption stdinOption(QStringLiteral("stdin"), QStringLiteral("With --export, read the data file of the CUE sheet from the standard input, <bytes> long."), QStringLiteral("bytes"));
+    QCommandLineOption storeOption(QStringLiteral("store"), QStringLiteral("Keep the exported files in the chunk store <directory>, leaving a manifest in the output directory."), QStringLiteral("directory"));
+    QCommandLineOption materializeOption(QStringLiteral("materialize"), QStringLiteral("Write back the files of <manifest> from the chunk store."), QStringLiteral("manifest"));
+    QCommandLineOption ecmOption(QStringLiteral("ecm"), QStringLiteral("Write the data files of <cue> as ECM files, next to a copy of the CUE sheet."), QStringLiteral("cue"));
+    QCommandLineOption scanBinOption(QStringLiteral("scan-bin"), QStringLiteral("Rebuild the CUE sheet of the BIN <file> from its sectors, next to it or in the output directory."), QStringLiteral("file"));
+    QCommandLineOption statsOption(QStringLiteral("stats"), QStringLiteral("Write the statistics of every stage of the exports to a JSON report."));
+    QCommandLineOption offsetReferencesOption(QStringLiteral("offset-references"), QStringLiteral("Detect the read offset from a file of reference track checksums."), QStringLiteral("file"));
+
+    parser.addOption(exportOption);
+    parser.addOption(benchmarkOption);
+    parser.addOption(batchOption);
+    parser.addOption(jobsOption);
+    parser.addOption(deviceJobsOption);
+    parser.addOption(memoryBudgetOption);
+    parser.addOption(watchOption);
+    parser.addOption(doneOption);
+    parser.addOption(failedOption);
+    parser.addOption(settleOption);
+    parser.addOption(pendingTimeoutOption);
+    parser.addOption(logFileOption);
+    parser.addOption(outputOption);
+    parser.addOption(ioBackendOption);
+    parser.addOption(directIoOption);
+    parser.addOption(queueDepthOption);
+    parser.addOption(maxBuffersOption);
+    parser.addOption(hugePagesOption);
+    parser.addOption(sparseOption);
+    parser.addOption(sampleOffsetOption);
+    parser.addOption(offsetReferencesOption);
+    parser.addOption(noDitherOption);
+    parser.addOption(noByteOrderOption);
+    parser.addOption(analyzeAudioOption);
+    parser.addOption(replayGainTagsOption);
+    parser.addOption(checksumsOption);
+    parser.addOption(accurateRipDatabaseOption);
+    parser.addOption(listFilesOption);
+    parser.addOption(extractFilesOption);
+    parser.addOption(filesOption);
+    parser.addOption(isoIndexOption);
+    parser.addOption(prefetchOption);
+    parser.addOption(prefetchBudgetOption);
+    parser.addOption(tarOption);
+    parser.addOption(stdinOption);
+    parser.addOption(storeOption);
+    parser.addOption(materializeOption);
+    parser.addOption(ecmOption);
+    parser.addOption(scanBinOption);
+    parser.addOption(statsOption);
+
+    parser.process(application);
+
+    if (parser.isSet(logFileOption))
+    {
+        // Messages then go through the logger, which also prints them
+        logger()->setConsoleOutput(true);
+
+        if (!logger()->setLogFile(parser.value(logFileOption)))
+        {
+            qCritical().noquote() << "Could not open log file: " << parser.value(logFileOption);
+            return 1;
+        }
+    }
+
+    ExportOptions options;
+
+    // Same choices as the backend list of the dialog, O_DIRECT being an option of the direct backend
+    QString ioBackend = parser.value(ioBackendOption);
+
+    if (parser.isSet(directIoOption) && !parser.isSet(ioBackendOption))
+        ioBackend = QStringLiteral("direct");
+
+    if (ioBackend == QStringLiteral("buffered"))
+        options.ioBackend = ExportOptions::IoBackend::Buffered;
+    else if (ioBackend == QStringLiteral("direct"))
+        options.ioBackend = ExportOptions::IoBackend::Direct;
+    else if (ioBackend == QStringLiteral("iouring"))
+        options.ioBackend = ExportOptions::IoBackend::IoUring;
+    else
+    {
+        qCritical().noquote() << "Unknown I/O backend: " << ioBackend;
+        return 1;
+    }
+
+    if (parser.isSet(directIoOption) && (options.ioBackend != ExportOptions::IoBackend::Direct))
+    {
+        qCritical().noquote() << "O_DIRECT is only available with the direct backend.";
+        return 1;
+    }
+
+    // The benchmark runs every backend, the other modes only use the queue depth with io_uring
+    if (parser.isSet(queueDepthOption) && !parser.isSet(benchmarkOption) && (options.ioBackend != ExportOptions::IoBackend::IoUring))
+    {
+        qCritical().noquote() << "The queue depth is only used by the io_uring backend.";
+        return 1;
+    }
+
+    options.directIo = parser.isSet(directIoOption);
+    options.queueDepth = parser.value(queueDepthOption).toInt();
+    options.maxBuffers = parser.value(maxBuffersOption).toInt();
+    options.hugePages = parser.isSet(hugePagesOption);
+    options.sparseOutput = parser.isSet(sparseOption);
+    options.prefetchFiles = parser.value(prefetchOption).toInt();
+    options.prefetchBudget = parser.value(prefetchBudgetOption).toLongLong() * 1024 * 1024;
+    options.sampleOffset = parser.value(sampleOffsetOption).toInt();
+    options.offsetReferenceFile = parser.value(offsetReferencesOption);
+    options.ditherAudio = !parser.isSet(noDitherOption);
+    options.detectByteOrder = !parser.isSet(noByteOrderOption);
+    options.replayGainTags = parser.isSet(replayGainTagsOption);
+    options.analyzeAudio = parser.isSet(analyzeAudioOption) || options.replayGainTags;
+    options.accurateRipDatabase = parser.value(accurateRipDatabaseOption);
+    options.computeChecksums = parser.isSet(checksumsOption) || !options.accurateRipDatabase.isEmpty();
+    options.chunkStore = parser.value(storeOption);
+    options.standardInputSize = parser.value(stdinOption).toLongLong();
+    options.statisticsReport = parser.isSet(statsOption);
+
+    // Archives are a single stream, written without an output directory
+    if (parser.isSet(tarOption) && parser.isSet(exportOption))
+    {
+        options.tarOutput = parser.value(tarOption);
+        options.chunkStore.clear();
+
+        return runExport(parser.value(exportOption), QString(), options);
+    }
+
+    if (parser.isSet(scanBinOption))
+        return runScanBin(parser.value(scanBinOption), parser.value(outputOption));
+
+    if (parser.isSet(listFilesOption))
+        return runListFiles(parser.value(listFilesOption), parser.value(isoIndexOption));
+
+    if (parser.isSet(exportOption) || parser.isSet(benchmarkOption) || parser.isSet(batchOption) || parser.isSet(watchOption) || parser.isSet(extractFilesOption)
+            || parser.isSet(materializeOption) || parser.isSet(ecmOption))
+    {
+        if (!parser.isSet(outputOption))
+        {
+            qCritical().noquote() << "An output directory is needed.";
+            return 1;
+        }
+
+        if (parser.isSet(benchmarkOption))
+            return runBenchmark(parser.value(benchmarkOption), parser.value(outputOption), options);
+
+        if (parser.isSet(watchOption))
+        {
+            QDir output(parser.value(outputOption));
+            QString doneDirectory = parser.isSet(doneOption) ? parser.value(doneOption) : output.filePath(QStringLiteral("done"));
+            QString failedDirectory = parser.isSet(failedOption) ? parser.value(failedOption) : output.filePath(QStringLiteral("failed"));
+
+            return runWatch(application, parser.values(watchOption), output.path(), doneDirectory, failedDirectory, parser.value(settleOption).toInt(),
+                            parser.value(pendingTimeoutOption).toInt(), options);
+        }
+
+        if (parser.isSet(materializeOption))
+        {
+            if (!parser.isSet(storeOption))
+            {
+                qCritical().noquote() << "A chunk store is needed.";
+                return 1;
+            }
+
+            return runMaterialize(parser.value(materializeOption), parser.value(storeOption), parser.value(outputOption), parser.value(jobsOption).toInt());
+        }
+
+        if (parser.isSet(ecmOption))
+            return runEncodeEcm(parser.value(ecmOption), parser.value(outputOption));
+
+        if (parser.isSet(extractFilesOption))
+            return runExtractFiles(parser.value(extractFilesOption), parser.value(isoIndexOption), parser.value(outputOption), parser.values(filesOption),
+                                   parser.value(jobsOption).toInt());
+
+        if (parser.isSet(batchOption))
+            return runBatch(parser.value(batchOption), parser.value(outputOption), options, parser.value(jobsOption).toInt(),
+                            parser.value(deviceJobsOption).toInt(), parser.value(memoryBudgetOption).toLongLong() * 1024 * 1024);
+
+        return runExport(parser.value(exportOption), parser.value(outputOption), options);
+    }
+
+    parser.showHelp(1);
+    return 1;
+}
+
+int CommandLine::runExport(const QString &cueFile, const QString &outputDirectory, const ExportOptions &options)
+{
+    CdromToc toc;
+    toc.setStandardInputSize(options.standardInputSize);
+    if (!toc.loadImage(cueFile))
+        return 1;
+
+    if (options.tarOutput.isEmpty() && !QDir().mkpath(outputDirectory))
+    {
+        qCritical().noquote() << "Could not create directory: " << outputDirectory;
+        return 1;
+    }
+
+    ImageWriterWorker worker;
+    worker.setOptions(options);
+    worker.start(outputDirectory, QFileInfo(cueFile).completeBaseName(), &toc);
+
+    // A broken export, or archive, must not look like a complete one to the scripts and pipelines running it
+    return worker.succeeded() ? 0 : 1;
+}
+
+int CommandLine::runBenchmark(const QString &cueFile, const QString &outputDirectory, const ExportOptions &baseOptions)
+{
+    struct Backend
+    {
+        QString name;
+        ExportOptions::IoBackend backend;
+        bool directIo;
+    };
+
+    static const Backend BACKENDS[] = {
+        { QStringLiteral("buffered"), ExportOptions::IoBackend::Buffered, false },
+        { QStringLiteral("direct"), ExportOptions::IoBackend::Direct, false },
+        { QStringLiteral("odirect"), ExportOptions::IoBackend::Direct, true },
+        { QStringLiteral("iouring"), ExportOptions::IoBackend::IoUring, false }
+    };
+
+    CdromToc toc;
+    if (!toc.loadImage(cueFile))
+        return 1;
+
+    QTextStream out(stdout);
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("backend"), -10).arg(QStringLiteral("seconds"), 10).arg(QStringLiteral("MiB/s"), 10) << endl;
+
+    bool succeeded = true;
+
+    for(const Backend& backend : BACKENDS)
+    {
+        QDir directory(outputDirectory);
+        if (!directory.mkpath(backend.name))
+        {
+            qCritical().noquote() << "Could not create directory: " << directory.filePath(backend.name);
+            return 1;
+        }
+
+        ExportOptions options = baseOptions;
+        options.ioBackend = backend.backend;
+        options.directIo = backend.directIo;
+
+        // Inputs are dropped from the page cache as they are read, so every run starts cold
+        options.adviseInputs = true;
+
+        ImageWriterWorker worker;
+        worker.setOptions(options);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        worker.start(directory.filePath(backend.name), QFileInfo(cueFile).completeBaseName(), &toc);
+
+        double seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+        // The time of a failed run says nothing about the backend
+        if (!worker.succeeded())
+        {
+            out << QStringLiteral("%1 %2").arg(backend.name, -10).arg(QStringLiteral("FAILED"), 10) << endl;
+            succeeded = false;
+            continue;
+        }
+
+        qint64 bytes = worker.statistics().stageTotal(ExportStatistics::Stage::Write).bytes;
+        double rate = (seconds > 0.0) ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds : 0.0;
+
+        out << QStringLiteral("%1 %2 %3").arg(backend.name, -10).arg(seconds, 10, 'f', 3).arg(rate, 10, 'f', 1) << endl;
+    }
+
+    return succeeded ? 0 : 1;
+}
+
+int CommandLine::runListFiles(const QString &image, const QString &indexFile)
+{
+    IsoFilesystem filesystem;
+    if (!openFilesystem(filesystem, image, indexFile))
+        return 1;
+
+    QTextStream out(stdout);
+
+    for(const IsoFilesystem::Entry& entry : filesystem.entries())
+    {
+        if (entry.isDirectory)
+            out << QStringLiteral("%1 %2/").arg(QString(), 10).arg(entry.path) << endl;
+        else
+            out << QStringLiteral("%1 %2").arg(entry.size, 10).arg(entry.path) << endl;
+    }
+
+    return 0;
+}
+
+int CommandLine::runExtractFiles(const QString &image, const QString &indexFile, const QString &outputDirectory, const QStringList &patterns, int jobs)
+{
+    IsoFilesystem filesystem;
+    if (!openFilesystem(filesystem, image, indexFile))
+        return 1;
+
+    QVector<int> files = filesystem.findFiles(patterns);
+    if (files.isEmpty())
+    {
+        qCritical().noquote() << "No file to extract from " << image;
+        return 1;
+    }
+
+    if (!QDir().mkpath(outputDirectory))
+    {
+        qCritical().noquote() << "Could not create directory: " << outputDirectory;
+        return 1;
+    }
+
+    return filesystem.extract(files, outputDirectory, jobs) ? 0 : 1;
+}
+
+int CommandLine::runMaterialize(const QString &manifest, const QString &storeDirectory, const QString &outputDirectory, int jobs)
+{
+    QVector<ChunkStore::File> files;
+    if (!ChunkStore::readManifest(manifest, files))
+        return 1;
+
+    if (!QDir().mkpath(outputDirectory))
+    {
+        qCritical().noquote() << "Could not create directory: " << outputDirectory;
+        return 1;
+    }
+
+    ChunkStore store;
+    store.setThreadCount(jobs);
+
+    if (!store.open(storeDirectory))
+        return 1;
+
+    return store.materialize(files, outputDirectory) ? 0 : 1;
+}
+
+int CommandLine::runEncodeEcm(const QString &cueFile, const QString &outputDirectory)
+{
+    CdromToc toc;
+    if (!toc.loadCueSheet(cueFile))
+        return 1;
+
+    if (!QDir().mkpath(outputDirectory))
+    {
+        qCritical().noquote() << "Could not create directory: " << outputDirectory;
+        return 1;
+    }
+
+    QDir output(outputDirectory);
+
+    // Copies of the CUE sheet and WAV files would replace the originals
+    if (output.canonicalPath() == QFileInfo(cueFile).dir().canonicalPath())
+    {
+        qCritical().noquote() << "The output directory must differ from the directory of the CUE sheet.";
+        return 1;
+    }
+
+    for(int i = 0; i < toc.fileList().size(); ++i)
+    {
+        const CdromToc::FileEntry& file = toc.fileList().at(i);
+        QString fileName = QFileInfo(file.fileName).fileName();
+
+        if (file.source != CdromToc::FileSource::Plain)
+        {
+            qCritical().noquote() << "File " << fileName << " is already compressed.";
+            return 1;
+        }
+
+        // WAV files have no sectors to rebuild, and are read in place by the export
+        bool isWave = std::any_of(toc.toc().cbegin(), toc.toc().cend(), [&](const CdromToc::Entry& entry)
+        {
+            return (entry.fileIndex == i) && (entry.trackType == CdromToc::TrackType::AudioWav);
+        });
+
+        if (isWave)
+        {
+            QFile::remove(output.filePath(fileName));
+            if (!QFile::copy(file.fileName, output.filePath(fileName)))
+            {
+                qCritical().noquote() << "Could not copy file: " << fileName;
+                return 1;
+            }
+
+            continue;
+        }
+
+        QFile in(file.fileName);
+        if (!in.open(QIODevice::ReadOnly))
+        {
+            qCritical().noquote() << "Could not open input file: " << file.fileName << endl << in.errorString() << endl;
+            return 1;
+        }
+
+        EcmWriter writer;
+        if (!writer.open(output.filePath(fileName + QStringLiteral(".ecm"))))
+        {
+            qCritical().noquote() << "Could not create file: " << fileName << ".ecm" << endl << writer.errorString() << endl;
+            return 1;
+        }
+
+        QByteArray buffer(4 * 1024 * 1024, Qt::Uninitialized);
+        qint64 read;
+
+        while((read = in.read(buffer.data(), buffer.size())) > 0)
+        {
+            if (!writer.write(buffer.constData(), read))
+                break;
+        }
+
+        if ((read < 0) || !writer.close())
+        {
+            qCritical().noquote() << "Could not encode file: " << fileName << endl << ((read < 0) ? in.errorString() : writer.errorString()) << endl;
+            return 1;
+        }
+
+        qint64 encodedSize = QFileInfo(output.filePath(fileName + QStringLiteral(".ecm"))).size();
+        qInfo().noquote() << "Encoded " << fileName << ": " << writer.sectorsRebuilt() << " sectors rebuilt, "
+                          << (in.size() / (1024 * 1024)) << " MiB to " << (encodedSize / (1024 * 1024)) << " MiB.";
+    }
+
+    // The CUE sheet keeps the names of the data files, they are found with their .ecm suffix
+    QString cueCopy = output.filePath(QFileInfo(cueFile).fileName());
+    QFile::remove(cueCopy);
+
+    if (!QFile::copy(cueFile, cueCopy))
+    {
+        qCritical().noquote() << "Could not copy CUE sheet: " << cueFile;
+        return 1;
+    }
+
+    return 0;
+}
+
+int CommandLine::runScanBin(const QString &binFile, const QString &outputDirectory)
+{
+    CdromToc toc;
+    if (!BinScanner::scan(binFile, toc))
+        return 1;
+
+    QFileInfo binInfo(binFile);
+    QString directory = outputDirectory.isEmpty() ? binInfo.absolutePath() : outputDirectory;
+
+    if (!QDir().mkpath(directory))
+    {
+        qCritical().noquote() << "Could not create directory: " << directory;
+        return 1;
+    }
+
+    // A CUE sheet already there is kept, it knows more than the sectors
+    QString cueFile = QDir(directory).filePath(binInfo.completeBaseName() + QStringLiteral(".cue"));
+    if (QFileInfo::exists(cueFile))
+    {
+        qCritical().noquote() << "File already exists: " << cueFile;
+        return 1;
+    }
+
+    return BinScanner::writeCueSheet(toc, cueFile) ? 0 : 1;
+}
+
+bool CommandLine::openFilesystem(IsoFilesystem &filesystem, const QString &image, const QString &indexFile)
+{
+    if (!filesystem.open(image))
+        return false;
+
+    // Walking the directories of a large volume is slow, a valid index is used instead
+    if (!indexFile.isEmpty() && filesystem.loadIndex(indexFile))
+        return true;
+
+    if (!filesystem.buildIndex())
+        return false;
+
+    if (!indexFile.isEmpty())
+        filesystem.saveIndex(indexFile);
+
+    return true;
+}
+
+int CommandLine::runBatch(const QString &inputDirectory, const QString &outputDirectory, const ExportOptions &options, int jobs, int deviceJobs, qint64 memoryBudget)
+{
+    BatchScheduler scheduler;
+    scheduler.setOptions(options);
+    scheduler.setThreadCount(jobs);
+    scheduler.setDeviceConcurrency(deviceJobs);
+    scheduler.setMemoryBudget(memoryBudget);
+
+    if (!scheduler.addDirectory(inputDirectory, outputDirectory))
+    {
+        qCritical().noquote() << "No CUE sheet found in " << inputDirectory;
+        return 1;
+    }
+
+    return scheduler.run() ? 0 : 1;
+}
+
+int CommandLine::runWatch(QCoreApplication &application, const QStringList &directories, const QString &outputDirectory, const QString &doneDirectory,
+                          const QString &failedDirectory, int settleSeconds, int pendingTimeoutSeconds, const ExportOptions &options)
+{
+    FolderWatcher watcher;
+    watcher.setOptions(options);
+    watcher.setDirectories(outputDirectory, doneDirectory, failedDirectory);
+    watcher.setSettleTime(settleSeconds * 1000);
+    watcher.setPendingTimeout(pendingTimeoutSeconds * 1000);
+
+    for(const QString& directory : directories)
+    {
+        if (!watcher.addDirectory(directory))
+            return 1;
+
+        qInfo().noquote() << "Watching " << directory;
+    }
+
+#ifdef Q_OS_UNIX
+    // SIGINT and SIGTERM end the event loop instead of the process, so the exit status tells about failed discs
+    QSocketNotifier* stopNotifier = Q_NULLPTR;
+
+    if (pipe(stopSignalPipe) == 0)
+    {
+        fcntl(stopSignalPipe[1], F_SETFL, O_NONBLOCK);
+
+        stopNotifier = new QSocketNotifier(stopSignalPipe[0], QSocketNotifier::Read, &application);
+        QObject::connect(stopNotifier, &QSocketNotifier::activated, &application, &QCoreApplication::quit);
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = handleStopSignal;
+        sigemptyset(&action.sa_mask);
+
+        sigaction(SIGINT, &action, Q_NULLPTR);
+        sigaction(SIGTERM, &action, Q_NULLPTR);
+    }
+#endif
+
+    // Runs until the process is stopped, the discs being exported are completed
+    application.exec();
+    watcher.waitForExports();
+
+    if (watcher.failedDiscs())
+    {
+        qCritical().noquote() << watcher.failedDiscs() << " discs could not be exported.";
+        return 1;
+    }
+
+    return 0;
+}
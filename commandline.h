@@ -0,0 +1,37 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QCoreApplication>
+#include <QString>
+#include <QStringList>
+
+#include "exportoptions.h"
+#include "isofilesystem.h"
+
+// Entry point for the modes that run without the user interface.
+
+class CommandLine
+{
+public:
+    /**
+     * @brief Check if the program was started with command line options instead of showing the dialog.
+     */
+    static bool isRequested(int argc, char* argv[]);
+
+    static int run(QCoreApplication& application);
+
+protected:
+    static int runExport(const QString& cueFile, const QString& outputDirectory, const ExportOptions& options);
+    static int runBenchmark(const QString& cueFile, const QString& outputDirectory, const ExportOptions& baseOptions);
+    static int runWatch(QCoreApplication& application, const QStringList& directories, const QString& outputDirectory, const QString& doneDirectory,
+                        const QString& failedDirectory, int settleSeconds, int pendingTimeoutSeconds, const ExportOptions& options);
+    static int runBatch(const QString& inputDirectory, const QString& outputDirectory, const ExportOptions& options, int jobs, int deviceJobs, qint64 memoryBudget);
+    static int runListFiles(const QString& image, const QString& indexFile);
+    static int runExtractFiles(const QString& image, const QString& indexFile, const QString& outputDirectory, const QStringList& patterns, int jobs);
+    static int runMaterialize(const QString& manifest, const QString& storeDirectory, const QString& outputDirectory, int jobs);
+    static int runEncodeEcm(const QString& cueFile, const QString& outputDirectory);
+    static int runScanBin(const QString& binFile, const QString& outputDirectory);
+    static bool openFilesystem(IsoFilesystem& filesystem, const QString& image, const QString& indexFile);
+};
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,73 @@
+#-------------------------------------------------
+#
+# Image parsing, sector I/O, verification and export, built as the core
+# library by core/core.pro. Only depends on Qt Core.
+#
+#-------------------------------------------------
+
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/cdromtoc.cpp \
+    $$PWD/wavfile.cpp \
+    $$PWD/imagewriterworker.cpp \
+    $$PWD/exportstatistics.cpp \
+    $$PWD/outputfile.cpp \
+    $$PWD/iouringengine.cpp \
+    $$PWD/bufferpool.cpp \
+    $$PWD/audiostream.cpp \
+    $$PWD/audioanalyzer.cpp \
+    $$PWD/audiochecksums.cpp \
+    $$PWD/accurateripdatabase.cpp \
+    $$PWD/offsetdetector.cpp \
+    $$PWD/sampleconverter.cpp \
+    $$PWD/blockdevice.cpp \
+    $$PWD/batchscheduler.cpp \
+    $$PWD/folderwatcher.cpp \
+    $$PWD/isofilesystem.cpp \
+    $$PWD/chunkstore.cpp \
+    $$PWD/fileprefetcher.cpp \
+    $$PWD/tarstream.cpp \
+    $$PWD/streaminput.cpp \
+    $$PWD/sectorcoder.cpp \
+    $$PWD/ecmwriter.cpp \
+    $$PWD/imagereader.cpp \
+    $$PWD/byteorderdetector.cpp \
+    $$PWD/binscanner.cpp \
+    $$PWD/inputfile.cpp
+
+HEADERS += $$PWD/wavfile.h \
+    $$PWD/cdromtoc.h \
+    $$PWD/endian.h \
+    $$PWD/packedstruct.h \
+    $$PWD/trackindex.h \
+    $$PWD/imagewriterworker.h \
+    $$PWD/wavstruct.h \
+    $$PWD/exportstatistics.h \
+    $$PWD/exportoptions.h \
+    $$PWD/outputfile.h \
+    $$PWD/iouringengine.h \
+    $$PWD/bufferpool.h \
+    $$PWD/audiostream.h \
+    $$PWD/audioanalyzer.h \
+    $$PWD/audiochecksums.h \
+    $$PWD/accurateripdatabase.h \
+    $$PWD/offsetdetector.h \
+    $$PWD/sampleconverter.h \
+    $$PWD/blockdevice.h \
+    $$PWD/batchscheduler.h \
+    $$PWD/folderwatcher.h \
+    $$PWD/isofilesystem.h \
+    $$PWD/isostruct.h \
+    $$PWD/chunkstore.h \
+    $$PWD/fileprefetcher.h \
+    $$PWD/tarstream.h \
+    $$PWD/streaminput.h \
+    $$PWD/sectorcoder.h \
+    $$PWD/ecmwriter.h \
+    $$PWD/imagereader.h \
+    $$PWD/byteorderdetector.h \
+    $$PWD/binscanner.h \
+    $$PWD/inputfile.h
+
+# Optional libraries, whose defines the headers depend on
+include($$PWD/coredeps.pri)
@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Core of the splitter as a library, without Qt GUI or Widgets, linked by
+# the application and the tests, and by programs embedding the export
+# through the C API of neocdcore.h.
+# Static by default, "qmake CONFIG+=neocd_shared" builds a shared library.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = neocdcore
+TEMPLATE = lib
+
+CONFIG += c++11 staticlib
+
+neocd_shared {
+    CONFIG -= staticlib
+    CONFIG += shared
+    DEFINES += NEOCDCORE_SHARED
+}
+
+DEFINES += NEOCDCORE_BUILD
+
+include(../core.pri)
+
+SOURCES += neocdcore.cpp
+
+HEADERS += neocdcore.h
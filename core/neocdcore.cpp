@@ -0,0 +1,141 @@
+#include "neocdcore.h"
+
+#include "cdromtoc.h"
+#include "imagewriterworker.h"
+
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtDebug>
+
+struct NeoCdToc
+{
+    CdromToc toc;
+};
+
+static QMutex g_messageMutex;
+static NeoCdMessageCallback g_messageCallback = Q_NULLPTR;
+static void* g_messageUser = Q_NULLPTR;
+
+static void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& message)
+{
+    NeoCdMessageLevel level;
+
+    switch(type)
+    {
+    case QtDebugMsg: level = NEOCD_MESSAGE_DEBUG; break;
+    case QtInfoMsg: level = NEOCD_MESSAGE_INFO; break;
+    case QtWarningMsg: level = NEOCD_MESSAGE_WARNING; break;
+    default: level = NEOCD_MESSAGE_ERROR; break;
+    }
+
+    QByteArray text = message.toUtf8();
+
+    QMutexLocker locker(&g_messageMutex);
+    if (g_messageCallback)
+        g_messageCallback(g_messageUser, level, text.constData());
+}
+
+void neocd_set_message_callback(NeoCdMessageCallback callback, void *user)
+{
+    {
+        QMutexLocker locker(&g_messageMutex);
+        g_messageCallback = callback;
+        g_messageUser = user;
+    }
+
+    qInstallMessageHandler(callback ? messageHandler : Q_NULLPTR);
+}
+
+NeoCdToc *neocd_toc_open(const char *path)
+{
+    if (!path)
+        return Q_NULLPTR;
+
+    NeoCdToc* toc = new NeoCdToc;
+
+    if (!toc->toc.loadImage(QString::fromUtf8(path)))
+    {
+        delete toc;
+        return Q_NULLPTR;
+    }
+
+    return toc;
+}
+
+void neocd_toc_close(NeoCdToc *toc)
+{
+    delete toc;
+}
+
+int neocd_toc_entry_count(const NeoCdToc *toc)
+{
+    return toc ? toc->toc.toc().size() : 0;
+}
+
+int neocd_toc_entry(const NeoCdToc *toc, int position, NeoCdTocEntry *entry)
+{
+    if (!toc || !entry || (position < 0) || (position >= toc->toc.toc().size()))
+        return 0;
+
+    const CdromToc::Entry& source = toc->toc.toc().at(position);
+
+    entry->track = source.trackIndex.track();
+    entry->index = source.trackIndex.index();
+    entry->type = static_cast<NeoCdTrackType>(source.trackType);
+    entry->file_index = source.fileIndex;
+    entry->start_sector = source.startSector;
+    entry->length = source.trackLength;
+    entry->file_offset = source.fileOffset;
+
+    return 1;
+}
+
+uint32_t neocd_toc_total_sectors(const NeoCdToc *toc)
+{
+    return toc ? toc->toc.totalSectors() : 0;
+}
+
+int neocd_export(NeoCdToc *toc, const char *output_directory, const char *base_name, const NeoCdExportCallbacks *callbacks)
+{
+    if (!toc || !output_directory || !base_name)
+        return 0;
+
+    QString outputDirectory = QString::fromUtf8(output_directory);
+    if (!QDir().mkpath(outputDirectory))
+    {
+        qCritical().noquote() << "Could not create directory: " << outputDirectory;
+        return 0;
+    }
+
+    // Signals are delivered directly on the calling thread, no event loop is needed
+    ImageWriterWorker worker;
+    int64_t total = 0;
+
+    if (callbacks)
+    {
+        QObject::connect(&worker, &ImageWriterWorker::progressRangeChanged, [&](int, int maximum)
+        {
+            total = maximum;
+        });
+
+        QObject::connect(&worker, &ImageWriterWorker::progressValueChanged, [&](int value)
+        {
+            if (callbacks->progress)
+                callbacks->progress(callbacks->user, value, total);
+
+            if (callbacks->cancel && callbacks->cancel(callbacks->user))
+                worker.cancel();
+        });
+
+        QObject::connect(&worker, &ImageWriterWorker::progressTextChanged, [&](const QString& text)
+        {
+            if (callbacks->status && !text.isEmpty())
+                callbacks->status(callbacks->user, text.toUtf8().constData());
+        });
+    }
+
+    worker.start(outputDirectory, QString::fromUtf8(base_name), &toc->toc);
+
+    return worker.succeeded() ? 1 : 0;
+}
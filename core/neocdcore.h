@@ -0,0 +1,115 @@
+#ifndef NEOCDCORE_H
+#define NEOCDCORE_H
+
+#include <stdint.h>
+
+// C interface of the core library: load the TOC of an image, walk its entries and export it to split
+// ISO / WAV / CUE files. Paths are UTF-8. Functions may be called from any thread, but a TOC is only used
+// by one thread at a time.
+
+#if defined(_WIN32) && defined(NEOCDCORE_SHARED)
+    #ifdef NEOCDCORE_BUILD
+        #define NEOCDCORE_API __declspec(dllexport)
+    #else
+        #define NEOCDCORE_API __declspec(dllimport)
+    #endif
+#else
+    #define NEOCDCORE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct NeoCdToc NeoCdToc;
+
+/// Track types, in the order of CdromToc::TrackType
+typedef enum NeoCdTrackType
+{
+    NEOCD_TRACK_MODE1_2352 = 0,
+    NEOCD_TRACK_MODE1_2048,
+    NEOCD_TRACK_SILENCE,
+    NEOCD_TRACK_AUDIO_PCM,
+    NEOCD_TRACK_AUDIO_FLAC,
+    NEOCD_TRACK_AUDIO_OGG,
+    NEOCD_TRACK_AUDIO_WAV
+} NeoCdTrackType;
+
+typedef enum NeoCdMessageLevel
+{
+    NEOCD_MESSAGE_DEBUG = 0,
+    NEOCD_MESSAGE_INFO,
+    NEOCD_MESSAGE_WARNING,
+    NEOCD_MESSAGE_ERROR
+} NeoCdMessageLevel;
+
+typedef struct NeoCdTocEntry
+{
+    /// Track and index numbers
+    int track;
+    int index;
+
+    NeoCdTrackType type;
+
+    /// Index of the data file in the file list, -1 for silence
+    int file_index;
+
+    /// Position on the disc and length (in sectors)
+    uint32_t start_sector;
+    uint32_t length;
+
+    /// Offset of the data in the file (in bytes)
+    int64_t file_offset;
+} NeoCdTocEntry;
+
+typedef struct NeoCdExportCallbacks
+{
+    /// Progress of the export, in units of sectors (several sectors per unit for the largest images)
+    void (*progress)(void* user, int64_t done, int64_t total);
+
+    /// Current step of the export, such as the file being written
+    void (*status)(void* user, const char* text);
+
+    /// Polled while exporting, returns non zero to cancel
+    int (*cancel)(void* user);
+
+    void* user;
+} NeoCdExportCallbacks;
+
+typedef void (*NeoCdMessageCallback)(void* user, NeoCdMessageLevel level, const char* message);
+
+/**
+ * @brief Receive the messages of the library, for the whole process. A null callback restores the default output.
+ */
+NEOCDCORE_API void neocd_set_message_callback(NeoCdMessageCallback callback, void* user);
+
+/**
+ * @brief Load the TOC of a CUE sheet, zip archive, CloneCD, Alcohol or Nero image, or of a BIN file scanned without its CUE sheet.
+ * @return The TOC, or null if the image could not be loaded.
+ */
+NEOCDCORE_API NeoCdToc* neocd_toc_open(const char* path);
+
+NEOCDCORE_API void neocd_toc_close(NeoCdToc* toc);
+
+NEOCDCORE_API int neocd_toc_entry_count(const NeoCdToc* toc);
+
+/**
+ * @brief Get an entry of the TOC, in disc order.
+ * @return 1 if the entry exists, 0 otherwise.
+ */
+NEOCDCORE_API int neocd_toc_entry(const NeoCdToc* toc, int position, NeoCdTocEntry* entry);
+
+NEOCDCORE_API uint32_t neocd_toc_total_sectors(const NeoCdToc* toc);
+
+/**
+ * @brief Export an image to split files named after base_name, with the default options.
+ * @param callbacks Optional, any of its functions may be null.
+ * @return 1 if the export succeeded, 0 otherwise.
+ */
+NEOCDCORE_API int neocd_export(NeoCdToc* toc, const char* output_directory, const char* base_name, const NeoCdExportCallbacks* callbacks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NEOCDCORE_H
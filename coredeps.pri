@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Optional libraries of the core, detected with pkg-config. Included by
+# the core library and by the projects linking it, which need the same
+# defines for the headers and the libraries for the static build.
+#
+#-------------------------------------------------
+
+# io_uring backend, only built when liburing is installed
+linux {
+    CONFIG += link_pkgconfig
+    packagesExist(liburing) {
+        PKGCONFIG += liburing
+        DEFINES += HAVE_LIBURING
+    }
+}
+
+# gzip and deflate compressed zip inputs, only read when zlib is installed
+unix {
+    CONFIG += link_pkgconfig
+    packagesExist(zlib) {
+        PKGCONFIG += zlib
+        DEFINES += HAVE_ZLIB
+    }
+}
@@ -7,6 +7,7 @@
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QProgressDialog>
+#include <QThread>
 #include <QtDebug>
 
 Dialog::Dialog(QWidget *parent) :
@@ -16,6 +17,7 @@ Dialog::Dialog(QWidget *parent) :
     m_dataIcon(QStringLiteral(":/res/data.png")),
     m_cdIcon(QStringLiteral(":/res/cd.png")),
     m_progressDialog(new QProgressDialog(this)),
+    m_exportThread(Q_NULLPTR),
     m_tocIsValid(false),
     m_toc()
 {
@@ -23,6 +25,9 @@ Dialog::Dialog(QWidget *parent) :
     m_progressDialog->setWindowFlags(m_progressDialog->windowFlags() & ~Qt::WindowContextHelpButtonHint);
     m_progressDialog->reset();
 
+    // The TOC is handed to the export thread through a queued connection
+    qRegisterMetaType<CdromToc*>("CdromToc*");
+
     setWindowFlags(Qt::Window);
 
     ui->setupUi(this);
@@ -34,6 +39,13 @@ Dialog::Dialog(QWidget *parent) :
 
 Dialog::~Dialog()
 {
+    // A running export is stopped before the TOC it reads goes away
+    if (m_exportThread)
+    {
+        emit cancelExportSplitImage();
+        m_exportThread->wait();
+    }
+
     delete ui;
 }
 
@@ -41,11 +53,14 @@ void Dialog::connectSignals()
 {
     connect(ui->loadCueButton, &QPushButton::clicked, this, &Dialog::loadToc);
     connect(ui->createSplitVersionButton, &QPushButton::clicked, this, &Dialog::exportSplitImage);
+    connect(m_progressDialog, &QProgressDialog::canceled, this, &Dialog::cancelExportSplitImage);
 }
 
 void Dialog::updateActions()
 {
-    ui->createSplitVersionButton->setEnabled(m_tocIsValid);
+    // The TOC is read by the export until it is done
+    ui->loadCueButton->setEnabled(!m_exportThread);
+    ui->createSplitVersionButton->setEnabled(m_tocIsValid && !m_exportThread);
 }
 
 void Dialog::updateTocView()
@@ -94,11 +109,11 @@ void Dialog::updateTocView()
 
 void Dialog::loadToc()
 {
-    QString cueFilename = QFileDialog::getOpenFileName(this, tr("Open a CUE file"), "", tr("Cue Files (*.cue)"));
+    QString cueFilename = QFileDialog::getOpenFileName(this, tr("Open a CUE file"), "", tr("Disc Images (*.cue *.ccd *.mds *.nrg *.bin)"));
     if (cueFilename.isEmpty())
         return;
 
-    m_tocIsValid = m_toc.loadCueSheet(cueFilename);
+    m_tocIsValid = m_toc.loadImage(cueFilename);
 
     updateActions();
 
@@ -108,6 +123,40 @@ void Dialog::loadToc()
         qInfo().noquote() << tr("TOC loaded successfully.");
 }
 
+ExportOptions Dialog::exportOptions() const
+{
+    ExportOptions options;
+
+    switch(ui->ioBackendComboBox->currentIndex())
+    {
+    case 1:
+        options.ioBackend = ExportOptions::IoBackend::Direct;
+        break;
+
+    case 2:
+        options.ioBackend = ExportOptions::IoBackend::Direct;
+        options.directIo = true;
+        break;
+
+    case 3:
+        options.ioBackend = ExportOptions::IoBackend::IoUring;
+        break;
+
+    default:
+        options.ioBackend = ExportOptions::IoBackend::Buffered;
+        break;
+    }
+
+    options.sparseOutput = ui->sparseOutputCheckBox->isChecked();
+    options.sampleOffset = ui->sampleOffsetSpinBox->value();
+    options.ditherAudio = ui->ditherAudioCheckBox->isChecked();
+    options.replayGainTags = ui->replayGainTagsCheckBox->isChecked();
+    options.analyzeAudio = ui->analyzeAudioCheckBox->isChecked() || options.replayGainTags;
+    options.computeChecksums = ui->checksumsCheckBox->isChecked();
+
+    return options;
+}
+
 void Dialog::exportSplitImage()
 {
     QString outputDirectory = QFileDialog::getExistingDirectory(this, tr("Choose the output directory"));
@@ -118,17 +167,35 @@ void Dialog::exportSplitImage()
     if (baseName.isEmpty())
         return;
 
+    // The export runs on its own thread, the dialog and its progress keep being updated meanwhile
+    m_exportThread = new QThread(this);
+
     ImageWriterWorker* worker = new ImageWriterWorker;
+    worker->setOptions(exportOptions());
+    worker->moveToThread(m_exportThread);
 
     connect(this, &Dialog::startExportSplitImage, worker, &ImageWriterWorker::start);
     connect(worker, &ImageWriterWorker::finished, worker, &ImageWriterWorker::deleteLater);
 
+    // The thread of the worker is busy exporting, cancellation and the end of the thread do not go through its events
+    connect(this, &Dialog::cancelExportSplitImage, worker, &ImageWriterWorker::cancel, Qt::DirectConnection);
+    connect(worker, &ImageWriterWorker::destroyed, m_exportThread, &QThread::quit, Qt::DirectConnection);
+    connect(m_exportThread, &QThread::finished, this, [this]()
+    {
+        m_exportThread->deleteLater();
+        m_exportThread = Q_NULLPTR;
+        updateActions();
+    });
+
     connect(worker, &ImageWriterWorker::started, m_progressDialog, &QProgressDialog::show);
     connect(worker, &ImageWriterWorker::finished, m_progressDialog, &QProgressDialog::reset);
     connect(worker, &ImageWriterWorker::progressRangeChanged, m_progressDialog, &QProgressDialog::setRange);
     connect(worker, &ImageWriterWorker::progressTextChanged, m_progressDialog, &QProgressDialog::setLabelText);
     connect(worker, &ImageWriterWorker::progressValueChanged, m_progressDialog, &QProgressDialog::setValue);
 
+    m_exportThread->start();
+    updateActions();
+
     emit startExportSplitImage(outputDirectory, baseName, &m_toc);
 }
 
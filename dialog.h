@@ -5,12 +5,14 @@
 #include <QIcon>
 
 #include "cdromtoc.h"
+#include "exportoptions.h"
 
 namespace Ui {
 class Dialog;
 }
 
 class QProgressDialog;
+class QThread;
 
 class Dialog : public QDialog
 {
@@ -22,6 +24,7 @@ public:
 
 signals:
     void startExportSplitImage(const QString& baseDirectory, const QString& baseName, CdromToc* toc);
+    void cancelExportSplitImage();
 
 protected:
     void connectSignals();
@@ -32,6 +35,8 @@ protected:
 
     void loadToc();
 
+    ExportOptions exportOptions() const;
+
     void exportSplitImage();
 
     Ui::Dialog *ui;
@@ -42,6 +47,9 @@ protected:
 
     QProgressDialog* m_progressDialog;
 
+    /// Thread of the running export, Q_NULLPTR when there is none
+    QThread* m_exportThread;
+
     bool m_tocIsValid;
     CdromToc m_toc;
 };
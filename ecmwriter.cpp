@@ -0,0 +1,165 @@
+#include "ecmwriter.h"
+#include "sectorcoder.h"
+
+constexpr int SECTOR_SIZE = 2352;
+
+// ECM record types written, Mode 2 sectors are not rebuilt by the export and stay raw
+constexpr int ECM_RAW = 0;
+constexpr int ECM_MODE1 = 1;
+
+// Encoded data buffered before it is written
+constexpr int OUTPUT_FLUSH_SIZE = 4 * 1024 * 1024;
+
+EcmWriter::EcmWriter() :
+    m_file(),
+    m_pending(),
+    m_output(),
+    m_edc(0),
+    m_sectorsRebuilt(0),
+    m_errorString()
+{ }
+
+EcmWriter::~EcmWriter()
+{
+    if (isOpen())
+        close();
+}
+
+bool EcmWriter::open(const QString &fileName)
+{
+    m_pending.clear();
+    m_output.clear();
+    m_edc = 0;
+    m_sectorsRebuilt = 0;
+    m_errorString.clear();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_output.append("ECM", 4);
+
+    return true;
+}
+
+bool EcmWriter::close()
+{
+    // A partial sector at the end of the image is kept as it is
+    if (!m_pending.isEmpty())
+    {
+        appendRecord(ECM_RAW, m_pending.size());
+        m_output.append(m_pending);
+        m_pending.clear();
+    }
+
+    // The end of the records is a count of 2^32, followed by the EDC of the image
+    appendRecord(ECM_RAW, qint64(1) << 32);
+
+    for(int i = 0; i < 4; ++i)
+        m_output.append(static_cast<char>((m_edc >> (8 * i)) & 0xff));
+
+    bool ok = flush();
+
+    m_file.close();
+
+    return ok;
+}
+
+bool EcmWriter::write(const char *data, qint64 size)
+{
+    m_edc = SectorCoder::edc(m_edc, reinterpret_cast<const uint8_t*>(data), static_cast<size_t>(size));
+
+    if (!m_pending.isEmpty())
+    {
+        qint64 slice = qMin(size, static_cast<qint64>(SECTOR_SIZE - m_pending.size()));
+        m_pending.append(data, static_cast<int>(slice));
+
+        data += slice;
+        size -= slice;
+
+        if (m_pending.size() == SECTOR_SIZE)
+        {
+            encodeSectors(m_pending.constData(), 1);
+            m_pending.clear();
+        }
+    }
+
+    qint64 count = size / SECTOR_SIZE;
+    encodeSectors(data, count);
+
+    m_pending.append(data + count * SECTOR_SIZE, static_cast<int>(size - count * SECTOR_SIZE));
+
+    if (m_output.size() >= OUTPUT_FLUSH_SIZE)
+        return flush();
+
+    return true;
+}
+
+void EcmWriter::encodeSectors(const char *data, qint64 count)
+{
+    qint64 i = 0;
+
+    // Consecutive sectors of the same type share a record
+    while(i < count)
+    {
+        const uint8_t* sector = reinterpret_cast<const uint8_t*>(data + i * SECTOR_SIZE);
+        bool rebuildable = SectorCoder::isRebuildableMode1(sector);
+
+        qint64 end = i + 1;
+        while((end < count) && (SectorCoder::isRebuildableMode1(reinterpret_cast<const uint8_t*>(data + end * SECTOR_SIZE)) == rebuildable))
+            ++end;
+
+        if (rebuildable)
+        {
+            appendRecord(ECM_MODE1, end - i);
+
+            // Address, then user data
+            for(qint64 j = i; j < end; ++j)
+            {
+                const char* source = data + j * SECTOR_SIZE;
+                m_output.append(source + 12, 3);
+                m_output.append(source + 16, 2048);
+            }
+
+            m_sectorsRebuilt += end - i;
+        }
+        else
+        {
+            appendRecord(ECM_RAW, (end - i) * SECTOR_SIZE);
+            m_output.append(data + i * SECTOR_SIZE, static_cast<int>((end - i) * SECTOR_SIZE));
+        }
+
+        i = end;
+    }
+}
+
+void EcmWriter::appendRecord(int type, qint64 count)
+{
+    // Type in the low two bits, count - 1 in the next five then seven bits per byte while the top bit is set
+    uint32_t value = static_cast<uint32_t>(count - 1);
+
+    m_output.append(static_cast<char>(((value >= 32) ? 0x80 : 0) | ((value & 0x1f) << 2) | type));
+    value >>= 5;
+
+    while(value)
+    {
+        m_output.append(static_cast<char>(((value >= 128) ? 0x80 : 0) | (value & 0x7f)));
+        value >>= 7;
+    }
+}
+
+bool EcmWriter::flush()
+{
+    if (m_file.write(m_output) != m_output.size())
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_output.clear();
+
+    return true;
+}
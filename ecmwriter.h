@@ -0,0 +1,74 @@
+#ifndef ECMWRITER_H
+#define ECMWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Writes a raw image as an ECM file, read back by the export like any other data file.
+// Mode 1 sectors whose sync, EDC and ECC match their content are stored as their address and user data
+// only, everything else is kept byte for byte. Sectors are taken at 2352 byte boundaries, as in BIN files.
+
+class EcmWriter
+{
+public:
+    explicit EcmWriter();
+    ~EcmWriter();
+
+    // Non copyable
+    EcmWriter(const EcmWriter&) = delete;
+
+    // Non copyable
+    EcmWriter& operator=(const EcmWriter&) = delete;
+
+    bool open(const QString& fileName);
+
+    /**
+     * @brief Write the end of the records and the checksum, and close the file.
+     */
+    bool close();
+
+    inline bool isOpen() const
+    {
+        return m_file.isOpen();
+    }
+
+    /**
+     * @brief Encode the next bytes of the image.
+     */
+    bool write(const char* data, qint64 size);
+
+    /**
+     * @brief Number of sectors stored without their sync, EDC and ECC so far.
+     */
+    inline qint64 sectorsRebuilt() const
+    {
+        return m_sectorsRebuilt;
+    }
+
+    inline QString errorString() const
+    {
+        return m_errorString;
+    }
+
+protected:
+    void encodeSectors(const char* data, qint64 count);
+    void appendRecord(int type, qint64 count);
+    bool flush();
+
+    QFile m_file;
+
+    /// Bytes of a sector not complete yet
+    QByteArray m_pending;
+
+    /// Encoded records waiting to be written
+    QByteArray m_output;
+
+    /// EDC of all the bytes of the image
+    uint32_t m_edc;
+
+    qint64 m_sectorsRebuilt;
+    QString m_errorString;
+};
+
+#endif // ECMWRITER_H
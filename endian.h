@@ -25,6 +25,7 @@
     || (defined(__GNUC__ ) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3)))
     #define BYTE_SWAP_16(x) __builtin_bswap16(x)
     #define BYTE_SWAP_32(x) __builtin_bswap32(x)
+    #define BYTE_SWAP_64(x) __builtin_bswap64(x)
 #elif defined(_MSC_VER)
     #ifdef __cplusplus
         #include <cstdlib>
@@ -33,6 +34,7 @@
     #endif
     #define BYTE_SWAP_16(x) _byteswap_ushort(x)
     #define BYTE_SWAP_32(x) _byteswap_ulong(x)
+    #define BYTE_SWAP_64(x) _byteswap_uint64(x)
 #else
     inline uint16_t BYTE_SWAP_16(uint16_t x)
     {
@@ -43,18 +45,27 @@
     {
         return static_cast<uint32_t>((x << 24) | ((x << 8) & 0x00FF0000) | ((x >> 8) & 0x0000FF00) | (x >> 24));
     }
+
+    inline uint64_t BYTE_SWAP_64(uint64_t x)
+    {
+        return (static_cast<uint64_t>(BYTE_SWAP_32(static_cast<uint32_t>(x))) << 32) | BYTE_SWAP_32(static_cast<uint32_t>(x >> 32));
+    }
 #endif
 
 #ifdef BIG_ENDIAN
     #define BIG_ENDIAN_WORD(x) (x)
     #define BIG_ENDIAN_DWORD(x) (x)
+    #define BIG_ENDIAN_QWORD(x) (x)
     #define LITTLE_ENDIAN_WORD(x) BYTE_SWAP_16(x)
     #define LITTLE_ENDIAN_DWORD(x) BYTE_SWAP_32(x)
+    #define LITTLE_ENDIAN_QWORD(x) BYTE_SWAP_64(x)
 #else // Little endian machine
     #define BIG_ENDIAN_WORD(x) BYTE_SWAP_16(x)
     #define BIG_ENDIAN_DWORD(x) BYTE_SWAP_32(x)
+    #define BIG_ENDIAN_QWORD(x) BYTE_SWAP_64(x)
     #define LITTLE_ENDIAN_WORD(x) (x)
     #define LITTLE_ENDIAN_DWORD(x) (x)
+    #define LITTLE_ENDIAN_QWORD(x) (x)
 #endif // LITTLE_ENDIAN
 
 #endif // ENDIAN_H
@@ -0,0 +1,104 @@
+#ifndef EXPORTOPTIONS_H
+#define EXPORTOPTIONS_H
+
+#include <QString>
+
+struct ExportOptions
+{
+    /// Enum representing the backends available to write output files
+    enum class IoBackend
+    {
+        Buffered,  /// Buffered writes through QFile
+        Direct,    /// Preallocated POSIX writes with page cache hints
+        IoUring    /// Asynchronous reads and writes with io_uring (Linux)
+    };
+
+    explicit ExportOptions() :
+        ioBackend(IoBackend::Buffered),
+        directIo(false),
+        adviseInputs(true),
+        prefetchFiles(2),
+        prefetchBudget(64 * 1024 * 1024),
+        queueDepth(0),
+        maxBuffers(0),
+        hugePages(false),
+        sparseOutput(false),
+        sampleOffset(0),
+        offsetReferenceFile(),
+        ditherAudio(true),
+        detectByteOrder(true),
+        analyzeAudio(false),
+        replayGainTags(false),
+        computeChecksums(false),
+        accurateRipDatabase(),
+        chunkStore(),
+        tarOutput(),
+        standardInputSize(0),
+        statisticsReport(false)
+    { }
+
+    /// Backend used to write the output files
+    IoBackend ioBackend;
+
+    /// Bypass the page cache with O_DIRECT (direct backend only)
+    bool directIo;
+
+    /// Tell the kernel input files are read sequentially and only once
+    bool adviseInputs;
+
+    /// Number of data files read ahead of the one being exported, 0 to disable prefetching
+    int prefetchFiles;
+
+    /// Bytes of the next data files read ahead at most
+    qint64 prefetchBudget;
+
+    /// Number of buffers in flight for the io_uring backend, zero to choose from the output device
+    int queueDepth;
+
+    /// Maximum number of sector buffers allocated at the same time, zero to follow the queue depth
+    int maxBuffers;
+
+    /// Back the sector buffers with huge pages when the system provides them
+    bool hugePages;
+
+    /// Leave long runs of zeros (digital silence, padding sectors) as holes in the output files
+    bool sparseOutput;
+
+    /// Read offset correction for audio tracks (in samples): output sample n is input sample n + offset
+    int sampleOffset;
+
+    /// Checksum reference file used to detect the read offset, empty to use sampleOffset as is
+    QString offsetReferenceFile;
+
+    /// Add dither when WAV files with more than 16 bits or another sample rate are converted to CD audio
+    bool ditherAudio;
+
+    /// Detect audio tracks of BIN files stored byte swapped (big endian) and write them back in little endian
+    bool detectByteOrder;
+
+    /// Measure peaks, loudness and clipping of the audio tracks, and write them to a sidecar report
+    bool analyzeAudio;
+
+    /// Also tag the WAV files with their ReplayGain (only with analyzeAudio)
+    bool replayGainTags;
+
+    /// Compute the AccurateRip v1 / v2 and CRC32 checksums of the audio tracks, and the CTDB CRC of the disc
+    bool computeChecksums;
+
+    /// AccurateRip dBAR file the checksums are verified against, empty to only report them
+    QString accurateRipDatabase;
+
+    /// Chunk store receiving the exported files, which are then replaced by a manifest; empty to keep the files
+    QString chunkStore;
+
+    /// File or pipe receiving the CUE sheet and tracks as a tar archive, "-" for the standard output; empty to write files
+    QString tarOutput;
+
+    /// Size of the data file of the CUE sheet piped to the standard input, 0 to read the data files from the disk
+    qint64 standardInputSize;
+
+    /// Write the time, bytes, I/O calls and allocations of every stage to [Base Name].stats.json (successful exports only)
+    bool statisticsReport;
+};
+
+#endif // EXPORTOPTIONS_H
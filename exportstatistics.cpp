@@ -0,0 +1,233 @@
+#include "exportstatistics.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtDebug>
+
+static double throughput(qint64 bytes, qint64 nanoseconds)
+{
+    if (nanoseconds <= 0)
+        return 0.0;
+
+    return (static_cast<double>(bytes) / (1024.0 * 1024.0)) / (static_cast<double>(nanoseconds) / 1e9);
+}
+
+ExportStatistics::StageTimer::StageTimer(ExportStatistics &statistics, Stage stage) :
+    m_statistics(statistics),
+    m_stage(stage),
+    m_timer(),
+    m_bytes(0),
+    m_syscalls(0),
+    m_allocations(0)
+{
+    m_timer.start();
+}
+
+ExportStatistics::StageTimer::~StageTimer()
+{
+    m_statistics.add(m_stage, m_timer.nsecsElapsed(), m_bytes, m_syscalls, m_allocations);
+}
+
+ExportStatistics::ExportStatistics() :
+    m_tracks(),
+    m_trackTimer(),
+    m_totalTimer(),
+    m_totalNanoseconds(0),
+    m_trackIsOpen(false),
+    m_sparseOutput(false)
+{ }
+
+void ExportStatistics::clear()
+{
+    m_tracks.clear();
+    m_totalNanoseconds = 0;
+    m_trackIsOpen = false;
+    m_totalTimer.start();
+}
+
+void ExportStatistics::beginTrack(uint8_t track, const QString &fileName)
+{
+    if (m_trackIsOpen)
+        endTrack();
+
+    if (!m_totalTimer.isValid())
+        m_totalTimer.start();
+
+    TrackStatistics statistics;
+    statistics.track = track;
+    statistics.fileName = fileName;
+    statistics.nanoseconds = 0;
+    statistics.stages.fill({ 0, 0, 0, 0 });
+    statistics.sparseBytes = 0;
+
+    m_tracks.push_back(statistics);
+    m_trackIsOpen = true;
+    m_trackTimer.start();
+}
+
+void ExportStatistics::endTrack()
+{
+    if (!m_trackIsOpen)
+        return;
+
+    m_tracks.last().nanoseconds = m_trackTimer.nsecsElapsed();
+    m_totalNanoseconds = m_totalTimer.nsecsElapsed();
+    m_trackIsOpen = false;
+}
+
+void ExportStatistics::add(Stage stage, qint64 nanoseconds, qint64 bytes, qint64 syscalls, qint64 allocations)
+{
+    // Work done outside of a track (CUE sheet, etc.) is not accounted for
+    if (!m_trackIsOpen)
+        return;
+
+    StageCounters& counters = m_tracks.last().stages[static_cast<size_t>(stage)];
+    counters.nanoseconds += nanoseconds;
+    counters.bytes += bytes;
+    counters.syscalls += syscalls;
+    counters.allocations += allocations;
+}
+
+void ExportStatistics::addSparseBytes(qint64 bytes)
+{
+    if (!m_trackIsOpen)
+        return;
+
+    m_tracks.last().sparseBytes += bytes;
+}
+
+ExportStatistics::StageCounters ExportStatistics::stageTotal(Stage stage) const
+{
+    StageCounters total = { 0, 0, 0, 0 };
+
+    for(const TrackStatistics& track : m_tracks)
+    {
+        const StageCounters& counters = track.stages[static_cast<size_t>(stage)];
+        total.nanoseconds += counters.nanoseconds;
+        total.bytes += counters.bytes;
+        total.syscalls += counters.syscalls;
+        total.allocations += counters.allocations;
+    }
+
+    return total;
+}
+
+qint64 ExportStatistics::sparseTotal() const
+{
+    qint64 total = 0;
+
+    for(const TrackStatistics& track : m_tracks)
+        total += track.sparseBytes;
+
+    return total;
+}
+
+QJsonObject ExportStatistics::toJson() const
+{
+    QJsonArray tracks;
+
+    for(const TrackStatistics& track : m_tracks)
+    {
+        QJsonObject stages;
+        for(int i = 0; i < STAGE_COUNT; ++i)
+            stages.insert(stageName(static_cast<Stage>(i)), countersToJson(track.stages[static_cast<size_t>(i)]));
+
+        QJsonObject object;
+        object.insert(QStringLiteral("track"), static_cast<int>(track.track));
+        object.insert(QStringLiteral("file"), track.fileName);
+        object.insert(QStringLiteral("nanoseconds"), static_cast<double>(track.nanoseconds));
+        object.insert(QStringLiteral("stages"), stages);
+        object.insert(QStringLiteral("sparseBytes"), static_cast<double>(track.sparseBytes));
+        tracks.append(object);
+    }
+
+    QJsonObject totals;
+    for(int i = 0; i < STAGE_COUNT; ++i)
+        totals.insert(stageName(static_cast<Stage>(i)), countersToJson(stageTotal(static_cast<Stage>(i))));
+
+    QJsonObject report;
+    report.insert(QStringLiteral("nanoseconds"), static_cast<double>(m_totalNanoseconds));
+    report.insert(QStringLiteral("tracks"), tracks);
+    report.insert(QStringLiteral("totals"), totals);
+    report.insert(QStringLiteral("sparseOutput"), m_sparseOutput);
+    report.insert(QStringLiteral("sparseBytes"), static_cast<double>(sparseTotal()));
+
+    return report;
+}
+
+bool ExportStatistics::writeReport(const QString &filename) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning().noquote() << "Could not write statistics report: " << file.errorString();
+        return false;
+    }
+
+    QByteArray json = QJsonDocument(toJson()).toJson(QJsonDocument::Indented);
+
+    return (file.write(json) == json.size());
+}
+
+void ExportStatistics::logSummary() const
+{
+    qInfo().noquote() << QStringLiteral("Export done in %1 ms.").arg(static_cast<double>(m_totalNanoseconds) / 1e6, 0, 'f', 1);
+
+    for(int i = 0; i < STAGE_COUNT; ++i)
+    {
+        StageCounters total = stageTotal(static_cast<Stage>(i));
+        if (!total.nanoseconds && !total.bytes)
+            continue;
+
+        qInfo().noquote() << QStringLiteral("%1: %2 ms, %3 MiB (%4 MiB/s), %5 syscalls, %6 allocations")
+                             .arg(stageName(static_cast<Stage>(i)))
+                             .arg(static_cast<double>(total.nanoseconds) / 1e6, 0, 'f', 1)
+                             .arg(static_cast<double>(total.bytes) / (1024.0 * 1024.0), 0, 'f', 1)
+                             .arg(throughput(total.bytes, total.nanoseconds), 0, 'f', 1)
+                             .arg(total.syscalls)
+                             .arg(total.allocations);
+    }
+
+    qint64 sparseBytes = sparseTotal();
+    if (sparseBytes)
+        qInfo().noquote() << QStringLiteral("Sparse output: %1 MiB of zeros left as holes.").arg(static_cast<double>(sparseBytes) / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+QString ExportStatistics::stageName(Stage stage)
+{
+    switch(stage)
+    {
+    case Stage::Read:
+        return QStringLiteral("read");
+
+    case Stage::EdcCheck:
+        return QStringLiteral("edcCheck");
+
+    case Stage::Copy:
+        return QStringLiteral("copy");
+
+    case Stage::WaveHeader:
+        return QStringLiteral("waveHeader");
+
+    case Stage::Write:
+        return QStringLiteral("write");
+
+    case Stage::Analysis:
+        return QStringLiteral("analysis");
+
+    default:
+        return QString();
+    }
+}
+
+QJsonObject ExportStatistics::countersToJson(const StageCounters &counters)
+{
+    QJsonObject object;
+    object.insert(QStringLiteral("nanoseconds"), static_cast<double>(counters.nanoseconds));
+    object.insert(QStringLiteral("bytes"), static_cast<double>(counters.bytes));
+    object.insert(QStringLiteral("syscalls"), static_cast<double>(counters.syscalls));
+    object.insert(QStringLiteral("allocations"), static_cast<double>(counters.allocations));
+    object.insert(QStringLiteral("throughput"), throughput(counters.bytes, counters.nanoseconds));
+    return object;
+}
@@ -0,0 +1,148 @@
+#ifndef EXPORTSTATISTICS_H
+#define EXPORTSTATISTICS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include <array>
+#include <cstdint>
+
+class ExportStatistics
+{
+public:
+    /// Enum representing the stages of the export pipeline being measured
+    enum class Stage
+    {
+        Read,        /// Reading sectors from the input file
+        EdcCheck,    /// Checking the EDC of raw data sectors
+        Copy,        /// Moving data between buffers (payload extraction, conversion)
+        WaveHeader,  /// Writing or patching WAV headers
+        Write,       /// Writing data to the output file
+        Analysis,    /// Measuring the levels, loudness and checksums of audio tracks
+        Count
+    };
+
+    static constexpr int STAGE_COUNT = static_cast<int>(Stage::Count);
+
+    struct StageCounters
+    {
+        /// Wall time spent in the stage (in nanoseconds)
+        qint64 nanoseconds;
+
+        /// Number of bytes processed by the stage
+        qint64 bytes;
+
+        /// Number of I/O calls (read, write, seek) issued by the stage
+        qint64 syscalls;
+
+        /// Number of heap allocations done by the stage
+        qint64 allocations;
+    };
+
+    struct TrackStatistics
+    {
+        /// Track number
+        uint8_t track;
+
+        /// Name of the output file
+        QString fileName;
+
+        /// Total wall time spent on the track (in nanoseconds)
+        qint64 nanoseconds;
+
+        /// Counters for every stage
+        std::array<StageCounters, STAGE_COUNT> stages;
+
+        /// Number of zero bytes left as holes instead of being written
+        qint64 sparseBytes;
+    };
+
+    /**
+     * @brief Helper measuring the wall time of a stage for the lifetime of the object.
+     */
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(ExportStatistics& statistics, Stage stage);
+        ~StageTimer();
+
+        // Non copyable
+        StageTimer(const StageTimer&) = delete;
+
+        // Non copyable
+        StageTimer& operator=(const StageTimer&) = delete;
+
+        inline void addBytes(qint64 bytes)
+        {
+            m_bytes += bytes;
+        }
+
+        inline void addSyscalls(qint64 count = 1)
+        {
+            m_syscalls += count;
+        }
+
+        inline void addAllocations(qint64 count = 1)
+        {
+            m_allocations += count;
+        }
+
+    protected:
+        ExportStatistics& m_statistics;
+        Stage m_stage;
+        QElapsedTimer m_timer;
+        qint64 m_bytes;
+        qint64 m_syscalls;
+        qint64 m_allocations;
+    };
+
+    explicit ExportStatistics();
+
+    void clear();
+
+    void beginTrack(uint8_t track, const QString& fileName);
+
+    void endTrack();
+
+    void add(Stage stage, qint64 nanoseconds, qint64 bytes, qint64 syscalls, qint64 allocations);
+
+    void addSparseBytes(qint64 bytes);
+
+    /**
+     * @brief Tell if runs of zeros were left as holes, the backend may have turned sparse output off.
+     */
+    inline void setSparseOutput(bool enabled)
+    {
+        m_sparseOutput = enabled;
+    }
+
+    inline const QVector<ExportStatistics::TrackStatistics>& tracks() const
+    {
+        return m_tracks;
+    }
+
+    StageCounters stageTotal(Stage stage) const;
+
+    qint64 sparseTotal() const;
+
+    QJsonObject toJson() const;
+
+    bool writeReport(const QString& filename) const;
+
+    void logSummary() const;
+
+    static QString stageName(Stage stage);
+
+protected:
+    static QJsonObject countersToJson(const StageCounters& counters);
+
+    QVector<ExportStatistics::TrackStatistics> m_tracks;
+    QElapsedTimer m_trackTimer;
+    QElapsedTimer m_totalTimer;
+    qint64 m_totalNanoseconds;
+    bool m_trackIsOpen;
+    bool m_sparseOutput;
+};
+
+#endif // EXPORTSTATISTICS_H
@@ -0,0 +1,117 @@
+#include "fileprefetcher.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+#endif
+
+// Size of the warm-up reads when the system has no readahead hint
+constexpr qint64 WARM_UP_READ_SIZE = 1024 * 1024;
+
+class PrefetchJob : public QRunnable
+{
+public:
+    PrefetchJob(FilePrefetcher& prefetcher, const QString& fileName, qint64 length) :
+        m_prefetcher(prefetcher),
+        m_fileName(fileName),
+        m_length(length)
+    { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_prefetcher.prefetch(m_fileName, m_length);
+    }
+
+protected:
+    FilePrefetcher& m_prefetcher;
+    QString m_fileName;
+    qint64 m_length;
+};
+
+FilePrefetcher::FilePrefetcher() :
+    m_threadPool(),
+    m_cancelFlag(0),
+    m_files(),
+    m_windows(),
+    m_nextFile(0),
+    m_depth(0),
+    m_budget(0)
+{
+    // Files are warmed one after the other, in the order the export reads them
+    m_threadPool.setMaxThreadCount(1);
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+    cancel();
+}
+
+void FilePrefetcher::setFiles(const QVector<CdromToc::FileEntry> &files, int depth, qint64 budget)
+{
+    cancel();
+
+    m_files.clear();
+    for(const CdromToc::FileEntry& file : files)
+        m_files.append(file.fileName);
+
+    m_windows.fill(0, files.size());
+    m_nextFile = 0;
+    m_depth = depth;
+    m_budget = budget;
+}
+
+void FilePrefetcher::advance(int currentFile)
+{
+    // Files up to the current one are being read or done, their windows are out of the budget
+    qint64 ahead = 0;
+    for(int i = currentFile + 1; i < m_nextFile; ++i)
+        ahead += m_windows.at(i);
+
+    m_nextFile = qMax(m_nextFile, currentFile + 1);
+
+    while((m_nextFile <= currentFile + m_depth) && (m_nextFile < m_files.size()) && (ahead < m_budget))
+    {
+        const QString& fileName = m_files.at(m_nextFile);
+        qint64 window = qMin(QFileInfo(fileName).size(), m_budget - ahead);
+
+        if (window > 0)
+            m_threadPool.start(new PrefetchJob(*this, fileName, window));
+
+        m_windows[m_nextFile] = window;
+        ahead += window;
+        ++m_nextFile;
+    }
+}
+
+void FilePrefetcher::cancel()
+{
+    m_cancelFlag.store(1);
+    m_threadPool.waitForDone();
+    m_cancelFlag.store(0);
+}
+
+void FilePrefetcher::prefetch(const QString &fileName, qint64 length)
+{
+    if (m_cancelFlag.load())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+#ifdef Q_OS_LINUX
+    // The kernel reads the range in the background, the pages stay cached once the file is closed
+    posix_fadvise(file.handle(), 0, length, POSIX_FADV_WILLNEED);
+#else
+    QByteArray buffer(static_cast<int>(WARM_UP_READ_SIZE), Qt::Uninitialized);
+
+    for(qint64 position = 0; (position < length) && !m_cancelFlag.load(); position += WARM_UP_READ_SIZE)
+    {
+        if (file.read(buffer.data(), qMin(WARM_UP_READ_SIZE, length - position)) <= 0)
+            break;
+    }
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef FILEPREFETCHER_H
+#define FILEPREFETCHER_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+#include "cdromtoc.h"
+
+// Warms the page cache with the next data files of a CUE sheet while the current one is exported, so
+// images with one file per track do not start every track on a cold cache.
+// The start of the next files is read ahead on a background thread (posix_fadvise WILLNEED on Linux, plain
+// reads elsewhere), one file after the other, within a budget of bytes prefetched and not yet reached.
+
+class FilePrefetcher
+{
+public:
+    explicit FilePrefetcher();
+    ~FilePrefetcher();
+
+    // Non copyable
+    FilePrefetcher(const FilePrefetcher&) = delete;
+
+    // Non copyable
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+    /**
+     * @brief Set the files of the disc, in the order they are read, and forget what was prefetched.
+     * @param depth Number of files prefetched ahead of the current one, 0 to disable prefetching.
+     * @param budget Bytes prefetched ahead of the current file at most.
+     */
+    void setFiles(const QVector<CdromToc::FileEntry>& files, int depth, qint64 budget);
+
+    /**
+     * @brief Start prefetching the files following the one being read.
+     */
+    void advance(int currentFile);
+
+    /**
+     * @brief Stop the reads in progress and wait for them.
+     */
+    void cancel();
+
+protected:
+    friend class PrefetchJob;
+
+    void prefetch(const QString& fileName, qint64 length);
+
+    QThreadPool m_threadPool;
+    QAtomicInt m_cancelFlag;
+    QStringList m_files;
+
+    /// Bytes prefetched for each file, 0 if not prefetched
+    QVector<qint64> m_windows;
+
+    /// First file not prefetched yet
+    int m_nextFile;
+
+    int m_depth;
+    qint64 m_budget;
+};
+
+#endif // FILEPREFETCHER_H
@@ -0,0 +1,412 @@
+#include "batchscheduler.h"
+#include "cdromtoc.h"
+#include "folderwatcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QtDebug>
+
+#ifdef Q_OS_LINUX
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+// Interval between two checks of the discs waiting for their files
+constexpr int CHECK_INTERVAL = 1000;
+
+#ifdef Q_OS_LINUX
+// Events telling that files or subdirectories appear, change or go away
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+#endif
+
+// Exports a batch of discs on its own thread, so the inboxes are still watched meanwhile
+class FolderWatcherBatch : public QThread
+{
+public:
+    explicit FolderWatcherBatch(const ExportOptions& options) :
+        QThread(),
+        m_scheduler()
+    {
+        m_scheduler.setOptions(options);
+    }
+
+    inline BatchScheduler& scheduler()
+    {
+        return m_scheduler;
+    }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        m_scheduler.run();
+    }
+
+    BatchScheduler m_scheduler;
+};
+
+FolderWatcher::FolderWatcher(QObject *parent) :
+    QObject(parent),
+    m_inotify(-1),
+    m_notifier(Q_NULLPTR),
+    m_timer(),
+    m_clock(),
+    m_watches(),
+    m_files(),
+    m_pendingDiscs(),
+    m_batch(Q_NULLPTR),
+    m_exportingDiscs(),
+    m_options(),
+    m_outputDirectory(),
+    m_doneDirectory(),
+    m_failedDirectory(),
+    m_settleTime(0),
+    m_pendingTimeout(0),
+    m_failedDiscs(0)
+{
+#ifdef Q_OS_LINUX
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (m_inotify >= 0)
+    {
+        m_notifier = new QSocketNotifier(m_inotify, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &FolderWatcher::readEvents);
+    }
+#endif
+
+    m_timer.setInterval(CHECK_INTERVAL);
+    connect(&m_timer, &QTimer::timeout, this, &FolderWatcher::exportReadyDiscs);
+
+    m_clock.start();
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    waitForExports();
+
+#ifdef Q_OS_LINUX
+    if (m_inotify >= 0)
+        close(m_inotify);
+#endif
+}
+
+void FolderWatcher::setDirectories(const QString &outputDirectory, const QString &doneDirectory, const QString &failedDirectory)
+{
+    m_outputDirectory = QFileInfo(outputDirectory).absoluteFilePath();
+    m_doneDirectory = QFileInfo(doneDirectory).absoluteFilePath();
+    m_failedDirectory = QFileInfo(failedDirectory).absoluteFilePath();
+}
+
+bool FolderWatcher::addDirectory(const QString &directory)
+{
+#ifdef Q_OS_LINUX
+    if (m_inotify < 0)
+    {
+        qCritical().noquote() << "Could not create the inotify instance.";
+        return false;
+    }
+
+    if (!QFileInfo(directory).isDir())
+    {
+        qCritical().noquote() << "Directory " << directory << " does not exist.";
+        return false;
+    }
+
+    QString root = QFileInfo(directory).absoluteFilePath();
+    watchTree(root, root);
+
+    m_timer.start();
+
+    return true;
+#else
+    Q_UNUSED(directory)
+
+    qCritical().noquote() << "Watch folders are only supported on Linux.";
+    return false;
+#endif
+}
+
+void FolderWatcher::waitForExports()
+{
+    if (m_batch)
+        qInfo().noquote() << "Waiting for " << m_exportingDiscs.size() << " discs being exported.";
+
+    finishBatch();
+}
+
+void FolderWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    for(;;)
+    {
+        // The descriptor is non blocking, reading stops once the queue is drained
+        ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for(char* position = buffer; position < buffer + length; )
+        {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(position);
+            position += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // Events were lost, every inbox is scanned again
+                QStringList roots;
+                for(const QPair<QString, QString>& watch : m_watches)
+                {
+                    if (!roots.contains(watch.second))
+                        roots.append(watch.second);
+                }
+
+                for(const QString& root : roots)
+                    watchTree(root, root);
+
+                continue;
+            }
+
+            auto watch = m_watches.find(event->wd);
+            if (watch == m_watches.end())
+                continue;
+
+            if (event->mask & IN_IGNORED)
+            {
+                m_watches.erase(watch);
+                continue;
+            }
+
+            if (!event->len)
+                continue;
+
+            QString path = QDir(watch.value().first).filePath(QFile::decodeName(event->name));
+            QString root = watch.value().second;
+
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    watchTree(path, root);
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                m_files.remove(path);
+                m_pendingDiscs.remove(path);
+            }
+            else
+                fileChanged(path, root, (event->mask & (IN_CREATE | IN_MODIFY)) != 0);
+        }
+    }
+#endif
+}
+
+void FolderWatcher::exportReadyDiscs()
+{
+    QStringList ready;
+    QStringList stalled;
+    qint64 now = m_clock.elapsed();
+
+    for(auto i = m_pendingDiscs.begin(); i != m_pendingDiscs.end(); )
+    {
+        QStringList files;
+        if (!CdromToc::listCueFiles(i.key(), files))
+        {
+            i = m_pendingDiscs.erase(i);
+            continue;
+        }
+
+        // Every file is checked so the sizes of all of them are tracked from now on
+        bool complete = isComplete(i.key());
+
+        for(const QString& file : files)
+            complete = isComplete(file) && complete;
+
+        if (complete)
+            ready.append(i.key());
+        else if (m_pendingTimeout > 0)
+        {
+            // A disc is given up once none of its files changed for the timeout, a slow copy keeps it waiting
+            qint64 changed = lastChange(i.key());
+            for(const QString& file : files)
+                changed = qMax(changed, lastChange(file));
+
+            if ((changed >= 0) && (now - changed >= m_pendingTimeout))
+                stalled.append(i.key());
+        }
+
+        ++i;
+    }
+
+    for(const QString& cueFile : stalled)
+    {
+        qCritical().noquote() << "Disc " << cueFile << " is still incomplete after " << (m_pendingTimeout / 1000) << " s without change.";
+        failDisc(cueFile, m_pendingDiscs.take(cueFile));
+    }
+
+    // The discs ready meanwhile make the next batch
+    if (ready.isEmpty() || m_batch)
+        return;
+
+    m_batch = new FolderWatcherBatch(m_options);
+
+    for(const QString& cueFile : ready)
+    {
+        QString root = m_pendingDiscs.take(cueFile);
+        m_exportingDiscs.insert(cueFile, root);
+
+        m_batch->scheduler().addJob(cueFile, QDir::cleanPath(QDir(m_outputDirectory).filePath(QDir(root).relativeFilePath(QFileInfo(cueFile).path()))));
+    }
+
+    connect(m_batch, &QThread::finished, this, &FolderWatcher::finishBatch);
+    m_batch->start();
+}
+
+void FolderWatcher::finishBatch()
+{
+    // Called once the thread is done, or to wait for it when the watch ends
+    if (!m_batch)
+        return;
+
+    m_batch->wait();
+
+    for(const BatchScheduler::Job& job : m_batch->scheduler().jobs())
+    {
+        QString root = m_exportingDiscs.value(job.cueFile);
+
+        if (job.succeeded)
+            moveInputs(job.cueFile, root, m_doneDirectory);
+        else
+            failDisc(job.cueFile, root);
+    }
+
+    m_exportingDiscs.clear();
+
+    delete m_batch;
+    m_batch = Q_NULLPTR;
+}
+
+void FolderWatcher::watchTree(const QString &directory, const QString &root)
+{
+#ifdef Q_OS_LINUX
+    // The trees written to may be inside an inbox, they are not inputs
+    for(const QString& excluded : { m_outputDirectory, m_doneDirectory, m_failedDirectory })
+    {
+        if (QDir::cleanPath(directory) == QDir::cleanPath(excluded))
+            return;
+    }
+
+    int wd = inotify_add_watch(m_inotify, QFile::encodeName(directory).constData(), WATCH_MASK);
+    if (wd < 0)
+    {
+        qWarning().noquote() << "Could not watch directory " << directory;
+        return;
+    }
+
+    m_watches.insert(wd, qMakePair(directory, root));
+
+    // CUE sheets already there, or written before the watch was added
+    QDir current(directory);
+
+    for(const QString& name : current.entryList({ QStringLiteral("*.cue"), QStringLiteral("*.zip") }, QDir::Files))
+    {
+        if (!m_exportingDiscs.contains(current.filePath(name)))
+            m_pendingDiscs.insert(current.filePath(name), root);
+    }
+
+    for(const QString& name : current.entryList(QStringList(), QDir::Dirs | QDir::NoDotAndDotDot))
+        watchTree(current.filePath(name), root);
+#else
+    Q_UNUSED(directory)
+    Q_UNUSED(root)
+#endif
+}
+
+void FolderWatcher::fileChanged(const QString &path, const QString &root, bool writing)
+{
+    FileState state;
+    state.size = -1;
+    state.lastChange = m_clock.elapsed();
+    state.writing = writing;
+
+    m_files.insert(path, state);
+
+    if (isDiscImage(path) && !m_exportingDiscs.contains(path))
+        m_pendingDiscs.insert(path, root);
+}
+
+bool FolderWatcher::isComplete(const QString &path)
+{
+    QFileInfo info(path);
+    if (!info.exists())
+        return false;
+
+    qint64 now = m_clock.elapsed();
+    auto i = m_files.find(path);
+
+    // Files without events yet are given the settle time too
+    if (i == m_files.end())
+    {
+        m_files.insert(path, { info.size(), now, false });
+        return false;
+    }
+
+    FileState& state = i.value();
+
+    if (state.writing)
+        return false;
+
+    if (state.size != info.size())
+    {
+        state.size = info.size();
+        state.lastChange = now;
+        return false;
+    }
+
+    return (now - state.lastChange) >= m_settleTime;
+}
+
+qint64 FolderWatcher::lastChange(const QString &path) const
+{
+    auto i = m_files.constFind(path);
+    return (i == m_files.constEnd()) ? -1 : i.value().lastChange;
+}
+
+void FolderWatcher::failDisc(const QString &cueFile, const QString &root)
+{
+    moveInputs(cueFile, root, m_failedDirectory);
+    ++m_failedDiscs;
+}
+
+void FolderWatcher::moveInputs(const QString &cueFile, const QString &root, const QString &destination)
+{
+    QDir cueDirectory = QFileInfo(cueFile).dir();
+    QDir target(QDir(destination).filePath(QDir(root).relativeFilePath(cueDirectory.path())));
+
+    QStringList files;
+    CdromToc::listCueFiles(cueFile, files);
+    files.prepend(cueFile);
+
+    for(const QString& file : files)
+    {
+        // Files are moved with the same path relative to the CUE sheet, so it stays valid
+        QString relativePath = cueDirectory.relativeFilePath(file);
+        if (relativePath.startsWith(QStringLiteral("..")) || !QFileInfo::exists(file))
+            continue;
+
+        QString targetPath = target.filePath(relativePath);
+
+        if (!QDir().mkpath(QFileInfo(targetPath).path()) || !QFile::rename(file, targetPath))
+            qCritical().noquote() << "Could not move " << file << " to " << targetPath;
+
+        m_files.remove(file);
+    }
+}
+
+bool FolderWatcher::isDiscImage(const QString &path)
+{
+    QString suffix = QFileInfo(path).suffix();
+
+    return (suffix.compare(QStringLiteral("cue"), Qt::CaseInsensitive) == 0) || (suffix.compare(QStringLiteral("zip"), Qt::CaseInsensitive) == 0);
+}
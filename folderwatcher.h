@@ -0,0 +1,131 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "exportoptions.h"
+
+class FolderWatcherBatch;
+class QSocketNotifier;
+
+// Long running ingest of the CUE sheets, or zip archives holding one, dropped in inbox directories.
+// The directories and their subdirectories are watched with inotify (Linux only). A CUE sheet is exported
+// once it and all the files it references, found as the loader finds them, are complete: closed for writing
+// and keeping the same size for a settle time. Discs still incomplete when none of their files changed for
+// a while are given up. Exports run on their own thread, one batch at a time, while the inboxes are still
+// watched. They go to the output tree, then the inputs are moved to the done or failed tree.
+
+class FolderWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FolderWatcher(QObject *parent = Q_NULLPTR);
+    virtual ~FolderWatcher() Q_DECL_OVERRIDE;
+
+    inline void setOptions(const ExportOptions& options)
+    {
+        m_options = options;
+    }
+
+    /**
+     * @brief Set the trees receiving the exports, and the inputs once exported or after a failure.
+     */
+    void setDirectories(const QString& outputDirectory, const QString& doneDirectory, const QString& failedDirectory);
+
+    /**
+     * @brief Time the files of a disc must stay unchanged before it is exported, in milliseconds.
+     */
+    inline void setSettleTime(int milliseconds)
+    {
+        m_settleTime = milliseconds;
+    }
+
+    /**
+     * @brief Time a disc may stay incomplete with none of its files changing before it is moved to the failed tree,
+     * in milliseconds, 0 to wait forever.
+     */
+    inline void setPendingTimeout(int milliseconds)
+    {
+        m_pendingTimeout = milliseconds;
+    }
+
+    /**
+     * @brief Watch a directory and its subdirectories. CUE sheets already there are exported too.
+     */
+    bool addDirectory(const QString& directory);
+
+    /**
+     * @brief Wait for the discs being exported, then move their inputs.
+     */
+    void waitForExports();
+
+    /**
+     * @brief Number of discs moved to the failed tree since the watch started.
+     */
+    inline int failedDiscs() const
+    {
+        return m_failedDiscs;
+    }
+
+protected slots:
+    void readEvents();
+    void exportReadyDiscs();
+    void finishBatch();
+
+protected:
+    struct FileState
+    {
+        /// Size seen at the last check, -1 when not checked yet
+        qint64 size;
+
+        /// Time of the last change, from m_clock
+        qint64 lastChange;
+
+        /// Set between the creation or modification of the file and its close
+        bool writing;
+    };
+
+    void watchTree(const QString& directory, const QString& root);
+    void fileChanged(const QString& path, const QString& root, bool writing);
+    bool isComplete(const QString& path);
+    qint64 lastChange(const QString& path) const;
+    void failDisc(const QString& cueFile, const QString& root);
+    void moveInputs(const QString& cueFile, const QString& root, const QString& destination);
+
+    static bool isDiscImage(const QString& path);
+
+    int m_inotify;
+    QSocketNotifier* m_notifier;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+
+    /// Watched directories by watch descriptor, with the inbox they belong to
+    QHash<int, QPair<QString, QString>> m_watches;
+
+    /// State of the files seen changing, by path
+    QHash<QString, FileState> m_files;
+
+    /// CUE sheets waiting for their files, with their inbox
+    QMap<QString, QString> m_pendingDiscs;
+
+    /// Export running, and the CUE sheets it exports with their inbox
+    FolderWatcherBatch* m_batch;
+    QMap<QString, QString> m_exportingDiscs;
+
+    ExportOptions m_options;
+    QString m_outputDirectory;
+    QString m_doneDirectory;
+    QString m_failedDirectory;
+    int m_settleTime;
+    int m_pendingTimeout;
+    int m_failedDiscs;
+};
+
+#endif // FOLDERWATCHER_H
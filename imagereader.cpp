@@ -0,0 +1,685 @@
+#include "endian.h"
+#include "imagereader.h"
+#include "packedstruct.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+constexpr int CDROM_SECTOR_SIZE = 2352;
+constexpr int CDROM_DATA_SIZE = 2048;
+
+// Size of the P-W subchannel stored after each sector
+constexpr int SUBCHANNEL_SIZE = 96;
+
+// Point of the TOC entry holding the start of the lead-out
+constexpr int LEAD_OUT_POINT = 0xa2;
+
+// Alcohol track modes (low nibble) and the subchannel mode of interleaved P-W data
+constexpr int MDS_MODE_AUDIO = 0x09;
+constexpr int MDS_MODE_MODE1 = 0x0a;
+constexpr int MDS_SUBCHANNEL_INTERLEAVED = 0x08;
+
+// Nero footers, the offset of the chunks is 64 bits in version 2 images and 32 bits before
+constexpr qint64 NRG_FOOTER_SIZE = 12;
+constexpr qint64 NRG_OLD_FOOTER_SIZE = 8;
+
+// Nero DAO chunk header, before the track blocks
+constexpr int NRG_DAO_HEADER_SIZE = 22;
+
+#ifdef _MSC_VER
+    #pragma pack(push,1)
+#endif
+
+struct PACKED MdsHeader
+{
+    char signature[16];
+    uint8_t version[2];
+    uint16_t mediumType;
+    uint16_t sessionCount;
+    uint16_t unused1[2];
+    uint16_t bcaLength;
+    uint32_t unused2[2];
+    uint32_t bcaOffset;
+    uint32_t unused3[6];
+    uint32_t structuresOffset;
+    uint32_t unused4[3];
+    uint32_t sessionsOffset;
+    uint32_t dpmOffset;
+};
+
+static_assert(sizeof(MdsHeader) == 88, "Struct MDS Header should be exactly 88 bytes!");
+
+struct PACKED MdsSession
+{
+    int32_t sessionStart;
+    int32_t sessionEnd;
+    uint16_t sessionNumber;
+    uint8_t blockCount;
+    uint8_t nonTrackBlockCount;
+    uint16_t firstTrack;
+    uint16_t lastTrack;
+    uint32_t unused;
+    uint32_t tracksOffset;
+};
+
+static_assert(sizeof(MdsSession) == 24, "Struct MDS Session should be exactly 24 bytes!");
+
+struct PACKED MdsTrack
+{
+    uint8_t mode;
+    uint8_t subchannel;
+    uint8_t adrControl;
+    uint8_t trackNumber;
+    uint8_t point;
+    uint8_t msf[3];
+    uint8_t zero;
+    uint8_t pointMsf[3];
+    uint32_t extraOffset;
+    uint16_t sectorSize;
+    uint8_t unused1[18];
+    uint32_t startSector;
+    uint64_t startOffset;
+    uint32_t fileCount;
+    uint32_t footerOffset;
+    uint8_t unused2[24];
+};
+
+static_assert(sizeof(MdsTrack) == 80, "Struct MDS Track should be exactly 80 bytes!");
+
+struct PACKED MdsExtra
+{
+    uint32_t pregap;
+    uint32_t length;
+};
+
+static_assert(sizeof(MdsExtra) == 8, "Struct MDS Extra should be exactly 8 bytes!");
+
+struct PACKED MdsFooter
+{
+    uint32_t fileNameOffset;
+    uint32_t wideChar;
+    uint32_t unused[2];
+};
+
+static_assert(sizeof(MdsFooter) == 16, "Struct MDS Footer should be exactly 16 bytes!");
+
+struct PACKED NrgChunkHeader
+{
+    char id[4];
+    uint32_t size;
+};
+
+static_assert(sizeof(NrgChunkHeader) == 8, "Struct NRG Chunk Header should be exactly 8 bytes!");
+
+#ifdef _MSC_VER
+    #pragma pack(pop)
+#endif
+
+static bool fitsIn(const QByteArray& data, qint64 offset, qint64 size)
+{
+    return (offset >= 0) && (size >= 0) && (offset + size <= data.size());
+}
+
+static uint32_t readBigEndian32(const char* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return BIG_ENDIAN_DWORD(value);
+}
+
+static uint64_t readBigEndian64(const char* data)
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return BIG_ENDIAN_QWORD(value);
+}
+
+static bool nrgModeType(uint8_t mode, bool& isAudio, int& sectorSize)
+{
+    // Only the Mode 1 and audio layouts, Mode 2 tracks are not exported
+    switch(mode)
+    {
+    case 0x00: isAudio = false; sectorSize = CDROM_DATA_SIZE; return true;
+    case 0x05: isAudio = false; sectorSize = CDROM_SECTOR_SIZE; return true;
+    case 0x07: isAudio = true; sectorSize = CDROM_SECTOR_SIZE; return true;
+    case 0x10: isAudio = true; sectorSize = CDROM_SECTOR_SIZE + SUBCHANNEL_SIZE; return true;
+    case 0x11: isAudio = false; sectorSize = CDROM_SECTOR_SIZE + SUBCHANNEL_SIZE; return true;
+    default: return false;
+    }
+}
+
+bool ImageReader::loadCloneCd(const QString &fileName, CdromToc &toc)
+{
+    static const QRegularExpression SECTION_REGEX("^\\s*\\[(.+)\\]\\s*$");
+    static const QRegularExpression VALUE_REGEX("^\\s*([^=]+?)\\s*=\\s*(.*?)\\s*$");
+    static const QRegularExpression TRACK_REGEX("^TRACK\\s+([0-9]+)$");
+
+    QByteArray data;
+    if (!readFile(fileName, data))
+        return false;
+
+    // Sections and keys are matched in upper case
+    QHash<QString, QHash<QString, QString>> sections;
+    QString section;
+
+    QTextStream in(&data, QIODevice::ReadOnly);
+
+    while(!in.atEnd())
+    {
+        QString line = in.readLine();
+
+        QRegularExpressionMatch match = SECTION_REGEX.match(line);
+        if (match.hasMatch())
+        {
+            section = match.captured(1).simplified().toUpper();
+            continue;
+        }
+
+        match = VALUE_REGEX.match(line);
+        if (match.hasMatch() && !section.isEmpty())
+            sections[section].insert(match.captured(1).simplified().toUpper(), match.captured(2));
+    }
+
+    if (sections.value(QStringLiteral("DISC")).value(QStringLiteral("SESSIONS"), QStringLiteral("1")).toInt() != 1)
+    {
+        qCritical().noquote() << "Image " << QFileInfo(fileName).fileName() << ": Multi-session images are not supported.";
+        return false;
+    }
+
+    // The sectors are in the .img file next to the descriptor, from LBA 0 on
+    QFileInfo info(fileName);
+    QString imageName = info.dir().filePath(info.completeBaseName() + QStringLiteral(".img"));
+    if (!QFileInfo::exists(imageName))
+        imageName = info.dir().filePath(info.completeBaseName() + QStringLiteral(".IMG"));
+
+    int leadOut = -1;
+    QMap<int, QHash<QString, QString>> trackSections;
+
+    for(auto i = sections.cbegin(); i != sections.cend(); ++i)
+    {
+        QRegularExpressionMatch match = TRACK_REGEX.match(i.key());
+        if (match.hasMatch())
+        {
+            trackSections.insert(match.captured(1).toInt(), i.value());
+            continue;
+        }
+
+        // Base 0 takes the hexadecimal points as well as decimal ones
+        if (i.key().startsWith(QStringLiteral("ENTRY ")) && (i.value().value(QStringLiteral("POINT")).toInt(Q_NULLPTR, 0) == LEAD_OUT_POINT))
+            leadOut = i.value().value(QStringLiteral("PLBA")).toInt();
+    }
+
+    if (leadOut < 0)
+        leadOut = static_cast<int>(QFileInfo(imageName).size() / CDROM_SECTOR_SIZE);
+
+    QVector<Track> tracks;
+
+    for(auto i = trackSections.cbegin(); i != trackSections.cend(); ++i)
+    {
+        bool hasIndexOne;
+        int mode = i.value().value(QStringLiteral("MODE")).toInt();
+        int index1 = i.value().value(QStringLiteral("INDEX 1")).toInt(&hasIndexOne);
+        int start = i.value().value(QStringLiteral("INDEX 0"), QString::number(index1)).toInt();
+
+        // A track ends where the next one starts, its pregap included
+        int end = leadOut;
+        auto next = std::next(i);
+        if (next != trackSections.cend())
+            end = next.value().value(QStringLiteral("INDEX 0"), next.value().value(QStringLiteral("INDEX 1"))).toInt();
+
+        if (!hasIndexOne || (start < 0) || (start > index1) || (index1 >= end))
+        {
+            qCritical().noquote() << "Invalid CloneCD image: Track " << i.key() << " indexes are missing or out of order.";
+            return false;
+        }
+
+        if ((mode != 0) && (mode != 1))
+        {
+            qCritical().noquote() << "Track " << i.key() << ": Mode " << mode << " is not supported.";
+            return false;
+        }
+
+        Track track;
+        track.number = static_cast<uint8_t>(i.key());
+        track.fileName = imageName;
+        track.fileOffset = static_cast<qint64>(start) * CDROM_SECTOR_SIZE;
+        track.pregapLength = static_cast<uint32_t>(index1 - start);
+        track.pregapStored = true;
+        track.length = static_cast<uint32_t>(end - index1);
+        setTrackType(track, mode == 0, CDROM_SECTOR_SIZE);
+
+        tracks.append(track);
+    }
+
+    return buildToc(fileName, tracks, toc);
+}
+
+bool ImageReader::loadMds(const QString &fileName, CdromToc &toc)
+{
+    QByteArray data;
+    if (!readFile(fileName, data))
+        return false;
+
+    MdsHeader header;
+    if (!fitsIn(data, 0, sizeof(header)) || std::memcmp(data.constData(), "MEDIA DESCRIPTOR", sizeof(header.signature)))
+    {
+        qCritical().noquote() << "File " << QFileInfo(fileName).fileName() << " is not a valid MDS file.";
+        return false;
+    }
+
+    std::memcpy(&header, data.constData(), sizeof(header));
+
+    if (LITTLE_ENDIAN_WORD(header.sessionCount) != 1)
+    {
+        qCritical().noquote() << "Image " << QFileInfo(fileName).fileName() << ": Multi-session images are not supported.";
+        return false;
+    }
+
+    MdsSession session;
+    qint64 sessionOffset = LITTLE_ENDIAN_DWORD(header.sessionsOffset);
+    if (!fitsIn(data, sessionOffset, sizeof(session)))
+    {
+        qCritical().noquote() << "Invalid MDS file: Session block is past the end of the file.";
+        return false;
+    }
+
+    std::memcpy(&session, data.constData() + sessionOffset, sizeof(session));
+
+    QVector<Track> tracks;
+    QVector<uint32_t> startSectors;
+    QVector<bool> hasLength;
+
+    for(int i = 0; i < session.blockCount; ++i)
+    {
+        MdsTrack block;
+        qint64 blockOffset = LITTLE_ENDIAN_DWORD(session.tracksOffset) + i * static_cast<qint64>(sizeof(block));
+        if (!fitsIn(data, blockOffset, sizeof(block)))
+        {
+            qCritical().noquote() << "Invalid MDS file: Track block is past the end of the file.";
+            return false;
+        }
+
+        std::memcpy(&block, data.constData() + blockOffset, sizeof(block));
+
+        // Blocks of the lead-in points come along the tracks
+        if ((block.point < 1) || (block.point > 99))
+            continue;
+
+        int mode = block.mode & 0x0f;
+        if ((mode != MDS_MODE_AUDIO) && (mode != MDS_MODE_MODE1))
+        {
+            qCritical().noquote() << "Track " << static_cast<int>(block.point) << ": Mode " << QString::number(block.mode, 16) << " is not supported.";
+            return false;
+        }
+
+        Track track;
+        track.number = block.point;
+
+        int sectorSize = LITTLE_ENDIAN_WORD(block.sectorSize);
+        if (!setTrackType(track, mode == MDS_MODE_AUDIO, sectorSize) || ((track.subchannelSize != 0) != (block.subchannel == MDS_SUBCHANNEL_INTERLEAVED)))
+        {
+            qCritical().noquote() << "Track " << static_cast<int>(block.point) << ": Sector size " << sectorSize << " is not supported.";
+            return false;
+        }
+
+        // The first pregap is before LBA 0, it is never stored
+        MdsExtra extra = { 0, 0 };
+        qint64 extraOffset = LITTLE_ENDIAN_DWORD(block.extraOffset);
+        if (extraOffset && fitsIn(data, extraOffset, sizeof(extra)))
+            std::memcpy(&extra, data.constData() + extraOffset, sizeof(extra));
+
+        track.pregapLength = tracks.isEmpty() ? 0 : LITTLE_ENDIAN_DWORD(extra.pregap);
+        track.pregapStored = true;
+        track.length = LITTLE_ENDIAN_DWORD(extra.length);
+        track.fileOffset = static_cast<qint64>(LITTLE_ENDIAN_QWORD(block.startOffset));
+
+        // "*.mdf" stands for the name of the descriptor with another suffix
+        QFileInfo info(fileName);
+        QString dataName = info.completeBaseName() + QStringLiteral(".mdf");
+        MdsFooter footer;
+        qint64 footerOffset = LITTLE_ENDIAN_DWORD(block.footerOffset);
+
+        if (footerOffset && fitsIn(data, footerOffset, sizeof(footer)))
+        {
+            std::memcpy(&footer, data.constData() + footerOffset, sizeof(footer));
+            qint64 nameOffset = LITTLE_ENDIAN_DWORD(footer.fileNameOffset);
+
+            if (fitsIn(data, nameOffset, 1))
+            {
+                QString name;
+
+                if (footer.wideChar)
+                {
+                    for(qint64 j = nameOffset; fitsIn(data, j, 2) && (data.at(static_cast<int>(j)) || data.at(static_cast<int>(j + 1))); j += 2)
+                        name.append(QChar(static_cast<uint8_t>(data.at(static_cast<int>(j))) | (static_cast<uint8_t>(data.at(static_cast<int>(j + 1))) << 8)));
+                }
+                else
+                    name = QString::fromLocal8Bit(data.constData() + nameOffset);
+
+                dataName = name.startsWith(QChar('*')) ? (info.completeBaseName() + name.mid(1)) : name;
+            }
+        }
+
+        track.fileName = info.dir().filePath(dataName);
+
+        tracks.append(track);
+        startSectors.append(LITTLE_ENDIAN_DWORD(block.startSector));
+        hasLength.append(extra.length != 0);
+    }
+
+    // Without an extra block, a track goes on until the pregap of the next one or the end of the session
+    for(int i = 0; i < tracks.size(); ++i)
+    {
+        if (hasLength.at(i))
+            continue;
+
+        int64_t end = (i + 1 < tracks.size()) ? static_cast<int64_t>(startSectors.at(i + 1)) - tracks.at(i + 1).pregapLength : LITTLE_ENDIAN_DWORD(static_cast<uint32_t>(session.sessionEnd));
+        if (end <= startSectors.at(i))
+        {
+            qCritical().noquote() << "Invalid MDS file: Track " << static_cast<int>(tracks.at(i).number) << " has no sectors.";
+            return false;
+        }
+
+        tracks[i].length = static_cast<uint32_t>(end - startSectors.at(i));
+    }
+
+    return buildToc(fileName, tracks, toc);
+}
+
+bool ImageReader::loadNrg(const QString &fileName, CdromToc &toc)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open image file: " << file.errorString();
+        return false;
+    }
+
+    // The chunks describing the image follow its data, the footer points to them
+    qint64 fileSize = file.size();
+    qint64 chunksOffset = -1;
+    qint64 footerSize = 0;
+    char footer[NRG_FOOTER_SIZE];
+
+    if ((fileSize >= NRG_FOOTER_SIZE) && file.seek(fileSize - NRG_FOOTER_SIZE) && (file.read(footer, NRG_FOOTER_SIZE) == NRG_FOOTER_SIZE))
+    {
+        if (!std::memcmp(footer, "NER5", 4))
+        {
+            chunksOffset = static_cast<qint64>(readBigEndian64(footer + 4));
+            footerSize = NRG_FOOTER_SIZE;
+        }
+        else if (!std::memcmp(footer + 4, "NERO", 4))
+        {
+            chunksOffset = readBigEndian32(footer + 8);
+            footerSize = NRG_OLD_FOOTER_SIZE;
+        }
+    }
+
+    if ((chunksOffset < 0) || (chunksOffset > fileSize - footerSize) || !file.seek(chunksOffset))
+    {
+        qCritical().noquote() << "File " << QFileInfo(fileName).fileName() << " is not a valid Nero image.";
+        return false;
+    }
+
+    QByteArray chunks = file.read(fileSize - footerSize - chunksOffset);
+
+    QVector<Track> tracks;
+    int sessions = 0;
+    int trackLists = 0;
+    qint64 position = 0;
+
+    while(fitsIn(chunks, position, sizeof(NrgChunkHeader)))
+    {
+        NrgChunkHeader header;
+        std::memcpy(&header, chunks.constData() + position, sizeof(header));
+
+        QByteArray id(header.id, sizeof(header.id));
+        qint64 size = BIG_ENDIAN_DWORD(header.size);
+        const char* chunk = chunks.constData() + position + sizeof(header);
+
+        if (id == "END!")
+            break;
+
+        if (!fitsIn(chunks, position + sizeof(header), size))
+        {
+            qCritical().noquote() << "Invalid Nero image: Chunk " << id << " is past the end of the file.";
+            return false;
+        }
+
+        if (id == "SINF")
+            ++sessions;
+        else if ((id == "DAOX") || (id == "DAOI"))
+        {
+            // Disc at once: the pregap, index 1 and end offsets of every track, 64 bits wide in DAOX
+            bool wide = (id == "DAOX");
+            int blockSize = wide ? 42 : 30;
+            int offsetSize = wide ? 8 : 4;
+
+            ++trackLists;
+
+            if (size < NRG_DAO_HEADER_SIZE)
+            {
+                qCritical().noquote() << "Invalid Nero image: DAO chunk is too short.";
+                return false;
+            }
+
+            uint8_t firstTrack = static_cast<uint8_t>(chunk[20]);
+            uint8_t lastTrack = static_cast<uint8_t>(chunk[21]);
+
+            for(int i = 0; firstTrack + i <= lastTrack; ++i)
+            {
+                qint64 blockOffset = NRG_DAO_HEADER_SIZE + i * blockSize;
+                if (blockOffset + blockSize > size)
+                {
+                    qCritical().noquote() << "Invalid Nero image: DAO chunk is too short.";
+                    return false;
+                }
+
+                const char* block = chunk + blockOffset;
+                auto readOffset = [&](int index) -> qint64
+                {
+                    const char* value = block + 18 + index * offsetSize;
+                    return wide ? static_cast<qint64>(readBigEndian64(value)) : readBigEndian32(value);
+                };
+
+                int sectorSize = (static_cast<uint8_t>(block[12]) << 8) | static_cast<uint8_t>(block[13]);
+                uint8_t mode = static_cast<uint8_t>(block[14]);
+                qint64 pregapOffset = readOffset(0);
+                qint64 startOffset = readOffset(1);
+                qint64 endOffset = readOffset(2);
+
+                Track track;
+                track.number = static_cast<uint8_t>(firstTrack + i);
+
+                bool isAudio;
+                int modeSectorSize;
+                if (!nrgModeType(mode, isAudio, modeSectorSize) || !setTrackType(track, isAudio, sectorSize))
+                {
+                    qCritical().noquote() << "Track " << static_cast<int>(track.number) << ": Mode " << QString::number(mode, 16) << " with " << sectorSize << " byte sectors is not supported.";
+                    return false;
+                }
+
+                if ((pregapOffset > startOffset) || (startOffset > endOffset))
+                {
+                    qCritical().noquote() << "Invalid Nero image: Track " << static_cast<int>(track.number) << " offsets are out of order.";
+                    return false;
+                }
+
+                track.fileName = fileName;
+                track.fileOffset = pregapOffset;
+                track.pregapLength = static_cast<uint32_t>((startOffset - pregapOffset) / sectorSize);
+                track.pregapStored = true;
+                track.length = static_cast<uint32_t>((endOffset - startOffset) / sectorSize);
+
+                tracks.append(track);
+            }
+        }
+        else if ((id == "ETN2") || (id == "ETNF"))
+        {
+            // Track at once: the offset, size and mode of every track, numbered from 1
+            bool wide = (id == "ETN2");
+            int blockSize = wide ? 32 : 20;
+            int offsetSize = wide ? 8 : 4;
+
+            ++trackLists;
+
+            for(qint64 blockOffset = 0; blockOffset + blockSize <= size; blockOffset += blockSize)
+            {
+                const char* block = chunk + blockOffset;
+                qint64 offset = wide ? static_cast<qint64>(readBigEndian64(block)) : readBigEndian32(block);
+                qint64 length = wide ? static_cast<qint64>(readBigEndian64(block + offsetSize)) : readBigEndian32(block + offsetSize);
+                uint32_t mode = readBigEndian32(block + 2 * offsetSize);
+
+                Track track;
+                track.number = static_cast<uint8_t>(tracks.size() + 1);
+
+                bool isAudio;
+                int sectorSize;
+                if ((mode > 0xff) || !nrgModeType(static_cast<uint8_t>(mode), isAudio, sectorSize) || !setTrackType(track, isAudio, sectorSize))
+                {
+                    qCritical().noquote() << "Track " << static_cast<int>(track.number) << ": Mode " << QString::number(mode, 16) << " is not supported.";
+                    return false;
+                }
+
+                track.fileName = fileName;
+                track.fileOffset = offset;
+                track.pregapLength = 0;
+                track.pregapStored = false;
+                track.length = static_cast<uint32_t>(length / sectorSize);
+
+                tracks.append(track);
+            }
+        }
+
+        position += sizeof(header) + size;
+    }
+
+    if ((sessions > 1) || (trackLists > 1))
+    {
+        qCritical().noquote() << "Image " << QFileInfo(fileName).fileName() << ": Multi-session images are not supported.";
+        return false;
+    }
+
+    return buildToc(fileName, tracks, toc);
+}
+
+bool ImageReader::setTrackType(Track &track, bool isAudio, int sectorSize)
+{
+    track.subchannelSize = (sectorSize == CDROM_SECTOR_SIZE + SUBCHANNEL_SIZE) ? SUBCHANNEL_SIZE : 0;
+
+    switch(sectorSize)
+    {
+    case CDROM_DATA_SIZE:
+        track.trackType = CdromToc::TrackType::Mode1_2048;
+        return !isAudio;
+
+    case CDROM_SECTOR_SIZE:
+    case CDROM_SECTOR_SIZE + SUBCHANNEL_SIZE:
+        track.trackType = isAudio ? CdromToc::TrackType::AudioPCM : CdromToc::TrackType::Mode1_2352;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool ImageReader::buildToc(const QString &fileName, const QVector<Track> &tracks, CdromToc &toc)
+{
+    toc.clear();
+
+    if (tracks.isEmpty())
+    {
+        qCritical().noquote() << "Image " << QFileInfo(fileName).fileName() << " has no track.";
+        return false;
+    }
+
+    QVector<Track> sortedTracks = tracks;
+    std::sort(sortedTracks.begin(), sortedTracks.end(), [](const Track& left, const Track& right) -> bool
+    {
+        return left.number < right.number;
+    });
+
+    for(int i = 0; i < sortedTracks.size(); ++i)
+    {
+        const Track& track = sortedTracks.at(i);
+
+        if ((track.number < 1) || (track.number > 99) || ((i > 0) && (track.number - sortedTracks.at(i - 1).number != 1)))
+        {
+            qCritical().noquote() << "Invalid image: Track numbers should be contiguous and increasing, between 1 and 99.";
+            return false;
+        }
+
+        auto file = std::find_if(toc.m_fileList.cbegin(), toc.m_fileList.cend(), [&](const CdromToc::FileEntry& entry)
+        {
+            return entry.fileName == track.fileName;
+        });
+
+        int fileIndex;
+
+        if (file == toc.m_fileList.cend())
+        {
+            QFile dataFile(track.fileName);
+            if (!dataFile.open(QIODevice::ReadOnly))
+            {
+                qCritical().noquote() << "File " << QFileInfo(track.fileName).fileName() << " could not be opened: " << dataFile.errorString();
+                return false;
+            }
+
+            toc.m_fileList.push_back({ track.fileName, dataFile.size(), CdromToc::FileSource::Plain, 0, dataFile.size(), 0 });
+            fileIndex = toc.m_fileList.size() - 1;
+        }
+        else
+            fileIndex = static_cast<int>(std::distance(toc.m_fileList.cbegin(), file));
+
+        // Every sector read by the export must be in the file
+        qint64 stride = ((track.trackType == CdromToc::TrackType::Mode1_2048) ? CDROM_DATA_SIZE : CDROM_SECTOR_SIZE) + track.subchannelSize;
+        qint64 storedSectors = static_cast<qint64>(track.length) + (track.pregapStored ? track.pregapLength : 0);
+
+        if ((track.length == 0) || (track.fileOffset < 0) || (track.fileOffset + storedSectors * stride > toc.m_fileList.at(fileIndex).fileSize))
+        {
+            qCritical().noquote() << "Image " << QFileInfo(fileName).fileName() << ": Track " << static_cast<int>(track.number) << " is empty or past the end of its data file.";
+            return false;
+        }
+
+        uint32_t position = static_cast<uint32_t>(track.fileOffset / stride);
+        qint64 indexOffset = track.fileOffset;
+
+        if (track.pregapLength && track.pregapStored)
+        {
+            toc.m_toc.push_back({ fileIndex, { track.number, 0 }, track.trackType, position, 0, track.fileOffset, track.pregapLength, track.subchannelSize });
+
+            position += track.pregapLength;
+            indexOffset += track.pregapLength * stride;
+        }
+        else if (track.pregapLength)
+            toc.m_toc.push_back({ -1, { track.number, 0 }, CdromToc::TrackType::Silence, 0, 0, 0, track.pregapLength, 0 });
+
+        toc.m_toc.push_back({ fileIndex, { track.number, 1 }, track.trackType, position, 0, indexOffset, track.length, track.subchannelSize });
+    }
+
+    toc.updatePositions();
+
+    return true;
+}
+
+bool ImageReader::readFile(const QString &fileName, QByteArray &data)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open image file: " << file.errorString();
+        return false;
+    }
+
+    data = file.readAll();
+
+    return true;
+}
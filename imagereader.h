@@ -0,0 +1,53 @@
+#ifndef IMAGEREADER_H
+#define IMAGEREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+#include "cdromtoc.h"
+
+// Builds the TOC of CloneCD (CCD/IMG), Alcohol (MDS/MDF) and Nero (NRG) images, so they are exported in place
+// like a BIN/CUE image. Sectors may be followed by 96 bytes of subchannel in the file, which the export skips.
+// Only single session images with Mode 1 and audio tracks are read, as with CUE sheets.
+
+class ImageReader
+{
+public:
+    static bool loadCloneCd(const QString& fileName, CdromToc& toc);
+    static bool loadMds(const QString& fileName, CdromToc& toc);
+    static bool loadNrg(const QString& fileName, CdromToc& toc);
+
+protected:
+    struct Track
+    {
+        /// Track number
+        uint8_t number;
+
+        /// Track type, from the mode and sector size
+        CdromToc::TrackType trackType;
+
+        /// Subchannel bytes after each sector in the file (0 or 96)
+        uint32_t subchannelSize;
+
+        /// File holding the track data
+        QString fileName;
+
+        /// Offset of the first sector of the track in the file, pregap included when it is stored (in bytes)
+        qint64 fileOffset;
+
+        /// Pregap length (in sectors), and if it is stored in the file before index 1
+        uint32_t pregapLength;
+        bool pregapStored;
+
+        /// Length from index 1 (in sectors)
+        uint32_t length;
+    };
+
+    static bool setTrackType(Track& track, bool isAudio, int sectorSize);
+    static bool buildToc(const QString& fileName, const QVector<Track>& tracks, CdromToc& toc);
+    static bool readFile(const QString& fileName, QByteArray& data);
+};
+
+#endif // IMAGEREADER_H
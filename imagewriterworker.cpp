@@ -1,56 +1,78 @@
+#include "chunkstore.h"
+#include "endian.h"
 #include "imagewriterworker.h"
+#include "offsetdetector.h"
+#include "sectorcoder.h"
+#include "streaminput.h"
 #include "wavfile.h"
 #include "wavstruct.h"
 
-#include <QCoreApplication>
+#include <QDir>
 #include <QFile>
+#include <QJsonDocument>
 #include <QTextStream>
 #include <QtDebug>
-#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+#endif
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
 
 constexpr int CDROM_SECTOR_SIZE = 2352;
 constexpr int CDROM_DATA_SIZE = 2048;
 constexpr int CDROM_HEADER_SIZE = 16;
+constexpr int SECTORS_PER_BATCH = 400;
+constexpr int WAVE_HEADER_SIZE = sizeof(WaveRiffHeader) + sizeof(WaveChunkHeader) + sizeof(WaveFmtChunk) + sizeof(WaveChunkHeader);
+
+// ds64 chunk inserted after the RIFF header of RF64 files, it holds the 64-bit sizes
+constexpr int WAVE_DS64_SIZE = sizeof(WaveChunkHeader) + sizeof(WaveDs64Chunk);
+
+// Largest audio data written as a plain RIFF file, the rest of the 32-bit RIFF size is left for the headers and the tag
+constexpr qint64 RIFF_MAX_DATA_SIZE = 0xffffffffLL - 64 * 1024;
+constexpr int AUDIO_SAMPLE_SIZE = 4;
+constexpr int MAX_SAMPLE_OFFSET = 10 * 588;
 
-static const std::array<uint32_t, 256> EDCTABLE{
-    0x00000000, 0x90910101, 0x91210201, 0x01b00300, 0x92410401, 0x02d00500, 0x03600600, 0x93f10701,
-    0x94810801, 0x04100900, 0x05a00a00, 0x95310b01, 0x06c00c00, 0x96510d01, 0x97e10e01, 0x07700f00,
-    0x99011001, 0x09901100, 0x08201200, 0x98b11301, 0x0b401400, 0x9bd11501, 0x9a611601, 0x0af01700,
-    0x0d801800, 0x9d111901, 0x9ca11a01, 0x0c301b00, 0x9fc11c01, 0x0f501d00, 0x0ee01e00, 0x9e711f01,
-    0x82012001, 0x12902100, 0x13202200, 0x83b12301, 0x10402400, 0x80d12501, 0x81612601, 0x11f02700,
-    0x16802800, 0x86112901, 0x87a12a01, 0x17302b00, 0x84c12c01, 0x14502d00, 0x15e02e00, 0x85712f01,
-    0x1b003000, 0x8b913101, 0x8a213201, 0x1ab03300, 0x89413401, 0x19d03500, 0x18603600, 0x88f13701,
-    0x8f813801, 0x1f103900, 0x1ea03a00, 0x8e313b01, 0x1dc03c00, 0x8d513d01, 0x8ce13e01, 0x1c703f00,
-    0xb4014001, 0x24904100, 0x25204200, 0xb5b14301, 0x26404400, 0xb6d14501, 0xb7614601, 0x27f04700,
-    0x20804800, 0xb0114901, 0xb1a14a01, 0x21304b00, 0xb2c14c01, 0x22504d00, 0x23e04e00, 0xb3714f01,
-    0x2d005000, 0xbd915101, 0xbc215201, 0x2cb05300, 0xbf415401, 0x2fd05500, 0x2e605600, 0xbef15701,
-    0xb9815801, 0x29105900, 0x28a05a00, 0xb8315b01, 0x2bc05c00, 0xbb515d01, 0xbae15e01, 0x2a705f00,
-    0x36006000, 0xa6916101, 0xa7216201, 0x37b06300, 0xa4416401, 0x34d06500, 0x35606600, 0xa5f16701,
-    0xa2816801, 0x32106900, 0x33a06a00, 0xa3316b01, 0x30c06c00, 0xa0516d01, 0xa1e16e01, 0x31706f00,
-    0xaf017001, 0x3f907100, 0x3e207200, 0xaeb17301, 0x3d407400, 0xadd17501, 0xac617601, 0x3cf07700,
-    0x3b807800, 0xab117901, 0xaaa17a01, 0x3a307b00, 0xa9c17c01, 0x39507d00, 0x38e07e00, 0xa8717f01,
-    0xd8018001, 0x48908100, 0x49208200, 0xd9b18301, 0x4a408400, 0xdad18501, 0xdb618601, 0x4bf08700,
-    0x4c808800, 0xdc118901, 0xdda18a01, 0x4d308b00, 0xdec18c01, 0x4e508d00, 0x4fe08e00, 0xdf718f01,
-    0x41009000, 0xd1919101, 0xd0219201, 0x40b09300, 0xd3419401, 0x43d09500, 0x42609600, 0xd2f19701,
-    0xd5819801, 0x45109900, 0x44a09a00, 0xd4319b01, 0x47c09c00, 0xd7519d01, 0xd6e19e01, 0x46709f00,
-    0x5a00a000, 0xca91a101, 0xcb21a201, 0x5bb0a300, 0xc841a401, 0x58d0a500, 0x5960a600, 0xc9f1a701,
-    0xce81a801, 0x5e10a900, 0x5fa0aa00, 0xcf31ab01, 0x5cc0ac00, 0xcc51ad01, 0xcde1ae01, 0x5d70af00,
-    0xc301b001, 0x5390b100, 0x5220b200, 0xc2b1b301, 0x5140b400, 0xc1d1b501, 0xc061b601, 0x50f0b700,
-    0x5780b800, 0xc711b901, 0xc6a1ba01, 0x5630bb00, 0xc5c1bc01, 0x5550bd00, 0x54e0be00, 0xc471bf01,
-    0x6c00c000, 0xfc91c101, 0xfd21c201, 0x6db0c300, 0xfe41c401, 0x6ed0c500, 0x6f60c600, 0xfff1c701,
-    0xf881c801, 0x6810c900, 0x69a0ca00, 0xf931cb01, 0x6ac0cc00, 0xfa51cd01, 0xfbe1ce01, 0x6b70cf00,
-    0xf501d001, 0x6590d100, 0x6420d200, 0xf4b1d301, 0x6740d400, 0xf7d1d501, 0xf661d601, 0x66f0d700,
-    0x6180d800, 0xf111d901, 0xf0a1da01, 0x6030db00, 0xf3c1dc01, 0x6350dd00, 0x62e0de00, 0xf271df01,
-    0xee01e001, 0x7e90e100, 0x7f20e200, 0xefb1e301, 0x7c40e400, 0xecd1e501, 0xed61e601, 0x7df0e700,
-    0x7a80e800, 0xea11e901, 0xeba1ea01, 0x7b30eb00, 0xe8c1ec01, 0x7850ed00, 0x79e0ee00, 0xe971ef01,
-    0x7700f000, 0xe791f101, 0xe621f201, 0x76b0f300, 0xe541f401, 0x75d0f500, 0x7460f600, 0xe4f1f701,
-    0xe381f801, 0x7310f900, 0x72a0fa00, 0xe231fb01, 0x71c0fc00, 0xe151fd01, 0xe0e1fe01, 0x7070ff00
-};
+// Samples of a compressed or piped track held back until its byte order is settled, about six minutes
+constexpr int MAX_HELD_AUDIO = 64 * 1024 * 1024;
+
+// Magic of the RIFF chunk holding an ID3v2 tag in WAV files
+constexpr uint32_t WAVE_ID3_MAGIC = 0x20336469;
+
+// Magics of the RF64 header and of its ds64 chunk, and the 32-bit size of chunks sized in the ds64 chunk
+constexpr uint32_t WAVE_RF64_MAGIC = 0x34364652;
+constexpr uint32_t WAVE_DS64_MAGIC = 0x34367364;
+constexpr uint32_t WAVE_LARGE_SIZE = 0xffffffff;
 
 ImageWriterWorker::ImageWriterWorker(QObject *parent) :
     QObject(parent),
     m_cancelFlag(false),
-    m_uncorrectedErrorsFlag(false)
+    m_uncorrectedErrorsFlag(false),
+    m_succeeded(false),
+    m_progressShift(0),
+    m_statistics(),
+    m_options(),
+    m_bufferPool(),
+    m_prefetcher(),
+    m_tarStream(),
+    m_ioUring(),
+    m_audioStream(),
+    m_byteOrder(),
+    m_trackSwapped(),
+    m_heldAudio(),
+    m_audioShift(0),
+    m_audioSkip(0),
+    m_audioCarry(),
+    m_audioAnalyzer(),
+    m_audioChecksums(),
+    m_accurateRip(),
+    m_audioReport(),
+    m_outputFiles()
 { }
 
 ImageWriterWorker::~ImageWriterWorker()
@@ -58,48 +80,111 @@ ImageWriterWorker::~ImageWriterWorker()
 
 void ImageWriterWorker::start(const QString &baseDirectory, const QString &baseName, CdromToc *toc)
 {
-    emit progressRangeChanged(0, static_cast<int>(toc->totalSectors()));
+    m_succeeded = false;
+
+    // Progress signals are int, very large images are reported in units of several sectors
+    m_progressShift = progressShift(toc->totalSectors());
+
+    emit progressRangeChanged(0, static_cast<int>(static_cast<qint64>(toc->totalSectors()) >> m_progressShift));
     emit progressValueChanged(0);
     emit progressTextChanged(QString());
     emit started();
 
-    QCoreApplication::processEvents();
+    m_outputFiles.clear();
+
+    if (!m_options.tarOutput.isEmpty())
+    {
+        if (!m_tarStream.open(m_options.tarOutput))
+        {
+            qCritical().noquote() << "Could not open output archive: " << m_options.tarOutput << endl << m_tarStream.errorString() << endl;
+            emit finished();
+            return;
+        }
+
+        // Tags are only sized once the track is measured, too late for its header in the archive
+        if (m_options.replayGainTags)
+            qWarning().noquote() << "WAV files streamed to an archive are not tagged with their ReplayGain.";
+    }
 
     if (!writeCueSheet(baseDirectory, baseName, toc))
     {
+        m_tarStream.close();
         emit finished();
         return;
     }
 
+    m_outputFiles.append(QStringLiteral("%1.cue").arg(baseName));
+
+    m_statistics.clear();
+    m_statistics.setSparseOutput(m_options.sparseOutput);
+    m_audioReport = QJsonArray();
+    m_heldAudio.clear();
+    m_trackSwapped.clear();
+
+    initializeSampleOffset(toc);
+
+    if (m_options.computeChecksums)
+    {
+        m_audioChecksums.beginDisc(m_audioStream.size() / AUDIO_SAMPLE_SIZE);
+
+        // Checksummed tracks start at their index 1, not at the start of their file
+        for(int track = toc->firstTrack(); track <= toc->lastTrack(); ++track)
+        {
+            qint64 position;
+            qint64 size;
+
+            if (m_audioStream.trackRange(static_cast<uint8_t>(track), position, size))
+                m_audioChecksums.addTrack(static_cast<uint8_t>(track), position / AUDIO_SAMPLE_SIZE, size / AUDIO_SAMPLE_SIZE,
+                                          track == toc->firstTrack(), track == toc->lastTrack());
+        }
+
+        // Without a database the checksums are only reported
+        m_accurateRip = AccurateRipDatabase();
+        if (!m_options.accurateRipDatabase.isEmpty())
+            m_accurateRip.load(m_options.accurateRipDatabase, toc);
+    }
+
+    int entriesDone = 0;
+
     uint8_t currentTrack = 0;
+    QString currentFileName;
     int currentFile = -1;
     CdromToc::TrackType currentType = CdromToc::TrackType::Silence;
+    uint32_t trackSectorsExpected = 0;
     uint32_t trackSectorsWritten = 0;
-    uint32_t sectorsProcessed = 0;
+    qint64 sectorsProcessed = 0;
     bool outFileIsWave = false;
-    QFile in;
-    QFile out;
+    InputFile waveInput;
+    StreamInput streamIn;
+    InputFile input;
+    OutputFile out;
     WavFile inWave;
 
+    out.setOptions(m_options);
+    out.setTarStream(m_tarStream.isOpen() ? &m_tarStream : Q_NULLPTR);
+
+    m_prefetcher.setFiles(toc->fileList(), m_options.prefetchFiles, m_options.prefetchBudget);
+
     for(const CdromToc::Entry& entry : toc->toc())
     {
-        if (m_cancelFlag)
+        if (m_cancelFlag.loadAcquire())
             break;
 
-        emit progressValueChanged(static_cast<int>(sectorsProcessed));
-        QCoreApplication::processEvents();
+        reportProgress(sectorsProcessed);
 
         if (entry.trackIndex.track() != currentTrack)
         {
             if (out.isOpen())
             {
-                if  (outFileIsWave)
-                    writeWaveHeader(out, trackSectorsWritten * CDROM_SECTOR_SIZE);
+                if (!flushHeldAudio(out))
+                    break;
 
-                out.close();
+                closeTrack(out, outFileIsWave, trackSectorsExpected, trackSectorsWritten, currentTrack, currentFileName);
+                m_statistics.endTrack();
             }
 
             m_uncorrectedErrorsFlag = false;
+            m_byteOrder.reset();
 
             currentTrack = entry.trackIndex.track();
 
@@ -127,18 +212,49 @@ void ImageWriterWorker::start(const QString &baseDirectory, const QString &baseN
 
             QString outFileName = buildTrackOutputFilename(entry.trackIndex, baseName, outSuffix);
             QString outFilePath = buildTrackOutputPath(baseDirectory, entry.trackIndex, baseName, outSuffix);
+            currentFileName = outFileName;
 
             emit progressTextChanged(tr("Writing: %1").arg(outFileName));
 
-            out.setFileName(outFilePath);
-            if (!out.open(QIODevice::WriteOnly))
+            m_statistics.beginTrack(currentTrack, outFileName);
+
+            // Every output size is known from the TOC, so the file can be preallocated and the WAV header written once
+            trackSectorsExpected = trackDataSectors(toc, currentTrack);
+
+            qint64 expectedSize;
+            if (outFileIsWave)
+                expectedSize = waveHeaderSize(isRf64Track(trackSectorsExpected)) + static_cast<qint64>(trackSectorsExpected) * CDROM_SECTOR_SIZE;
+            else
+                expectedSize = static_cast<qint64>(trackSectorsExpected) * CDROM_DATA_SIZE;
+
+            if (!out.open(outFilePath, expectedSize))
             {
                 qCritical().noquote() << "Could not create file: " << outFileName << endl << out.errorString() << endl;
                 break;
             }
 
+            m_statistics.add(ExportStatistics::Stage::Write, 0, 0, out.takeSyscalls(), out.takeAllocations());
+
+            m_outputFiles.append(outFileName);
+
+            // Buffers and ring are created with the first output, whose device decides the default queue depth
+            if (!m_bufferPool.isInitialized() && !initializeBuffers(out))
+                break;
+
             if (outFileIsWave)
-                writeWaveHeader(out, 0);
+                writeWaveHeader(out, isRf64Track(trackSectorsExpected), static_cast<qint64>(trackSectorsExpected) * CDROM_SECTOR_SIZE);
+
+            if (outFileIsWave && m_options.analyzeAudio)
+                m_audioAnalyzer.reset();
+
+            // Seekable tracks are measured before their first sample is written, the others hold their samples back
+            if ((currentType == CdromToc::TrackType::AudioPCM) && m_options.detectByteOrder && toc->hasSeekableFiles())
+            {
+                if (!detectByteOrder(currentTrack, m_byteOrder))
+                    break;
+
+                m_trackSwapped.insert(currentTrack, m_byteOrder.isSwapped());
+            }
 
             trackSectorsWritten = 0;
         }
@@ -147,25 +263,65 @@ void ImageWriterWorker::start(const QString &baseDirectory, const QString &baseN
         {
             currentFile = entry.fileIndex;
 
-            if (in.isOpen())
-                in.close();
+            // The mapping of the previous WAV file goes away with it
+            inWave.cleanup();
+
+            // Compressed files are only known to be intact once their trailer is checked
+            if (streamIn.isOpen() && !streamIn.finish())
+            {
+                qCritical().noquote() << "Read error on input file: " << streamIn.errorString();
+                break;
+            }
+
+            input.close();
+            waveInput.close();
+
+            const CdromToc::FileEntry& fileEntry = toc->fileList().at(currentFile);
+            bool opened;
+            QString openError;
+
+            // Compressed and piped files are decompressed on their own thread and read forward only,
+            // WAV files are mapped and decoded by WavFile, the other plain files are read from their descriptor
+            if (fileEntry.source != CdromToc::FileSource::Plain)
+            {
+                opened = streamIn.open(fileEntry) && input.open(&streamIn);
+                openError = input.errorString();
+            }
+            else if (currentType == CdromToc::TrackType::AudioWav)
+            {
+                opened = waveInput.open(fileEntry.fileName);
+                openError = waveInput.errorString();
+            }
+            else
+            {
+                opened = input.open(fileEntry.fileName);
+                openError = input.errorString();
+            }
 
-            in.setFileName(toc->fileList().at(currentFile).fileName);
-            if (!in.open(QIODevice::ReadOnly))
+            if (!opened)
             {
-                qCritical().noquote() << "Could not open input file: " << toc->fileList().at(currentFile).fileName << endl << in.errorString() << endl;
+                qCritical().noquote() << "Could not open input file: " << fileEntry.fileName << endl << openError << endl;
                 break;
             }
 
+            if (m_options.adviseInputs)
+                adviseSequentialRead(waveInput.isOpen() ? waveInput.handle() : input.handle());
+
+            // The next files are warmed while this one is exported
+            m_prefetcher.advance(currentFile);
+
             if (currentType == CdromToc::TrackType::AudioWav)
-                inWave.initialize(&in);
+            {
+                inWave.initialize(&waveInput);
+                inWave.setDither(m_options.ditherAudio);
+            }
         }
 
         if (entry.fileIndex != -1)
         {
             if (currentType == CdromToc::TrackType::AudioPCM)
             {
-                if (!writePcmAudio(in, out, entry, sectorsProcessed))
+                if (!writePcmAudio(input, out, entry, sectorsProcessed))
                     break;
             }
             else if (currentType == CdromToc::TrackType::AudioWav)
@@ -175,12 +331,12 @@ void ImageWriterWorker::start(const QString &baseDirectory, const QString &baseN
             }
             else if (currentType == CdromToc::TrackType::Mode1_2048)
             {
-                if (!writeIsoData(in, out, entry, sectorsProcessed))
+                if (!writeIsoData(input, out, entry, sectorsProcessed))
                     break;
             }
             else if (currentType == CdromToc::TrackType::Mode1_2352)
             {
-                if (!writeRawData(in, out, entry, sectorsProcessed))
+                if (!writeRawData(input, out, entry, sectorsProcessed))
                     break;
             }
 
@@ -188,34 +344,116 @@ void ImageWriterWorker::start(const QString &baseDirectory, const QString &baseN
         }
 
         sectorsProcessed += entry.trackLength;
+        ++entriesDone;
+    }
+
+    m_succeeded = (entriesDone == toc->toc().size()) && !m_cancelFlag.loadAcquire();
+
+    if (m_succeeded && streamIn.isOpen() && !streamIn.finish())
+    {
+        qCritical().noquote() << "Read error on input file: " << streamIn.errorString();
+        m_succeeded = false;
     }
 
     if (out.isOpen())
     {
-        if  (outFileIsWave)
-            writeWaveHeader(out, trackSectorsWritten * CDROM_SECTOR_SIZE);
+        if (!flushHeldAudio(out))
+            m_succeeded = false;
+
+        closeTrack(out, outFileIsWave, trackSectorsExpected, trackSectorsWritten, currentTrack, currentFileName);
+    }
+
+    m_statistics.endTrack();
+
+    inWave.cleanup();
+
+    input.close();
+    waveInput.close();
+
+    m_prefetcher.cancel();
+    m_ioUring.cleanup();
+    m_bufferPool.cleanup();
+
+    m_statistics.logSummary();
+
+    // The pregap of the next track is checksummed with a track, so its results are only known once the next track is written
+    if (m_options.computeChecksums)
+    {
+        for(int i = 0; i < m_audioReport.size(); ++i)
+        {
+            QJsonObject object = m_audioReport.at(i).toObject();
+            uint8_t track = static_cast<uint8_t>(object.value(QStringLiteral("track")).toInt());
+
+            if (!m_audioChecksums.hasTrackResult(track))
+                continue;
+
+            reportChecksums(object, track, object.value(QStringLiteral("file")).toString());
+            m_audioReport.replace(i, object);
+        }
+    }
+
+    if (m_options.computeChecksums && m_succeeded)
+        qInfo().noquote() << QStringLiteral("CTDB CRC: %1").arg(m_audioChecksums.ctdbCrc(), 8, 16, QChar('0'));
+
+    if (m_tarStream.isOpen())
+    {
+        // Reports close the archive, after the tracks
+        if (inspectsAudio() && !m_audioReport.isEmpty())
+            m_tarStream.addFile(QStringLiteral("%1.audio.json").arg(baseName), buildAudioReport());
+
+        // The statistics of an incomplete export would be misleading
+        if (m_options.statisticsReport && m_succeeded)
+            m_tarStream.addFile(QStringLiteral("%1.stats.json").arg(baseName), QJsonDocument(m_statistics.toJson()).toJson(QJsonDocument::Indented));
+
+        if (!m_tarStream.close())
+        {
+            qCritical().noquote() << "Write error on output archive: " << m_tarStream.errorString();
+            m_succeeded = false;
+        }
+    }
+    else
+    {
+        if (m_options.statisticsReport && m_succeeded)
+            m_statistics.writeReport(buildOutputPath(baseDirectory, baseName, QStringLiteral("stats.json")));
 
-        out.close();
+        if (inspectsAudio() && !m_audioReport.isEmpty() && writeAudioReport(buildOutputPath(baseDirectory, baseName, QStringLiteral("audio.json"))))
+            m_outputFiles.append(QStringLiteral("%1.audio.json").arg(baseName));
     }
 
-    if (in.isOpen())
-        in.close();
+    // Only complete exports are stored, a failed one is left as is to be looked at
+    if (!m_options.chunkStore.isEmpty() && m_options.tarOutput.isEmpty() && m_succeeded)
+    {
+        emit progressTextChanged(tr("Storing: %1").arg(baseName));
+
+        m_succeeded = storeOutputFiles(baseDirectory, baseName);
+    }
 
     emit finished();
 }
 
 void ImageWriterWorker::cancel()
 {
-    m_cancelFlag = true;
+    m_cancelFlag.storeRelease(true);
 }
 
-bool ImageWriterWorker::writeCueSheet(const QString &baseDirectory, const QString &baseName, CdromToc *toc)
+void ImageWriterWorker::setOptions(const ExportOptions &options)
 {
-    QFile outFile(buildOutputPath(baseDirectory, baseName, QStringLiteral("cue")));
-    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
-        return false;
+    m_options = options;
+
+    // The report must not claim holes the backend never makes
+    QString reason;
+    if (m_options.sparseOutput && !OutputFile::supportsSparse(m_options, reason))
+    {
+        qWarning().noquote() << "Sparse output is not supported with " << reason << ", the output files are written without holes.";
+        m_options.sparseOutput = false;
+    }
+}
 
-    QTextStream out(&outFile);
+bool ImageWriterWorker::writeCueSheet(const QString &baseDirectory, const QString &baseName, CdromToc *toc)
+{
+    // Built in memory first, archives need the size before the data
+    QByteArray cueSheet;
+    QTextStream out(&cueSheet, QIODevice::WriteOnly);
     out.setCodec("UTF-8");
 
     uint8_t currentTrack = 0;
@@ -268,77 +506,250 @@ bool ImageWriterWorker::writeCueSheet(const QString &baseDirectory, const QStrin
         }
     }
 
-    return true;
+    out.flush();
+
+    if (m_tarStream.isOpen())
+    {
+        if (!m_tarStream.addFile(QStringLiteral("%1.cue").arg(baseName), cueSheet))
+        {
+            qCritical().noquote() << "Write error on output archive: " << m_tarStream.errorString();
+            return false;
+        }
+
+        return true;
+    }
+
+    QFile outFile(buildOutputPath(baseDirectory, baseName, QStringLiteral("cue")));
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    return (outFile.write(cueSheet) == cueSheet.size());
 }
 
-bool ImageWriterWorker::writePcmAudio(QFile &in, QFile &out, const CdromToc::Entry &entry, uint32_t progressValue)
+bool ImageWriterWorker::writePcmAudio(InputFile &in, OutputFile &out, const CdromToc::Entry &entry, qint64 progressValue)
 {
+    // Only plain files can be read at any offset by io_uring and advised
+    int handle = in.handle();
+
+    // Shifted samples go through the carry buffer, and the analysis, checksums and held back samples
+    // need the samples in order, which only the synchronous path handles
+    bool detecting = m_options.detectByteOrder && !m_byteOrder.isSettled();
+    bool useIoUring = (handle >= 0) && m_ioUring.isInitialized() && (out.handle() >= 0) && !m_audioShift && !inspectsAudio() && !entry.subchannelSize && !detecting;
+
+    if (useIoUring && !m_byteOrder.isSwapped())
+        return writeWithIoUring(handle, entry.fileOffset, out, entry.trackLength, CDROM_SECTOR_SIZE, CDROM_SECTOR_SIZE, Q_NULLPTR, progressValue);
+
+    if (useIoUring)
+    {
+        // Buffers complete out of order, each one is swapped back to little endian in place
+        IoUringEngine::TransformCallback transform = [this](char* data, qint64 size, qint64) -> qint64
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+            timer.addBytes(size);
+
+            swapAudioBytes(data, size);
+            return size;
+        };
+
+        return writeWithIoUring(handle, entry.fileOffset, out, entry.trackLength, CDROM_SECTOR_SIZE, CDROM_SECTOR_SIZE, &transform, progressValue);
+    }
+
     uint32_t length = entry.trackLength;
 
-    in.seek(static_cast<qint64>(entry.fileOffset));
+    // Sectors followed by their subchannel are read in smaller batches, to fit the same buffers
+    int sectorStride = CDROM_SECTOR_SIZE + static_cast<int>(entry.subchannelSize);
+    uint32_t batchSectors = (SECTORS_PER_BATCH * CDROM_SECTOR_SIZE) / sectorStride;
+
+    if (!in.seek(entry.fileOffset))
+    {
+        qCritical().noquote() << "Could not seek in input file: " << in.errorString();
+        return false;
+    }
+
+    BufferPool::Lease buffer(m_bufferPool);
+
+    // With a positive offset the start of the entry was written at the end of the previous one
+    if (m_audioShift > 0)
+        m_audioSkip = qMin(m_audioShift, static_cast<qint64>(entry.trackLength) * CDROM_SECTOR_SIZE);
 
     while(length)
     {
-        if (m_cancelFlag)
+        if (m_cancelFlag.loadAcquire())
             return false;
 
-        emit progressValueChanged(static_cast<int>(progressValue));
-        QCoreApplication::processEvents();
+        reportProgress(progressValue);
+
+        uint32_t slice = qMin(length, batchSectors);
 
-        uint32_t slice = qMin(length, uint32_t(400));
+        qint64 reallyRead;
 
-        QByteArray data = in.read(slice * CDROM_SECTOR_SIZE);
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Read);
+            qint64 offset = in.pos();
+            reallyRead = in.read(buffer.data(), slice * sectorStride);
+            timer.addBytes(qMax(reallyRead, qint64(0)));
+            timer.addSyscalls();
+            timer.addAllocations(in.takeAllocations());
+
+            if (m_options.adviseInputs && (handle >= 0))
+            {
+                releaseReadCache(handle, offset, reallyRead);
+                timer.addSyscalls();
+            }
+        }
 
-        if (data.size() % CDROM_SECTOR_SIZE)
+        if ((reallyRead <= 0) || (reallyRead % sectorStride))
         {
             qCritical().noquote() << "Read error on input file: " << in.errorString();
             return false;
         }
 
-        if (out.write(data) < data.size())
+        uint32_t count = static_cast<uint32_t>(reallyRead / sectorStride);
+
+        if (entry.subchannelSize)
         {
-            qCritical().noquote() << "Write error on output file: " << out.errorString();
-            return false;
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+            reallyRead = stripSubchannel(buffer.data(), count, entry.subchannelSize);
+            timer.addBytes(reallyRead);
+        }
+
+        // Batches read before the byte order is settled are held back, past the limit the order known so far is used
+        if (m_options.detectByteOrder && !m_byteOrder.isSettled())
+        {
+            {
+                ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Analysis);
+                timer.addBytes(reallyRead);
+
+                m_byteOrder.process(buffer.data(), reallyRead);
+            }
+
+            if (!m_byteOrder.isSettled() && (m_heldAudio.size() + reallyRead <= MAX_HELD_AUDIO))
+            {
+                ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+                timer.addBytes(reallyRead);
+
+                int capacity = m_heldAudio.capacity();
+                m_heldAudio.append(buffer.data(), static_cast<int>(reallyRead));
+
+                if (m_heldAudio.capacity() != capacity)
+                    timer.addAllocations();
+
+                progressValue += count;
+                length -= count;
+                continue;
+            }
+
+            if (!flushHeldAudio(out))
+                return false;
+        }
+
+        if (m_byteOrder.isSwapped())
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+            timer.addBytes(reallyRead);
+
+            swapAudioBytes(buffer.data(), reallyRead);
+        }
+
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+            timer.addBytes(reallyRead);
+
+            bool ok = writeAudioBatch(out, buffer.data(), reallyRead);
+            timer.addSyscalls(out.takeSyscalls());
+
+            if (!ok)
+            {
+                qCritical().noquote() << "Write error on output file: " << out.errorString();
+                return false;
+            }
         }
 
-        uint32_t count = static_cast<uint32_t>(data.size()) / CDROM_SECTOR_SIZE;
         progressValue += count;
         length -= count;
     }
 
-    return true;
+    return finishAudioEntry(out, entry);
 }
 
-bool ImageWriterWorker::writeWaveAudio(WavFile &in, QFile &out, const CdromToc::Entry &entry, uint32_t progressValue)
+bool ImageWriterWorker::writeWaveAudio(WavFile &in, OutputFile &out, const CdromToc::Entry &entry, qint64 progressValue)
 {
+    // Converted audio is produced by WavFile, the file data can not be copied as is
+    if (m_ioUring.isInitialized() && (out.handle() >= 0) && !m_audioShift && !in.isConverted() && !inspectsAudio())
+        return writeWithIoUring(in.file()->handle(), in.dataOffset() + entry.fileOffset, out, entry.trackLength, CDROM_SECTOR_SIZE, CDROM_SECTOR_SIZE, Q_NULLPTR, progressValue);
+
     uint32_t length = entry.trackLength;
 
-    in.seek(static_cast<qint64>(entry.fileOffset));
+    in.seek(entry.fileOffset);
+
+    BufferPool::Lease buffer(m_bufferPool);
 
-    QByteArray data(400 * CDROM_SECTOR_SIZE, Qt::Uninitialized);
+    // With a positive offset the start of the entry was written at the end of the previous one
+    if (m_audioShift > 0)
+        m_audioSkip = qMin(m_audioShift, static_cast<qint64>(entry.trackLength) * CDROM_SECTOR_SIZE);
 
     while(length)
     {
-        if (m_cancelFlag)
+        if (m_cancelFlag.loadAcquire())
             return false;
 
-        emit progressValueChanged(static_cast<int>(progressValue));
-        QCoreApplication::processEvents();
+        reportProgress(progressValue);
+
+        uint32_t slice = qMin(length, uint32_t(SECTORS_PER_BATCH));
+
+        qint64 reallyRead;
+        const char* data = buffer.data();
+
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Read);
+            qint64 offset = in.dataOffset() + in.position();
+
+            // Mapped files are written straight from the page cache, the buffer is only used for converted audio
+            reallyRead = in.view(data, slice * CDROM_SECTOR_SIZE);
+
+            if (reallyRead < 0)
+            {
+                reallyRead = in.read(buffer.data(), slice * CDROM_SECTOR_SIZE);
+                timer.addSyscalls();
+            }
 
-        uint32_t slice = qMin(length, uint32_t(400));
+            timer.addBytes(qMax(reallyRead, qint64(0)));
+            timer.addAllocations(in.takeAllocations());
 
-        qint64 reallyRead = in.read(data.data(), slice * CDROM_SECTOR_SIZE);
+            // Viewed pages are still needed for the write, their cache is released after it
+            if (m_options.adviseInputs && (data == buffer.data()) && !in.isConverted())
+            {
+                releaseReadCache(in.file()->handle(), offset, reallyRead);
+                timer.addSyscalls();
+            }
+        }
 
-        if (reallyRead % CDROM_SECTOR_SIZE)
+        if ((reallyRead <= 0) || (reallyRead % CDROM_SECTOR_SIZE))
         {
             qCritical().noquote() << "Read error on input file.";
             return false;
         }
 
-        if (out.write(data.constData(), reallyRead) < reallyRead)
         {
-            qCritical().noquote() << "Write error on output file: " << out.errorString();
-            return false;
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+            timer.addBytes(reallyRead);
+
+            bool ok = writeAudioBatch(out, data, reallyRead);
+            timer.addSyscalls(out.takeSyscalls());
+
+            if (!ok)
+            {
+                qCritical().noquote() << "Write error on output file: " << out.errorString();
+                return false;
+            }
+        }
+
+        if (m_options.adviseInputs && (data != buffer.data()) && (reallyRead > 0))
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Read);
+            in.releaseView(data, reallyRead);
+            releaseReadCache(in.file()->handle(), in.dataOffset() + in.position() - reallyRead, reallyRead);
+            timer.addSyscalls(2);
         }
 
         uint32_t count = static_cast<uint32_t>(reallyRead) / CDROM_SECTOR_SIZE;
@@ -346,40 +757,73 @@ bool ImageWriterWorker::writeWaveAudio(WavFile &in, QFile &out, const CdromToc::
         length -= count;
     }
 
-    return true;
+    return finishAudioEntry(out, entry);
 }
 
-bool ImageWriterWorker::writeIsoData(QFile &in, QFile &out, const CdromToc::Entry &entry, uint32_t progressValue)
+bool ImageWriterWorker::writeIsoData(InputFile &in, OutputFile &out, const CdromToc::Entry &entry, qint64 progressValue)
 {
+    int handle = in.handle();
+
+    if ((handle >= 0) && m_ioUring.isInitialized() && (out.handle() >= 0))
+        return writeWithIoUring(handle, entry.fileOffset, out, entry.trackLength, CDROM_DATA_SIZE, CDROM_DATA_SIZE, Q_NULLPTR, progressValue);
+
     uint32_t length = entry.trackLength;
 
-    in.seek(static_cast<qint64>(entry.fileOffset));
+    if (!in.seek(entry.fileOffset))
+    {
+        qCritical().noquote() << "Could not seek in input file: " << in.errorString();
+        return false;
+    }
+
+    BufferPool::Lease buffer(m_bufferPool);
 
     while(length)
     {
-        if (m_cancelFlag)
+        if (m_cancelFlag.loadAcquire())
             return false;
 
-        emit progressValueChanged(static_cast<int>(progressValue));
-        QCoreApplication::processEvents();
+        reportProgress(progressValue);
 
-        uint32_t slice = qMin(length, uint32_t(400));
+        uint32_t slice = qMin(length, uint32_t(SECTORS_PER_BATCH));
 
-        QByteArray data = in.read(slice * CDROM_DATA_SIZE);
+        qint64 reallyRead;
+
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Read);
+            qint64 offset = in.pos();
+            reallyRead = in.read(buffer.data(), slice * CDROM_DATA_SIZE);
+            timer.addBytes(qMax(reallyRead, qint64(0)));
+            timer.addSyscalls();
+            timer.addAllocations(in.takeAllocations());
+
+            if (m_options.adviseInputs && (handle >= 0))
+            {
+                releaseReadCache(handle, offset, reallyRead);
+                timer.addSyscalls();
+            }
+        }
 
-        if (data.size() % CDROM_DATA_SIZE)
+        if ((reallyRead <= 0) || (reallyRead % CDROM_DATA_SIZE))
         {
             qCritical().noquote() << "Read error on input file: " << in.errorString();
             return false;
         }
 
-        if (out.write(data) < data.size())
         {
-            qCritical().noquote() << "Write error on output file: " << out.errorString();
-            return false;
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+            timer.addBytes(reallyRead);
+
+            bool ok = (out.write(buffer.data(), reallyRead) == reallyRead);
+            timer.addSyscalls(out.takeSyscalls());
+
+            if (!ok)
+            {
+                qCritical().noquote() << "Write error on output file: " << out.errorString();
+                return false;
+            }
         }
 
-        uint32_t count = static_cast<uint32_t>(data.size()) / CDROM_DATA_SIZE;
+        uint32_t count = static_cast<uint32_t>(reallyRead) / CDROM_DATA_SIZE;
         progressValue += count;
         length -= count;
     }
@@ -387,52 +831,104 @@ bool ImageWriterWorker::writeIsoData(QFile &in, QFile &out, const CdromToc::Entr
     return true;
 }
 
-bool ImageWriterWorker::writeRawData(QFile &in, QFile &out, const CdromToc::Entry &entry, uint32_t progressValue)
+bool ImageWriterWorker::writeRawData(InputFile &in, OutputFile &out, const CdromToc::Entry &entry, qint64 progressValue)
 {
+    int handle = in.handle();
+
+    if ((handle >= 0) && m_ioUring.isInitialized() && (out.handle() >= 0) && !entry.subchannelSize)
+    {
+        // Buffers complete out of order, each one is checked then reduced to its user data in place
+        IoUringEngine::TransformCallback transform = [this](char* data, qint64 size, qint64) -> qint64
+        {
+            uint32_t count = static_cast<uint32_t>(size / CDROM_SECTOR_SIZE);
+
+            checkSectors(data, count);
+
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+            timer.addBytes(count * CDROM_DATA_SIZE);
+
+            return extractSectorPayloads(data, count);
+        };
+
+        return writeWithIoUring(handle, entry.fileOffset, out, entry.trackLength, CDROM_SECTOR_SIZE, CDROM_DATA_SIZE, &transform, progressValue);
+    }
+
     uint32_t length = entry.trackLength;
+    int sectorStride = CDROM_SECTOR_SIZE + static_cast<int>(entry.subchannelSize);
+    uint32_t batchSectors = (SECTORS_PER_BATCH * CDROM_SECTOR_SIZE) / sectorStride;
+
+    if (!in.seek(entry.fileOffset))
+    {
+        qCritical().noquote() << "Could not seek in input file: " << in.errorString();
+        return false;
+    }
 
-    in.seek(static_cast<qint64>(entry.fileOffset));
+    BufferPool::Lease buffer(m_bufferPool);
 
     while(length)
     {
-        if (m_cancelFlag)
+        if (m_cancelFlag.loadAcquire())
             return false;
 
-        emit progressValueChanged(static_cast<int>(progressValue));
-        QCoreApplication::processEvents();
+        reportProgress(progressValue);
+
+        uint32_t slice = qMin(length, batchSectors);
 
-        uint32_t slice = qMin(length, uint32_t(400));
+        qint64 reallyRead;
 
-        QByteArray data = in.read(slice * CDROM_SECTOR_SIZE);
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Read);
+            qint64 offset = in.pos();
+            reallyRead = in.read(buffer.data(), slice * sectorStride);
+            timer.addBytes(qMax(reallyRead, qint64(0)));
+            timer.addSyscalls();
+            timer.addAllocations(in.takeAllocations());
+
+            if (m_options.adviseInputs && (handle >= 0))
+            {
+                releaseReadCache(handle, offset, reallyRead);
+                timer.addSyscalls();
+            }
+        }
 
-        if (data.size() % CDROM_SECTOR_SIZE)
+        if ((reallyRead <= 0) || (reallyRead % sectorStride))
         {
             qCritical().noquote() << "Read error on input file: " << in.errorString();
             return false;
         }
 
-        uint32_t count = static_cast<uint32_t>(data.size()) / CDROM_SECTOR_SIZE;
+        uint32_t count = static_cast<uint32_t>(reallyRead / sectorStride);
+
+        if (entry.subchannelSize)
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+            reallyRead = stripSubchannel(buffer.data(), count, entry.subchannelSize);
+            timer.addBytes(reallyRead);
+        }
+
+        checkSectors(buffer.data(), count);
 
-        const char* ptr = data.constData();
+        qint64 payloadSize;
 
-        for(uint32_t i = 0; i < count; ++i)
         {
-            if (!m_uncorrectedErrorsFlag)
-            {
-                if (!checkSectorData(ptr))
-                {
-                    qWarning().noquote() << "Data track contains uncorrected errors!";
-                    m_uncorrectedErrorsFlag = true;
-                }
-            }
+            // The whole batch is reduced to its user data, then written with a single call
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+            payloadSize = extractSectorPayloads(buffer.data(), count);
+            timer.addBytes(payloadSize);
+        }
+
+        {
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+            timer.addBytes(payloadSize);
+
+            bool ok = (out.write(buffer.data(), payloadSize) == payloadSize);
+            timer.addSyscalls(out.takeSyscalls());
 
-            if (out.write(ptr + CDROM_HEADER_SIZE, CDROM_DATA_SIZE) < CDROM_DATA_SIZE)
+            if (!ok)
             {
                 qCritical().noquote() << "Write error on output file: " << out.errorString();
                 return false;
             }
-
-            ptr += CDROM_SECTOR_SIZE;
         }
 
         progressValue += count;
@@ -442,19 +938,677 @@ bool ImageWriterWorker::writeRawData(QFile &in, QFile &out, const CdromToc::Entr
     return true;
 }
 
-QString ImageWriterWorker::buildOutputPath(const QString &directory, const QString &baseName, const QString &suffix)
+bool ImageWriterWorker::initializeBuffers(OutputFile &out)
 {
-    return QStringLiteral("%1/%2.%3").arg(directory, baseName, suffix);
+    bool useIoUring = (m_options.ioBackend == ExportOptions::IoBackend::IoUring);
+    int queueDepth = (m_options.queueDepth > 0) ? m_options.queueDepth : IoUringEngine::autoQueueDepth(out.handle());
+    int bufferCount = exportBufferCount(m_options, queueDepth);
+
+    if (!m_bufferPool.initialize(bufferCount, SECTORS_PER_BATCH * CDROM_SECTOR_SIZE, m_options.hugePages))
+    {
+        qCritical().noquote() << "Could not allocate " << bufferCount << " export buffers.";
+        return false;
+    }
+
+    m_statistics.add(ExportStatistics::Stage::Read, 0, 0, 0, m_bufferPool.takeAllocations());
+
+    if (m_options.hugePages && !m_bufferPool.usesHugePages())
+        qWarning().noquote() << "Huge pages are not available, using regular pages for the export buffers.";
+
+    if (useIoUring)
+    {
+        if (m_ioUring.initialize(queueDepth, m_bufferPool))
+            qInfo().noquote() << "Using io_uring with a queue depth of " << m_ioUring.queueDepth() << ".";
+        else
+            qWarning().noquote() << "io_uring is not available, using synchronous I/O: " << m_ioUring.errorString();
+    }
+
+    return true;
 }
 
-QString ImageWriterWorker::buildTrackNumber(const TrackIndex &trackIndex)
+int ImageWriterWorker::exportBufferCount(const ExportOptions &options, int queueDepth)
 {
-    return QStringLiteral("%1").arg(trackIndex.track(), 2, 10, QChar('0'));
+    // The synchronous paths hold a single buffer at a time, io_uring one per request in flight
+    if (options.maxBuffers > 0)
+        return options.maxBuffers;
+
+    return (options.ioBackend == ExportOptions::IoBackend::IoUring) ? queueDepth : 1;
 }
 
-QString ImageWriterWorker::buildIndexNumber(const TrackIndex &trackIndex)
+qint64 ImageWriterWorker::exportMemory(const ExportOptions &options, int queueDepth)
 {
-    return QStringLiteral("%1").arg(trackIndex.index(), 2, 10, QChar('0'));
+    return exportBufferCount(options, queueDepth) * qint64(SECTORS_PER_BATCH * CDROM_SECTOR_SIZE);
+}
+
+void ImageWriterWorker::initializeSampleOffset(CdromToc *toc)
+{
+    int sampleOffset = m_options.sampleOffset;
+
+    m_audioStream.initialize(toc);
+
+    // Shifting the samples reads ahead of the export, which compressed and piped files cannot do
+    if (!toc->hasSeekableFiles())
+    {
+        if (sampleOffset || !m_options.offsetReferenceFile.isEmpty())
+            qWarning().noquote() << "Read offsets are not corrected for compressed or piped images.";
+
+        m_audioShift = 0;
+        m_audioSkip = 0;
+        m_audioCarry.clear();
+        return;
+    }
+
+    if (!m_options.offsetReferenceFile.isEmpty())
+    {
+        emit progressTextChanged(tr("Detecting the read offset"));
+
+        OffsetDetector detector;
+        if (detector.loadReferences(m_options.offsetReferenceFile) && detector.detect(toc, MAX_SAMPLE_OFFSET, sampleOffset))
+            qInfo().noquote() << "Using the detected read offset of " << sampleOffset << " samples.";
+        else
+            qWarning().noquote() << "Using the configured read offset of " << sampleOffset << " samples.";
+    }
+
+    if (qAbs(sampleOffset) > MAX_SAMPLE_OFFSET)
+    {
+        qWarning().noquote() << "Read offset of " << sampleOffset << " samples is out of range, audio tracks are not corrected.";
+        sampleOffset = 0;
+    }
+
+    // The missing lead-in or lead-out samples read as silence
+    m_audioShift = static_cast<qint64>(sampleOffset) * AUDIO_SAMPLE_SIZE;
+    m_audioSkip = 0;
+    m_audioCarry.fill(0, static_cast<int>(qAbs(m_audioShift)));
+}
+
+bool ImageWriterWorker::writeAudioBatch(OutputFile &out, const char *data, qint64 size)
+{
+    if (m_audioShift > 0)
+    {
+        // Samples already written at the end of the previous entry
+        qint64 skipped = qMin(m_audioSkip, size);
+        m_audioSkip -= skipped;
+
+        return writeAudio(out, data + skipped, size - skipped);
+    }
+
+    if (m_audioShift < 0)
+    {
+        // Output lags the input: write the samples carried over, then carry the end of this batch
+        char* carry = m_audioCarry.data();
+        qint64 carrySize = m_audioCarry.size();
+
+        if (size >= carrySize)
+        {
+            if (!writeAudio(out, carry, carrySize) || !writeAudio(out, data, size - carrySize))
+                return false;
+
+            std::memcpy(carry, data + size - carrySize, static_cast<size_t>(carrySize));
+        }
+        else
+        {
+            if (!writeAudio(out, carry, size))
+                return false;
+
+            std::memmove(carry, carry + size, static_cast<size_t>(carrySize - size));
+            std::memcpy(carry + carrySize - size, data, static_cast<size_t>(size));
+        }
+
+        return true;
+    }
+
+    return writeAudio(out, data, size);
+}
+
+bool ImageWriterWorker::finishAudioEntry(OutputFile &out, const CdromToc::Entry &entry)
+{
+    if (m_audioShift <= 0)
+        return true;
+
+    // The entry ends with the first samples of the next audio entry, or silence at the end of the disc
+    qint64 entrySize = static_cast<qint64>(entry.trackLength) * CDROM_SECTOR_SIZE;
+    qint64 position = m_audioStream.entryPosition(entry) + qMax(entrySize, m_audioShift);
+    qint64 size = qMin(entrySize, m_audioShift);
+
+    {
+        ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Read);
+        timer.addBytes(size);
+
+        if (!m_audioStream.read(position, m_audioCarry.data(), size))
+            return false;
+    }
+
+    // The samples come from the next entries, each in the byte order of its own track
+    for(qint64 done = 0; done < size; )
+    {
+        qint64 sourceEnd;
+        const CdromToc::Entry* source = m_audioStream.findEntry(position + done, sourceEnd);
+
+        // Silence past the end of the disc
+        if (!source)
+            break;
+
+        qint64 slice = qMin(size - done, sourceEnd - (position + done));
+        bool swapped;
+
+        if (!isEntrySwapped(*source, swapped))
+            return false;
+
+        if (swapped)
+            swapAudioBytes(m_audioCarry.data() + done, slice);
+
+        done += slice;
+    }
+
+    ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+    timer.addBytes(size);
+
+    bool ok = writeAudio(out, m_audioCarry.constData(), size);
+    timer.addSyscalls(out.takeSyscalls());
+
+    if (!ok)
+        qCritical().noquote() << "Write error on output file: " << out.errorString();
+
+    return ok;
+}
+
+bool ImageWriterWorker::writeAudio(OutputFile &out, const char *data, qint64 size)
+{
+    // Samples are measured on their way to the output, in the order they are written
+    if (inspectsAudio())
+    {
+        ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Analysis);
+        timer.addBytes(size);
+
+        if (m_options.analyzeAudio)
+            m_audioAnalyzer.process(data, size);
+
+        if (m_options.computeChecksums)
+            m_audioChecksums.process(data, size);
+    }
+
+    return (out.write(data, size) == size);
+}
+
+void ImageWriterWorker::closeTrack(OutputFile &out, bool isWave, uint32_t sectorsExpected, uint32_t sectorsWritten, uint8_t track, const QString &fileName)
+{
+    uint32_t trailerSize = 0;
+
+    // Tracks cut short are left out of the report, their measures would be misleading
+    bool reported = isWave && inspectsAudio() && (sectorsWritten == sectorsExpected);
+
+    QJsonObject object;
+    object.insert(QStringLiteral("track"), static_cast<int>(track));
+    object.insert(QStringLiteral("file"), fileName);
+
+    if (reported && m_options.analyzeAudio)
+    {
+        AudioAnalyzer::Result result = m_audioAnalyzer.result();
+        addAnalysisToJson(object, result);
+
+        qInfo().noquote() << QStringLiteral("%1: peak %2 dBFS, true peak %3 dBTP, loudness %4 LUFS, %5 clipped samples.")
+                             .arg(fileName)
+                             .arg(20.0 * std::log10(result.samplePeak), 0, 'f', 2)
+                             .arg(20.0 * std::log10(result.truePeak), 0, 'f', 2)
+                             .arg(result.loudness, 0, 'f', 2)
+                             .arg(result.clippedSamples);
+
+        if (m_options.replayGainTags && std::isfinite(result.loudness) && !out.isStreamed())
+            trailerSize = writeReplayGainTag(out, result);
+    }
+
+    // Only BIN audio tracks are measured, WAV files are little endian by definition
+    if (isWave && m_byteOrder.isSwapped())
+    {
+        qWarning().noquote() << QStringLiteral("%1: audio is stored byte swapped (big endian), written back in little endian (difference energy ratio %2).")
+                                .arg(fileName)
+                                .arg(m_byteOrder.ratio(), 0, 'g', 3);
+    }
+
+    if (reported && m_options.detectByteOrder)
+        object.insert(QStringLiteral("byteSwapped"), m_byteOrder.isSwapped());
+
+    if (reported)
+        m_audioReport.append(object);
+
+    // The header was written with the expected size, only patch it if the track came out short or got a tag.
+    // Streamed tracks can not be patched, the archive pads them with silence instead.
+    if (isWave && !out.isStreamed() && ((sectorsWritten != sectorsExpected) || trailerSize))
+        writeWaveHeader(out, isRf64Track(sectorsExpected), static_cast<qint64>(sectorsWritten) * CDROM_SECTOR_SIZE, trailerSize);
+
+    out.close();
+    m_statistics.add(ExportStatistics::Stage::Write, 0, 0, out.takeSyscalls(), 0);
+    m_statistics.addSparseBytes(out.takeSparseBytes());
+}
+
+uint32_t ImageWriterWorker::writeReplayGainTag(OutputFile &out, const AudioAnalyzer::Result &result)
+{
+    ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::WaveHeader);
+
+    QByteArray gain = QByteArray::number(result.replayGain, 'f', 2) + " dB";
+    if (result.replayGain >= 0.0)
+        gain.prepend('+');
+
+    const QPair<QByteArray, QByteArray> fields[] = {
+        qMakePair(QByteArray("REPLAYGAIN_TRACK_GAIN"), gain),
+        qMakePair(QByteArray("REPLAYGAIN_TRACK_PEAK"), QByteArray::number(result.samplePeak, 'f', 6))
+    };
+
+    // ID3v2.3 user defined text frames: Latin-1 encoding, description, value
+    QByteArray frames;
+    for(const QPair<QByteArray, QByteArray>& field : fields)
+    {
+        uint32_t frameSize = BIG_ENDIAN_DWORD(static_cast<uint32_t>(field.first.size() + field.second.size() + 2));
+
+        frames.append("TXXX", 4);
+        frames.append(reinterpret_cast<const char*>(&frameSize), sizeof(frameSize));
+        frames.append(2, '\0');
+        frames.append('\0');
+        frames.append(field.first);
+        frames.append('\0');
+        frames.append(field.second);
+    }
+
+    // RIFF chunks are word aligned, the padding goes in the tag
+    if (frames.size() % 2)
+        frames.append('\0');
+
+    // Tag header, its size is stored on 7 bits per byte
+    uint32_t tagSize = static_cast<uint32_t>(frames.size());
+    QByteArray tag("ID3\x03\x00\x00", 6);
+    tag.append(static_cast<char>((tagSize >> 21) & 0x7f));
+    tag.append(static_cast<char>((tagSize >> 14) & 0x7f));
+    tag.append(static_cast<char>((tagSize >> 7) & 0x7f));
+    tag.append(static_cast<char>(tagSize & 0x7f));
+    tag.append(frames);
+
+    WaveChunkHeader chunkHeader;
+    chunkHeader.magic = WAVE_ID3_MAGIC;
+    chunkHeader.dataSize = static_cast<uint32_t>(tag.size());
+
+    // Written right after the audio data, the file grows past its preallocated size
+    bool ok = (out.write(reinterpret_cast<const char*>(&chunkHeader), sizeof(chunkHeader)) == sizeof(chunkHeader))
+            && (out.write(tag.constData(), tag.size()) == tag.size());
+
+    timer.addBytes(static_cast<qint64>(sizeof(chunkHeader)) + tag.size());
+    timer.addSyscalls(out.takeSyscalls());
+
+    if (!ok)
+    {
+        qWarning().noquote() << "Could not write the ReplayGain tag: " << out.errorString();
+        return 0;
+    }
+
+    return static_cast<uint32_t>(sizeof(chunkHeader) + tag.size());
+}
+
+void ImageWriterWorker::reportChecksums(QJsonObject &object, uint8_t track, const QString &fileName)
+{
+    AudioChecksums::TrackResult result = m_audioChecksums.trackResult(track);
+
+    object.insert(QStringLiteral("accurateRipV1"), QStringLiteral("%1").arg(result.accurateRipV1, 8, 16, QChar('0')));
+    object.insert(QStringLiteral("accurateRipV2"), QStringLiteral("%1").arg(result.accurateRipV2, 8, 16, QChar('0')));
+    object.insert(QStringLiteral("crc32"), QStringLiteral("%1").arg(result.crc32, 8, 16, QChar('0')));
+
+    QString message = QStringLiteral("%1: AccurateRip v1 %2, v2 %3, CRC32 %4.")
+            .arg(fileName)
+            .arg(result.accurateRipV1, 8, 16, QChar('0'))
+            .arg(result.accurateRipV2, 8, 16, QChar('0'))
+            .arg(result.crc32, 8, 16, QChar('0'));
+
+    if (!m_accurateRip.isLoaded())
+    {
+        qInfo().noquote() << message;
+        return;
+    }
+
+    int confidenceV1 = m_accurateRip.confidence(track, result.accurateRipV1);
+    int confidenceV2 = m_accurateRip.confidence(track, result.accurateRipV2);
+
+    object.insert(QStringLiteral("accurateRipV1Confidence"), confidenceV1);
+    object.insert(QStringLiteral("accurateRipV2Confidence"), confidenceV2);
+
+    if (confidenceV1 || confidenceV2)
+        qInfo().noquote() << message << QStringLiteral(" Accurately ripped (confidence %1 v1, %2 v2).").arg(confidenceV1).arg(confidenceV2);
+    else
+        qWarning().noquote() << message << " Not matching the AccurateRip database.";
+}
+
+bool ImageWriterWorker::writeAudioReport(const QString &filename) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning().noquote() << "Could not write audio report: " << file.errorString();
+        return false;
+    }
+
+    QByteArray json = buildAudioReport();
+
+    return (file.write(json) == json.size());
+}
+
+QByteArray ImageWriterWorker::buildAudioReport() const
+{
+    QJsonObject report;
+    report.insert(QStringLiteral("tracks"), m_audioReport);
+
+    // The disc CRC covers all the audio tracks, it is only known after a complete export
+    if (m_options.computeChecksums && m_succeeded)
+        report.insert(QStringLiteral("ctdbCrc"), QStringLiteral("%1").arg(m_audioChecksums.ctdbCrc(), 8, 16, QChar('0')));
+
+    return QJsonDocument(report).toJson(QJsonDocument::Indented);
+}
+
+bool ImageWriterWorker::storeOutputFiles(const QString &baseDirectory, const QString &baseName)
+{
+    ChunkStore store;
+    if (!store.open(m_options.chunkStore))
+        return false;
+
+    QDir directory(baseDirectory);
+    QVector<ChunkStore::File> files;
+
+    for(const QString& fileName : m_outputFiles)
+    {
+        ChunkStore::File file;
+        file.name = fileName;
+
+        if (!store.addFile(directory.filePath(fileName), file))
+            return false;
+
+        files.append(file);
+    }
+
+    if (!ChunkStore::writeManifest(buildOutputPath(baseDirectory, baseName, QStringLiteral("manifest.json")), files))
+        return false;
+
+    // The manifest now stands for the files
+    for(const QString& fileName : m_outputFiles)
+        directory.remove(fileName);
+
+    qInfo().noquote() << QStringLiteral("Chunk store: %1 MiB added, %2 MiB already stored.")
+                         .arg(static_cast<double>(store.storedBytes()) / (1024.0 * 1024.0), 0, 'f', 1)
+                         .arg(static_cast<double>(store.duplicateBytes()) / (1024.0 * 1024.0), 0, 'f', 1);
+
+    return true;
+}
+
+uint32_t ImageWriterWorker::trackDataSectors(CdromToc *toc, uint8_t track)
+{
+    uint32_t sectors = 0;
+
+    for(const CdromToc::Entry& entry : toc->toc())
+    {
+        if ((entry.trackIndex.track() == track) && (entry.fileIndex != -1))
+            sectors += entry.trackLength;
+    }
+
+    return sectors;
+}
+
+void ImageWriterWorker::adviseSequentialRead(int handle)
+{
+#ifdef Q_OS_LINUX
+    if (handle >= 0)
+        posix_fadvise(handle, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    Q_UNUSED(handle)
+#endif
+}
+
+void ImageWriterWorker::releaseReadCache(int handle, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    if (length > 0)
+        posix_fadvise(handle, offset, length, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(handle)
+    Q_UNUSED(offset)
+    Q_UNUSED(length)
+#endif
+}
+
+bool ImageWriterWorker::detectByteOrder(uint8_t track, ByteOrderDetector &detector)
+{
+    qint64 position;
+    qint64 size;
+
+    // The samples are read ahead of the copy, from index 1 until the detection is settled
+    if (m_audioStream.trackRange(track, position, size))
+    {
+        BufferPool::Lease buffer(m_bufferPool);
+        qint64 batchSize = static_cast<qint64>(SECTORS_PER_BATCH) * CDROM_SECTOR_SIZE;
+
+        for(qint64 done = 0; (done < size) && !detector.isSettled(); done += batchSize)
+        {
+            qint64 count = qMin(batchSize, size - done);
+
+            ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Analysis);
+            timer.addBytes(count);
+
+            if (!m_audioStream.read(position + done, buffer.data(), count))
+                return false;
+
+            detector.process(buffer.data(), count);
+        }
+    }
+
+    detector.finish();
+    return true;
+}
+
+bool ImageWriterWorker::isEntrySwapped(const CdromToc::Entry &entry, bool &swapped)
+{
+    swapped = false;
+
+    // WAV files are little endian by definition
+    if (!m_options.detectByteOrder || (entry.trackType != CdromToc::TrackType::AudioPCM))
+        return true;
+
+    uint8_t track = entry.trackIndex.track();
+    auto i = m_trackSwapped.constFind(track);
+
+    if (i != m_trackSwapped.constEnd())
+    {
+        swapped = i.value();
+        return true;
+    }
+
+    // A track not exported yet is measured the same way its export will measure it, so both agree
+    ByteOrderDetector detector;
+    if (!detectByteOrder(track, detector))
+        return false;
+
+    swapped = detector.isSwapped();
+    m_trackSwapped.insert(track, swapped);
+
+    return true;
+}
+
+bool ImageWriterWorker::flushHeldAudio(OutputFile &out)
+{
+    if (m_heldAudio.isEmpty())
+        return true;
+
+    // Reaching the end of the track or the limit of the held samples settles the detection
+    m_byteOrder.finish();
+
+    if (m_byteOrder.isSwapped())
+    {
+        ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Copy);
+        timer.addBytes(m_heldAudio.size());
+
+        swapAudioBytes(m_heldAudio.data(), m_heldAudio.size());
+    }
+
+    ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+    timer.addBytes(m_heldAudio.size());
+
+    bool ok = writeAudioBatch(out, m_heldAudio.constData(), m_heldAudio.size());
+    timer.addSyscalls(out.takeSyscalls());
+
+    m_heldAudio.clear();
+
+    if (!ok)
+        qCritical().noquote() << "Write error on output file: " << out.errorString();
+
+    return ok;
+}
+
+bool ImageWriterWorker::writeWithIoUring(int inHandle, qint64 inOffset, OutputFile &out, uint32_t sectorCount, int inSectorSize, int outSectorSize, const IoUringEngine::TransformCallback *transform, qint64 progressValue)
+{
+    qint64 inLength = static_cast<qint64>(sectorCount) * inSectorSize;
+    qint64 outLength = static_cast<qint64>(sectorCount) * outSectorSize;
+
+    IoUringEngine::ProgressCallback progress = [&](qint64 done) -> bool
+    {
+        reportProgress(progressValue + done / inSectorSize);
+        return !m_cancelFlag.loadAcquire();
+    };
+
+    bool ok;
+
+    {
+        // Reads and writes overlap, so the whole operation is accounted as the write stage
+        ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::Write);
+
+        if (transform)
+            ok = m_ioUring.transform(inHandle, inOffset, out.handle(), out.pos(), inLength, inSectorSize, outSectorSize, *transform, progress);
+        else
+            ok = m_ioUring.copy(inHandle, inOffset, out.handle(), out.pos(), inLength, inSectorSize, progress);
+
+        timer.addBytes(outLength);
+        timer.addSyscalls(m_ioUring.takeSyscalls());
+    }
+
+    m_statistics.add(ExportStatistics::Stage::Read, 0, inLength, 0, 0);
+
+    if (m_options.adviseInputs)
+        releaseReadCache(inHandle, inOffset, inLength);
+
+    if (!ok)
+    {
+        if (!m_cancelFlag.loadAcquire())
+            qCritical().noquote() << "I/O error during export: " << m_ioUring.errorString();
+
+        return false;
+    }
+
+    out.advance(outLength);
+
+    return true;
+}
+
+void ImageWriterWorker::checkSectors(const char *data, uint32_t count)
+{
+    if (m_uncorrectedErrorsFlag)
+        return;
+
+    ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::EdcCheck);
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        timer.addBytes(CDROM_DATA_SIZE + CDROM_HEADER_SIZE);
+
+        if (!checkSectorData(data))
+        {
+            qWarning().noquote() << "Data track contains uncorrected errors!";
+            m_uncorrectedErrorsFlag = true;
+            break;
+        }
+
+        data += CDROM_SECTOR_SIZE;
+    }
+}
+
+qint64 ImageWriterWorker::extractSectorPayloads(char *data, uint32_t count)
+{
+    // Destination never overtakes the source and stays at least a header behind it,
+    // so payloads can be moved down in place with forward 16 byte copies
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        char* destination = data + i * CDROM_DATA_SIZE;
+        const char* source = data + i * CDROM_SECTOR_SIZE + CDROM_HEADER_SIZE;
+
+#ifdef __SSE2__
+        for(int offset = 0; offset < CDROM_DATA_SIZE; offset += 64)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset + 32));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset + 48));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset), a);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset + 16), b);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset + 32), c);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset + 48), d);
+        }
+#else
+        std::memmove(destination, source, CDROM_DATA_SIZE);
+#endif
+    }
+
+    return static_cast<qint64>(count) * CDROM_DATA_SIZE;
+}
+
+qint64 ImageWriterWorker::stripSubchannel(char *data, uint32_t count, uint32_t subchannelSize)
+{
+    // The first sector is already in place, the others move down by one subchannel more each
+    for(uint32_t i = 1; i < count; ++i)
+        std::memmove(data + i * CDROM_SECTOR_SIZE, data + i * (CDROM_SECTOR_SIZE + subchannelSize), CDROM_SECTOR_SIZE);
+
+    return static_cast<qint64>(count) * CDROM_SECTOR_SIZE;
+}
+
+void ImageWriterWorker::swapAudioBytes(char *data, qint64 size)
+{
+    qint64 offset = 0;
+
+#ifdef __SSE2__
+    // Both bytes of every 16-bit sample are exchanged with a pair of shifts, 64 bytes at a time
+    for(; offset + 64 <= size; offset += 64)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + 48));
+
+        a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+        b = _mm_or_si128(_mm_slli_epi16(b, 8), _mm_srli_epi16(b, 8));
+        c = _mm_or_si128(_mm_slli_epi16(c, 8), _mm_srli_epi16(c, 8));
+        d = _mm_or_si128(_mm_slli_epi16(d, 8), _mm_srli_epi16(d, 8));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + offset), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + offset + 16), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + offset + 32), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + offset + 48), d);
+    }
+#endif
+
+    // Samples may not be aligned, they are copied out and back
+    for(; offset + 2 <= size; offset += 2)
+    {
+        uint16_t sample;
+        std::memcpy(&sample, data + offset, sizeof(sample));
+        sample = BYTE_SWAP_16(sample);
+        std::memcpy(data + offset, &sample, sizeof(sample));
+    }
+}
+
+QString ImageWriterWorker::buildOutputPath(const QString &directory, const QString &baseName, const QString &suffix)
+{
+    return QStringLiteral("%1/%2.%3").arg(directory, baseName, suffix);
+}
+
+QString ImageWriterWorker::buildTrackNumber(const TrackIndex &trackIndex)
+{
+    return QStringLiteral("%1").arg(trackIndex.track(), 2, 10, QChar('0'));
+}
+
+QString ImageWriterWorker::buildIndexNumber(const TrackIndex &trackIndex)
+{
+    return QStringLiteral("%1").arg(trackIndex.index(), 2, 10, QChar('0'));
 }
 
 QString ImageWriterWorker::buildTrackOutputFilename(const TrackIndex& trackIndex, const QString &baseName, const QString &suffix)
@@ -467,6 +1621,29 @@ QString ImageWriterWorker::buildTrackOutputPath(const QString &directory, const
     return QStringLiteral("%1/%2").arg(directory, buildTrackOutputFilename(trackIndex, baseName, suffix));
 }
 
+void ImageWriterWorker::addAnalysisToJson(QJsonObject &object, const AudioAnalyzer::Result &result)
+{
+    // JSON has no infinities, levels of silent or too short tracks are null
+    auto decibels = [](double value) -> QJsonValue
+    {
+        double level = 20.0 * std::log10(value);
+        return std::isfinite(level) ? QJsonValue(level) : QJsonValue();
+    };
+
+    bool hasLoudness = std::isfinite(result.loudness);
+
+    object.insert(QStringLiteral("frames"), static_cast<double>(result.frames));
+    object.insert(QStringLiteral("samplePeak"), result.samplePeak);
+    object.insert(QStringLiteral("samplePeakDb"), decibels(result.samplePeak));
+    object.insert(QStringLiteral("truePeak"), result.truePeak);
+    object.insert(QStringLiteral("truePeakDb"), decibels(result.truePeak));
+    object.insert(QStringLiteral("rms"), result.rms);
+    object.insert(QStringLiteral("rmsDb"), decibels(result.rms));
+    object.insert(QStringLiteral("loudness"), hasLoudness ? QJsonValue(result.loudness) : QJsonValue());
+    object.insert(QStringLiteral("replayGain"), hasLoudness ? QJsonValue(result.replayGain) : QJsonValue());
+    object.insert(QStringLiteral("clippedSamples"), static_cast<double>(result.clippedSamples));
+}
+
 QString ImageWriterWorker::buildMsf(uint32_t value)
 {
     uint32_t m;
@@ -480,9 +1657,13 @@ QString ImageWriterWorker::buildMsf(uint32_t value)
             .arg(f, 2, 10, QChar('0'));
 }
 
-void ImageWriterWorker::writeWaveHeader(QFile &out, uint32_t dataSize)
+void ImageWriterWorker::writeWaveHeader(OutputFile &out, bool rf64, qint64 dataSize, uint32_t trailerSize)
 {
+    ExportStatistics::StageTimer timer(m_statistics, ExportStatistics::Stage::WaveHeader);
+
     WaveRiffHeader riffHeader;
+    WaveChunkHeader ds64Header;
+    WaveDs64Chunk ds64Chunk;
     WaveChunkHeader fmtHeader;
     WaveFmtChunk fmtChunk;
     WaveChunkHeader dataHeader;
@@ -492,10 +1673,20 @@ void ImageWriterWorker::writeWaveHeader(QFile &out, uint32_t dataSize)
     constexpr uint32_t sampleRate = 44100;
     constexpr uint16_t bitsPerSample = 16;
 
-    riffHeader.magic = 0x46464952;
-    riffHeader.fileSize = dataSize + sizeof(fmtHeader) + sizeof(fmtChunk) + sizeof(dataHeader) + 4;
+    qint64 riffSize = waveHeaderSize(rf64) - 8 + dataSize + trailerSize;
+
+    // RF64 files keep their sizes in the ds64 chunk, the 32-bit fields are all set
+    riffHeader.magic = rf64 ? WAVE_RF64_MAGIC : 0x46464952;
+    riffHeader.fileSize = rf64 ? WAVE_LARGE_SIZE : static_cast<uint32_t>(riffSize);
     riffHeader.formatId = 0x45564157;
 
+    ds64Header.magic = WAVE_DS64_MAGIC;
+    ds64Header.dataSize = sizeof(ds64Chunk);
+
+    ds64Chunk.riffSize = static_cast<uint64_t>(riffSize);
+    ds64Chunk.dataSize = static_cast<uint64_t>(dataSize);
+    ds64Chunk.sampleCount = static_cast<uint64_t>(dataSize / AUDIO_SAMPLE_SIZE);
+    ds64Chunk.tableLength = 0;
 
     fmtHeader.magic = 0x20746d66;
     fmtHeader.dataSize = sizeof(fmtChunk);
@@ -508,30 +1699,57 @@ void ImageWriterWorker::writeWaveHeader(QFile &out, uint32_t dataSize)
     fmtChunk.bytesPerSecond = sampleRate * fmtChunk.bytesPerBlock;
 
     dataHeader.magic = 0x61746164;
-    dataHeader.dataSize = dataSize;
+    dataHeader.dataSize = rf64 ? WAVE_LARGE_SIZE : static_cast<uint32_t>(dataSize);
+
+    if (out.pos() != 0)
+        out.seek(0);
 
-    out.seek(0);
     out.write(reinterpret_cast<const char *>(&riffHeader), sizeof(riffHeader));
+
+    if (rf64)
+    {
+        out.write(reinterpret_cast<const char *>(&ds64Header), sizeof(ds64Header));
+        out.write(reinterpret_cast<const char *>(&ds64Chunk), sizeof(ds64Chunk));
+    }
+
     out.write(reinterpret_cast<const char *>(&fmtHeader), sizeof(fmtHeader));
     out.write(reinterpret_cast<const char *>(&fmtChunk), sizeof(fmtChunk));
     out.write(reinterpret_cast<const char *>(&dataHeader), sizeof(dataHeader));
+
+    timer.addBytes(waveHeaderSize(rf64));
+    timer.addSyscalls(out.takeSyscalls());
 }
 
-uint32_t ImageWriterWorker::calculateEdc(const uint8_t *data, int len)
+qint64 ImageWriterWorker::waveHeaderSize(bool rf64)
 {
-    uint32_t crc = 0;
+    return rf64 ? WAVE_HEADER_SIZE + WAVE_DS64_SIZE : WAVE_HEADER_SIZE;
+}
 
-    while (len--)
-        crc = EDCTABLE[static_cast<int>(crc ^ *data++) & 0xff] ^ (crc >> 8);
+bool ImageWriterWorker::isRf64Track(uint32_t sectors)
+{
+    // Decided from the expected length, so the header keeps its size when patched at the end of the track
+    return static_cast<qint64>(sectors) * CDROM_SECTOR_SIZE > RIFF_MAX_DATA_SIZE;
+}
 
-    return crc;
+int ImageWriterWorker::progressShift(qint64 sectors)
+{
+    int shift = 0;
+    while((sectors >> shift) > std::numeric_limits<int>::max())
+        ++shift;
+
+    return shift;
+}
+
+void ImageWriterWorker::reportProgress(qint64 sectors)
+{
+    emit progressValueChanged(static_cast<int>(sectors >> m_progressShift));
 }
 
 bool ImageWriterWorker::checkSectorData(const void *data)
 {
     const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
 
-    uint32_t checkEdc = calculateEdc(ptr, CDROM_DATA_SIZE + CDROM_HEADER_SIZE);
+    uint32_t checkEdc = SectorCoder::edc(0, ptr, CDROM_DATA_SIZE + CDROM_HEADER_SIZE);
     const uint32_t* edc = reinterpret_cast<const uint32_t*>(ptr + CDROM_DATA_SIZE + CDROM_HEADER_SIZE);
 
     return (*edc == checkEdc);
@@ -1,10 +1,28 @@
 #ifndef IMAGEWRITERWORKER_H
 #define IMAGEWRITERWORKER_H
 
+#include <QAtomicInt>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMap>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 
+#include "accurateripdatabase.h"
+#include "audioanalyzer.h"
+#include "audiochecksums.h"
+#include "audiostream.h"
+#include "bufferpool.h"
+#include "byteorderdetector.h"
 #include "cdromtoc.h"
+#include "exportoptions.h"
+#include "exportstatistics.h"
+#include "fileprefetcher.h"
+#include "inputfile.h"
+#include "iouringengine.h"
+#include "outputfile.h"
+#include "tarstream.h"
 #include "wavfile.h"
 
 class ImageWriterWorker : public QObject
@@ -26,26 +44,110 @@ public slots:
 
     void cancel();
 
+    void setOptions(const ExportOptions& options);
+
+    inline const ExportStatistics& statistics() const
+    {
+        return m_statistics;
+    }
+
+    /**
+     * @brief Check if the last export went through every entry of the TOC without being cancelled.
+     */
+    inline bool succeeded() const
+    {
+        return m_succeeded;
+    }
+
+    /**
+     * @brief Memory used by the export buffers, for a given io_uring queue depth.
+     */
+    static qint64 exportMemory(const ExportOptions& options, int queueDepth);
+
 protected:
     bool writeCueSheet(const QString &baseDirectory, const QString &baseName, CdromToc *toc);
 
-    bool writePcmAudio(QFile& in, QFile& out, const CdromToc::Entry& entry, uint32_t progressValue);
-    bool writeWaveAudio(WavFile& in, QFile& out, const CdromToc::Entry& entry, uint32_t progressValue);
-    bool writeIsoData(QFile& in, QFile& out, const CdromToc::Entry& entry, uint32_t progressValue);
-    bool writeRawData(QFile& in, QFile& out, const CdromToc::Entry& entry, uint32_t progressValue);
+    bool writePcmAudio(InputFile& in, OutputFile& out, const CdromToc::Entry& entry, qint64 progressValue);
+    bool writeWaveAudio(WavFile& in, OutputFile& out, const CdromToc::Entry& entry, qint64 progressValue);
+    bool writeIsoData(InputFile& in, OutputFile& out, const CdromToc::Entry& entry, qint64 progressValue);
+    bool writeRawData(InputFile& in, OutputFile& out, const CdromToc::Entry& entry, qint64 progressValue);
+    bool detectByteOrder(uint8_t track, ByteOrderDetector& detector);
+    bool isEntrySwapped(const CdromToc::Entry& entry, bool& swapped);
+    bool flushHeldAudio(OutputFile& out);
+    bool writeWithIoUring(int inHandle, qint64 inOffset, OutputFile& out, uint32_t sectorCount, int inSectorSize, int outSectorSize, const IoUringEngine::TransformCallback* transform, qint64 progressValue);
+    void checkSectors(const char* data, uint32_t count);
+    bool initializeBuffers(OutputFile& out);
+    static int exportBufferCount(const ExportOptions& options, int queueDepth);
+    void initializeSampleOffset(CdromToc* toc);
+    bool writeAudioBatch(OutputFile& out, const char* data, qint64 size);
+    bool finishAudioEntry(OutputFile& out, const CdromToc::Entry& entry);
+    bool writeAudio(OutputFile& out, const char* data, qint64 size);
+    void closeTrack(OutputFile& out, bool isWave, uint32_t sectorsExpected, uint32_t sectorsWritten, uint8_t track, const QString& fileName);
+    uint32_t writeReplayGainTag(OutputFile& out, const AudioAnalyzer::Result& result);
+    void reportChecksums(QJsonObject& object, uint8_t track, const QString& fileName);
+    bool writeAudioReport(const QString& filename) const;
+    QByteArray buildAudioReport() const;
+    bool storeOutputFiles(const QString& baseDirectory, const QString& baseName);
+
+    /**
+     * @brief Check if audio samples are measured or checksummed, they then have to be written in order.
+     */
+    inline bool inspectsAudio() const
+    {
+        return m_options.analyzeAudio || m_options.computeChecksums;
+    }
 
+    static uint32_t trackDataSectors(CdromToc* toc, uint8_t track);
+    static void adviseSequentialRead(int handle);
+    static void releaseReadCache(int handle, qint64 offset, qint64 length);
     static QString buildOutputPath(const QString& directory, const QString& baseName, const QString& suffix);
     static QString buildTrackNumber(const TrackIndex& trackIndex);
     static QString buildIndexNumber(const TrackIndex& trackIndex);
     static QString buildTrackOutputFilename(const TrackIndex& trackIndex, const QString& baseName, const QString &suffix);
     static QString buildTrackOutputPath(const QString& baseDirectory, const TrackIndex& trackIndex, const QString& baseName, const QString& suffix);
     static QString buildMsf(uint32_t value);
-    static void writeWaveHeader(QFile& out, uint32_t dataSize);
-    static uint32_t calculateEdc(const uint8_t *data, int len);
+    static void addAnalysisToJson(QJsonObject& object, const AudioAnalyzer::Result& result);
+    void writeWaveHeader(OutputFile& out, bool rf64, qint64 dataSize, uint32_t trailerSize = 0);
+    static qint64 waveHeaderSize(bool rf64);
+    static bool isRf64Track(uint32_t sectors);
+    static int progressShift(qint64 sectors);
+    void reportProgress(qint64 sectors);
+    static qint64 extractSectorPayloads(char* data, uint32_t count);
+    static qint64 stripSubchannel(char* data, uint32_t count, uint32_t subchannelSize);
+    static void swapAudioBytes(char* data, qint64 size);
     static bool checkSectorData(const void* data);
 
-    bool m_cancelFlag;
+    QAtomicInt m_cancelFlag;
     bool m_uncorrectedErrorsFlag;
+    bool m_succeeded;
+
+    /// Progress is reported in units of 2^shift sectors, so the whole image fits the int range of the signals
+    int m_progressShift;
+
+    ExportStatistics m_statistics;
+    ExportOptions m_options;
+    BufferPool m_bufferPool;
+    FilePrefetcher m_prefetcher;
+    TarStream m_tarStream;
+    IoUringEngine m_ioUring;
+    AudioStream m_audioStream;
+    ByteOrderDetector m_byteOrder;
+
+    /// Byte order of the PCM tracks measured so far, true when swapped
+    QMap<uint8_t, bool> m_trackSwapped;
+
+    /// Samples of a compressed or piped track read before its byte order is settled
+    QByteArray m_heldAudio;
+    qint64 m_audioShift;
+    qint64 m_audioSkip;
+    QByteArray m_audioCarry;
+    AudioAnalyzer m_audioAnalyzer;
+    AudioChecksums m_audioChecksums;
+    AccurateRipDatabase m_accurateRip;
+    QJsonArray m_audioReport;
+
+    /// Files written by the export, relative to the output directory
+    QStringList m_outputFiles;
 };
 
 #endif // IMAGEWRITERWORKER_H
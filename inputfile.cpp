@@ -0,0 +1,202 @@
+#include "inputfile.h"
+#include "streaminput.h"
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+InputFile::InputFile() :
+    m_device(Q_NULLPTR),
+    m_file(),
+    m_fd(-1),
+    m_position(0),
+    m_errorString()
+{
+}
+
+InputFile::~InputFile()
+{
+    close();
+}
+
+bool InputFile::open(const QString &fileName)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    m_fd = ::open(QFile::encodeName(fileName).constData(), O_RDONLY);
+    if (m_fd < 0)
+    {
+        setSystemError(QStringLiteral("open"));
+        return false;
+    }
+
+    return true;
+#else
+    m_file.setFileName(fileName);
+    m_device = &m_file;
+
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+        m_device = Q_NULLPTR;
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+bool InputFile::open(QIODevice *device)
+{
+    close();
+
+    if (!device->isOpen())
+    {
+        m_errorString = device->errorString();
+        return false;
+    }
+
+    m_device = device;
+    return true;
+}
+
+bool InputFile::isOpen() const
+{
+    return (m_fd >= 0) || m_device;
+}
+
+qint64 InputFile::read(char *data, qint64 size)
+{
+    if (m_device)
+        return m_device->read(data, size);
+
+    qint64 done = 0;
+
+#ifdef Q_OS_UNIX
+    while(done < size)
+    {
+        ssize_t count = pread(m_fd, data + done, static_cast<size_t>(size - done), static_cast<off_t>(m_position + done));
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            setSystemError(QStringLiteral("read"));
+            if (!done)
+                return -1;
+
+            break;
+        }
+
+        // End of the file
+        if (!count)
+            break;
+
+        done += count;
+    }
+#else
+    Q_UNUSED(data)
+#endif
+
+    m_position += done;
+    return done;
+}
+
+bool InputFile::seek(qint64 position)
+{
+    if (m_device)
+        return m_device->seek(position);
+
+    if (position < 0)
+    {
+        m_errorString = QStringLiteral("Invalid position.");
+        return false;
+    }
+
+    // pread takes the position with every call
+    m_position = position;
+    return true;
+}
+
+qint64 InputFile::pos() const
+{
+    return m_device ? m_device->pos() : m_position;
+}
+
+qint64 InputFile::size() const
+{
+    if (m_device)
+        return m_device->isSequential() ? -1 : m_device->size();
+
+#ifdef Q_OS_UNIX
+    struct stat status;
+    if ((m_fd >= 0) && (fstat(m_fd, &status) == 0))
+        return static_cast<qint64>(status.st_size);
+#endif
+
+    return -1;
+}
+
+uchar *InputFile::map(qint64 offset, qint64 size)
+{
+#ifdef Q_OS_UNIX
+    if ((m_fd < 0) || (size <= 0) || (static_cast<quint64>(size) > std::numeric_limits<size_t>::max()))
+        return Q_NULLPTR;
+
+    void* address = mmap(Q_NULLPTR, static_cast<size_t>(size), PROT_READ, MAP_SHARED, m_fd, static_cast<off_t>(offset));
+    return (address == MAP_FAILED) ? Q_NULLPTR : static_cast<uchar*>(address);
+#else
+    // Only plain files are opened through m_file
+    return (m_device == &m_file) ? m_file.map(offset, size) : Q_NULLPTR;
+#endif
+}
+
+void InputFile::unmap(uchar *address, qint64 size)
+{
+#ifdef Q_OS_UNIX
+    munmap(address, static_cast<size_t>(size));
+#else
+    Q_UNUSED(size)
+    m_file.unmap(address);
+#endif
+}
+
+void InputFile::close()
+{
+    if (m_device)
+        m_device->close();
+
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0)
+        ::close(m_fd);
+#endif
+
+    m_device = Q_NULLPTR;
+    m_fd = -1;
+    m_position = 0;
+}
+
+QString InputFile::errorString() const
+{
+    return m_device ? m_device->errorString() : m_errorString;
+}
+
+qint64 InputFile::takeAllocations()
+{
+    // Plain files are read straight into the buffers of the caller
+    StreamInput* stream = qobject_cast<StreamInput*>(m_device);
+    return stream ? stream->takeAllocations() : 0;
+}
+
+void InputFile::setSystemError(const QString &what)
+{
+    m_errorString = QStringLiteral("%1: %2").arg(what, QString::fromLocal8Bit(std::strerror(errno)));
+}
@@ -0,0 +1,91 @@
+#ifndef INPUTFILE_H
+#define INPUTFILE_H
+
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+
+// Input file read by the export pipeline.
+// Plain files are read with pread on their POSIX descriptor, from a position kept here, so seeking costs no
+// system call and the data does not go through the buffer of QFile. Compressed and piped files are read through
+// their device (StreamInput), forward only. Systems without POSIX calls read plain files through QFile.
+// Plain files can also be memory mapped, with mmap or QFile.
+
+class InputFile
+{
+public:
+    InputFile();
+    ~InputFile();
+
+    // Non copyable
+    InputFile(const InputFile&) = delete;
+
+    // Non copyable
+    InputFile& operator=(const InputFile&) = delete;
+
+    /**
+     * @brief Open a plain file.
+     */
+    bool open(const QString& fileName);
+
+    /**
+     * @brief Read from an open device instead of a plain file. The device is closed with the input file.
+     */
+    bool open(QIODevice* device);
+
+    bool isOpen() const;
+
+    /**
+     * @brief Read at the current position, all of the size unless the end of the file is reached.
+     * @return Number of bytes read, -1 on error.
+     */
+    qint64 read(char* data, qint64 size);
+
+    bool seek(qint64 position);
+
+    qint64 pos() const;
+
+    /**
+     * @brief Size of the file, -1 if it is not known.
+     */
+    qint64 size() const;
+
+    /**
+     * @brief Map part of a plain file in memory, read only.
+     * @return Start of the mapping, or Q_NULLPTR when the file can not be mapped (device, address space too small).
+     */
+    uchar* map(qint64 offset, qint64 size);
+
+    /**
+     * @brief Remove a mapping returned by map(), with the size it was created with.
+     */
+    void unmap(uchar* address, qint64 size);
+
+    /**
+     * @brief POSIX descriptor of a plain file, or -1 when the data is read through a device or QFile.
+     */
+    inline int handle() const
+    {
+        return m_fd;
+    }
+
+    void close();
+
+    QString errorString() const;
+
+    /**
+     * @brief Return the number of heap allocations done for the data since the last call, for statistics.
+     */
+    qint64 takeAllocations();
+
+protected:
+    void setSystemError(const QString& what);
+
+    QIODevice* m_device;
+    QFile m_file;
+    int m_fd;
+    qint64 m_position;
+    QString m_errorString;
+};
+
+#endif // INPUTFILE_H
@@ -0,0 +1,372 @@
+#include "blockdevice.h"
+#include "iouringengine.h"
+
+#include <QString>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+    #include <sys/uio.h>
+#endif
+
+// Limits for the number of buffers in flight
+constexpr int MIN_QUEUE_DEPTH = 1;
+constexpr int MAX_QUEUE_DEPTH = 128;
+
+#ifdef HAVE_LIBURING
+static inline void* encodeUserData(int index, bool isWrite)
+{
+    return reinterpret_cast<void*>((static_cast<uintptr_t>(index) << 1) | (isWrite ? 1 : 0));
+}
+#endif
+
+IoUringEngine::IoUringEngine() :
+    m_pool(Q_NULLPTR),
+    m_initialized(false),
+    m_fixedBuffers(false),
+    m_queueDepth(0),
+    m_slots(),
+    m_syscalls(0),
+    m_errorString()
+{ }
+
+IoUringEngine::~IoUringEngine()
+{
+    cleanup();
+}
+
+bool IoUringEngine::initialize(int queueDepth, BufferPool &pool)
+{
+    cleanup();
+
+#ifdef HAVE_LIBURING
+    m_pool = &pool;
+    m_queueDepth = qBound(MIN_QUEUE_DEPTH, qMin(queueDepth, pool.capacity()), MAX_QUEUE_DEPTH);
+
+    // Every buffer can have a read and a write queued at the same time
+    int result = io_uring_queue_init(static_cast<unsigned>(m_queueDepth * 2), &m_ring, 0);
+    ++m_syscalls;
+
+    if (result < 0)
+    {
+        setSystemError(QStringLiteral("io_uring_queue_init"), -result);
+        return false;
+    }
+
+    m_initialized = true;
+
+    QVector<struct iovec> iovecs;
+
+    for(int i = 0; i < pool.capacity(); ++i)
+    {
+        struct iovec iov;
+        iov.iov_base = pool.buffer(i);
+        iov.iov_len = static_cast<size_t>(pool.bufferSize());
+        iovecs.push_back(iov);
+
+        m_slots.push_back({ 0, 0, 0, 0 });
+    }
+
+    // Registration can fail when the locked memory limit is low, plain reads and writes are used then
+    m_fixedBuffers = (io_uring_register_buffers(&m_ring, iovecs.constData(), static_cast<unsigned>(iovecs.size())) == 0);
+    ++m_syscalls;
+
+    return true;
+#else
+    Q_UNUSED(queueDepth)
+    Q_UNUSED(pool)
+
+    m_errorString = QStringLiteral("io_uring support was not compiled in.");
+    return false;
+#endif
+}
+
+bool IoUringEngine::copy(int inFd, qint64 inOffset, int outFd, qint64 outOffset, qint64 length, int blockSize, const ProgressCallback &progress)
+{
+    return run(inFd, inOffset, outFd, outOffset, length, blockSize, blockSize, Q_NULLPTR, progress);
+}
+
+bool IoUringEngine::transform(int inFd, qint64 inOffset, int outFd, qint64 outOffset, qint64 length, int inBlockSize, int outBlockSize, const TransformCallback &transform, const ProgressCallback &progress)
+{
+    return run(inFd, inOffset, outFd, outOffset, length, inBlockSize, outBlockSize, &transform, progress);
+}
+
+void IoUringEngine::cleanup()
+{
+#ifdef HAVE_LIBURING
+    if (m_initialized)
+        io_uring_queue_exit(&m_ring);
+#endif
+
+    m_pool = Q_NULLPTR;
+    m_slots.clear();
+    m_initialized = false;
+    m_fixedBuffers = false;
+}
+
+qint64 IoUringEngine::takeSyscalls()
+{
+    qint64 count = m_syscalls;
+    m_syscalls = 0;
+    return count;
+}
+
+int IoUringEngine::autoQueueDepth(int fd)
+{
+    return deviceQueueDepth(BlockDevice::ofHandle(fd));
+}
+
+int IoUringEngine::deviceQueueDepth(quint64 device)
+{
+    // Spinning disks gain nothing from deep queues, flash devices need them to reach full speed
+    constexpr int ROTATIONAL_QUEUE_DEPTH = 4;
+    constexpr int SOLID_STATE_QUEUE_DEPTH = 32;
+    constexpr int DEFAULT_QUEUE_DEPTH = 16;
+
+    switch(BlockDevice::kind(device))
+    {
+    case BlockDevice::Kind::Rotational:
+        return ROTATIONAL_QUEUE_DEPTH;
+
+    case BlockDevice::Kind::SolidState:
+        return SOLID_STATE_QUEUE_DEPTH;
+
+    default:
+        return DEFAULT_QUEUE_DEPTH;
+    }
+}
+
+bool IoUringEngine::run(int inFd, qint64 inOffset, int outFd, qint64 outOffset, qint64 length, int inBlockSize, int outBlockSize, const TransformCallback* transform, const ProgressCallback &progress)
+{
+#ifdef HAVE_LIBURING
+    if (!m_initialized)
+        return false;
+
+    qint64 chunk = (m_pool->bufferSize() / inBlockSize) * inBlockSize;
+    qint64 next = 0;
+    qint64 done = 0;
+    int inFlight = 0;
+    bool failed = false;
+    bool cancelled = false;
+
+    // Take as many buffers as the queue depth allows, the pool bounds the memory in flight
+    QVector<int> ownedSlots;
+    ownedSlots.push_back(m_pool->acquire());
+
+    while(ownedSlots.size() < m_queueDepth)
+    {
+        int index = m_pool->tryAcquire();
+        if (index < 0)
+            break;
+
+        ownedSlots.push_back(index);
+    }
+
+    QVector<int> freeSlots = ownedSlots;
+
+    // Submission queue entries for the next requests. When the queue is full, the entries already
+    // prepared are submitted first, so a linked read and write always go in the same submission.
+    auto reserveEntries = [&](unsigned count) -> bool
+    {
+        while(io_uring_sq_space_left(&m_ring) < count)
+        {
+            int result = io_uring_submit(&m_ring);
+            ++m_syscalls;
+
+            if (result == -EINTR)
+                continue;
+
+            if (result <= 0)
+            {
+                if (!failed)
+                {
+                    if (result < 0)
+                        setSystemError(QStringLiteral("io_uring_submit"), -result);
+                    else
+                        m_errorString = QStringLiteral("The io_uring submission queue is full.");
+                }
+
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    auto prepareRead = [&](int index, qint64 size, qint64 offset) -> struct io_uring_sqe*
+    {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+
+        if (m_fixedBuffers)
+            io_uring_prep_read_fixed(sqe, inFd, m_pool->buffer(index), static_cast<unsigned>(size), static_cast<__u64>(offset), index);
+        else
+            io_uring_prep_read(sqe, inFd, m_pool->buffer(index), static_cast<unsigned>(size), static_cast<__u64>(offset));
+
+        io_uring_sqe_set_data(sqe, encodeUserData(index, false));
+        return sqe;
+    };
+
+    auto prepareWrite = [&](int index, qint64 size, qint64 offset)
+    {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+
+        if (m_fixedBuffers)
+            io_uring_prep_write_fixed(sqe, outFd, m_pool->buffer(index), static_cast<unsigned>(size), static_cast<__u64>(offset), index);
+        else
+            io_uring_prep_write(sqe, outFd, m_pool->buffer(index), static_cast<unsigned>(size), static_cast<__u64>(offset));
+
+        io_uring_sqe_set_data(sqe, encodeUserData(index, true));
+    };
+
+    while(((next < length) && !failed && !cancelled) || inFlight)
+    {
+        // Queue a read for every free buffer. When copying, the write is linked to the read
+        // and starts as soon as the read completes, without a round trip to user space.
+        while(!freeSlots.isEmpty() && (next < length) && !failed && !cancelled)
+        {
+            if (!reserveEntries(transform ? 1 : 2))
+            {
+                failed = true;
+                break;
+            }
+
+            int index = freeSlots.takeLast();
+            Slot& slot = m_slots[index];
+
+            slot.position = next;
+            slot.size = qMin(chunk, length - next);
+            slot.outputSize = slot.size;
+
+            struct io_uring_sqe* sqe = prepareRead(index, slot.size, inOffset + next);
+
+            if (!transform)
+            {
+                sqe->flags |= IOSQE_IO_LINK;
+                prepareWrite(index, slot.size, outOffset + next);
+                slot.pending = 2;
+            }
+            else
+                slot.pending = 1;
+
+            next += slot.size;
+            ++inFlight;
+        }
+
+        if (!inFlight)
+            break;
+
+        int result = io_uring_submit_and_wait(&m_ring, 1);
+        ++m_syscalls;
+
+        if (result < 0)
+        {
+            if (result == -EINTR)
+                continue;
+
+            // Completions can not be waited for anymore, give up on the ring
+            setSystemError(QStringLiteral("io_uring_submit"), -result);
+
+            for(int index : ownedSlots)
+                m_pool->release(index);
+
+            cleanup();
+            return false;
+        }
+
+        struct io_uring_cqe* cqe;
+        while(io_uring_peek_cqe(&m_ring, &cqe) == 0)
+        {
+            uintptr_t userData = reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe));
+            int index = static_cast<int>(userData >> 1);
+            bool isWrite = (userData & 1);
+            result = cqe->res;
+
+            io_uring_cqe_seen(&m_ring, cqe);
+
+            Slot& slot = m_slots[index];
+
+            if (!isWrite)
+            {
+                if (result != slot.size)
+                {
+                    if (!failed)
+                    {
+                        if (result < 0)
+                            setSystemError(QStringLiteral("read"), -result);
+                        else
+                            m_errorString = QStringLiteral("Unexpected end of input file.");
+                    }
+
+                    failed = true;
+                }
+                else if (transform && !failed && !cancelled)
+                {
+                    slot.outputSize = (*transform)(m_pool->buffer(index), slot.size, slot.position);
+
+                    if ((slot.outputSize < 0) || !reserveEntries(1))
+                        failed = true;
+                    else
+                    {
+                        // The buffer stays busy until the write completes
+                        prepareWrite(index, slot.outputSize, outOffset + (slot.position / inBlockSize) * outBlockSize);
+                        continue;
+                    }
+                }
+            }
+            else
+            {
+                // A write linked to a failed read is cancelled by the kernel, the read reported the error
+                if (result == -ECANCELED)
+                    failed = true;
+                else if (result < 0)
+                {
+                    if (!failed)
+                        setSystemError(QStringLiteral("write"), -result);
+
+                    failed = true;
+                }
+                else if (result != slot.outputSize)
+                {
+                    if (!failed)
+                        m_errorString = QStringLiteral("Short write on output file.");
+
+                    failed = true;
+                }
+                else
+                    done += slot.size;
+            }
+
+            if (--slot.pending == 0)
+            {
+                freeSlots.push_back(index);
+                --inFlight;
+            }
+        }
+
+        // Transform writes queued above are submitted with the next batch of reads
+        if (!failed && !cancelled && progress && !progress(done))
+            cancelled = true;
+    }
+
+    for(int index : ownedSlots)
+        m_pool->release(index);
+
+    return !failed && !cancelled;
+#else
+    Q_UNUSED(inFd)
+    Q_UNUSED(inOffset)
+    Q_UNUSED(outFd)
+    Q_UNUSED(outOffset)
+    Q_UNUSED(length)
+    Q_UNUSED(inBlockSize)
+    Q_UNUSED(outBlockSize)
+    Q_UNUSED(transform)
+    Q_UNUSED(progress)
+    return false;
+#endif
+}
+
+void IoUringEngine::setSystemError(const QString &what, int error)
+{
+    m_errorString = QStringLiteral("%1: %2").arg(what, QString::fromLocal8Bit(std::strerror(error)));
+}
@@ -0,0 +1,115 @@
+#ifndef IOURINGENGINE_H
+#define IOURINGENGINE_H
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <functional>
+
+#ifdef HAVE_LIBURING
+    #include <liburing.h>
+#endif
+
+#include "bufferpool.h"
+
+// Asynchronous copy engine built on Linux io_uring.
+// Keeps many reads and writes in flight over the buffers of a BufferPool, registered with the kernel.
+// When the library is not available at build time, or the kernel refuses to create a ring,
+// initialize() fails and the caller is expected to use the synchronous path instead.
+
+class IoUringEngine
+{
+public:
+    /// Callback reporting the number of input bytes done, returns false to cancel the operation
+    typedef std::function<bool(qint64)> ProgressCallback;
+
+    /// Callback transforming a buffer in place, returns the size of the data to write or -1 on error
+    typedef std::function<qint64(char*, qint64, qint64)> TransformCallback;
+
+    IoUringEngine();
+    ~IoUringEngine();
+
+    // Non copyable
+    IoUringEngine(const IoUringEngine&) = delete;
+
+    // Non copyable
+    IoUringEngine& operator=(const IoUringEngine&) = delete;
+
+    /**
+     * @brief Create the ring and register the buffers of the pool.
+     * @param queueDepth Number of buffers in flight, limited by the capacity of the pool.
+     * @param pool Pool providing the buffers, must outlive the engine or the next cleanup().
+     */
+    bool initialize(int queueDepth, BufferPool& pool);
+
+    inline bool isInitialized() const
+    {
+        return m_initialized;
+    }
+
+    inline int queueDepth() const
+    {
+        return m_queueDepth;
+    }
+
+    /**
+     * @brief Copy a range of bytes using linked read and write operations.
+     * @param blockSize Every buffer holds a whole number of blocks of this size.
+     */
+    bool copy(int inFd, qint64 inOffset, int outFd, qint64 outOffset, qint64 length, int blockSize, const ProgressCallback& progress);
+
+    /**
+     * @brief Read a range of blocks, transform every buffer in place when it arrives, then write the result.
+     * @param inBlockSize Size of an input block. Output offsets are computed with outBlockSize.
+     */
+    bool transform(int inFd, qint64 inOffset, int outFd, qint64 outOffset, qint64 length, int inBlockSize, int outBlockSize, const TransformCallback& transform, const ProgressCallback& progress);
+
+    void cleanup();
+
+    qint64 takeSyscalls();
+
+    inline QString errorString() const
+    {
+        return m_errorString;
+    }
+
+    static int autoQueueDepth(int fd);
+
+    /**
+     * @brief Default queue depth for a device, see BlockDevice.
+     */
+    static int deviceQueueDepth(quint64 device);
+
+protected:
+    struct Slot
+    {
+        /// Offset of the buffer data relative to the start of the operation (in input bytes)
+        qint64 position;
+
+        /// Number of bytes read in the buffer
+        qint64 size;
+
+        /// Number of bytes to write from the buffer
+        qint64 outputSize;
+
+        /// Number of operations still pending on the buffer
+        int pending;
+    };
+
+    bool run(int inFd, qint64 inOffset, int outFd, qint64 outOffset, qint64 length, int inBlockSize, int outBlockSize, const TransformCallback* transform, const ProgressCallback& progress);
+
+    void setSystemError(const QString& what, int error);
+
+#ifdef HAVE_LIBURING
+    struct io_uring m_ring;
+#endif
+    BufferPool* m_pool;
+    bool m_initialized;
+    bool m_fixedBuffers;
+    int m_queueDepth;
+    QVector<Slot> m_slots;
+    qint64 m_syscalls;
+    QString m_errorString;
+};
+
+#endif // IOURINGENGINE_H
@@ -0,0 +1,596 @@
+#include "cdromtoc.h"
+#include "endian.h"
+#include "isofilesystem.h"
+#include "isostruct.h"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFileInfo>
+#include <QQueue>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+constexpr int ISO_SECTOR_SIZE = 2048;
+constexpr int RAW_SECTOR_SIZE = 2352;
+
+// Sync pattern and header in front of the user data of raw MODE1 sectors
+constexpr int RAW_HEADER_SIZE = 16;
+
+// The volume descriptors start after the system area
+constexpr uint32_t VOLUME_DESCRIPTOR_SECTOR = 16;
+
+// Volume descriptors looked at before giving up on finding the primary one
+constexpr uint32_t MAX_VOLUME_DESCRIPTORS = 32;
+
+// Sectors read at a time when extracting a file
+constexpr uint32_t EXTRACT_SECTORS = 256;
+
+// Magic and version of the index sidecar
+constexpr uint32_t INDEX_MAGIC = 0x5849434e;
+constexpr uint16_t INDEX_VERSION = 1;
+
+#ifdef _MSC_VER
+    #pragma pack(push,1)
+#endif
+
+struct PACKED IsoIndexHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t volumeChecksum;
+    uint32_t trackSectors;
+    uint32_t entryCount;
+    uint32_t namesSize;
+};
+
+static_assert(sizeof(IsoIndexHeader) == 20, "Struct ISO Index Header should be exactly 20 bytes!");
+
+struct PACKED IsoIndexEntry
+{
+    uint32_t sector;
+    uint32_t size;
+    uint32_t nameOffset;
+    uint16_t nameLength;
+    uint16_t flags;
+};
+
+static_assert(sizeof(IsoIndexEntry) == 16, "Struct ISO Index Entry should be exactly 16 bytes!");
+
+#ifdef _MSC_VER
+    #pragma pack(pop)
+#endif
+
+class IsoExtractJob : public QRunnable
+{
+public:
+    IsoExtractJob(const IsoFilesystem& filesystem, const IsoFilesystem::Entry& entry, const QString& outputDirectory, QAtomicInt& failures) :
+        m_filesystem(filesystem),
+        m_entry(entry),
+        m_outputDirectory(outputDirectory),
+        m_failures(failures)
+    { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!m_filesystem.extractFile(m_entry, m_outputDirectory))
+            m_failures.ref();
+    }
+
+protected:
+    const IsoFilesystem& m_filesystem;
+    const IsoFilesystem::Entry& m_entry;
+    QString m_outputDirectory;
+    QAtomicInt& m_failures;
+};
+
+IsoFilesystem::IsoFilesystem() :
+    m_fileName(),
+    m_trackOffset(0),
+    m_sectorSize(ISO_SECTOR_SIZE),
+    m_trackSectors(0),
+    m_rootSector(0),
+    m_rootSize(0),
+    m_volumeChecksum(0),
+    m_entries()
+{ }
+
+bool IsoFilesystem::open(const QString &fileName)
+{
+    m_entries.clear();
+
+    if (CdromToc::isImageDescriptor(fileName))
+    {
+        CdromToc toc;
+        if (!toc.loadImage(fileName))
+            return false;
+
+        const CdromToc::Entry* first = Q_NULLPTR;
+        m_trackSectors = 0;
+
+        // The volume starts at index 1 of the first data track
+        for(const CdromToc::Entry& entry : toc.toc())
+        {
+            bool isData = (entry.trackType == CdromToc::TrackType::Mode1_2048) || (entry.trackType == CdromToc::TrackType::Mode1_2352);
+
+            if (!first && isData && (entry.fileIndex != -1) && (entry.trackIndex.index() >= 1))
+                first = &entry;
+
+            if (first && (entry.trackIndex.track() == first->trackIndex.track()) && (entry.fileIndex != -1) && (entry.trackIndex.index() >= 1))
+                m_trackSectors += entry.trackLength;
+        }
+
+        if (!first)
+        {
+            qCritical().noquote() << "Image " << fileName << " has no data track.";
+            return false;
+        }
+
+        // Files are read at the offsets of the directory records
+        if (toc.fileList().at(first->fileIndex).source != CdromToc::FileSource::Plain)
+        {
+            qCritical().noquote() << "Files can only be listed from uncompressed images.";
+            return false;
+        }
+
+        m_fileName = toc.fileList().at(first->fileIndex).fileName;
+        m_trackOffset = first->fileOffset;
+        m_sectorSize = (first->trackType == CdromToc::TrackType::Mode1_2048) ? ISO_SECTOR_SIZE : RAW_SECTOR_SIZE + static_cast<int>(first->subchannelSize);
+
+        return readVolumeDescriptor();
+    }
+
+    // Other files are whole tracks, the sector size is the one holding a volume descriptor where expected
+    m_fileName = fileName;
+    m_trackOffset = 0;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open input file: " << fileName << endl << file.errorString() << endl;
+        return false;
+    }
+
+    for(int sectorSize : { ISO_SECTOR_SIZE, RAW_SECTOR_SIZE })
+    {
+        char identifier[5];
+        qint64 offset = VOLUME_DESCRIPTOR_SECTOR * sectorSize + ((sectorSize == RAW_SECTOR_SIZE) ? RAW_HEADER_SIZE : 0) + 1;
+
+        if (file.seek(offset) && (file.read(identifier, sizeof(identifier)) == sizeof(identifier)) && !std::memcmp(identifier, "CD001", sizeof(identifier)))
+        {
+            m_sectorSize = sectorSize;
+            m_trackSectors = static_cast<uint32_t>(file.size() / sectorSize);
+            return readVolumeDescriptor();
+        }
+    }
+
+    qCritical().noquote() << "File " << fileName << " does not hold an ISO9660 volume.";
+    return false;
+}
+
+bool IsoFilesystem::buildIndex()
+{
+    struct Directory
+    {
+        uint32_t sector;
+        uint32_t size;
+        QString path;
+    };
+
+    m_entries.clear();
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open input file: " << m_fileName << endl << file.errorString() << endl;
+        return false;
+    }
+
+    QQueue<Directory> pending;
+    pending.enqueue(Directory{ m_rootSector, m_rootSize, QString() });
+
+    // Damaged volumes can have directories pointing back to their parents
+    QSet<uint32_t> visited;
+    QByteArray extent;
+
+    while(!pending.isEmpty())
+    {
+        Directory directory = pending.dequeue();
+
+        if (visited.contains(directory.sector))
+            continue;
+
+        visited.insert(directory.sector);
+
+        uint32_t count = (directory.size + ISO_SECTOR_SIZE - 1) / ISO_SECTOR_SIZE;
+        extent.resize(static_cast<int>(count * ISO_SECTOR_SIZE));
+
+        if (!readSectors(file, directory.sector, count, extent.data()))
+            return false;
+
+        int position = 0;
+        int end = static_cast<int>(directory.size);
+
+        while(position < end)
+        {
+            uint8_t length = static_cast<uint8_t>(extent.at(position));
+
+            // Records never cross sectors, the end of a sector is padded with zeros
+            if (!length)
+            {
+                position = (position / ISO_SECTOR_SIZE + 1) * ISO_SECTOR_SIZE;
+                continue;
+            }
+
+            IsoDirectoryRecord record;
+            if ((length < sizeof(record)) || (position + length > end))
+            {
+                qCritical().noquote() << "Invalid directory record in " << (directory.path.isEmpty() ? QStringLiteral("/") : directory.path) << ".";
+                return false;
+            }
+
+            std::memcpy(&record, extent.constData() + position, sizeof(record));
+
+            if (sizeof(record) + record.fileIdentifierLength > length)
+            {
+                qCritical().noquote() << "Invalid directory record in " << (directory.path.isEmpty() ? QStringLiteral("/") : directory.path) << ".";
+                return false;
+            }
+
+            const char* identifier = extent.constData() + position + sizeof(record);
+            position += length;
+
+            // The directory itself and its parent have the single byte names 0 and 1
+            if ((record.fileIdentifierLength == 1) && ((identifier[0] == 0) || (identifier[0] == 1)))
+                continue;
+
+            QString name = QString::fromLatin1(identifier, record.fileIdentifierLength);
+
+            int version = name.indexOf(QChar(';'));
+            if (version >= 0)
+                name.truncate(version);
+
+            // Files without extension keep the separator
+            if (name.endsWith(QChar('.')))
+                name.chop(1);
+
+            // Names are joined into paths under the output directory, they can not hold a separator nor go up
+            if (!isSafeName(name))
+            {
+                qCritical().noquote() << "Invalid file name in " << (directory.path.isEmpty() ? QStringLiteral("/") : directory.path) << ".";
+                return false;
+            }
+
+            Entry entry;
+            entry.path = directory.path.isEmpty() ? name : directory.path + QChar('/') + name;
+            entry.sector = LITTLE_ENDIAN_DWORD(record.extentLocation) + record.extendedAttributeLength;
+            entry.size = LITTLE_ENDIAN_DWORD(record.dataLength);
+            entry.isDirectory = (record.fileFlags & 0x02) != 0;
+
+            m_entries.append(entry);
+
+            if (entry.isDirectory)
+                pending.enqueue(Directory{ entry.sector, entry.size, entry.path });
+        }
+    }
+
+    return true;
+}
+
+bool IsoFilesystem::loadIndex(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray data = file.readAll();
+
+    IsoIndexHeader header;
+    if (data.size() < static_cast<int>(sizeof(header)))
+        return false;
+
+    std::memcpy(&header, data.constData(), sizeof(header));
+
+    if ((LITTLE_ENDIAN_DWORD(header.magic) != INDEX_MAGIC) || (LITTLE_ENDIAN_WORD(header.version) != INDEX_VERSION))
+        return false;
+
+    // An index written for another volume, or an older version of it, is not used
+    if ((LITTLE_ENDIAN_WORD(header.volumeChecksum) != m_volumeChecksum) || (LITTLE_ENDIAN_DWORD(header.trackSectors) != m_trackSectors))
+        return false;
+
+    qint64 entryCount = LITTLE_ENDIAN_DWORD(header.entryCount);
+    qint64 namesSize = LITTLE_ENDIAN_DWORD(header.namesSize);
+    qint64 namesOffset = static_cast<qint64>(sizeof(header)) + entryCount * static_cast<qint64>(sizeof(IsoIndexEntry));
+
+    if (namesOffset + namesSize != data.size())
+        return false;
+
+    QVector<Entry> entries;
+    entries.reserve(static_cast<int>(entryCount));
+
+    for(qint64 i = 0; i < entryCount; ++i)
+    {
+        IsoIndexEntry indexEntry;
+        std::memcpy(&indexEntry, data.constData() + sizeof(header) + i * sizeof(indexEntry), sizeof(indexEntry));
+
+        qint64 nameOffset = LITTLE_ENDIAN_DWORD(indexEntry.nameOffset);
+        qint64 nameLength = LITTLE_ENDIAN_WORD(indexEntry.nameLength);
+
+        if (nameOffset + nameLength > namesSize)
+            return false;
+
+        Entry entry;
+        entry.path = QString::fromUtf8(data.constData() + namesOffset + nameOffset, static_cast<int>(nameLength));
+
+        // Paths are checked as the directory records are, the sidecar may not come from this program
+        if (!isSafePath(entry.path))
+            return false;
+        entry.sector = LITTLE_ENDIAN_DWORD(indexEntry.sector);
+        entry.size = LITTLE_ENDIAN_DWORD(indexEntry.size);
+        entry.isDirectory = (LITTLE_ENDIAN_WORD(indexEntry.flags) & 0x01) != 0;
+        entries.append(entry);
+    }
+
+    m_entries.swap(entries);
+
+    return true;
+}
+
+bool IsoFilesystem::saveIndex(const QString &fileName) const
+{
+    QByteArray entries;
+    QByteArray names;
+
+    for(const Entry& entry : m_entries)
+    {
+        QByteArray name = entry.path.toUtf8();
+
+        IsoIndexEntry indexEntry;
+        indexEntry.sector = LITTLE_ENDIAN_DWORD(entry.sector);
+        indexEntry.size = LITTLE_ENDIAN_DWORD(entry.size);
+        indexEntry.nameOffset = LITTLE_ENDIAN_DWORD(static_cast<uint32_t>(names.size()));
+        indexEntry.nameLength = LITTLE_ENDIAN_WORD(static_cast<uint16_t>(name.size()));
+        indexEntry.flags = LITTLE_ENDIAN_WORD(static_cast<uint16_t>(entry.isDirectory ? 0x01 : 0x00));
+
+        entries.append(reinterpret_cast<const char*>(&indexEntry), sizeof(indexEntry));
+        names.append(name);
+    }
+
+    IsoIndexHeader header;
+    header.magic = LITTLE_ENDIAN_DWORD(INDEX_MAGIC);
+    header.version = LITTLE_ENDIAN_WORD(INDEX_VERSION);
+    header.volumeChecksum = LITTLE_ENDIAN_WORD(m_volumeChecksum);
+    header.trackSectors = LITTLE_ENDIAN_DWORD(m_trackSectors);
+    header.entryCount = LITTLE_ENDIAN_DWORD(static_cast<uint32_t>(m_entries.size()));
+    header.namesSize = LITTLE_ENDIAN_DWORD(static_cast<uint32_t>(names.size()));
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning().noquote() << "Could not write ISO index: " << file.errorString();
+        return false;
+    }
+
+    return (file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header))
+            && (file.write(entries) == entries.size())
+            && (file.write(names) == names.size());
+}
+
+QVector<int> IsoFilesystem::findFiles(const QStringList &patterns) const
+{
+    QVector<int> files;
+
+    for(int i = 0; i < m_entries.size(); ++i)
+    {
+        const Entry& entry = m_entries.at(i);
+
+        if (entry.isDirectory)
+            continue;
+
+        // Patterns without a directory match the file name anywhere in the tree
+        bool matches = patterns.isEmpty();
+
+        for(const QString& pattern : patterns)
+        {
+            const QString& name = pattern.contains(QChar('/')) ? entry.path : entry.path.section(QChar('/'), -1);
+
+            if (QDir::match(pattern, name))
+            {
+                matches = true;
+                break;
+            }
+        }
+
+        if (matches)
+            files.append(i);
+    }
+
+    return files;
+}
+
+bool IsoFilesystem::extract(const QVector<int> &files, const QString &outputDirectory, int threadCount) const
+{
+    QThreadPool threadPool;
+    QAtomicInt failures(0);
+
+    if (threadCount > 0)
+        threadPool.setMaxThreadCount(threadCount);
+
+    // Largest files first, so a big file started last does not run alone at the end
+    QVector<int> order = files;
+    std::sort(order.begin(), order.end(), [this](int a, int b) -> bool
+    {
+        return m_entries.at(a).size > m_entries.at(b).size;
+    });
+
+    for(int index : order)
+        threadPool.start(new IsoExtractJob(*this, m_entries.at(index), outputDirectory, failures));
+
+    threadPool.waitForDone();
+
+    return (failures.load() == 0);
+}
+
+bool IsoFilesystem::readSectors(QFile &file, uint32_t sector, uint32_t count, char *data) const
+{
+    if ((sector > m_trackSectors) || (count > m_trackSectors - sector))
+    {
+        qCritical().noquote() << "Sectors " << sector << " to " << sector + count << " are past the end of the data track.";
+        return false;
+    }
+
+    qint64 offset = m_trackOffset + static_cast<qint64>(sector) * m_sectorSize;
+
+    if (!file.seek(offset))
+        return false;
+
+    if (m_sectorSize == ISO_SECTOR_SIZE)
+    {
+        qint64 size = static_cast<qint64>(count) * ISO_SECTOR_SIZE;
+        if (file.read(data, size) != size)
+        {
+            qCritical().noquote() << "Read error on input file: " << file.errorString();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Raw sectors are read in one go with their subchannel if any, then reduced to their user data
+    QByteArray raw(static_cast<int>(count) * m_sectorSize, Qt::Uninitialized);
+    if (file.read(raw.data(), raw.size()) != raw.size())
+    {
+        qCritical().noquote() << "Read error on input file: " << file.errorString();
+        return false;
+    }
+
+    for(uint32_t i = 0; i < count; ++i)
+        std::memcpy(data + i * ISO_SECTOR_SIZE, raw.constData() + i * m_sectorSize + RAW_HEADER_SIZE, ISO_SECTOR_SIZE);
+
+    return true;
+}
+
+bool IsoFilesystem::readVolumeDescriptor()
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open input file: " << m_fileName << endl << file.errorString() << endl;
+        return false;
+    }
+
+    QByteArray sector(ISO_SECTOR_SIZE, Qt::Uninitialized);
+
+    for(uint32_t i = 0; i < MAX_VOLUME_DESCRIPTORS; ++i)
+    {
+        if (!readSectors(file, VOLUME_DESCRIPTOR_SECTOR + i, 1, sector.data()))
+            return false;
+
+        IsoPrimaryVolumeDescriptor descriptor;
+        std::memcpy(&descriptor, sector.constData(), sizeof(descriptor));
+
+        if (std::memcmp(descriptor.identifier, "CD001", sizeof(descriptor.identifier)))
+            break;
+
+        // Set terminator
+        if (descriptor.type == 255)
+            break;
+
+        if (descriptor.type != 1)
+            continue;
+
+        if (LITTLE_ENDIAN_WORD(descriptor.logicalBlockSize) != ISO_SECTOR_SIZE)
+        {
+            qCritical().noquote() << "ISO9660 volumes with " << LITTLE_ENDIAN_WORD(descriptor.logicalBlockSize) << " byte blocks are not supported.";
+            return false;
+        }
+
+        m_rootSector = LITTLE_ENDIAN_DWORD(descriptor.rootDirectoryRecord.extentLocation);
+        m_rootSize = LITTLE_ENDIAN_DWORD(descriptor.rootDirectoryRecord.dataLength);
+        m_volumeChecksum = qChecksum(sector.constData(), static_cast<uint>(sector.size()));
+
+        return true;
+    }
+
+    qCritical().noquote() << "No ISO9660 primary volume descriptor found in " << m_fileName << ".";
+    return false;
+}
+
+bool IsoFilesystem::extractFile(const Entry &entry, const QString &outputDirectory) const
+{
+    // Paths leaving the output directory are refused
+    if (!isSafePath(entry.path))
+    {
+        qCritical().noquote() << "Invalid file name: " << entry.path;
+        return false;
+    }
+
+    QString outputPath = QDir(outputDirectory).filePath(entry.path);
+
+    if (!QDir().mkpath(QFileInfo(outputPath).path()))
+    {
+        qCritical().noquote() << "Could not create directory: " << QFileInfo(outputPath).path();
+        return false;
+    }
+
+    QFile in(m_fileName);
+    if (!in.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open input file: " << m_fileName << endl << in.errorString() << endl;
+        return false;
+    }
+
+    QFile out(outputPath);
+    if (!out.open(QIODevice::WriteOnly))
+    {
+        qCritical().noquote() << "Could not create file: " << entry.path << endl << out.errorString() << endl;
+        return false;
+    }
+
+    QByteArray buffer(static_cast<int>(EXTRACT_SECTORS * ISO_SECTOR_SIZE), Qt::Uninitialized);
+    uint32_t sector = entry.sector;
+    qint64 remaining = entry.size;
+
+    while(remaining > 0)
+    {
+        uint32_t count = static_cast<uint32_t>(qMin(remaining, qint64(EXTRACT_SECTORS * ISO_SECTOR_SIZE)) + ISO_SECTOR_SIZE - 1) / ISO_SECTOR_SIZE;
+
+        if (!readSectors(in, sector, count, buffer.data()))
+            return false;
+
+        qint64 size = qMin(remaining, static_cast<qint64>(count) * ISO_SECTOR_SIZE);
+        if (out.write(buffer.constData(), size) != size)
+        {
+            qCritical().noquote() << "Write error on output file: " << out.errorString();
+            return false;
+        }
+
+        sector += count;
+        remaining -= size;
+    }
+
+    return true;
+}
+
+bool IsoFilesystem::isSafeName(const QString &name)
+{
+    if (name.isEmpty() || (name == QStringLiteral(".")) || (name == QStringLiteral("..")))
+        return false;
+
+    // Backslashes and drive letters also lead out of the directory on Windows
+    return !name.contains(QChar('/')) && !name.contains(QChar('\\')) && !name.contains(QChar(0)) && !name.contains(QChar(':'));
+}
+
+bool IsoFilesystem::isSafePath(const QString &path)
+{
+    for(const QString& name : path.split(QChar('/')))
+    {
+        if (!isSafeName(name))
+            return false;
+    }
+
+    return true;
+}
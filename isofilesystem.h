@@ -0,0 +1,93 @@
+#ifndef ISOFILESYSTEM_H
+#define ISOFILESYSTEM_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <cstdint>
+
+// Reads the ISO9660 filesystem of a data track, straight from the disc image: the first data track of a CUE
+// sheet (2048 or 2352 bytes per sector) or an ISO file. The directory tree is walked once into a flat index
+// of every file and directory, which can be saved to a compact binary sidecar and loaded back instead.
+// Files are extracted in parallel, each one with its own handle and a few large reads of its sector range.
+
+class IsoFilesystem
+{
+public:
+    struct Entry
+    {
+        /// Path from the root, directories separated by /, without the version number
+        QString path;
+
+        /// First sector of the data, from the start of the track
+        uint32_t sector;
+
+        /// Size of the data (in bytes)
+        uint32_t size;
+
+        /// Set for directories
+        bool isDirectory;
+    };
+
+    explicit IsoFilesystem();
+
+    /**
+     * @brief Open the data track of a disc image.
+     * @param fileName CUE sheet, ISO file or raw track.
+     */
+    bool open(const QString& fileName);
+
+    /**
+     * @brief Walk the directory tree to build the index.
+     */
+    bool buildIndex();
+
+    /**
+     * @brief Load the index from a sidecar file.
+     * @return false if the file is missing, invalid or was written for another volume.
+     */
+    bool loadIndex(const QString& fileName);
+
+    bool saveIndex(const QString& fileName) const;
+
+    inline const QVector<IsoFilesystem::Entry>& entries() const
+    {
+        return m_entries;
+    }
+
+    /**
+     * @brief Find the files matching any of the wildcard patterns (case insensitive), or every file without pattern.
+     * @return Indexes in entries().
+     */
+    QVector<int> findFiles(const QStringList& patterns) const;
+
+    /**
+     * @brief Extract files in parallel.
+     * @param files Indexes in entries().
+     * @param outputDirectory Receives the files, in the same tree of directories as the volume.
+     * @param threadCount Number of files extracted at the same time, 0 for one per CPU core.
+     * @return True if all files were extracted.
+     */
+    bool extract(const QVector<int>& files, const QString& outputDirectory, int threadCount) const;
+
+protected:
+    friend class IsoExtractJob;
+
+    bool readSectors(QFile& file, uint32_t sector, uint32_t count, char* data) const;
+    bool readVolumeDescriptor();
+    bool extractFile(const Entry& entry, const QString& outputDirectory) const;
+    static bool isSafeName(const QString& name);
+    static bool isSafePath(const QString& path);
+
+    QString m_fileName;
+    qint64 m_trackOffset;
+    int m_sectorSize;
+    uint32_t m_trackSectors;
+    uint32_t m_rootSector;
+    uint32_t m_rootSize;
+    quint16 m_volumeChecksum;
+    QVector<IsoFilesystem::Entry> m_entries;
+};
+
+#endif // ISOFILESYSTEM_H
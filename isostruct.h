@@ -0,0 +1,67 @@
+#ifndef ISOSTRUCT_H
+#define ISOSTRUCT_H
+
+#include <cstdint>
+
+#include "packedstruct.h"
+
+#ifdef _MSC_VER
+    #pragma pack(push,1)
+#endif
+
+// Numbers are stored twice in ISO9660 structures, little endian then big endian
+
+struct PACKED IsoDirectoryRecord
+{
+    uint8_t recordLength;
+    uint8_t extendedAttributeLength;
+    uint32_t extentLocation;
+    uint32_t extentLocationBigEndian;
+    uint32_t dataLength;
+    uint32_t dataLengthBigEndian;
+    uint8_t recordingDate[7];
+    uint8_t fileFlags;
+    uint8_t fileUnitSize;
+    uint8_t interleaveGapSize;
+    uint16_t volumeSequenceNumber;
+    uint16_t volumeSequenceNumberBigEndian;
+    uint8_t fileIdentifierLength;
+};
+
+static_assert(sizeof(IsoDirectoryRecord) == 33, "Struct ISO Directory Record should be exactly 33 bytes!");
+
+struct PACKED IsoPrimaryVolumeDescriptor
+{
+    uint8_t type;
+    char identifier[5];
+    uint8_t version;
+    uint8_t unused1;
+    char systemIdentifier[32];
+    char volumeIdentifier[32];
+    uint8_t unused2[8];
+    uint32_t volumeSpaceSize;
+    uint32_t volumeSpaceSizeBigEndian;
+    uint8_t unused3[32];
+    uint16_t volumeSetSize;
+    uint16_t volumeSetSizeBigEndian;
+    uint16_t volumeSequenceNumber;
+    uint16_t volumeSequenceNumberBigEndian;
+    uint16_t logicalBlockSize;
+    uint16_t logicalBlockSizeBigEndian;
+    uint32_t pathTableSize;
+    uint32_t pathTableSizeBigEndian;
+    uint32_t typeLPathTable;
+    uint32_t optionalTypeLPathTable;
+    uint32_t typeMPathTable;
+    uint32_t optionalTypeMPathTable;
+    IsoDirectoryRecord rootDirectoryRecord;
+    uint8_t rootDirectoryIdentifier;
+};
+
+static_assert(sizeof(IsoPrimaryVolumeDescriptor) == 190, "Struct ISO Primary Volume Descriptor should be exactly 190 bytes!");
+
+#ifdef _MSC_VER
+    #pragma pack(pop)
+#endif
+
+#endif // ISOSTRUCT_H
@@ -1,9 +1,34 @@
 #include <QDateTime>
+#include <QMutexLocker>
+#include <QThread>
+#include <cstdio>
+#include <cstring>
 
 #include "logger.h"
 
-Q_DECLARE_METATYPE(QtMsgType)
-Q_DECLARE_METATYPE(LoggerMessage)
+// Most messages waiting for the log view, older ones are dropped first
+constexpr int MAX_COLLECTED_MESSAGES = 10000;
+
+class LoggerThread : public QThread
+{
+public:
+    explicit LoggerThread(Logger& logger) :
+        QThread(),
+        m_logger(logger)
+    { }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        while(m_logger.waitForMessages())
+            m_logger.dispatch();
+
+        // Messages posted while stopping still reach the outputs
+        m_logger.dispatch();
+    }
+
+    Logger& m_logger;
+};
 
 Q_GLOBAL_STATIC(Logger, g_logger)
 
@@ -14,17 +39,255 @@ Logger* logger()
 
 static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-    logger()->newMessage(LoggerMessage(type, context, msg));
+    logger()->post(type, context, msg);
+
+    // The application aborts right after a fatal message, before the dispatch thread can run
+    if (type == QtFatalMsg)
+        std::fprintf(stderr, "%s\n", msg.toLocal8Bit().constData());
 }
 
 Logger::Logger(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    m_slots(new Slot[RING_SIZE]),
+    m_enqueuePosition(0),
+    m_dequeuePosition(0),
+    m_dropped(0),
+    m_sleeping(0),
+    m_wakeMutex(),
+    m_wakeUp(),
+    m_stopping(false),
+    m_mutex(),
+    m_logFile(),
+    m_consoleOutput(false),
+    m_collectMessages(false),
+    m_collected(),
+    m_thread(Q_NULLPTR)
 {
-    qRegisterMetaType<QtMsgType>();
-    qRegisterMetaType<LoggerMessage>();
+    for(quint32 i = 0; i < RING_SIZE; ++i)
+        m_slots[i].sequence.store(i);
+
+    m_thread = new LoggerThread(*this);
+    m_thread->start();
 
     qInstallMessageHandler(messageHandler);
 }
 
 Logger::~Logger()
-{ }
+{
+    qInstallMessageHandler(Q_NULLPTR);
+
+    {
+        QMutexLocker locker(&m_wakeMutex);
+        m_stopping = true;
+        m_wakeUp.wakeOne();
+    }
+
+    m_thread->wait();
+    delete m_thread;
+
+    // The last messages were flushed by the final drain
+    m_logFile.close();
+
+    delete[] m_slots;
+}
+
+void Logger::post(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    quint32 position = m_enqueuePosition.load();
+    Slot* slot;
+
+    // Claim the next free slot, competing with the other threads posting at the same time
+    for(;;)
+    {
+        slot = &m_slots[position & (RING_SIZE - 1)];
+        qint32 difference = static_cast<qint32>(slot->sequence.loadAcquire() - position);
+
+        if (difference == 0)
+        {
+            if (m_enqueuePosition.testAndSetOrdered(position, position + 1))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // The slot still holds a message from the previous round, the ring is full
+            m_dropped.fetchAndAddRelaxed(1);
+            return;
+        }
+
+        position = m_enqueuePosition.load();
+    }
+
+    slot->type = type;
+    slot->timestamp = QDateTime::currentMSecsSinceEpoch();
+    slot->file = context.file;
+    slot->function = context.function;
+    slot->category = context.category;
+    slot->line = context.line;
+    slot->length = qMin(message.size(), MESSAGE_SIZE);
+    std::memcpy(slot->text, message.utf16(), static_cast<size_t>(slot->length) * sizeof(ushort));
+
+    // Hand the slot over to the dispatch thread
+    slot->sequence.storeRelease(position + 1);
+
+    // Only the first message after the thread went to sleep wakes it up
+    if (m_sleeping.testAndSetOrdered(1, 0))
+    {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeUp.wakeOne();
+    }
+}
+
+bool Logger::setLogFile(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_logFile.isOpen())
+        m_logFile.close();
+
+    if (fileName.isEmpty())
+        return true;
+
+    m_logFile.setFileName(fileName);
+    return m_logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+}
+
+void Logger::setConsoleOutput(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_consoleOutput = enabled;
+}
+
+void Logger::setCollectMessages(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_collectMessages = enabled;
+}
+
+QVector<LoggerMessage> Logger::takeMessages()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QVector<LoggerMessage> messages;
+    messages.swap(m_collected);
+
+    return messages;
+}
+
+void Logger::dispatch()
+{
+    QMutexLocker locker(&m_mutex);
+
+    bool wasEmpty = m_collected.isEmpty();
+    bool written = false;
+
+    for(;;)
+    {
+        Slot& slot = m_slots[m_dequeuePosition & (RING_SIZE - 1)];
+
+        if (slot.sequence.loadAcquire() != m_dequeuePosition + 1)
+            break;
+
+        LoggerMessage message;
+        message.timestamp = QDateTime::fromMSecsSinceEpoch(slot.timestamp);
+        message.type = slot.type;
+        message.message = QString::fromUtf16(slot.text, slot.length);
+        message.file = slot.file ? QString::fromLatin1(slot.file) : QString();
+        message.function = slot.function ? QString::fromLatin1(slot.function) : QString();
+        message.category = slot.category ? QString::fromLatin1(slot.category) : QString();
+        message.line = slot.line;
+
+        // The slot is free again for the next round of the ring
+        slot.sequence.storeRelease(m_dequeuePosition + RING_SIZE);
+        ++m_dequeuePosition;
+
+        writeMessage(message);
+        written = true;
+    }
+
+    quint32 dropped = m_dropped.fetchAndStoreRelaxed(0);
+    if (dropped)
+    {
+        LoggerMessage message;
+        message.timestamp = QDateTime::currentDateTime();
+        message.type = QtWarningMsg;
+        message.message = QStringLiteral("%1 log messages were dropped.").arg(dropped);
+
+        writeMessage(message);
+        written = true;
+    }
+
+    if (!written)
+        return;
+
+    if (m_logFile.isOpen())
+        m_logFile.flush();
+
+    if (m_collected.size() > MAX_COLLECTED_MESSAGES)
+        m_collected.remove(0, m_collected.size() - MAX_COLLECTED_MESSAGES);
+
+    bool notify = m_collectMessages && wasEmpty && !m_collected.isEmpty();
+    locker.unlock();
+
+    // The view is only notified once until it takes the messages
+    if (notify)
+        emit messagesAvailable();
+}
+
+bool Logger::waitForMessages()
+{
+    QMutexLocker locker(&m_wakeMutex);
+
+    // Messages posted between the last drain and now would not wake the thread up, they are checked once sleeping is set
+    m_sleeping.fetchAndStoreOrdered(1);
+
+    while(!m_stopping && (m_sleeping.loadAcquire() == 1))
+    {
+        const Slot& slot = m_slots[m_dequeuePosition & (RING_SIZE - 1)];
+        if (slot.sequence.loadAcquire() == m_dequeuePosition + 1)
+            break;
+
+        m_wakeUp.wait(&m_wakeMutex);
+    }
+
+    m_sleeping.storeRelease(0);
+
+    return !m_stopping;
+}
+
+void Logger::writeMessage(const LoggerMessage &message)
+{
+    if (m_logFile.isOpen() || m_consoleOutput)
+    {
+        QString line = QStringLiteral("%1 %2: %3\n").arg(message.timestamp.toString(Qt::ISODate), typeName(message.type), message.message);
+
+        if (m_logFile.isOpen())
+            m_logFile.write(line.toUtf8());
+
+        if (m_consoleOutput)
+            std::fputs(line.toLocal8Bit().constData(), stderr);
+    }
+
+    if (m_collectMessages)
+        m_collected.append(message);
+}
+
+QString Logger::typeName(QtMsgType type)
+{
+    switch(type)
+    {
+    case QtDebugMsg:
+        return QStringLiteral("debug");
+
+    case QtInfoMsg:
+        return QStringLiteral("info");
+
+    case QtWarningMsg:
+        return QStringLiteral("warning");
+
+    case QtCriticalMsg:
+        return QStringLiteral("critical");
+
+    default:
+        return QStringLiteral("fatal");
+    }
+}
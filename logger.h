@@ -1,15 +1,20 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <QAtomicInteger>
 #include <QObject>
 #include <QDateTime>
+#include <QFile>
 #include <QMessageLogger>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
 
 class LoggerMessage
 {
 public:
     explicit LoggerMessage() :
-        timestamp(QDateTime::currentDateTime()),
+        timestamp(),
         type(),
         message(),
         file(),
@@ -18,16 +23,6 @@ public:
         line(0)
     { }
 
-    explicit LoggerMessage(QtMsgType _type, const QMessageLogContext& _context, const QString& _msg) :
-        timestamp(QDateTime::currentDateTime()),
-        type(_type),
-        message(_msg),
-        file(_context.file ? QString::fromLatin1(_context.file) : QString()),
-        function(_context.function ? QString::fromLatin1(_context.function) : QString()),
-        category(_context.category ? QString::fromLatin1(_context.category) : QString()),
-        line(_context.line)
-    {}
-
     QDateTime timestamp;
     QtMsgType type;
     QString message;
@@ -37,6 +32,14 @@ public:
     int line;
 };
 
+class LoggerThread;
+
+// Sink of all the messages of the application.
+// Messages are captured in a fixed ring of slots, from any thread, without allocating. A dispatch thread
+// sleeps until a message is posted to an empty ring, the only time a poster locks, then drains the ring and
+// hands the messages over, in batches, to the enabled outputs: the log view, a log file and the console.
+// Messages are dropped, and counted, when the ring is full. The ring is drained and the file flushed on exit.
+
 class Logger : public QObject
 {
     Q_OBJECT
@@ -44,8 +47,79 @@ public:
     explicit Logger(QObject *parent = Q_NULLPTR);
     virtual ~Logger() Q_DECL_OVERRIDE;
 
+    /**
+     * @brief Queue a message, called by the message handler from any thread.
+     */
+    void post(QtMsgType type, const QMessageLogContext& context, const QString& message);
+
+    /**
+     * @brief Also write the messages to a file, or stop writing them with an empty name.
+     */
+    bool setLogFile(const QString& fileName);
+
+    void setConsoleOutput(bool enabled);
+
+    /**
+     * @brief Keep the messages for takeMessages(), for a log view.
+     */
+    void setCollectMessages(bool enabled);
+
+    /**
+     * @brief Take the messages collected since the last call.
+     */
+    QVector<LoggerMessage> takeMessages();
+
 signals:
-    void newMessage(const LoggerMessage& message);
+    /// Emitted from the dispatch thread when messages are collected while none were waiting
+    void messagesAvailable();
+
+protected:
+    /// Number of slots in the ring, a power of 2
+    static constexpr quint32 RING_SIZE = 1024;
+
+    /// Longest message kept, in UTF-16 code units. Longer messages are truncated.
+    static constexpr int MESSAGE_SIZE = 480;
+
+    struct Slot
+    {
+        /// Position of the slot in the ring sequence, tells whether it is free or holds a message
+        QAtomicInteger<quint32> sequence;
+
+        QtMsgType type;
+        qint64 timestamp;
+        const char* file;
+        const char* function;
+        const char* category;
+        int line;
+        int length;
+        ushort text[MESSAGE_SIZE];
+    };
+
+    friend class LoggerThread;
+
+    void dispatch();
+    bool waitForMessages();
+    void writeMessage(const LoggerMessage& message);
+
+    static QString typeName(QtMsgType type);
+
+    Slot* m_slots;
+    QAtomicInteger<quint32> m_enqueuePosition;
+    quint32 m_dequeuePosition;
+    QAtomicInteger<quint32> m_dropped;
+
+    /// Set by the dispatch thread before it sleeps, the first poster clears it and wakes the thread up
+    QAtomicInteger<quint32> m_sleeping;
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeUp;
+    bool m_stopping;
+
+    QMutex m_mutex;
+    QFile m_logFile;
+    bool m_consoleOutput;
+    bool m_collectMessages;
+    QVector<LoggerMessage> m_collected;
+    LoggerThread* m_thread;
 };
 
 extern Logger* logger();
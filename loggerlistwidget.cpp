@@ -3,43 +3,28 @@
 
 #include <QStyle>
 
-LoggerListWidget::LoggerListWidget(QWidget *parent) : QListWidget(parent)
+LoggerListWidget::LoggerListWidget(QWidget *parent) :
+    QListView(parent),
+    m_model(new LoggerModel(this))
 {
-    setSelectionMode(QAbstractItemView::ContiguousSelection);
-    connect(logger(), &Logger::newMessage, this, &LoggerListWidget::handleMessage, Qt::QueuedConnection);
-}
-
-LoggerListWidget::~LoggerListWidget()
-{ }
-
-void LoggerListWidget::handleMessage(const LoggerMessage &message)
-{
-    QIcon icon;
+    m_model->setIcons(style()->standardIcon(QStyle::SP_MessageBoxInformation), style()->standardIcon(QStyle::SP_MessageBoxWarning),
+                      style()->standardIcon(QStyle::SP_MessageBoxCritical), style()->standardIcon(QStyle::SP_MessageBoxQuestion));
 
-    switch(message.type)
-    {
-    case QtInfoMsg:
-        icon = style()->standardIcon(QStyle::SP_MessageBoxInformation);
-        break;
-
-    case QtWarningMsg:
-        icon = style()->standardIcon(QStyle::SP_MessageBoxWarning);
-        break;
-
-    case QtFatalMsg:
-    case QtCriticalMsg:
-        icon = style()->standardIcon(QStyle::SP_MessageBoxCritical);
-        break;
+    setModel(m_model);
+    setSelectionMode(QAbstractItemView::ContiguousSelection);
 
-    default:
-        icon = style()->standardIcon(QStyle::SP_MessageBoxQuestion);
-        break;
-    }
+    // All rows have the same height, so the view does not need to measure every message
+    setUniformItemSizes(true);
 
-    QString messageStr = QString("%1: %2").arg(message.timestamp.toString(Qt::SystemLocaleShortDate)).arg(message.message);
+    // Scroll once per batch of messages rather than once per message
+    connect(m_model, &LoggerModel::messagesAdded, this, &LoggerListWidget::scrollToBottom);
+    connect(logger(), &Logger::messagesAvailable, m_model, &LoggerModel::fetchMessages, Qt::QueuedConnection);
 
-    QListWidgetItem* item = new QListWidgetItem(icon, messageStr);
-    addItem(item);
+    logger()->setCollectMessages(true);
+    m_model->fetchMessages();
+}
 
-    scrollToBottom();
+LoggerListWidget::~LoggerListWidget()
+{
+    logger()->setCollectMessages(false);
 }
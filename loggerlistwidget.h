@@ -1,20 +1,21 @@
 #ifndef LOGGERLISTWIDGET_H
 #define LOGGERLISTWIDGET_H
 
-#include <QDateTime>
-#include <QListWidget>
+#include <QListView>
 
-#include "logger.h"
+#include "loggermodel.h"
 
-class LoggerListWidget : public QListWidget
+// Log view, showing the messages of the logger as they arrive.
+
+class LoggerListWidget : public QListView
 {
     Q_OBJECT
 public:
     explicit LoggerListWidget(QWidget *parent = Q_NULLPTR);
     virtual ~LoggerListWidget() Q_DECL_OVERRIDE;
 
-public slots:
-    void handleMessage(const LoggerMessage &message);
+protected:
+    LoggerModel* m_model;
 };
 
 #endif // LOGGERLISTWIDGET_H
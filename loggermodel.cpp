@@ -0,0 +1,87 @@
+#include "loggermodel.h"
+
+// Most messages kept in the view
+constexpr int MAX_ROWS = 50000;
+
+LoggerModel::LoggerModel(QObject *parent) :
+    QAbstractListModel(parent),
+    m_messages(),
+    m_informationIcon(),
+    m_warningIcon(),
+    m_criticalIcon(),
+    m_otherIcon()
+{ }
+
+LoggerModel::~LoggerModel()
+{ }
+
+int LoggerModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_messages.size();
+}
+
+QVariant LoggerModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (index.row() >= m_messages.size()))
+        return QVariant();
+
+    const LoggerMessage& message = m_messages.at(index.row());
+
+    if (role == Qt::DisplayRole)
+        return QString("%1: %2").arg(message.timestamp.toString(Qt::SystemLocaleShortDate)).arg(message.message);
+
+    if (role == Qt::DecorationRole)
+    {
+        switch(message.type)
+        {
+        case QtInfoMsg:
+            return m_informationIcon;
+
+        case QtWarningMsg:
+            return m_warningIcon;
+
+        case QtFatalMsg:
+        case QtCriticalMsg:
+            return m_criticalIcon;
+
+        default:
+            return m_otherIcon;
+        }
+    }
+
+    return QVariant();
+}
+
+void LoggerModel::setIcons(const QIcon &information, const QIcon &warning, const QIcon &critical, const QIcon &other)
+{
+    m_informationIcon = information;
+    m_warningIcon = warning;
+    m_criticalIcon = critical;
+    m_otherIcon = other;
+}
+
+void LoggerModel::fetchMessages()
+{
+    QVector<LoggerMessage> messages = logger()->takeMessages();
+
+    if (messages.isEmpty())
+        return;
+
+    // A batch larger than the view only keeps its most recent messages
+    if (messages.size() > MAX_ROWS)
+        messages.remove(0, messages.size() - MAX_ROWS);
+
+    int excess = m_messages.size() + messages.size() - MAX_ROWS;
+    if (excess > 0)
+    {
+        beginRemoveRows(QModelIndex(), 0, excess - 1);
+        m_messages.remove(0, excess);
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_messages.size(), m_messages.size() + messages.size() - 1);
+    m_messages += messages;
+    endInsertRows();
+
+    emit messagesAdded();
+}
@@ -0,0 +1,44 @@
+#ifndef LOGGERMODEL_H
+#define LOGGERMODEL_H
+
+#include <QAbstractListModel>
+#include <QIcon>
+#include <QVector>
+
+#include "logger.h"
+
+// List of the messages shown in the log view.
+// Messages are fetched from the logger in batches, with one row insertion per batch, and formatted
+// only when the view asks for them. The oldest messages are removed past a maximum number of rows.
+
+class LoggerModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit LoggerModel(QObject *parent = Q_NULLPTR);
+    virtual ~LoggerModel() Q_DECL_OVERRIDE;
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    /**
+     * @brief Set the icons shown for each kind of message.
+     */
+    void setIcons(const QIcon& information, const QIcon& warning, const QIcon& critical, const QIcon& other);
+
+signals:
+    /// Emitted after a batch of messages was added
+    void messagesAdded();
+
+public slots:
+    void fetchMessages();
+
+protected:
+    QVector<LoggerMessage> m_messages;
+    QIcon m_informationIcon;
+    QIcon m_warningIcon;
+    QIcon m_criticalIcon;
+    QIcon m_otherIcon;
+};
+
+#endif // LOGGERMODEL_H
@@ -1,8 +1,15 @@
+#include "commandline.h"
 #include "dialog.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    if (CommandLine::isRequested(argc, argv))
+    {
+        QCoreApplication a(argc, argv);
+        return CommandLine::run(a);
+    }
+
     QApplication a(argc, argv);
     Dialog w;
     w.show();
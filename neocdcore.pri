@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Links the core library built by core/core.pro, for the application
+# and the tests of the subdirs build. The library is found in the build
+# directory of core/, which mirrors the source tree.
+#
+#-------------------------------------------------
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+NEOCDCORE_DIR = $$clean_path($$OUT_PWD/$$relative_path($$PWD, $$_PRO_FILE_PWD_)/core)
+win32:CONFIG(release, debug|release): NEOCDCORE_DIR = $$NEOCDCORE_DIR/release
+else:win32:CONFIG(debug, debug|release): NEOCDCORE_DIR = $$NEOCDCORE_DIR/debug
+
+LIBS += -L$$NEOCDCORE_DIR -lneocdcore
+
+# Programs are relinked when the static library changes
+!neocd_shared {
+    win32-msvc*: PRE_TARGETDEPS += $$NEOCDCORE_DIR/neocdcore.lib
+    else: PRE_TARGETDEPS += $$NEOCDCORE_DIR/libneocdcore.a
+}
+
+# Same defines as the library, and its libraries for the static build
+include($$PWD/coredeps.pri)
@@ -0,0 +1,177 @@
+#include "audiostream.h"
+#include "endian.h"
+#include "offsetdetector.h"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QtDebug>
+
+// AccurateRip ignores the first and last five sectors of the disc, drives can not read them reliably
+constexpr qint64 ACCURATERIP_SKIPPED_SAMPLES = 5 * 588;
+
+constexpr qint64 BYTES_PER_SAMPLE = 4;
+
+// Samples read from the stream at once, 64 sectors
+constexpr qint64 SAMPLES_PER_READ = 64 * 588;
+
+OffsetDetector::OffsetDetector() :
+    m_references()
+{ }
+
+bool OffsetDetector::loadReferences(const QString &fileName)
+{
+    static const QRegularExpression REFERENCE_REGEX("^\\s*([0-9]+)\\s+(?:0x)?([0-9a-f]{1,8})\\s*$", QRegularExpression::CaseInsensitiveOption);
+
+    m_references.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qCritical().noquote() << "Could not open checksum reference file: " << file.errorString();
+        return false;
+    }
+
+    QTextStream in(&file);
+    int lineNumber = 0;
+
+    while(!in.atEnd())
+    {
+        QString line = in.readLine();
+        ++lineNumber;
+
+        if (line.trimmed().isEmpty() || line.trimmed().startsWith(QChar('#')))
+            continue;
+
+        QRegularExpressionMatch match = REFERENCE_REGEX.match(line);
+        if (!match.hasMatch())
+        {
+            qCritical().noquote() << "Invalid checksum reference file: Syntax error on line " << lineNumber << ".";
+            return false;
+        }
+
+        int track = match.captured(1).toInt();
+        if ((track < 1) || (track > 99))
+        {
+            qCritical().noquote() << "Invalid checksum reference file: Track number out of range on line " << lineNumber << ".";
+            return false;
+        }
+
+        m_references[static_cast<uint8_t>(track)].push_back(match.captured(2).toUInt(Q_NULLPTR, 16));
+    }
+
+    if (m_references.isEmpty())
+    {
+        qCritical().noquote() << "Checksum reference file " << fileName << " is empty.";
+        return false;
+    }
+
+    return true;
+}
+
+bool OffsetDetector::detect(CdromToc *toc, int maxOffset, int &offset)
+{
+    AudioStream stream;
+    stream.initialize(toc);
+
+    // One window per candidate offset, and the samples leaving the window as it slides over them
+    int windowCount = 2 * maxOffset + 1;
+    QVector<int> votes(windowCount, 0);
+    QVector<uint32_t> outgoing(windowCount - 1);
+    QVector<uint32_t> chunk(static_cast<int>(SAMPLES_PER_READ));
+    int trackCount = 0;
+
+    for(auto i = m_references.cbegin(); i != m_references.cend(); ++i)
+    {
+        uint8_t track = i.key();
+        qint64 position;
+        qint64 size;
+
+        if (!stream.trackRange(track, position, size))
+        {
+            qWarning().noquote() << "Track " << track << " of the checksum reference file is not an audio track.";
+            continue;
+        }
+
+        qint64 count = size / BYTES_PER_SAMPLE;
+        qint64 first = (track == toc->firstTrack()) ? ACCURATERIP_SKIPPED_SAMPLES - 1 : 0;
+        qint64 last = (track == toc->lastTrack()) ? count - ACCURATERIP_SKIPPED_SAMPLES : count;
+
+        if (last <= first)
+            continue;
+
+        ++trackCount;
+
+        // Sample k is the sample of the track at k - maxOffset, the window of the lowest offset covers [first, last)
+        // and sliding it over every offset reads up to last + 2 * maxOffset. Only the samples leaving the window
+        // are kept, the first 2 * maxOffset of the lowest one.
+        qint64 end = last + windowCount - 1;
+        qint64 streamPosition = position + (first - maxOffset) * BYTES_PER_SAMPLE;
+
+        // Checksum and plain sum of the window, all arithmetic is modulo 2^32
+        uint32_t checksum = 0;
+        uint32_t sum = 0;
+
+        for(qint64 k = first; k < end; k += chunk.size())
+        {
+            qint64 chunkSize = qMin(SAMPLES_PER_READ, end - k);
+            if (!stream.read(streamPosition + (k - first) * BYTES_PER_SAMPLE, reinterpret_cast<char*>(chunk.data()), chunkSize * BYTES_PER_SAMPLE))
+                return false;
+
+            for(qint64 j = k; j < k + chunkSize; ++j)
+            {
+                uint32_t sample = LITTLE_ENDIAN_DWORD(chunk.at(static_cast<int>(j - k)));
+
+                if (j - first < outgoing.size())
+                    outgoing[static_cast<int>(j - first)] = sample;
+
+                if (j < last)
+                {
+                    checksum += static_cast<uint32_t>(j + 1) * sample;
+                    sum += sample;
+                    continue;
+                }
+
+                // The window of this offset is complete, moving it one sample forward removes one of each sample
+                // and brings in the next one
+                int window = static_cast<int>(j - last);
+
+                if (i.value().contains(checksum))
+                    ++votes[window];
+
+                uint32_t leaving = outgoing.at(window);
+
+                checksum = checksum - sum - static_cast<uint32_t>(first) * leaving + static_cast<uint32_t>(last) * sample;
+                sum = sum - leaving + sample;
+            }
+        }
+
+        // Window of the highest offset
+        if (i.value().contains(checksum))
+            ++votes[windowCount - 1];
+    }
+
+    // Most matches wins, the smallest correction breaks ties
+    int best = -1;
+
+    for(int i = 0; i < votes.size(); ++i)
+    {
+        if (!votes.at(i))
+            continue;
+
+        if ((best < 0) || (votes.at(i) > votes.at(best)) || ((votes.at(i) == votes.at(best)) && (qAbs(i - maxOffset) < qAbs(best - maxOffset))))
+            best = i;
+    }
+
+    if (best < 0)
+    {
+        qWarning().noquote() << "No read offset within " << maxOffset << " samples matches the checksum reference file.";
+        return false;
+    }
+
+    offset = best - maxOffset;
+
+    qInfo().noquote() << "Detected a read offset of " << offset << " samples, matching " << votes.at(best) << " of " << trackCount << " tracks.";
+
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef OFFSETDETECTOR_H
+#define OFFSETDETECTOR_H
+
+#include <QMap>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+#include "cdromtoc.h"
+
+// Finds the read offset of the drive a disc image was ripped with.
+// The AccurateRip (v1) checksum of every track listed in a local reference file is computed for every
+// candidate offset, sliding over the samples of the neighbouring tracks. The offset matching the most
+// tracks wins.
+//
+// Reference files are text files holding one "<track> <checksum>" pair per line, checksums being
+// hexadecimal. A track can be listed several times (different pressings), lines starting with # are ignored.
+
+class OffsetDetector
+{
+public:
+    explicit OffsetDetector();
+
+    bool loadReferences(const QString& fileName);
+
+    /**
+     * @brief Find the sample offset to apply to the audio tracks of a disc.
+     * @param[in] toc TOC of the disc.
+     * @param[in] maxOffset Largest offset tried, in samples, in both directions.
+     * @param[out] offset Offset found: output sample n is input sample n + offset.
+     * @return true if at least one track matched its reference.
+     */
+    bool detect(CdromToc* toc, int maxOffset, int& offset);
+
+protected:
+    QMap<uint8_t, QVector<uint32_t>> m_references;
+};
+
+#endif // OFFSETDETECTOR_H
@@ -0,0 +1,632 @@
+#include "outputfile.h"
+
+#include <QFileInfo>
+#include <QtDebug>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+    #include <linux/falloc.h>
+#endif
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+// Alignment required for O_DIRECT buffers, offsets and lengths
+constexpr qint64 DIRECT_IO_ALIGNMENT = 4096;
+
+// Size of the staging buffer used to build aligned O_DIRECT writes
+constexpr qint64 STAGING_BUFFER_SIZE = 1024 * 1024;
+
+// Amount of written data after which writeback is started and older data is dropped from the page cache
+constexpr qint64 WRITEBACK_WINDOW_SIZE = 8 * 1024 * 1024;
+
+// Granularity of holes, matches the block size of common filesystems
+constexpr qint64 SPARSE_BLOCK_SIZE = 4096;
+
+// Shorter runs of zeros are written, so files are not fragmented by tiny holes
+constexpr qint64 SPARSE_MIN_RUN = 64 * 1024;
+
+OutputFile::OutputFile() :
+    m_options(),
+    m_tarStream(Q_NULLPTR),
+    m_streamOpen(false),
+    m_file(),
+    m_fd(-1),
+    m_directIo(false),
+    m_preallocated(false),
+    m_staging(Q_NULLPTR),
+    m_stagingUsed(0),
+    m_stagingStart(0),
+    m_position(0),
+    m_size(0),
+    m_writebackUpTo(0),
+    m_droppedUpTo(0),
+    m_syscalls(0),
+    m_sparseBytes(0),
+    m_allocations(0),
+    m_errorString()
+{ }
+
+OutputFile::~OutputFile()
+{
+    close();
+}
+
+void OutputFile::setOptions(const ExportOptions &options)
+{
+    m_options = options;
+}
+
+bool OutputFile::supportsSparse(const ExportOptions &options, QString &reason)
+{
+    if (!options.tarOutput.isEmpty())
+        reason = QStringLiteral("archive output");
+    else if (options.ioBackend == ExportOptions::IoBackend::IoUring)
+        reason = QStringLiteral("the io_uring backend");
+    else if ((options.ioBackend == ExportOptions::IoBackend::Direct) && options.directIo)
+        reason = QStringLiteral("O_DIRECT");
+    else
+        return true;
+
+    return false;
+}
+
+void OutputFile::setTarStream(TarStream *stream)
+{
+    close();
+
+    m_tarStream = stream;
+}
+
+bool OutputFile::open(const QString &fileName, qint64 expectedSize)
+{
+    close();
+
+    m_position = 0;
+    m_size = 0;
+    m_stagingStart = 0;
+    m_stagingUsed = 0;
+    m_writebackUpTo = 0;
+    m_droppedUpTo = 0;
+    m_preallocated = false;
+    m_errorString.clear();
+
+    // Archives only hold the file name, the size goes in the header before the data
+    if (m_tarStream)
+    {
+        m_streamOpen = m_tarStream->beginFile(QFileInfo(fileName).fileName(), expectedSize);
+        if (!m_streamOpen)
+            m_errorString = m_tarStream->errorString();
+
+        return m_streamOpen;
+    }
+
+#ifdef Q_OS_UNIX
+    if (m_options.ioBackend != ExportOptions::IoBackend::Buffered)
+    {
+        QByteArray nativeName = QFile::encodeName(fileName);
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    #ifdef O_DIRECT
+        // Only the direct backend stages writes into aligned blocks
+        if (m_options.directIo && (m_options.ioBackend == ExportOptions::IoBackend::Direct))
+        {
+            m_fd = ::open(nativeName.constData(), flags | O_DIRECT, 0666);
+            ++m_syscalls;
+
+            // Some filesystems (tmpfs, network shares) refuse O_DIRECT, fall back to cached writes
+            if ((m_fd < 0) && (errno == EINVAL))
+                qWarning().noquote() << "O_DIRECT is not supported for " << fileName << ", using cached writes.";
+            else
+                m_directIo = (m_fd >= 0);
+        }
+    #endif
+
+        if (m_fd < 0)
+        {
+            m_fd = ::open(nativeName.constData(), flags, 0666);
+            ++m_syscalls;
+        }
+
+        if (m_fd < 0)
+        {
+            setSystemError(QStringLiteral("open"));
+            m_directIo = false;
+            return false;
+        }
+
+        if (m_directIo)
+        {
+            void* buffer = Q_NULLPTR;
+            if (posix_memalign(&buffer, DIRECT_IO_ALIGNMENT, STAGING_BUFFER_SIZE) != 0)
+            {
+                m_errorString = QStringLiteral("Could not allocate the O_DIRECT staging buffer.");
+                close();
+                return false;
+            }
+
+            m_staging = static_cast<char*>(buffer);
+            ++m_allocations;
+        }
+
+    #ifdef Q_OS_LINUX
+        if (expectedSize > 0)
+        {
+            // Reserve all the blocks up front so the file is not fragmented by appends
+            ++m_syscalls;
+            if (fallocate(m_fd, 0, 0, expectedSize) == 0)
+                m_preallocated = true;
+            else if (errno != EOPNOTSUPP)
+            {
+                setSystemError(QStringLiteral("fallocate"));
+                close();
+                return false;
+            }
+        }
+    #else
+        Q_UNUSED(expectedSize)
+    #endif
+
+        return true;
+    }
+#endif
+
+    Q_UNUSED(expectedSize)
+
+    m_file.setFileName(fileName);
+    ++m_syscalls;
+
+    if (!m_file.open(QIODevice::WriteOnly))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+qint64 OutputFile::write(const char *data, qint64 size)
+{
+    if (m_tarStream)
+    {
+        ++m_syscalls;
+
+        if (m_tarStream->write(data, size) < 0)
+        {
+            m_errorString = m_tarStream->errorString();
+            return -1;
+        }
+
+        m_position += size;
+        m_size = m_position;
+        return size;
+    }
+
+    // Holes can not be made in the middle of aligned O_DIRECT blocks, staged writes are always dense
+    if (m_options.sparseOutput && !m_staging)
+    {
+        if (!writeSparse(data, size))
+            return -1;
+
+        m_position += size;
+        m_size = std::max(m_size, m_position);
+
+        dropWrittenCache(false);
+
+        return size;
+    }
+
+    if (m_fd < 0)
+    {
+        ++m_syscalls;
+
+        qint64 done = m_file.write(data, size);
+        if (done < 0)
+        {
+            m_errorString = m_file.errorString();
+            return done;
+        }
+
+        m_position += done;
+        m_size = std::max(m_size, m_position);
+        return done;
+    }
+
+    if (m_staging)
+    {
+        qint64 remaining = size;
+
+        while(remaining)
+        {
+            qint64 slice = std::min(remaining, STAGING_BUFFER_SIZE - m_stagingUsed);
+            std::memcpy(m_staging + m_stagingUsed, data, static_cast<size_t>(slice));
+
+            m_stagingUsed += slice;
+            data += slice;
+            remaining -= slice;
+
+            if ((m_stagingUsed == STAGING_BUFFER_SIZE) && !flushStaging(false))
+                return -1;
+        }
+    }
+    else
+    {
+        if (!writeFully(data, size, m_position))
+            return -1;
+    }
+
+    m_position += size;
+    m_size = std::max(m_size, m_position);
+
+    dropWrittenCache(false);
+
+    return size;
+}
+
+bool OutputFile::seek(qint64 position)
+{
+    if (m_tarStream)
+    {
+        if (position == m_position)
+            return true;
+
+        m_errorString = QStringLiteral("Streamed files can not be rewritten.");
+        return false;
+    }
+
+    if (m_fd < 0)
+    {
+        ++m_syscalls;
+
+        if (!m_file.seek(position))
+        {
+            m_errorString = m_file.errorString();
+            return false;
+        }
+
+        m_position = position;
+        return true;
+    }
+
+    if (!flushStaging(true))
+        return false;
+
+    m_position = position;
+    m_stagingStart = position;
+
+    return true;
+}
+
+void OutputFile::advance(qint64 size)
+{
+    if (!flushStaging(true))
+        return;
+
+    m_position += size;
+    m_stagingStart = m_position;
+    m_size = std::max(m_size, m_position);
+
+    dropWrittenCache(false);
+}
+
+bool OutputFile::isOpen() const
+{
+    return (m_fd >= 0) || m_file.isOpen() || m_streamOpen;
+}
+
+void OutputFile::close()
+{
+    if (m_streamOpen)
+    {
+        ++m_syscalls;
+        if (!m_tarStream->endFile())
+            qCritical().noquote() << "Write error on output archive: " << m_tarStream->errorString();
+
+        m_streamOpen = false;
+    }
+
+    if (m_file.isOpen())
+    {
+        // A trailing hole is only made by extending the file
+        if (m_file.size() < m_size)
+        {
+            ++m_syscalls;
+            m_file.resize(m_size);
+        }
+
+        ++m_syscalls;
+        m_file.close();
+    }
+
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0)
+    {
+        if (!flushStaging(true))
+            qCritical().noquote() << "Write error on output file: " << m_errorString;
+
+        // Preallocation may have reserved more than what was written (cancelled export)
+        ++m_syscalls;
+        if (ftruncate(m_fd, m_size) != 0)
+            setSystemError(QStringLiteral("ftruncate"));
+
+        dropWrittenCache(true);
+
+        ++m_syscalls;
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+    std::free(m_staging);
+    m_staging = Q_NULLPTR;
+    m_stagingUsed = 0;
+    m_directIo = false;
+    m_preallocated = false;
+}
+
+qint64 OutputFile::takeSyscalls()
+{
+    qint64 count = m_syscalls;
+    m_syscalls = 0;
+    return count;
+}
+
+qint64 OutputFile::takeSparseBytes()
+{
+    qint64 count = m_sparseBytes;
+    m_sparseBytes = 0;
+    return count;
+}
+
+qint64 OutputFile::takeAllocations()
+{
+    qint64 count = m_allocations;
+    m_allocations = 0;
+    return count;
+}
+
+bool OutputFile::flushStaging(bool all)
+{
+    if (!m_staging || !m_stagingUsed)
+        return true;
+
+    qint64 directSize = 0;
+
+    // O_DIRECT can only write whole aligned blocks at aligned offsets
+    if ((m_stagingStart % DIRECT_IO_ALIGNMENT) == 0)
+        directSize = m_stagingUsed & ~(DIRECT_IO_ALIGNMENT - 1);
+
+    if (!all && (directSize == 0))
+        return true;
+
+    if (directSize && !writeFully(m_staging, directSize, m_stagingStart))
+        return false;
+
+    qint64 tailSize = m_stagingUsed - directSize;
+
+#if defined(Q_OS_UNIX) && defined(O_DIRECT)
+    if (tailSize)
+    {
+        // The unaligned tail is written through the page cache
+        int flags = fcntl(m_fd, F_GETFL);
+        fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+        m_syscalls += 2;
+
+        bool ok = writeFully(m_staging + directSize, tailSize, m_stagingStart + directSize);
+
+        fcntl(m_fd, F_SETFL, flags);
+        ++m_syscalls;
+
+        if (!ok)
+            return false;
+    }
+#endif
+
+    m_stagingStart += directSize + tailSize;
+    m_stagingUsed = 0;
+
+    return true;
+}
+
+bool OutputFile::writeFully(const char *data, qint64 size, qint64 offset)
+{
+#ifdef Q_OS_UNIX
+    while(size)
+    {
+        ++m_syscalls;
+
+        ssize_t done = pwrite(m_fd, data, static_cast<size_t>(size), static_cast<off_t>(offset));
+        if (done < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            setSystemError(QStringLiteral("write"));
+            return false;
+        }
+
+        data += done;
+        size -= done;
+        offset += done;
+    }
+
+    return true;
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+    Q_UNUSED(offset)
+    return false;
+#endif
+}
+
+bool OutputFile::writeSparse(const char *data, qint64 size)
+{
+    qint64 pending = 0;
+
+    // Holes are made of whole filesystem blocks, start at the first block boundary
+    qint64 cursor = (SPARSE_BLOCK_SIZE - (m_position % SPARSE_BLOCK_SIZE)) % SPARSE_BLOCK_SIZE;
+
+    while(cursor + SPARSE_BLOCK_SIZE <= size)
+    {
+        if (!isZeroBlock(data + cursor, SPARSE_BLOCK_SIZE))
+        {
+            cursor += SPARSE_BLOCK_SIZE;
+            continue;
+        }
+
+        qint64 runEnd = cursor + SPARSE_BLOCK_SIZE;
+        while((runEnd + SPARSE_BLOCK_SIZE <= size) && isZeroBlock(data + runEnd, SPARSE_BLOCK_SIZE))
+            runEnd += SPARSE_BLOCK_SIZE;
+
+        if (runEnd - cursor >= SPARSE_MIN_RUN)
+        {
+            if (!writeRange(data + pending, cursor - pending, m_position + pending))
+                return false;
+
+            if (!skipRange(data + cursor, runEnd - cursor, m_position + cursor))
+                return false;
+
+            pending = runEnd;
+        }
+
+        cursor = runEnd;
+    }
+
+    return writeRange(data + pending, size - pending, m_position + pending);
+}
+
+bool OutputFile::writeRange(const char *data, qint64 size, qint64 offset)
+{
+    if (!size)
+        return true;
+
+    if (m_fd >= 0)
+        return writeFully(data, size, offset);
+
+    if (m_file.pos() != offset)
+    {
+        ++m_syscalls;
+
+        if (!m_file.seek(offset))
+        {
+            m_errorString = m_file.errorString();
+            return false;
+        }
+    }
+
+    ++m_syscalls;
+
+    if (m_file.write(data, size) != size)
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool OutputFile::skipRange(const char *data, qint64 size, qint64 offset)
+{
+    // Nothing was ever written past the end of a file that was not preallocated, it reads back as zeros
+    if (!m_preallocated && (offset >= m_size))
+    {
+        m_sparseBytes += size;
+        return true;
+    }
+
+#if defined(Q_OS_LINUX) && defined(FALLOC_FL_PUNCH_HOLE)
+    if (m_fd >= 0)
+    {
+        ++m_syscalls;
+
+        if (fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size) == 0)
+        {
+            m_sparseBytes += size;
+            return true;
+        }
+    }
+#endif
+
+    // The filesystem can not make holes there, the zeros have to be written
+    return writeRange(data, size, offset);
+}
+
+bool OutputFile::isZeroBlock(const char *data, qint64 size)
+{
+#ifdef __SSE2__
+    const __m128i* ptr = reinterpret_cast<const __m128i*>(data);
+    const __m128i* end = ptr + (size / 64) * 4;
+    __m128i accumulator = _mm_setzero_si128();
+
+    // Bail out as soon as a chunk has non zero bytes, most audio blocks fail in the first one
+    while(ptr < end)
+    {
+        accumulator = _mm_or_si128(accumulator, _mm_or_si128(_mm_or_si128(_mm_loadu_si128(ptr), _mm_loadu_si128(ptr + 1)),
+                                                             _mm_or_si128(_mm_loadu_si128(ptr + 2), _mm_loadu_si128(ptr + 3))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(accumulator, _mm_setzero_si128())) != 0xffff)
+            return false;
+
+        ptr += 4;
+    }
+
+    data = reinterpret_cast<const char*>(end);
+    size %= 64;
+#endif
+
+    for(qint64 i = 0; i < size; ++i)
+    {
+        if (data[i])
+            return false;
+    }
+
+    return true;
+}
+
+void OutputFile::dropWrittenCache(bool all)
+{
+#ifdef Q_OS_LINUX
+    // Data written with O_DIRECT never enters the page cache
+    if (m_directIo || (m_fd < 0))
+        return;
+
+    if (all)
+    {
+        m_syscalls += 2;
+        sync_file_range(m_fd, m_droppedUpTo, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(m_fd, m_droppedUpTo, 0, POSIX_FADV_DONTNEED);
+        m_writebackUpTo = m_position;
+        m_droppedUpTo = m_position;
+        return;
+    }
+
+    if (m_position - m_writebackUpTo < WRITEBACK_WINDOW_SIZE)
+        return;
+
+    // Start writeback of the current window, then wait for the previous one and drop it from the cache
+    m_syscalls += 3;
+    sync_file_range(m_fd, m_writebackUpTo, m_position - m_writebackUpTo, SYNC_FILE_RANGE_WRITE);
+    sync_file_range(m_fd, m_droppedUpTo, m_writebackUpTo - m_droppedUpTo, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(m_fd, m_droppedUpTo, m_writebackUpTo - m_droppedUpTo, POSIX_FADV_DONTNEED);
+
+    m_droppedUpTo = m_writebackUpTo;
+    m_writebackUpTo = m_position;
+#else
+    Q_UNUSED(all)
+#endif
+}
+
+void OutputFile::setSystemError(const QString &what)
+{
+    m_errorString = QStringLiteral("%1: %2").arg(what, QString::fromLocal8Bit(std::strerror(errno)));
+}
@@ -0,0 +1,139 @@
+#ifndef OUTPUTFILE_H
+#define OUTPUTFILE_H
+
+#include <QFile>
+#include <QString>
+
+#include "exportoptions.h"
+#include "tarstream.h"
+
+// Output file used by the export pipeline.
+// The buffered backend goes through QFile, the direct and io_uring backends use POSIX calls to preallocate
+// the file, optionally bypass the page cache with O_DIRECT, and drop written data from the cache.
+// When sparse output is enabled, block-aligned runs of zeros are not written but left as holes, except where
+// the writes are always dense (see supportsSparse()).
+// Files can also be streamed into a tar archive instead, they are then written in order without seeking.
+
+class OutputFile
+{
+public:
+    OutputFile();
+    ~OutputFile();
+
+    // Non copyable
+    OutputFile(const OutputFile&) = delete;
+
+    // Non copyable
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    void setOptions(const ExportOptions& options);
+
+    /**
+     * @brief Check if the files written with some options can have holes. Writes staged for O_DIRECT, io_uring writes
+     * and archives are always dense.
+     * @param[out] reason What makes the files dense.
+     */
+    static bool supportsSparse(const ExportOptions& options, QString& reason);
+
+    /**
+     * @brief Write the next files to an archive instead of the disk, Q_NULLPTR to go back to files.
+     */
+    void setTarStream(TarStream* stream);
+
+    /**
+     * @brief Create the output file.
+     * @param fileName Path of the file to create.
+     * @param expectedSize Final size of the file if known, zero otherwise. Used for preallocation.
+     */
+    bool open(const QString& fileName, qint64 expectedSize);
+
+    qint64 write(const char* data, qint64 size);
+
+    inline qint64 write(const QByteArray& data)
+    {
+        return write(data.constData(), data.size());
+    }
+
+    bool seek(qint64 position);
+
+    inline qint64 pos() const
+    {
+        return m_position;
+    }
+
+    bool isOpen() const;
+
+    /**
+     * @brief Check if the file goes to an archive, where it can not be patched after being written.
+     */
+    inline bool isStreamed() const
+    {
+        return m_tarStream != Q_NULLPTR;
+    }
+
+    /**
+     * @brief POSIX descriptor of the file, or -1 when the file is written through QFile.
+     */
+    inline int handle() const
+    {
+        return m_fd;
+    }
+
+    /**
+     * @brief Account for data written at the current position directly through handle().
+     */
+    void advance(qint64 size);
+
+    void close();
+
+    inline QString errorString() const
+    {
+        return m_errorString;
+    }
+
+    /**
+     * @brief Return the number of system calls issued since the last call, for statistics.
+     */
+    qint64 takeSyscalls();
+
+    /**
+     * @brief Return the number of bytes left as holes since the last call, for statistics.
+     */
+    qint64 takeSparseBytes();
+
+    /**
+     * @brief Return the number of heap allocations done since the last call, for statistics.
+     */
+    qint64 takeAllocations();
+
+protected:
+    bool flushStaging(bool all);
+    bool writeFully(const char* data, qint64 size, qint64 offset);
+    bool writeSparse(const char* data, qint64 size);
+    bool writeRange(const char* data, qint64 size, qint64 offset);
+    bool skipRange(const char* data, qint64 size, qint64 offset);
+    static bool isZeroBlock(const char* data, qint64 size);
+    void dropWrittenCache(bool all);
+    void setSystemError(const QString& what);
+
+    ExportOptions m_options;
+    TarStream* m_tarStream;
+    bool m_streamOpen;
+    QFile m_file;
+    int m_fd;
+    bool m_directIo;
+    bool m_preallocated;
+    char* m_staging;
+    qint64 m_stagingUsed;
+    qint64 m_stagingStart;
+    qint64 m_position;
+    qint64 m_size;
+    qint64 m_writebackUpTo;
+    qint64 m_droppedUpTo;
+    qint64 m_syscalls;
+    qint64 m_sparseBytes;
+    qint64 m_allocations;
+    QString m_errorString;
+};
+
+#endif // OUTPUTFILE_H
@@ -0,0 +1,430 @@
+#include "endian.h"
+#include "sampleconverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+constexpr uint32_t CD_SAMPLE_RATE = 44100;
+
+// Taps of the resampling filter used for every output sample
+constexpr qint64 FILTER_TAPS = 64;
+
+// Odd sample rates would need huge filter tables
+constexpr qint64 MAX_UP_FACTOR = 1024;
+
+// Shape of the Kaiser window, about 90 dB of stop band attenuation
+constexpr double KAISER_BETA = 9.0;
+
+// Part of the output bandwidth kept intact, the rest is the filter transition band
+constexpr double PASSBAND = 0.91;
+
+constexpr double PI = 3.14159265358979323846;
+
+static qint64 greatestCommonDivisor(qint64 a, qint64 b)
+{
+    while(b)
+    {
+        qint64 r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for(int k = 1; k < 64; ++k)
+    {
+        double factor = x / (2.0 * k);
+        term *= factor * factor;
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+// Buffers only grow, an allocation is counted when they outgrow their capacity
+static inline void resizeBuffer(QVector<float>& buffer, int size, qint64& allocations)
+{
+    if (size > buffer.capacity())
+        ++allocations;
+
+    buffer.resize(size);
+}
+
+static inline uint32_t readLittleEndian32(const char* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return LITTLE_ENDIAN_DWORD(value);
+}
+
+SampleConverter::SampleConverter() :
+    m_format(SampleFormat::Int16),
+    m_channelCount(2),
+    m_sampleRate(CD_SAMPLE_RATE),
+    m_upFactor(1),
+    m_downFactor(1),
+    m_dither(true),
+    m_ditherState(0x12345678),
+    m_filter(),
+    m_decoded(),
+    m_stereo(),
+    m_resampled(),
+    m_allocations(0)
+{ }
+
+bool SampleConverter::setFormat(SampleFormat format, int channelCount, uint32_t sampleRate)
+{
+    if ((channelCount < 1) || (channelCount > 2) || (sampleRate == 0))
+        return false;
+
+    qint64 divisor = greatestCommonDivisor(CD_SAMPLE_RATE, sampleRate);
+    qint64 upFactor = CD_SAMPLE_RATE / divisor;
+    qint64 downFactor = sampleRate / divisor;
+
+    if (upFactor > MAX_UP_FACTOR)
+        return false;
+
+    m_format = format;
+    m_channelCount = channelCount;
+    m_sampleRate = sampleRate;
+    m_upFactor = upFactor;
+    m_downFactor = downFactor;
+
+    if (m_sampleRate != CD_SAMPLE_RATE)
+        buildFilter();
+    else
+        m_filter.clear();
+
+    return true;
+}
+
+bool SampleConverter::isPassthrough() const
+{
+    return (m_format == SampleFormat::Int16) && (m_channelCount == 2) && (m_sampleRate == CD_SAMPLE_RATE);
+}
+
+int SampleConverter::inputFrameSize() const
+{
+    switch(m_format)
+    {
+    case SampleFormat::UInt8:
+        return m_channelCount;
+
+    case SampleFormat::Int16:
+        return m_channelCount * 2;
+
+    case SampleFormat::Int24:
+        return m_channelCount * 3;
+
+    case SampleFormat::Int32:
+    case SampleFormat::Float32:
+        return m_channelCount * 4;
+
+    case SampleFormat::Float64:
+        return m_channelCount * 8;
+    }
+
+    return m_channelCount;
+}
+
+qint64 SampleConverter::outputFrames(qint64 inputFrames) const
+{
+    return (inputFrames * m_upFactor) / m_downFactor;
+}
+
+void SampleConverter::inputRange(qint64 outputFrame, qint64 count, qint64 &first, qint64 &last) const
+{
+    if (m_sampleRate == CD_SAMPLE_RATE)
+    {
+        first = outputFrame;
+        last = outputFrame + count;
+        return;
+    }
+
+    // Every output frame is centered on an input position, the filter spans half its taps on each side
+    qint64 firstCenter = (outputFrame * m_downFactor) / m_upFactor;
+    qint64 lastCenter = ((outputFrame + count - 1) * m_downFactor) / m_upFactor;
+
+    first = firstCenter - FILTER_TAPS / 2 + 1;
+    last = lastCenter + FILTER_TAPS / 2 + 1;
+}
+
+void SampleConverter::convert(const char *input, qint64 outputFrame, qint64 count, char *output)
+{
+    qint64 first;
+    qint64 last;
+    inputRange(outputFrame, count, first, last);
+
+    decode(input, last - first);
+
+    if (m_sampleRate != CD_SAMPLE_RATE)
+    {
+        resample(first, outputFrame, count);
+        quantize(m_resampled.constData(), count, output);
+    }
+    else
+        quantize(m_stereo.constData(), count, output);
+}
+
+qint64 SampleConverter::takeAllocations()
+{
+    qint64 count = m_allocations;
+    m_allocations = 0;
+    return count;
+}
+
+void SampleConverter::decode(const char *input, qint64 frames)
+{
+    qint64 count = frames * m_channelCount;
+
+    resizeBuffer(m_stereo, static_cast<int>(frames * 2), m_allocations);
+
+    if (m_channelCount == 1)
+        resizeBuffer(m_decoded, static_cast<int>(count), m_allocations);
+
+    float* output = (m_channelCount == 1) ? m_decoded.data() : m_stereo.data();
+    qint64 i = 0;
+
+    switch(m_format)
+    {
+    case SampleFormat::UInt8:
+        for(; i < count; ++i)
+            output[i] = (static_cast<float>(static_cast<uint8_t>(input[i])) - 128.0f) * (1.0f / 128.0f);
+        break;
+
+    case SampleFormat::Int16:
+#ifdef __SSE2__
+        for(; i + 8 <= count; i += 8)
+        {
+            // Sign extend by placing the samples in the high half of 32-bit lanes, then shifting them down
+            __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 2));
+            __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+            __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+            __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+        }
+#endif
+        for(; i < count; ++i)
+        {
+            uint16_t sample;
+            std::memcpy(&sample, input + i * 2, sizeof(sample));
+            output[i] = static_cast<float>(static_cast<int16_t>(LITTLE_ENDIAN_WORD(sample))) * (1.0f / 32768.0f);
+        }
+        break;
+
+    case SampleFormat::Int24:
+        for(; i < count; ++i)
+        {
+            const uint8_t* ptr = reinterpret_cast<const uint8_t*>(input + i * 3);
+            int32_t sample = static_cast<int32_t>((static_cast<uint32_t>(ptr[0]) << 8) | (static_cast<uint32_t>(ptr[1]) << 16) | (static_cast<uint32_t>(ptr[2]) << 24)) >> 8;
+            output[i] = static_cast<float>(sample) * (1.0f / 8388608.0f);
+        }
+        break;
+
+    case SampleFormat::Int32:
+        for(; i < count; ++i)
+            output[i] = static_cast<float>(static_cast<int32_t>(readLittleEndian32(input + i * 4))) * (1.0f / 2147483648.0f);
+        break;
+
+    case SampleFormat::Float32:
+        for(; i < count; ++i)
+        {
+            uint32_t bits = readLittleEndian32(input + i * 4);
+            std::memcpy(output + i, &bits, sizeof(float));
+        }
+        break;
+
+    case SampleFormat::Float64:
+        for(; i < count; ++i)
+        {
+            uint64_t bits = (static_cast<uint64_t>(readLittleEndian32(input + i * 8 + 4)) << 32) | readLittleEndian32(input + i * 8);
+            double sample;
+            std::memcpy(&sample, &bits, sizeof(double));
+            output[i] = static_cast<float>(sample);
+        }
+        break;
+    }
+
+    if (m_channelCount != 1)
+        return;
+
+    // Mono is played on both channels
+    const float* mono = m_decoded.constData();
+    float* stereo = m_stereo.data();
+    i = 0;
+
+#ifdef __SSE2__
+    for(; i + 4 <= frames; i += 4)
+    {
+        __m128 samples = _mm_loadu_ps(mono + i);
+        _mm_storeu_ps(stereo + i * 2, _mm_unpacklo_ps(samples, samples));
+        _mm_storeu_ps(stereo + i * 2 + 4, _mm_unpackhi_ps(samples, samples));
+    }
+#endif
+
+    for(; i < frames; ++i)
+    {
+        stereo[i * 2] = mono[i];
+        stereo[i * 2 + 1] = mono[i];
+    }
+}
+
+void SampleConverter::resample(qint64 firstInputFrame, qint64 outputFrame, qint64 count)
+{
+    resizeBuffer(m_resampled, static_cast<int>(count * 2), m_allocations);
+
+    const float* input = m_stereo.constData();
+    float* output = m_resampled.data();
+
+    for(qint64 n = 0; n < count; ++n)
+    {
+        qint64 position = (outputFrame + n) * m_downFactor;
+        qint64 center = position / m_upFactor;
+        qint64 phase = position % m_upFactor;
+
+        // Both tables are interleaved left / right, so one multiply handles two taps of both channels
+        const float* coefficients = m_filter.constData() + phase * FILTER_TAPS * 2;
+        const float* samples = input + (center - FILTER_TAPS / 2 + 1 - firstInputFrame) * 2;
+
+#ifdef __SSE2__
+        __m128 accumulator = _mm_setzero_ps();
+
+        for(qint64 k = 0; k < FILTER_TAPS * 2; k += 4)
+            accumulator = _mm_add_ps(accumulator, _mm_mul_ps(_mm_loadu_ps(coefficients + k), _mm_loadu_ps(samples + k)));
+
+        float sums[4];
+        _mm_storeu_ps(sums, accumulator);
+
+        output[n * 2] = sums[0] + sums[2];
+        output[n * 2 + 1] = sums[1] + sums[3];
+#else
+        float left = 0.0f;
+        float right = 0.0f;
+
+        for(qint64 k = 0; k < FILTER_TAPS * 2; k += 2)
+        {
+            left += coefficients[k] * samples[k];
+            right += coefficients[k + 1] * samples[k + 1];
+        }
+
+        output[n * 2] = left;
+        output[n * 2 + 1] = right;
+#endif
+    }
+}
+
+void SampleConverter::quantize(const float *input, qint64 frames, char *output)
+{
+    // Exact conversions (16 bits or less, same rate) do not need dither
+    bool dither = m_dither
+            && ((m_sampleRate != CD_SAMPLE_RATE)
+                || ((m_format != SampleFormat::UInt8) && (m_format != SampleFormat::Int16)));
+
+    // Triangular dither of one LSB peak, from the difference of two uniform values
+    auto nextDither = [this]() -> float
+    {
+        m_ditherState = m_ditherState * 1664525u + 1013904223u;
+        float a = static_cast<float>(m_ditherState >> 8) * (1.0f / 16777216.0f);
+        m_ditherState = m_ditherState * 1664525u + 1013904223u;
+        float b = static_cast<float>(m_ditherState >> 8) * (1.0f / 16777216.0f);
+        return a - b;
+    };
+
+    qint64 count = frames * 2;
+    qint64 i = 0;
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 minimum = _mm_set1_ps(-32768.0f);
+    const __m128 maximum = _mm_set1_ps(32767.0f);
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128 low = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+        __m128 high = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+
+        if (dither)
+        {
+            low = _mm_add_ps(low, _mm_set_ps(nextDither(), nextDither(), nextDither(), nextDither()));
+            high = _mm_add_ps(high, _mm_set_ps(nextDither(), nextDither(), nextDither(), nextDither()));
+        }
+
+        // Clamp before converting, out of range floats do not saturate
+        low = _mm_min_ps(_mm_max_ps(low, minimum), maximum);
+        high = _mm_min_ps(_mm_max_ps(high, minimum), maximum);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 2), _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high)));
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        float value = input[i] * 32768.0f;
+
+        if (dither)
+            value += nextDither();
+
+        value = std::min(std::max(value, -32768.0f), 32767.0f);
+
+        uint16_t sample = LITTLE_ENDIAN_WORD(static_cast<uint16_t>(static_cast<int16_t>(std::lrint(value))));
+        std::memcpy(output + i * 2, &sample, sizeof(sample));
+    }
+}
+
+void SampleConverter::buildFilter()
+{
+    // Low pass filter designed at the rate the input would have once upsampled, then split in phases
+    qint64 length = FILTER_TAPS * m_upFactor;
+    double cutoff = PASSBAND * 0.5 / static_cast<double>(std::max(m_upFactor, m_downFactor));
+    // Centered on a whole input sample, so the delay is exactly half the taps and is compensated in inputRange()
+    double center = static_cast<double>(length / 2);
+    double windowScale = 1.0 / besselI0(KAISER_BETA);
+
+    QVector<double> prototype(static_cast<int>(length));
+    double sum = 0.0;
+
+    for(qint64 i = 0; i < length; ++i)
+    {
+        double x = static_cast<double>(i) - center;
+        double sinc = (x == 0.0) ? 2.0 * cutoff : std::sin(2.0 * PI * cutoff * x) / (PI * x);
+        double ratio = x / center;
+        double window = besselI0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) * windowScale;
+
+        prototype[static_cast<int>(i)] = sinc * window;
+        sum += sinc * window;
+    }
+
+    // Every phase sees one input sample in upFactor, so each has a gain of one
+    double gain = static_cast<double>(m_upFactor) / sum;
+
+    // Phases are stored in input order with every coefficient duplicated for the left and right channels
+    m_filter.resize(static_cast<int>(m_upFactor * FILTER_TAPS * 2));
+
+    for(qint64 phase = 0; phase < m_upFactor; ++phase)
+    {
+        for(qint64 tap = 0; tap < FILTER_TAPS; ++tap)
+        {
+            float coefficient = static_cast<float>(prototype.at(static_cast<int>(phase + (FILTER_TAPS - 1 - tap) * m_upFactor)) * gain);
+            int index = static_cast<int>((phase * FILTER_TAPS + tap) * 2);
+
+            m_filter[index] = coefficient;
+            m_filter[index + 1] = coefficient;
+        }
+    }
+}
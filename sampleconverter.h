@@ -0,0 +1,99 @@
+#ifndef SAMPLECONVERTER_H
+#define SAMPLECONVERTER_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <cstdint>
+
+// Converts audio in any common PCM layout to CD audio: 16-bit little endian stereo at 44.1 kHz.
+// Samples are decoded to floats, mono is duplicated to both channels, other rates go through a polyphase
+// windowed sinc resampler, and the result is quantized to 16 bits with optional triangular dither.
+// Conversion is stateless between calls so the caller can seek freely: every call gets the input frames
+// reported by inputRange(), the filter history included.
+
+class SampleConverter
+{
+public:
+    /// Enum representing the sample formats supported
+    enum class SampleFormat
+    {
+        UInt8,    /// 8-bit unsigned integer
+        Int16,    /// 16-bit signed integer
+        Int24,    /// 24-bit signed integer, packed in 3 bytes
+        Int32,    /// 32-bit signed integer
+        Float32,  /// 32-bit IEEE float
+        Float64   /// 64-bit IEEE float
+    };
+
+    explicit SampleConverter();
+
+    /**
+     * @brief Set up the conversion.
+     * @return false if the format can not be converted.
+     */
+    bool setFormat(SampleFormat format, int channelCount, uint32_t sampleRate);
+
+    inline void setDither(bool dither)
+    {
+        m_dither = dither;
+    }
+
+    /**
+     * @brief Check if the input already is CD audio, and can be copied as is.
+     */
+    bool isPassthrough() const;
+
+    /**
+     * @brief Size of an input frame (one sample for every channel), in bytes.
+     */
+    int inputFrameSize() const;
+
+    /**
+     * @brief Number of output frames produced from a whole input.
+     */
+    qint64 outputFrames(qint64 inputFrames) const;
+
+    /**
+     * @brief Find the input frames needed to produce a range of output frames.
+     * @param[in] outputFrame First output frame.
+     * @param[in] count Number of output frames.
+     * @param[out] first First input frame needed, may be negative.
+     * @param[out] last Input frame after the last one needed, may be past the end of the input.
+     */
+    void inputRange(qint64 outputFrame, qint64 count, qint64& first, qint64& last) const;
+
+    /**
+     * @brief Convert a range of frames.
+     * @param input Input frames from inputRange(), frames outside of the input must be zeros.
+     * @param outputFrame First output frame.
+     * @param count Number of output frames.
+     * @param output Destination, count * 4 bytes.
+     */
+    void convert(const char* input, qint64 outputFrame, qint64 count, char* output);
+
+    /**
+     * @brief Return the number of heap allocations done since the last call, for statistics.
+     */
+    qint64 takeAllocations();
+
+protected:
+    void decode(const char* input, qint64 frames);
+    void resample(qint64 firstInputFrame, qint64 outputFrame, qint64 count);
+    void quantize(const float* input, qint64 frames, char* output);
+    void buildFilter();
+
+    SampleFormat m_format;
+    int m_channelCount;
+    uint32_t m_sampleRate;
+    qint64 m_upFactor;
+    qint64 m_downFactor;
+    bool m_dither;
+    uint32_t m_ditherState;
+    QVector<float> m_filter;
+    QVector<float> m_decoded;
+    QVector<float> m_stereo;
+    QVector<float> m_resampled;
+    qint64 m_allocations;
+};
+
+#endif // SAMPLECONVERTER_H
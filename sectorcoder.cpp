@@ -0,0 +1,252 @@
+#include "sectorcoder.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+// Reflected polynomial of the EDC, x^32 + x^31 + x^16 + x^15 + x^4 + x^3 + x + 1
+constexpr uint32_t EDC_POLYNOMIAL = 0xd8018001;
+
+// Field polynomial of the ECC, x^8 + x^4 + x^3 + x^2 + 1
+constexpr uint32_t ECC_POLYNOMIAL = 0x11d;
+
+constexpr size_t MODE1_EDC_OFFSET = 0x810;
+constexpr size_t MODE1_ZERO_OFFSET = 0x814;
+constexpr size_t ECC_P_OFFSET = 0x81c;
+constexpr size_t ECC_Q_OFFSET = 0x8c8;
+constexpr size_t ECC_SIZE = 0x930 - ECC_P_OFFSET;
+
+// P parity: 86 columns of 24 bytes, Q parity: 52 diagonals of 43 bytes, both from the header on
+constexpr int P_MAJOR_COUNT = 86;
+constexpr int P_MINOR_COUNT = 24;
+constexpr int Q_MAJOR_COUNT = 52;
+constexpr int Q_MINOR_COUNT = 43;
+
+struct CoderTables
+{
+    /// EDC of one byte, then of a byte followed by one to three zeros (slicing by four)
+    uint32_t edc[4][256];
+
+    /// Multiplication by x in the ECC field, and the inverse of multiplying by x + 1
+    uint8_t eccForward[256];
+    uint8_t eccBackward[256];
+
+    CoderTables()
+    {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t forward = (i << 1) ^ ((i & 0x80) ? ECC_POLYNOMIAL : 0);
+            eccForward[i] = static_cast<uint8_t>(forward);
+            eccBackward[i ^ forward] = static_cast<uint8_t>(i);
+
+            uint32_t value = i;
+            for(int bit = 0; bit < 8; ++bit)
+                value = (value >> 1) ^ ((value & 1) ? EDC_POLYNOMIAL : 0);
+
+            edc[0][i] = value;
+        }
+
+        for(int slice = 1; slice < 4; ++slice)
+        {
+            for(int i = 0; i < 256; ++i)
+                edc[slice][i] = (edc[slice - 1][i] >> 8) ^ edc[0][edc[slice - 1][i] & 0xff];
+        }
+    }
+};
+
+static const CoderTables TABLES;
+
+static void finishParity(const uint8_t* a, const uint8_t* b, int majorCount, uint8_t* destination)
+{
+    for(int major = 0; major < majorCount; ++major)
+    {
+        uint8_t parity = TABLES.eccBackward[TABLES.eccForward[a[major]] ^ b[major]];
+
+        destination[major] = parity;
+        destination[major + majorCount] = parity ^ b[major];
+    }
+}
+
+static void computeParity(const uint8_t* source, int majorCount, int minorCount, int majorMult, int minorIncrement, uint8_t* destination)
+{
+    int size = majorCount * minorCount;
+    uint8_t a[P_MAJOR_COUNT];
+    uint8_t b[P_MAJOR_COUNT];
+
+    for(int major = 0; major < majorCount; ++major)
+    {
+        int index = (major >> 1) * majorMult + (major & 1);
+        uint8_t eccA = 0;
+        uint8_t eccB = 0;
+
+        for(int minor = 0; minor < minorCount; ++minor)
+        {
+            uint8_t value = source[index];
+
+            index += minorIncrement;
+            if (index >= size)
+                index -= size;
+
+            eccA = TABLES.eccForward[eccA ^ value];
+            eccB ^= value;
+        }
+
+        a[major] = eccA;
+        b[major] = eccB;
+    }
+
+    finishParity(a, b, majorCount, destination);
+}
+
+static void computePParity(const uint8_t* source, uint8_t* destination)
+{
+    // Column m is made of the bytes m, m + 86, m + 172... so a row holds one byte of every column
+    uint8_t a[P_MAJOR_COUNT];
+    uint8_t b[P_MAJOR_COUNT];
+    int major = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i polynomial = _mm_set1_epi8(static_cast<char>(ECC_POLYNOMIAL & 0xff));
+
+    for(; major + 16 <= P_MAJOR_COUNT; major += 16)
+    {
+        __m128i eccA = zero;
+        __m128i eccB = zero;
+
+        for(int minor = 0; minor < P_MINOR_COUNT; ++minor)
+        {
+            __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + minor * P_MAJOR_COUNT + major));
+
+            eccA = _mm_xor_si128(eccA, row);
+            eccB = _mm_xor_si128(eccB, row);
+
+            // Multiplication by x: shift left, reducing the bytes whose top bit was set
+            __m128i carry = _mm_cmplt_epi8(eccA, zero);
+            eccA = _mm_xor_si128(_mm_add_epi8(eccA, eccA), _mm_and_si128(carry, polynomial));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(a + major), eccA);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(b + major), eccB);
+    }
+#endif
+
+    for(; major < P_MAJOR_COUNT; ++major)
+    {
+        uint8_t eccA = 0;
+        uint8_t eccB = 0;
+
+        for(int minor = 0; minor < P_MINOR_COUNT; ++minor)
+        {
+            uint8_t value = source[minor * P_MAJOR_COUNT + major];
+
+            eccA = TABLES.eccForward[eccA ^ value];
+            eccB ^= value;
+        }
+
+        a[major] = eccA;
+        b[major] = eccB;
+    }
+
+    finishParity(a, b, P_MAJOR_COUNT, destination);
+}
+
+static void storeEdc(uint8_t* destination, uint32_t value)
+{
+    destination[0] = static_cast<uint8_t>(value);
+    destination[1] = static_cast<uint8_t>(value >> 8);
+    destination[2] = static_cast<uint8_t>(value >> 16);
+    destination[3] = static_cast<uint8_t>(value >> 24);
+}
+
+uint32_t SectorCoder::edc(uint32_t edc, const uint8_t *data, size_t size)
+{
+    // The EDC is reflected, four bytes are folded in at once taken in little-endian order
+    while(size >= 4)
+    {
+        edc ^= static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        edc = TABLES.edc[3][edc & 0xff] ^ TABLES.edc[2][(edc >> 8) & 0xff] ^ TABLES.edc[1][(edc >> 16) & 0xff] ^ TABLES.edc[0][edc >> 24];
+
+        data += 4;
+        size -= 4;
+    }
+
+    while(size--)
+        edc = TABLES.edc[0][(edc ^ *data++) & 0xff] ^ (edc >> 8);
+
+    return edc;
+}
+
+void SectorCoder::generateEcc(uint8_t *sector, bool zeroAddress)
+{
+    uint8_t address[4];
+
+    if (zeroAddress)
+    {
+        std::memcpy(address, sector + 12, sizeof(address));
+        std::memset(sector + 12, 0, sizeof(address));
+    }
+
+    computePParity(sector + 12, sector + ECC_P_OFFSET);
+    computeParity(sector + 12, Q_MAJOR_COUNT, Q_MINOR_COUNT, P_MAJOR_COUNT, P_MAJOR_COUNT + 2, sector + ECC_Q_OFFSET);
+
+    if (zeroAddress)
+        std::memcpy(sector + 12, address, sizeof(address));
+}
+
+void SectorCoder::rebuildMode1(uint8_t *sector)
+{
+    sector[0] = 0;
+    std::memset(sector + 1, 0xff, 10);
+    sector[11] = 0;
+    sector[15] = 1;
+
+    storeEdc(sector + MODE1_EDC_OFFSET, edc(0, sector, MODE1_EDC_OFFSET));
+    std::memset(sector + MODE1_ZERO_OFFSET, 0, ECC_P_OFFSET - MODE1_ZERO_OFFSET);
+
+    generateEcc(sector, false);
+}
+
+void SectorCoder::rebuildMode2Form1(uint8_t *sector)
+{
+    // The subheader is stored twice
+    std::memcpy(sector + 0x10, sector + 0x14, 4);
+
+    storeEdc(sector + 0x818, edc(0, sector + 0x10, 0x808));
+    generateEcc(sector, true);
+}
+
+void SectorCoder::rebuildMode2Form2(uint8_t *sector)
+{
+    std::memcpy(sector + 0x10, sector + 0x14, 4);
+
+    storeEdc(sector + 0x92c, edc(0, sector + 0x10, 0x91c));
+}
+
+bool SectorCoder::isRebuildableMode1(const uint8_t *sector)
+{
+    static const uint8_t SYNC[12] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+
+    if ((std::memcmp(sector, SYNC, sizeof(SYNC)) != 0) || (sector[15] != 1))
+        return false;
+
+    for(size_t i = MODE1_ZERO_OFFSET; i < ECC_P_OFFSET; ++i)
+    {
+        if (sector[i])
+            return false;
+    }
+
+    uint8_t expected[4];
+    storeEdc(expected, edc(0, sector, MODE1_EDC_OFFSET));
+    if (std::memcmp(expected, sector + MODE1_EDC_OFFSET, sizeof(expected)) != 0)
+        return false;
+
+    // Sectors with damaged parity are kept as they are, a rebuilt one would differ
+    uint8_t copy[ECC_P_OFFSET + ECC_SIZE];
+    std::memcpy(copy, sector, ECC_P_OFFSET);
+    generateEcc(copy, false);
+
+    return std::memcmp(copy + ECC_P_OFFSET, sector + ECC_P_OFFSET, ECC_SIZE) == 0;
+}
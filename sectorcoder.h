@@ -0,0 +1,47 @@
+#ifndef SECTORCODER_H
+#define SECTORCODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// EDC and ECC of raw CD-ROM sectors (ECMA-130), shared by the export checks and the ECM codec.
+// The EDC is computed four bytes at a time from sliced tables, the P parity of the ECC sixteen
+// columns at a time with SSE2 when available; the Q parity walks diagonals and stays scalar.
+
+class SectorCoder
+{
+public:
+    /**
+     * @brief Update the EDC with a block of data.
+     * @param edc EDC of the data before the block, 0 to start.
+     */
+    static uint32_t edc(uint32_t edc, const uint8_t* data, size_t size);
+
+    /**
+     * @brief Compute the P and Q parity of a sector in place.
+     * @param zeroAddress Compute the parity with a zero header, as Mode 2 Form 1 sectors do.
+     */
+    static void generateEcc(uint8_t* sector, bool zeroAddress);
+
+    /**
+     * @brief Rebuild the sync pattern, EDC and ECC of a Mode 1 sector whose address and user data are set.
+     */
+    static void rebuildMode1(uint8_t* sector);
+
+    /**
+     * @brief Rebuild the EDC and ECC of a Mode 2 Form 1 sector whose subheader (at 0x14) and user data are set.
+     */
+    static void rebuildMode2Form1(uint8_t* sector);
+
+    /**
+     * @brief Rebuild the EDC of a Mode 2 Form 2 sector whose subheader (at 0x14) and user data are set.
+     */
+    static void rebuildMode2Form2(uint8_t* sector);
+
+    /**
+     * @brief Check if a raw sector is a Mode 1 sector whose sync, EDC and ECC can be rebuilt from its address and user data.
+     */
+    static bool isRebuildableMode1(const uint8_t* sector);
+};
+
+#endif // SECTORCODER_H
@@ -0,0 +1,913 @@
+#include "endian.h"
+#include "packedstruct.h"
+#include "sectorcoder.h"
+#include "streaminput.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+#include <QtDebug>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+    #include <zlib.h>
+#endif
+
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+#endif
+
+#ifdef Q_OS_WIN
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+// Size of the blocks handed from the decompression thread to the export
+constexpr int BLOCK_SIZE = 1024 * 1024;
+
+// Blocks decompressed ahead of the export at most, bounds the memory used by an input
+constexpr int MAX_QUEUED_BLOCKS = 8;
+
+// Size of the compressed reads
+constexpr qint64 SOURCE_READ_SIZE = 256 * 1024;
+
+// Size of the reads discarded when skipping forward
+constexpr qint64 SKIP_READ_SIZE = 64 * 1024;
+
+// Smallest gzip file, a 10 byte header and an 8 byte trailer
+constexpr qint64 GZIP_MIN_SIZE = 18;
+
+// Stored deflate blocks hold 65535 bytes after a 5 byte header, deflate never expands data more than they do
+constexpr qint64 DEFLATE_STORED_BLOCK_SIZE = 65535;
+constexpr qint64 DEFLATE_STORED_HEADER_SIZE = 5;
+
+// Zip compression methods
+constexpr int ZIP_STORED = 0;
+constexpr int ZIP_DEFLATED = 8;
+
+// ECM record types, and the size each sector of a record takes in the file and once decoded
+constexpr int ECM_RAW = 0;
+constexpr int ECM_MODE1 = 1;
+constexpr int ECM_MODE2_FORM1 = 2;
+constexpr int ECM_MODE2_FORM2 = 3;
+constexpr int ECM_PAYLOAD_SIZES[4] = { 1, 0x803, 0x804, 0x918 };
+constexpr int ECM_DECODED_SIZES[4] = { 1, 2352, 2336, 2336 };
+
+// Sectors of a record read at a time
+constexpr qint64 ECM_SECTORS_PER_READ = 256;
+
+// The end of central directory record is followed by a comment of 64 KiB at most
+constexpr qint64 ZIP_END_SEARCH_SIZE = 22 + 65535;
+
+constexpr uint32_t ZIP_LOCAL_HEADER_MAGIC = 0x04034b50;
+constexpr uint32_t ZIP_CENTRAL_HEADER_MAGIC = 0x02014b50;
+constexpr uint32_t ZIP_END_RECORD_MAGIC = 0x06054b50;
+
+// Sizes and offsets of this value are stored in a Zip64 extra field instead
+constexpr uint32_t ZIP64_MARKER = 0xffffffff;
+
+#ifdef _MSC_VER
+    #pragma pack(push,1)
+#endif
+
+struct PACKED ZipLocalHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t method;
+    uint16_t modificationTime;
+    uint16_t modificationDate;
+    uint32_t crc32;
+    uint32_t compressedSize;
+    uint32_t size;
+    uint16_t nameLength;
+    uint16_t extraLength;
+};
+
+static_assert(sizeof(ZipLocalHeader) == 30, "Struct Zip Local Header should be exactly 30 bytes!");
+
+struct PACKED ZipCentralHeader
+{
+    uint32_t magic;
+    uint16_t versionMadeBy;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t method;
+    uint16_t modificationTime;
+    uint16_t modificationDate;
+    uint32_t crc32;
+    uint32_t compressedSize;
+    uint32_t size;
+    uint16_t nameLength;
+    uint16_t extraLength;
+    uint16_t commentLength;
+    uint16_t diskNumber;
+    uint16_t internalAttributes;
+    uint32_t externalAttributes;
+    uint32_t localHeaderOffset;
+};
+
+static_assert(sizeof(ZipCentralHeader) == 46, "Struct Zip Central Header should be exactly 46 bytes!");
+
+struct PACKED ZipEndRecord
+{
+    uint32_t magic;
+    uint16_t diskNumber;
+    uint16_t directoryDisk;
+    uint16_t diskEntries;
+    uint16_t entries;
+    uint32_t directorySize;
+    uint32_t directoryOffset;
+    uint16_t commentLength;
+};
+
+static_assert(sizeof(ZipEndRecord) == 22, "Struct Zip End Record should be exactly 22 bytes!");
+
+#ifdef _MSC_VER
+    #pragma pack(pop)
+#endif
+
+static bool readEcmRecord(QIODevice& source, int& type, qint64& count)
+{
+    // Type in the low two bits, count - 1 in the next five then seven bits per byte while the top bit is set
+    char value;
+    if (!source.getChar(&value))
+        return false;
+
+    uint8_t byte = static_cast<uint8_t>(value);
+    uint32_t countValue = (byte >> 2) & 0x1f;
+    int bits = 5;
+
+    type = byte & 0x03;
+
+    while(byte & 0x80)
+    {
+        if ((bits > 26) || !source.getChar(&value))
+            return false;
+
+        byte = static_cast<uint8_t>(value);
+        countValue |= static_cast<uint32_t>(byte & 0x7f) << bits;
+        bits += 7;
+    }
+
+    // The largest count marks the end of the records
+    count = (countValue == 0xffffffff) ? -1 : static_cast<qint64>(countValue) + 1;
+
+    return true;
+}
+
+class StreamInputThread : public QThread
+{
+public:
+    explicit StreamInputThread(StreamInput& input) :
+        QThread(),
+        m_input(input)
+    { }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        m_input.produce();
+    }
+
+    StreamInput& m_input;
+};
+
+StreamInput::StreamInput(QObject *parent) :
+    QIODevice(parent),
+    m_entry(),
+    m_thread(Q_NULLPTR),
+    m_mutex(),
+    m_blockAdded(),
+    m_blockRemoved(),
+    m_blocks(),
+    m_block(),
+    m_blockPosition(0),
+    m_position(0),
+    m_producerDone(false),
+    m_producerError(),
+    m_stopFlag(false),
+    m_allocations(0)
+{ }
+
+StreamInput::~StreamInput()
+{
+    close();
+}
+
+bool StreamInput::open(const CdromToc::FileEntry &entry)
+{
+    close();
+
+#ifndef HAVE_ZLIB
+    if ((entry.source == CdromToc::FileSource::Gzip) || ((entry.source == CdromToc::FileSource::ZipMember) && (entry.compression != ZIP_STORED)))
+    {
+        setErrorString(QStringLiteral("Compressed images are not supported by this build."));
+        return false;
+    }
+#endif
+
+    m_entry = entry;
+    m_blocks.clear();
+    m_block.clear();
+    m_blockPosition = 0;
+    m_position = 0;
+    m_producerDone = false;
+    m_producerError.clear();
+    m_stopFlag = false;
+    m_allocations = 0;
+
+    if (!QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return false;
+
+    m_thread = new StreamInputThread(*this);
+    m_thread->start();
+
+    return true;
+}
+
+void StreamInput::close()
+{
+    if (m_thread)
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopFlag = true;
+            m_blockRemoved.wakeAll();
+        }
+
+        m_thread->wait();
+        delete m_thread;
+        m_thread = Q_NULLPTR;
+    }
+
+    m_blocks.clear();
+    m_block.clear();
+    m_blockPosition = 0;
+
+    if (isOpen())
+        QIODevice::close();
+}
+
+bool StreamInput::finish()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // The trailer follows the last block, which the thread only checks once it was queued
+    while(!m_producerDone)
+    {
+        m_blocks.clear();
+        m_blockRemoved.wakeAll();
+        m_blockAdded.wait(&m_mutex);
+    }
+
+    m_blocks.clear();
+
+    if (m_producerError.isEmpty())
+        return true;
+
+    setErrorString(m_producerError);
+    return false;
+}
+
+qint64 StreamInput::size() const
+{
+    return m_entry.fileSize;
+}
+
+qint64 StreamInput::pos() const
+{
+    return m_position;
+}
+
+bool StreamInput::seek(qint64 position)
+{
+    if (position < m_position)
+    {
+        setErrorString(QStringLiteral("Compressed images and pipes can only be read forward."));
+        return false;
+    }
+
+    QByteArray buffer(static_cast<int>(SKIP_READ_SIZE), Qt::Uninitialized);
+
+    while(m_position < position)
+    {
+        if (readData(buffer.data(), qMin(SKIP_READ_SIZE, position - m_position)) <= 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool StreamInput::atEnd() const
+{
+    return m_position >= m_entry.fileSize;
+}
+
+bool StreamInput::readFile(const CdromToc::FileEntry &entry, QByteArray &data)
+{
+    StreamInput input;
+    if (!input.open(entry))
+        return false;
+
+    data.resize(static_cast<int>(entry.fileSize));
+
+    return input.read(data.data(), data.size()) == data.size();
+}
+
+qint64 StreamInput::gzipSize(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || (file.size() < GZIP_MIN_SIZE))
+        return -1;
+
+    uint8_t magic[2];
+    if ((file.read(reinterpret_cast<char*>(magic), sizeof(magic)) != sizeof(magic)) || (magic[0] != 0x1f) || (magic[1] != 0x8b))
+        return -1;
+
+    // The trailer holds the size modulo 4 GiB, and files of several members only give the size of the last one.
+    // Neither is supported: a size smaller than the compressed data tells them here, the others fail once decompressed.
+    uint32_t size;
+    if (!file.seek(file.size() - 4) || (file.read(reinterpret_cast<char*>(&size), sizeof(size)) != sizeof(size)))
+        return -1;
+
+    qint64 compressedSize = file.size() - GZIP_MIN_SIZE;
+    qint64 maxOverhead = (compressedSize / DEFLATE_STORED_BLOCK_SIZE + 1) * DEFLATE_STORED_HEADER_SIZE;
+
+    if (LITTLE_ENDIAN_DWORD(size) + maxOverhead < compressedSize)
+    {
+        qCritical().noquote() << "File " << QFileInfo(fileName).fileName() << " holds more data than its gzip trailer tells: files of 4 GiB or more, and files of several members, are not supported.";
+        return -1;
+    }
+
+    return LITTLE_ENDIAN_DWORD(size);
+}
+
+qint64 StreamInput::ecmSize(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    char magic[4];
+    if ((file.read(magic, sizeof(magic)) != sizeof(magic)) || (std::memcmp(magic, "ECM", sizeof(magic)) != 0))
+        return -1;
+
+    // Only the record headers are read, the payloads are skipped
+    qint64 size = 0;
+
+    for(;;)
+    {
+        int type;
+        qint64 count;
+        if (!readEcmRecord(file, type, count))
+            return -1;
+
+        if (count < 0)
+            break;
+
+        size += count * ECM_DECODED_SIZES[type];
+
+        if (!file.seek(file.pos() + count * ECM_PAYLOAD_SIZES[type]))
+            return -1;
+    }
+
+    // The records are followed by the EDC of the decoded data
+    if (file.size() - file.pos() != 4)
+        return -1;
+
+    return size;
+}
+
+bool StreamInput::readZipDirectory(const QString &fileName, QVector<CdromToc::ZipMember> &members)
+{
+    members.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Could not open archive: " << file.errorString();
+        return false;
+    }
+
+    // Find the end of central directory record, looking back from the end of the archive
+    qint64 searchSize = qMin(file.size(), ZIP_END_SEARCH_SIZE);
+    file.seek(file.size() - searchSize);
+    QByteArray tail = file.read(searchSize);
+
+    ZipEndRecord endRecord;
+    int recordPosition = tail.lastIndexOf(QByteArrayLiteral("PK\x05\x06"));
+
+    if ((recordPosition < 0) || (tail.size() - recordPosition < static_cast<int>(sizeof(endRecord))))
+    {
+        qCritical().noquote() << "File " << QFileInfo(fileName).fileName() << " is not a zip archive.";
+        return false;
+    }
+
+    std::memcpy(&endRecord, tail.constData() + recordPosition, sizeof(endRecord));
+
+    if (LITTLE_ENDIAN_DWORD(endRecord.magic) != ZIP_END_RECORD_MAGIC)
+    {
+        qCritical().noquote() << "File " << QFileInfo(fileName).fileName() << " is not a zip archive.";
+        return false;
+    }
+
+    if ((LITTLE_ENDIAN_DWORD(endRecord.directoryOffset) == ZIP64_MARKER) || (LITTLE_ENDIAN_DWORD(endRecord.directorySize) == ZIP64_MARKER))
+    {
+        qCritical().noquote() << "Zip64 archives are not supported.";
+        return false;
+    }
+
+    QByteArray directory;
+    if (file.seek(LITTLE_ENDIAN_DWORD(endRecord.directoryOffset)))
+        directory = file.read(LITTLE_ENDIAN_DWORD(endRecord.directorySize));
+
+    if (directory.size() != static_cast<int>(LITTLE_ENDIAN_DWORD(endRecord.directorySize)))
+    {
+        qCritical().noquote() << "Could not read the central directory of the archive.";
+        return false;
+    }
+
+    int position = 0;
+    for(int i = 0; i < LITTLE_ENDIAN_WORD(endRecord.entries); ++i)
+    {
+        ZipCentralHeader header;
+        if (directory.size() - position < static_cast<int>(sizeof(header)))
+            break;
+
+        std::memcpy(&header, directory.constData() + position, sizeof(header));
+
+        int nameLength = LITTLE_ENDIAN_WORD(header.nameLength);
+        if ((LITTLE_ENDIAN_DWORD(header.magic) != ZIP_CENTRAL_HEADER_MAGIC) || (directory.size() - position - static_cast<int>(sizeof(header)) < nameLength))
+            break;
+
+        QByteArray encodedName = directory.mid(position + static_cast<int>(sizeof(header)), nameLength);
+        position += static_cast<int>(sizeof(header)) + nameLength + LITTLE_ENDIAN_WORD(header.extraLength) + LITTLE_ENDIAN_WORD(header.commentLength);
+
+        // Bit 11 of the flags tells the name is UTF-8, older archives use the DOS code page
+        uint16_t flags = LITTLE_ENDIAN_WORD(header.flags);
+        QString name = (flags & 0x0800) ? QString::fromUtf8(encodedName) : QString::fromLatin1(encodedName);
+
+        if (name.endsWith(QChar('/')))
+            continue;
+
+        int method = LITTLE_ENDIAN_WORD(header.method);
+        if ((flags & 0x0001) || ((method != ZIP_STORED) && (method != ZIP_DEFLATED)))
+        {
+            qWarning().noquote() << "Member " << name << " of the archive is encrypted or uses an unsupported compression method, skipped.";
+            continue;
+        }
+
+        uint32_t compressedSize = LITTLE_ENDIAN_DWORD(header.compressedSize);
+        uint32_t size = LITTLE_ENDIAN_DWORD(header.size);
+        uint32_t localHeaderOffset = LITTLE_ENDIAN_DWORD(header.localHeaderOffset);
+
+        if ((compressedSize == ZIP64_MARKER) || (size == ZIP64_MARKER) || (localHeaderOffset == ZIP64_MARKER))
+        {
+            qCritical().noquote() << "Zip64 archives are not supported.";
+            return false;
+        }
+
+        // The local header can have a different extra field, the data starts after it
+        ZipLocalHeader localHeader;
+        if (!file.seek(localHeaderOffset)
+                || (file.read(reinterpret_cast<char*>(&localHeader), sizeof(localHeader)) != sizeof(localHeader))
+                || (LITTLE_ENDIAN_DWORD(localHeader.magic) != ZIP_LOCAL_HEADER_MAGIC))
+        {
+            qCritical().noquote() << "Invalid local header for member " << name << " of the archive.";
+            return false;
+        }
+
+        qint64 dataOffset = static_cast<qint64>(localHeaderOffset) + sizeof(localHeader) + LITTLE_ENDIAN_WORD(localHeader.nameLength) + LITTLE_ENDIAN_WORD(localHeader.extraLength);
+
+        members.push_back({ name, method, dataOffset, compressedSize, size });
+    }
+
+    return true;
+}
+
+qint64 StreamInput::readData(char *data, qint64 maxSize)
+{
+    qint64 done = 0;
+
+    // Reads are served in full, the export asks for whole sectors
+    while(done < maxSize)
+    {
+        if (m_blockPosition >= m_block.size())
+        {
+            QMutexLocker locker(&m_mutex);
+
+            while(m_blocks.isEmpty() && !m_producerDone)
+                m_blockAdded.wait(&m_mutex);
+
+            if (m_blocks.isEmpty())
+            {
+                if (!m_producerError.isEmpty())
+                {
+                    setErrorString(m_producerError);
+
+                    if (!done)
+                        return -1;
+                }
+
+                break;
+            }
+
+            m_block = m_blocks.dequeue();
+            m_blockPosition = 0;
+            m_blockRemoved.wakeOne();
+
+            continue;
+        }
+
+        qint64 slice = qMin(maxSize - done, static_cast<qint64>(m_block.size() - m_blockPosition));
+        std::memcpy(data + done, m_block.constData() + m_blockPosition, static_cast<size_t>(slice));
+
+        m_blockPosition += static_cast<int>(slice);
+        done += slice;
+    }
+
+    m_position += done;
+
+    return done;
+}
+
+qint64 StreamInput::writeData(const char *data, qint64 size)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+
+    return -1;
+}
+
+void StreamInput::produce()
+{
+    QFile source;
+    QString error;
+    bool ok;
+
+    if (m_entry.source == CdromToc::FileSource::StandardInput)
+    {
+#ifdef Q_OS_WIN
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        ok = source.open(stdin, QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+    else
+    {
+        source.setFileName(m_entry.fileName);
+        ok = source.open(QIODevice::ReadOnly | QIODevice::Unbuffered) && source.seek(m_entry.sourceOffset);
+
+#ifdef Q_OS_LINUX
+        // Compressed data is read once, front to back
+        if (ok)
+            posix_fadvise(source.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    if (!ok)
+        error = source.errorString();
+    else if (m_entry.source == CdromToc::FileSource::Gzip)
+        ok = inflateData(source, -1, 15 + 32, error);
+    else if ((m_entry.source == CdromToc::FileSource::ZipMember) && (m_entry.compression == ZIP_DEFLATED))
+        ok = inflateData(source, m_entry.sourceSize, -15, error);
+    else if (m_entry.source == CdromToc::FileSource::ZipMember)
+        ok = copyData(source, m_entry.sourceSize, error);
+    else if (m_entry.source == CdromToc::FileSource::Ecm)
+        ok = decodeEcm(source, error);
+    else
+        ok = copyData(source, -1, error);
+
+    QMutexLocker locker(&m_mutex);
+
+    m_producerDone = true;
+    if (!ok && !m_stopFlag)
+        m_producerError = error.isEmpty() ? QStringLiteral("Could not read input data.") : error;
+
+    m_blockAdded.wakeAll();
+}
+
+bool StreamInput::inflateData(QIODevice &source, qint64 sourceSize, int windowBits, QString &error)
+{
+#ifdef HAVE_ZLIB
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+
+    // Window bits over 32 detect the gzip header, negative ones read raw deflate data as zip members hold
+    if (inflateInit2(&stream, windowBits) != Z_OK)
+    {
+        error = QStringLiteral("Could not initialize the decompression.");
+        return false;
+    }
+
+    QByteArray input(static_cast<int>(SOURCE_READ_SIZE), Qt::Uninitialized);
+    QByteArray output(BLOCK_SIZE, Qt::Uninitialized);
+
+    stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    stream.avail_out = BLOCK_SIZE;
+
+    // -1 reads the source up to its end
+    qint64 remaining = sourceSize;
+    qint64 produced = 0;
+    bool streamEnd = false;
+    bool ok = true;
+
+    while(ok)
+    {
+        if (stream.avail_in == 0)
+        {
+            qint64 read = 0;
+            if (remaining != 0)
+                read = source.read(input.data(), (remaining < 0) ? SOURCE_READ_SIZE : qMin(remaining, SOURCE_READ_SIZE));
+
+            if (read < 0)
+            {
+                error = source.errorString();
+                ok = false;
+                break;
+            }
+
+            if (read == 0)
+                break;
+
+            if (remaining > 0)
+                remaining -= read;
+
+            stream.next_in = reinterpret_cast<Bytef*>(input.data());
+            stream.avail_in = static_cast<uInt>(read);
+        }
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+
+        if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR))
+        {
+            error = QStringLiteral("Corrupted compressed data: %1").arg(QString::fromLatin1(stream.msg ? stream.msg : "unknown error"));
+            ok = false;
+            break;
+        }
+
+        if (result != Z_BUF_ERROR)
+            streamEnd = (result == Z_STREAM_END);
+
+        // Each block is handed over as is, a new one is allocated rather than detaching the queued one
+        if ((stream.avail_out == 0) || streamEnd)
+        {
+            output.resize(BLOCK_SIZE - static_cast<int>(stream.avail_out));
+            produced += output.size();
+
+            if (!output.isEmpty() && !pushBlock(output))
+            {
+                ok = false;
+                break;
+            }
+
+            output = QByteArray(BLOCK_SIZE, Qt::Uninitialized);
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = BLOCK_SIZE;
+        }
+
+        if (streamEnd)
+        {
+            // Zip members hold one deflate stream, gzip files can chain several members
+            if (windowBits < 0)
+                break;
+
+            inflateReset(&stream);
+        }
+    }
+
+    inflateEnd(&stream);
+
+    if (ok && !streamEnd)
+    {
+        error = QStringLiteral("Compressed data is truncated.");
+        ok = false;
+    }
+
+    // zlib checks the size of each member modulo 4 GiB only, the TOC was built from the size of the trailer
+    if (ok && (windowBits >= 0) && (produced != m_entry.fileSize))
+    {
+        error = QStringLiteral("The gzip file holds %1 bytes, not the %2 bytes its trailer tells: files of 4 GiB or more, and files of several members, are not supported.")
+                .arg(produced)
+                .arg(m_entry.fileSize);
+        ok = false;
+    }
+
+    return ok;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(sourceSize)
+    Q_UNUSED(windowBits)
+
+    error = QStringLiteral("Compressed images are not supported by this build.");
+    return false;
+#endif
+}
+
+bool StreamInput::copyData(QIODevice &source, qint64 sourceSize, QString &error)
+{
+    // -1 reads the source up to its end
+    qint64 remaining = sourceSize;
+
+    while(remaining != 0)
+    {
+        QByteArray block(BLOCK_SIZE, Qt::Uninitialized);
+        qint64 size = (remaining < 0) ? BLOCK_SIZE : qMin(remaining, static_cast<qint64>(BLOCK_SIZE));
+        qint64 done = 0;
+
+        // Pipes give partial reads, blocks are filled up to the end of the data
+        while(done < size)
+        {
+            qint64 read = source.read(block.data() + done, size - done);
+            if (read < 0)
+            {
+                error = source.errorString();
+                return false;
+            }
+
+            if (read == 0)
+                break;
+
+            done += read;
+        }
+
+        if (done > 0)
+        {
+            block.resize(static_cast<int>(done));
+            if (!pushBlock(block))
+                return false;
+        }
+
+        if (remaining > 0)
+            remaining -= done;
+
+        if (done < size)
+            break;
+    }
+
+    if (remaining > 0)
+    {
+        error = QStringLiteral("Input data is truncated.");
+        return false;
+    }
+
+    return true;
+}
+
+bool StreamInput::decodeEcm(QIODevice &source, QString &error)
+{
+    char magic[4];
+    if ((source.read(magic, sizeof(magic)) != sizeof(magic)) || (std::memcmp(magic, "ECM", sizeof(magic)) != 0))
+    {
+        error = QStringLiteral("Not an ECM file.");
+        return false;
+    }
+
+    QByteArray output(BLOCK_SIZE, Qt::Uninitialized);
+    int outputSize = 0;
+    uint32_t edc = 0;
+
+    // Decoded data goes to blocks of the queue, a new one is allocated once a block is handed over
+    auto emitData = [&](const uint8_t* data, int size) -> bool
+    {
+        edc = SectorCoder::edc(edc, data, static_cast<size_t>(size));
+
+        while(size > 0)
+        {
+            int slice = qMin(size, BLOCK_SIZE - outputSize);
+            std::memcpy(output.data() + outputSize, data, static_cast<size_t>(slice));
+
+            outputSize += slice;
+            data += slice;
+            size -= slice;
+
+            if (outputSize == BLOCK_SIZE)
+            {
+                if (!pushBlock(output))
+                    return false;
+
+                output = QByteArray(BLOCK_SIZE, Qt::Uninitialized);
+                outputSize = 0;
+            }
+        }
+
+        return true;
+    };
+
+    QByteArray payload;
+    uint8_t sector[2352];
+    std::memset(sector, 0, sizeof(sector));
+
+    for(;;)
+    {
+        int type;
+        qint64 count;
+        if (!readEcmRecord(source, type, count))
+        {
+            error = QStringLiteral("ECM data is truncated.");
+            return false;
+        }
+
+        if (count < 0)
+            break;
+
+        while(count > 0)
+        {
+            // Raw bytes are copied by blocks, sectors are rebuilt a batch at a time
+            qint64 slice = (type == ECM_RAW) ? qMin(count, static_cast<qint64>(BLOCK_SIZE)) : qMin(count, ECM_SECTORS_PER_READ);
+            int payloadSize = ECM_PAYLOAD_SIZES[type];
+
+            payload.resize(static_cast<int>(slice * payloadSize));
+            if (source.read(payload.data(), payload.size()) != payload.size())
+            {
+                error = QStringLiteral("ECM data is truncated.");
+                return false;
+            }
+
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(payload.constData());
+            bool ok = true;
+
+            if (type == ECM_RAW)
+                ok = emitData(data, payload.size());
+
+            for(qint64 i = 0; (type != ECM_RAW) && ok && (i < slice); ++i)
+            {
+                if (type == ECM_MODE1)
+                {
+                    // Address, then user data
+                    std::memcpy(sector + 12, data, 3);
+                    std::memcpy(sector + 16, data + 3, 2048);
+                    SectorCoder::rebuildMode1(sector);
+
+                    ok = emitData(sector, 2352);
+                }
+                else
+                {
+                    // Subheader, then user data; Mode 2 sectors are stored without their sync and header
+                    std::memcpy(sector + 0x14, data, static_cast<size_t>(payloadSize));
+
+                    if (type == ECM_MODE2_FORM1)
+                        SectorCoder::rebuildMode2Form1(sector);
+                    else
+                        SectorCoder::rebuildMode2Form2(sector);
+
+                    ok = emitData(sector + 0x10, 2336);
+                }
+
+                data += payloadSize;
+            }
+
+            if (!ok)
+                return false;
+
+            count -= slice;
+        }
+    }
+
+    if (outputSize && !pushBlock(output.left(outputSize)))
+        return false;
+
+    uint32_t expected;
+    if (source.read(reinterpret_cast<char*>(&expected), sizeof(expected)) != sizeof(expected))
+    {
+        error = QStringLiteral("ECM data is truncated.");
+        return false;
+    }
+
+    if (LITTLE_ENDIAN_DWORD(expected) != edc)
+    {
+        error = QStringLiteral("ECM data does not match its checksum.");
+        return false;
+    }
+
+    return true;
+}
+
+qint64 StreamInput::takeAllocations()
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 count = m_allocations;
+    m_allocations = 0;
+    return count;
+}
+
+bool StreamInput::pushBlock(const QByteArray &block)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while((m_blocks.size() >= MAX_QUEUED_BLOCKS) && !m_stopFlag)
+        m_blockRemoved.wait(&m_mutex);
+
+    if (m_stopFlag)
+        return false;
+
+    m_blocks.enqueue(block);
+    ++m_allocations;
+    m_blockAdded.wakeOne();
+
+    return true;
+}
@@ -0,0 +1,128 @@
+#ifndef STREAMINPUT_H
+#define STREAMINPUT_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "cdromtoc.h"
+
+class StreamInputThread;
+
+// Data file of a CUE sheet that can only be read forward: a gzip compressed file, a member of a zip
+// archive, an ECM file or the standard input. The data is decoded on its own thread, a few blocks ahead
+// of the export, and never lands on the disk. Seeking forward skips the data in between, seeking back fails.
+
+class StreamInput : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit StreamInput(QObject* parent = Q_NULLPTR);
+    virtual ~StreamInput() Q_DECL_OVERRIDE;
+
+    /**
+     * @brief Start reading a data file, from the source given by the TOC.
+     */
+    bool open(const CdromToc::FileEntry& entry);
+
+    void close() Q_DECL_OVERRIDE;
+
+    /**
+     * @brief Decode the rest of the file, discarding it, and check its trailer (gzip CRC, ECM EDC).
+     * @return false if the data is corrupt or could not be read, with the error string set.
+     */
+    bool finish();
+
+    bool isSequential() const Q_DECL_OVERRIDE
+    {
+        return true;
+    }
+
+    /**
+     * @brief Size of the decompressed data.
+     */
+    qint64 size() const Q_DECL_OVERRIDE;
+
+    qint64 pos() const Q_DECL_OVERRIDE;
+
+    /**
+     * @brief Move forward in the data, skipping what is in between.
+     * @return false if the position is behind the current one or past the end.
+     */
+    bool seek(qint64 position) Q_DECL_OVERRIDE;
+
+    bool atEnd() const Q_DECL_OVERRIDE;
+
+    /**
+     * @brief Read the whole data of a file, for small files such as CUE sheets.
+     */
+    static bool readFile(const CdromToc::FileEntry& entry, QByteArray& data);
+
+    /**
+     * @brief Size of the data of a gzip file, from its trailer. The trailer holds the size modulo 4 GiB, so larger files
+     * are not supported: they are rejected here when the size is clearly wrong, otherwise once the data is decompressed.
+     * @return Size in bytes, -1 if the file is not a gzip file or holds more data than its trailer tells.
+     */
+    static qint64 gzipSize(const QString& fileName);
+
+    /**
+     * @brief Size of the data of an ECM file once decoded, from its records.
+     * @return Size in bytes, -1 if the file is not a valid ECM file.
+     */
+    static qint64 ecmSize(const QString& fileName);
+
+    /**
+     * @brief List the members of a zip archive, from its central directory.
+     */
+    static bool readZipDirectory(const QString& fileName, QVector<CdromToc::ZipMember>& members);
+
+    /**
+     * @brief Return the number of blocks allocated by the decompression thread since the last call, for statistics.
+     */
+    qint64 takeAllocations();
+
+protected:
+    friend class StreamInputThread;
+
+    qint64 readData(char* data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 writeData(const char* data, qint64 size) Q_DECL_OVERRIDE;
+
+    void produce();
+    bool inflateData(QIODevice& source, qint64 sourceSize, int windowBits, QString& error);
+    bool copyData(QIODevice& source, qint64 sourceSize, QString& error);
+    bool decodeEcm(QIODevice& source, QString& error);
+    bool pushBlock(const QByteArray& block);
+
+    CdromToc::FileEntry m_entry;
+    StreamInputThread* m_thread;
+
+    QMutex m_mutex;
+    QWaitCondition m_blockAdded;
+    QWaitCondition m_blockRemoved;
+
+    /// Decompressed blocks waiting to be read
+    QQueue<QByteArray> m_blocks;
+
+    /// Block being read, and the position in it
+    QByteArray m_block;
+    int m_blockPosition;
+
+    /// Position in the decompressed data
+    qint64 m_position;
+
+    /// Set by the decompression thread once it is done, with an error message if it failed
+    bool m_producerDone;
+    QString m_producerError;
+
+    /// Set to stop the decompression thread
+    bool m_stopFlag;
+
+    /// Blocks allocated by the decompression thread, each queued block is a new one
+    qint64 m_allocations;
+};
+
+#endif // STREAMINPUT_H
@@ -0,0 +1,254 @@
+#include "packedstruct.h"
+#include "tarstream.h"
+
+#include <QDateTime>
+#include <QtDebug>
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+constexpr qint64 TAR_BLOCK_SIZE = 512;
+
+// Longest name held by the header itself, longer ones go to a pax extended header
+constexpr int TAR_NAME_SIZE = 100;
+
+#ifdef _MSC_VER
+    #pragma pack(push,1)
+#endif
+
+struct PACKED TarHeader
+{
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char modificationTime[12];
+    char checksum[8];
+    char type;
+    char linkName[100];
+    char magic[6];
+    char version[2];
+    char userName[32];
+    char groupName[32];
+    char deviceMajor[8];
+    char deviceMinor[8];
+    char prefix[155];
+    char padding[12];
+};
+
+static_assert(sizeof(TarHeader) == 512, "Struct Tar Header should be exactly 512 bytes!");
+
+#ifdef _MSC_VER
+    #pragma pack(pop)
+#endif
+
+static void writeNumber(char* field, int size, qint64 value)
+{
+    // Octal with a terminating NUL when it fits, the base-256 extension of GNU tar otherwise
+    if (value < (qint64(1) << (3 * (size - 1))))
+    {
+        std::snprintf(field, static_cast<size_t>(size), "%0*llo", size - 1, static_cast<unsigned long long>(value));
+        return;
+    }
+
+    for(int i = size - 1; i > 0; --i)
+    {
+        field[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+
+    field[0] = static_cast<char>(0x80);
+}
+
+TarStream::TarStream() :
+    m_file(),
+    m_inFile(false),
+    m_remaining(0),
+    m_padding(0),
+    m_modificationTime(0),
+    m_errorString()
+{ }
+
+TarStream::~TarStream()
+{
+    if (isOpen())
+        close();
+}
+
+bool TarStream::open(const QString &fileName)
+{
+    m_inFile = false;
+    m_remaining = 0;
+    m_padding = 0;
+    m_modificationTime = QDateTime::currentMSecsSinceEpoch() / 1000;
+    m_errorString.clear();
+
+    bool opened;
+
+    // Writes are large, buffering them again in QFile would only add a copy
+    if (fileName == QStringLiteral("-"))
+    {
+#ifdef Q_OS_WIN
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        opened = m_file.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+    }
+    else
+    {
+        m_file.setFileName(fileName);
+        opened = m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+    }
+
+    if (!opened)
+        m_errorString = m_file.errorString();
+
+    return opened;
+}
+
+bool TarStream::close()
+{
+    bool ok = endFile();
+
+    // The archive ends with two empty blocks
+    ok = ok && writePadding(2 * TAR_BLOCK_SIZE);
+
+    m_file.close();
+
+    return ok;
+}
+
+bool TarStream::beginFile(const QString &name, qint64 size)
+{
+    if (!endFile())
+        return false;
+
+    QByteArray encodedName = name.toUtf8();
+
+    if (encodedName.size() > TAR_NAME_SIZE)
+    {
+        // A pax record is "<length> path=<name>\n", its length counting its own digits
+        QByteArray record = " path=" + encodedName + "\n";
+        int length = record.size();
+        while(QByteArray::number(length).size() + record.size() != length)
+            length = QByteArray::number(length).size() + record.size();
+
+        record.prepend(QByteArray::number(length));
+
+        if (!writeHeader(QByteArrayLiteral("././@PaxHeader"), record.size(), 'x') || !writeFully(record.constData(), record.size()))
+            return false;
+
+        if (!writePadding((TAR_BLOCK_SIZE - record.size() % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE))
+            return false;
+    }
+
+    if (!writeHeader(encodedName.left(TAR_NAME_SIZE), size, '0'))
+        return false;
+
+    m_inFile = true;
+    m_remaining = size;
+    m_padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+
+    return true;
+}
+
+qint64 TarStream::write(const char *data, qint64 size)
+{
+    if (!m_inFile || (size > m_remaining))
+    {
+        m_errorString = QStringLiteral("Data past the size of the file in the archive.");
+        return -1;
+    }
+
+    if (!writeFully(data, size))
+        return -1;
+
+    m_remaining -= size;
+
+    return size;
+}
+
+bool TarStream::endFile()
+{
+    if (!m_inFile)
+        return true;
+
+    m_inFile = false;
+
+    if (m_remaining)
+        qWarning().noquote() << "File of the archive ended " << m_remaining << " bytes short, padded with zeros.";
+
+    return writePadding(m_remaining + m_padding);
+}
+
+bool TarStream::addFile(const QString &name, const QByteArray &data)
+{
+    return beginFile(name, data.size()) && (write(data.constData(), data.size()) == data.size()) && endFile();
+}
+
+bool TarStream::writeHeader(const QByteArray &name, qint64 size, char type)
+{
+    TarHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::memcpy(header.name, name.constData(), static_cast<size_t>(qMin(name.size(), TAR_NAME_SIZE)));
+    writeNumber(header.mode, sizeof(header.mode), 0644);
+    writeNumber(header.uid, sizeof(header.uid), 0);
+    writeNumber(header.gid, sizeof(header.gid), 0);
+    writeNumber(header.size, sizeof(header.size), size);
+    writeNumber(header.modificationTime, sizeof(header.modificationTime), m_modificationTime);
+    header.type = type;
+    std::memcpy(header.magic, "ustar", 6);
+    std::memcpy(header.version, "00", 2);
+
+    // The checksum is computed with its own field filled with spaces
+    std::memset(header.checksum, ' ', sizeof(header.checksum));
+
+    uint32_t checksum = 0;
+    for(size_t i = 0; i < sizeof(header); ++i)
+        checksum += reinterpret_cast<const uint8_t*>(&header)[i];
+
+    std::snprintf(header.checksum, sizeof(header.checksum), "%06o", checksum);
+    header.checksum[7] = ' ';
+
+    return writeFully(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+bool TarStream::writePadding(qint64 size)
+{
+    static const char ZEROS[TAR_BLOCK_SIZE] = {};
+
+    while(size > 0)
+    {
+        qint64 slice = qMin(size, TAR_BLOCK_SIZE);
+        if (!writeFully(ZEROS, slice))
+            return false;
+
+        size -= slice;
+    }
+
+    return true;
+}
+
+bool TarStream::writeFully(const char *data, qint64 size)
+{
+    // Pipes take partial writes
+    while(size > 0)
+    {
+        qint64 done = m_file.write(data, size);
+        if (done <= 0)
+        {
+            m_errorString = m_file.errorString();
+            return false;
+        }
+
+        data += done;
+        size -= done;
+    }
+
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef TARSTREAM_H
+#define TARSTREAM_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Writes files as a tar archive (POSIX ustar) to standard output, a pipe or a file, without ever seeking back.
+// The size of each file is given before its data, as it goes in the header; a file ending short is padded
+// with zeros to the announced size so the archive stays readable. Names longer than ustar allows are stored
+// in a pax extended header.
+
+class TarStream
+{
+public:
+    explicit TarStream();
+    ~TarStream();
+
+    // Non copyable
+    TarStream(const TarStream&) = delete;
+
+    // Non copyable
+    TarStream& operator=(const TarStream&) = delete;
+
+    /**
+     * @brief Open the archive.
+     * @param fileName File or pipe to write to, "-" for the standard output.
+     */
+    bool open(const QString& fileName);
+
+    /**
+     * @brief Write the archive trailer and close it.
+     */
+    bool close();
+
+    inline bool isOpen() const
+    {
+        return m_file.isOpen();
+    }
+
+    /**
+     * @brief Start a file of the archive, ending the previous one.
+     */
+    bool beginFile(const QString& name, qint64 size);
+
+    /**
+     * @brief Write data of the current file, up to the size it was started with.
+     */
+    qint64 write(const char* data, qint64 size);
+
+    /**
+     * @brief End the current file, padding it to its announced size.
+     */
+    bool endFile();
+
+    /**
+     * @brief Add a file whose data is known in full.
+     */
+    bool addFile(const QString& name, const QByteArray& data);
+
+    inline QString errorString() const
+    {
+        return m_errorString;
+    }
+
+protected:
+    bool writeHeader(const QByteArray& name, qint64 size, char type);
+    bool writePadding(qint64 size);
+    bool writeFully(const char* data, qint64 size);
+
+    QFile m_file;
+    bool m_inFile;
+
+    /// Bytes of the current file not written yet
+    qint64 m_remaining;
+
+    /// Bytes of padding after the current file, to end it on a block boundary
+    qint64 m_padding;
+
+    /// Modification time given to the files (seconds since the epoch)
+    qint64 m_modificationTime;
+
+    QString m_errorString;
+};
+
+#endif // TARSTREAM_H
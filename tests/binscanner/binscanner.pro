@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# TOC rebuilt from the sectors of a BIN image without a CUE sheet,
+# and the CUE sheet written for it. Run with "make check".
+#
+#-------------------------------------------------
+
+QT       = core testlib
+
+TARGET = tst_binscanner
+TEMPLATE = app
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+include(../../neocdcore.pri)
+
+SOURCES += tst_binscanner.cpp
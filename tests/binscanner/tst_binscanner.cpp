@@ -0,0 +1,181 @@
+#include <QByteArray>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cmath>
+
+#include "binscanner.h"
+#include "cdromtoc.h"
+#include "sectorcoder.h"
+
+constexpr int CDROM_SECTOR_SIZE = 2352;
+constexpr double PI = 3.14159265358979323846;
+
+// Data track from 00:02:00, two seconds and 50 frames of silence, then an audio track
+constexpr uint32_t DATA_SECTORS = 300;
+constexpr uint32_t GAP_SECTORS = 200;
+constexpr uint32_t AUDIO_SECTORS = 400;
+
+// Silence in the audio track, too short to split it (sectors from the start of the track)
+constexpr uint32_t PAUSE_FIRST = 100;
+constexpr uint32_t PAUSE_SECTORS = 50;
+
+class TestBinScanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void dataAndAudio();
+    void cueSheet();
+
+private:
+    static QByteArray dataSector(uint32_t position);
+    static QByteArray audioSector(uint32_t sector);
+    bool createImage(const QString& fileName);
+
+    QTemporaryDir m_directory;
+};
+
+void TestBinScanner::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+    QVERIFY(createImage(m_directory.filePath(QStringLiteral("image.bin"))));
+}
+
+QByteArray TestBinScanner::dataSector(uint32_t position)
+{
+    QByteArray sector(CDROM_SECTOR_SIZE, '\0');
+    uint8_t* data = reinterpret_cast<uint8_t*>(sector.data());
+
+    uint32_t m;
+    uint32_t s;
+    uint32_t f;
+    CdromToc::toMSF(position, m, s, f);
+
+    data[12] = static_cast<uint8_t>(((m / 10) << 4) | (m % 10));
+    data[13] = static_cast<uint8_t>(((s / 10) << 4) | (s % 10));
+    data[14] = static_cast<uint8_t>(((f / 10) << 4) | (f % 10));
+
+    for(int i = 16; i < 16 + 2048; ++i)
+        data[i] = static_cast<uint8_t>(i + position);
+
+    SectorCoder::rebuildMode1(data);
+
+    return sector;
+}
+
+QByteArray TestBinScanner::audioSector(uint32_t sector)
+{
+    // A tone on both channels, little endian 16-bit samples
+    QByteArray data(CDROM_SECTOR_SIZE, '\0');
+
+    for(int i = 0; i < CDROM_SECTOR_SIZE / 4; ++i)
+    {
+        int frame = static_cast<int>(sector) * (CDROM_SECTOR_SIZE / 4) + i;
+        int16_t sample = static_cast<int16_t>(8000.0 * std::sin(2.0 * PI * 440.0 * frame / 44100.0));
+
+        for(int channel = 0; channel < 2; ++channel)
+        {
+            data[4 * i + 2 * channel] = static_cast<char>(sample & 0xff);
+            data[4 * i + 2 * channel + 1] = static_cast<char>((sample >> 8) & 0xff);
+        }
+    }
+
+    return data;
+}
+
+bool TestBinScanner::createImage(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray silence(CDROM_SECTOR_SIZE, '\0');
+    bool ok = true;
+
+    for(uint32_t i = 0; i < DATA_SECTORS; ++i)
+        ok = ok && (file.write(dataSector(150 + i)) == CDROM_SECTOR_SIZE);
+
+    for(uint32_t i = 0; i < GAP_SECTORS; ++i)
+        ok = ok && (file.write(silence) == CDROM_SECTOR_SIZE);
+
+    for(uint32_t i = 0; i < AUDIO_SECTORS; ++i)
+    {
+        bool pause = (i >= PAUSE_FIRST) && (i < PAUSE_FIRST + PAUSE_SECTORS);
+        ok = ok && (file.write(pause ? silence : audioSector(i)) == CDROM_SECTOR_SIZE);
+    }
+
+    return ok;
+}
+
+void TestBinScanner::dataAndAudio()
+{
+    QString fileName = m_directory.filePath(QStringLiteral("image.bin"));
+
+    CdromToc toc;
+    QVERIFY(BinScanner::scan(fileName, toc));
+
+    QCOMPARE(toc.fileList().size(), 1);
+    QCOMPARE(toc.toc().size(), 3);
+    QCOMPARE(toc.firstTrack(), uint8_t(1));
+    QCOMPARE(toc.lastTrack(), uint8_t(2));
+    QCOMPARE(toc.totalSectors(), DATA_SECTORS + GAP_SECTORS + AUDIO_SECTORS);
+
+    const CdromToc::Entry* data = toc.findTocEntry(TrackIndex{1, 1});
+    const CdromToc::Entry* pregap = toc.findTocEntry(TrackIndex{2, 0});
+    const CdromToc::Entry* audio = toc.findTocEntry(TrackIndex{2, 1});
+    QVERIFY(data && pregap && audio);
+
+    QVERIFY(data->trackType == CdromToc::TrackType::Mode1_2352);
+    QCOMPARE(data->fileOffset, qint64(0));
+    QCOMPARE(data->trackLength, DATA_SECTORS);
+
+    // The silence after the data track is stored as the pregap of the audio track
+    QVERIFY(pregap->trackType == CdromToc::TrackType::AudioPCM);
+    QCOMPARE(pregap->fileIndex, 0);
+    QCOMPARE(pregap->fileOffset, qint64(DATA_SECTORS) * CDROM_SECTOR_SIZE);
+    QCOMPARE(pregap->trackLength, GAP_SECTORS);
+
+    // The short pause stays in the track
+    QVERIFY(audio->trackType == CdromToc::TrackType::AudioPCM);
+    QCOMPARE(audio->fileOffset, qint64(DATA_SECTORS + GAP_SECTORS) * CDROM_SECTOR_SIZE);
+    QCOMPARE(audio->trackLength, AUDIO_SECTORS);
+}
+
+void TestBinScanner::cueSheet()
+{
+    QString fileName = m_directory.filePath(QStringLiteral("image.bin"));
+    QString cueFileName = m_directory.filePath(QStringLiteral("image.cue"));
+
+    CdromToc toc;
+    QVERIFY(BinScanner::scan(fileName, toc));
+    QVERIFY(BinScanner::writeCueSheet(toc, cueFileName));
+
+    QFile cueFile(cueFileName);
+    QVERIFY(cueFile.open(QIODevice::ReadOnly));
+
+    QCOMPARE(cueFile.readAll(), QByteArray("FILE \"image.bin\" BINARY\n"
+                                           "  TRACK 01 MODE1/2352\n"
+                                           "    INDEX 01 00:00:00\n"
+                                           "  TRACK 02 AUDIO\n"
+                                           "    INDEX 00 00:04:00\n"
+                                           "    INDEX 01 00:06:50\n"));
+
+    // The CUE sheet gives back the TOC of the scan
+    CdromToc loaded;
+    QVERIFY(loaded.loadCueSheet(cueFileName));
+    QCOMPARE(loaded.toc().size(), toc.toc().size());
+
+    for(int i = 0; i < toc.toc().size(); ++i)
+    {
+        QVERIFY(loaded.toc().at(i).trackIndex == toc.toc().at(i).trackIndex);
+        QCOMPARE(loaded.toc().at(i).fileOffset, toc.toc().at(i).fileOffset);
+        QCOMPARE(loaded.toc().at(i).trackLength, toc.toc().at(i).trackLength);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestBinScanner)
+
+#include "tst_binscanner.moc"
@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Detection of byte swapped audio tracks, and the byte swap applied
+# to their samples by the export. Run with "make check".
+#
+#-------------------------------------------------
+
+QT       = core testlib
+
+TARGET = tst_byteorder
+TEMPLATE = app
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+include(../../neocdcore.pri)
+
+SOURCES += tst_byteorder.cpp
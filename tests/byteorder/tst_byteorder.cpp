@@ -0,0 +1,152 @@
+#include <QByteArray>
+#include <QtTest>
+
+#include <cmath>
+
+#include "byteorderdetector.h"
+#include "imagewriterworker.h"
+
+constexpr int CDROM_SECTOR_SIZE = 2352;
+
+constexpr double PI = 3.14159265358979323846;
+
+// A little more than the 300 sectors measured before the detection settles
+constexpr int AUDIO_SECTORS = 320;
+
+// Exposes the byte swap of the export to the test
+class ByteOrderWorker : public ImageWriterWorker
+{
+public:
+    using ImageWriterWorker::swapAudioBytes;
+};
+
+class TestByteOrder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void nativeAudio();
+    void swappedAudio();
+    void silence();
+    void reset();
+    void swapBytes();
+
+private:
+    static QByteArray generateAudio(int sectors);
+    static QByteArray swapReference(const QByteArray& data);
+    static void processSectors(ByteOrderDetector& detector, const QByteArray& data);
+};
+
+QByteArray TestByteOrder::generateAudio(int sectors)
+{
+    // Two tones, one per channel, as little endian 16-bit samples
+    QByteArray data(sectors * CDROM_SECTOR_SIZE, '\0');
+    int frames = data.size() / 4;
+
+    for(int i = 0; i < frames; ++i)
+    {
+        int16_t left = static_cast<int16_t>(8000.0 * std::sin(2.0 * PI * 440.0 * i / 44100.0));
+        int16_t right = static_cast<int16_t>(6000.0 * std::sin(2.0 * PI * 660.0 * i / 44100.0));
+
+        data[4 * i] = static_cast<char>(left & 0xff);
+        data[4 * i + 1] = static_cast<char>((left >> 8) & 0xff);
+        data[4 * i + 2] = static_cast<char>(right & 0xff);
+        data[4 * i + 3] = static_cast<char>((right >> 8) & 0xff);
+    }
+
+    return data;
+}
+
+QByteArray TestByteOrder::swapReference(const QByteArray &data)
+{
+    QByteArray swapped = data;
+
+    for(int i = 0; i + 1 < swapped.size(); i += 2)
+        std::swap(swapped[i], swapped[i + 1]);
+
+    return swapped;
+}
+
+void TestByteOrder::processSectors(ByteOrderDetector &detector, const QByteArray &data)
+{
+    // The export measures the track a sector at a time
+    for(int position = 0; (position < data.size()) && !detector.isSettled(); position += CDROM_SECTOR_SIZE)
+        detector.process(data.constData() + position, CDROM_SECTOR_SIZE);
+}
+
+void TestByteOrder::nativeAudio()
+{
+    ByteOrderDetector detector;
+    processSectors(detector, generateAudio(AUDIO_SECTORS));
+
+    QVERIFY(detector.isSettled());
+    QVERIFY(!detector.isSwapped());
+    QVERIFY(detector.ratio() < 1.0);
+}
+
+void TestByteOrder::swappedAudio()
+{
+    ByteOrderDetector detector;
+    processSectors(detector, swapReference(generateAudio(AUDIO_SECTORS)));
+
+    QVERIFY(detector.isSettled());
+    QVERIFY(detector.isSwapped());
+    QVERIFY(detector.ratio() > 4.0);
+}
+
+void TestByteOrder::silence()
+{
+    // Digital silence reads the same in both orders, it never settles the detection and is kept as it is
+    ByteOrderDetector detector;
+    processSectors(detector, QByteArray(AUDIO_SECTORS * CDROM_SECTOR_SIZE, '\0'));
+
+    QVERIFY(!detector.isSettled());
+    QVERIFY(!detector.isSwapped());
+    QCOMPARE(detector.ratio(), 1.0);
+
+    detector.finish();
+    QVERIFY(detector.isSettled());
+}
+
+void TestByteOrder::reset()
+{
+    ByteOrderDetector detector;
+    processSectors(detector, swapReference(generateAudio(AUDIO_SECTORS)));
+    QVERIFY(detector.isSwapped());
+
+    // A short track, settled at its end, after a swapped one
+    detector.reset();
+    QVERIFY(!detector.isSettled());
+
+    processSectors(detector, generateAudio(10));
+    detector.finish();
+
+    QVERIFY(detector.isSettled());
+    QVERIFY(!detector.isSwapped());
+}
+
+void TestByteOrder::swapBytes()
+{
+    QByteArray audio = generateAudio(2);
+
+    // Sizes below, at and past the 64 byte blocks of the vector loop
+    for(int size : { 0, 2, 62, 64, 66, 130, 4096 + 6, audio.size() })
+    {
+        QByteArray data = audio.left(size);
+
+        ByteOrderWorker::swapAudioBytes(data.data(), data.size());
+        QCOMPARE(data, swapReference(audio.left(size)));
+
+        ByteOrderWorker::swapAudioBytes(data.data(), data.size());
+        QCOMPARE(data, audio.left(size));
+    }
+
+    // Unaligned start
+    QByteArray data = audio.mid(2, 1000);
+    ByteOrderWorker::swapAudioBytes(data.data() + 2, data.size() - 2);
+    QCOMPARE(data.mid(2), swapReference(audio.mid(4, 998)));
+}
+
+QTEST_GUILESS_MAIN(TestByteOrder)
+
+#include "tst_byteorder.moc"
@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# EDC and ECC of raw sectors, and the ECM files written by the
+# export read back through the stream input. Run with "make check".
+#
+#-------------------------------------------------
+
+QT       = core testlib
+
+TARGET = tst_ecm
+TEMPLATE = app
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+include(../../neocdcore.pri)
+
+SOURCES += tst_ecm.cpp
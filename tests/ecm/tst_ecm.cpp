@@ -0,0 +1,168 @@
+#include <QByteArray>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cstring>
+
+#include "cdromtoc.h"
+#include "ecmwriter.h"
+#include "sectorcoder.h"
+#include "streaminput.h"
+
+constexpr int CDROM_SECTOR_SIZE = 2352;
+constexpr int CDROM_DATA_SIZE = 2048;
+constexpr int MODE1_EDC_OFFSET = 0x810;
+constexpr int ECC_OFFSET = 0x81c;
+
+// EDC and P / Q parity of the Mode 1 sector of knownSector(), from a bitwise reference implementation of ECMA-130
+static const char KNOWN_EDC[] = "35f4ee68";
+static const char KNOWN_ECC[] =
+        "2963ee530d6d074af7a462b07c64fa6d2a67e54bda4554435018ba19e4225f3d203a43f995bc5a6e1f7e56bdc4e0c539"
+        "d27d8c3c99876b0081d8afb0ccf7eb4d05e71142c50dcca8c6c0b004f8cec33ecef8f5f758df1e1f1bcedd9da7ea87f4"
+        "82b0ec34dacdda97652bead5b463c0681a99d4123f5df0aa4359c58cba8e2f2ef6bd5430a559e24d0c9ce9174be011e8"
+        "cf303c074b6d557711a2957d6c083610e6fa976efcb893bc4e55211fdaa85533462a66bcf1356ca2c4558c4e2d48183b"
+        "8758553863c2086b6deb3e2c449f3ca03f5da54c20dd8a3e841984892df9c058b0bf835f30ed910d63f4002214419e4f"
+        "ad76670068fed9f5b4bd4a92f00d3e9655e82165761388b62dd558ff437c08434afdced1";
+
+class TestEcm : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void mode1Sector();
+    void edcBlocks();
+    void damagedSector();
+    void roundTrip();
+
+private:
+    static QByteArray knownSector();
+    static QByteArray buildImage();
+
+    QTemporaryDir m_directory;
+};
+
+void TestEcm::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+}
+
+QByteArray TestEcm::knownSector()
+{
+    // Mode 1 sector at 00:02:00, the first sector of a disc, with a repeating pattern as user data
+    QByteArray sector(CDROM_SECTOR_SIZE, '\0');
+    uint8_t* data = reinterpret_cast<uint8_t*>(sector.data());
+
+    data[13] = 0x02;
+
+    for(int i = 0; i < CDROM_DATA_SIZE; ++i)
+        data[16 + i] = static_cast<uint8_t>(i * 7 + 3);
+
+    SectorCoder::rebuildMode1(data);
+
+    return sector;
+}
+
+QByteArray TestEcm::buildImage()
+{
+    // Mode 1 sectors with consecutive addresses, an audio sector, then a partial sector at the end
+    QByteArray image;
+
+    for(int i = 0; i < 20; ++i)
+    {
+        QByteArray sector = knownSector();
+        uint8_t* data = reinterpret_cast<uint8_t*>(sector.data());
+
+        data[14] = static_cast<uint8_t>(((i / 10) << 4) | (i % 10));
+        data[16] = static_cast<uint8_t>(i);
+        SectorCoder::rebuildMode1(data);
+
+        image.append(sector);
+    }
+
+    QByteArray audio(CDROM_SECTOR_SIZE, '\0');
+    for(int i = 0; i < audio.size(); ++i)
+        audio[i] = static_cast<char>((i * 131) >> 3);
+
+    image.append(audio);
+    image.append(audio.left(1000));
+
+    return image;
+}
+
+void TestEcm::mode1Sector()
+{
+    QByteArray sector = knownSector();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(sector.constData());
+
+    QCOMPARE(sector.mid(MODE1_EDC_OFFSET, 4).toHex(), QByteArray(KNOWN_EDC));
+    QCOMPARE(sector.mid(MODE1_EDC_OFFSET + 4, ECC_OFFSET - MODE1_EDC_OFFSET - 4), QByteArray(ECC_OFFSET - MODE1_EDC_OFFSET - 4, '\0'));
+    QCOMPARE(sector.mid(ECC_OFFSET).toHex(), QByteArray(KNOWN_ECC));
+
+    QVERIFY(SectorCoder::isRebuildableMode1(data));
+}
+
+void TestEcm::edcBlocks()
+{
+    // The sliced EDC gives the same result for any split of the data, aligned or not
+    QByteArray sector = knownSector();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(sector.constData());
+
+    uint32_t whole = SectorCoder::edc(0, data, MODE1_EDC_OFFSET);
+    QCOMPARE(QByteArray::number(whole, 16), QByteArray("68eef435"));
+
+    for(size_t split : { size_t(1), size_t(3), size_t(5), size_t(1029), size_t(MODE1_EDC_OFFSET - 1) })
+        QCOMPARE(SectorCoder::edc(SectorCoder::edc(0, data, split), data + split, MODE1_EDC_OFFSET - split), whole);
+}
+
+void TestEcm::damagedSector()
+{
+    // A rebuilt sector would not give back damaged data, so it is stored as it is
+    QByteArray sector = knownSector();
+    uint8_t* data = reinterpret_cast<uint8_t*>(sector.data());
+
+    data[ECC_OFFSET + 100] ^= 0x01;
+    QVERIFY(!SectorCoder::isRebuildableMode1(data));
+
+    sector = knownSector();
+    data = reinterpret_cast<uint8_t*>(sector.data());
+
+    data[100] ^= 0x01;
+    QVERIFY(!SectorCoder::isRebuildableMode1(data));
+}
+
+void TestEcm::roundTrip()
+{
+    QByteArray image = buildImage();
+    QString fileName = m_directory.filePath(QStringLiteral("image.bin.ecm"));
+
+    // Odd write sizes leave partial sectors between the calls
+    EcmWriter writer;
+    QVERIFY(writer.open(fileName));
+
+    for(int position = 0; position < image.size(); position += 5000)
+        QVERIFY(writer.write(image.constData() + position, qMin(5000, image.size() - position)));
+
+    QVERIFY(writer.close());
+    QCOMPARE(writer.sectorsRebuilt(), qint64(20));
+
+    // Rebuilt sectors only keep their address and user data
+    QVERIFY(QFileInfo(fileName).size() < image.size() - 20 * (CDROM_SECTOR_SIZE - CDROM_DATA_SIZE - 4));
+    QCOMPARE(StreamInput::ecmSize(fileName), qint64(image.size()));
+
+    CdromToc::FileEntry entry{ fileName, image.size(), CdromToc::FileSource::Ecm, 0, QFileInfo(fileName).size(), 0 };
+
+    StreamInput input;
+    QVERIFY(input.open(entry));
+
+    QByteArray decoded(image.size(), '\0');
+    QCOMPARE(input.read(decoded.data(), decoded.size()), qint64(image.size()));
+    QVERIFY(input.finish());
+
+    QVERIFY(decoded == image);
+}
+
+QTEST_GUILESS_MAIN(TestEcm)
+
+#include "tst_ecm.moc"
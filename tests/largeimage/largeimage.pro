@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Images past 4 GiB, built as sparse files: 64-bit TOC offsets,
+# progress scaling and RF64 track headers. Run with "make check".
+#
+#-------------------------------------------------
+
+QT       = core testlib
+
+TARGET = tst_largeimage
+TEMPLATE = app
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+include(../../neocdcore.pri)
+
+SOURCES += tst_largeimage.cpp
@@ -0,0 +1,341 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cstring>
+#include <limits>
+
+#include "cdromtoc.h"
+#include "endian.h"
+#include "exportoptions.h"
+#include "imagewriterworker.h"
+#include "outputfile.h"
+#include "wavstruct.h"
+
+// Sectors of the sparse images, their data is never read so the files take no space
+constexpr qint64 CDROM_SECTOR_SIZE = 2352;
+constexpr uint32_t BIN_SECTORS = 4000000;
+constexpr uint32_t WAV_SECTORS = 2500000;
+
+// Index 01 of track 2, 444:26:50, past 4 GiB in the data file
+constexpr uint32_t TRACK2_POSITION = 2000000;
+
+// Index 00 of track 2, 444:24:50
+constexpr uint32_t TRACK2_PREGAP = 1999850;
+
+// Exposes the helpers of the export to the test
+class LargeImageWorker : public ImageWriterWorker
+{
+public:
+    using ImageWriterWorker::writeWaveHeader;
+    using ImageWriterWorker::waveHeaderSize;
+    using ImageWriterWorker::isRf64Track;
+    using ImageWriterWorker::progressShift;
+    using ImageWriterWorker::buildTrackOutputPath;
+};
+
+class TestLargeImage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void binOffsets();
+    void wavOffsets();
+    void exportImage();
+    void progressScaling();
+    void rf64Tracks();
+    void rf64Header();
+    void riffHeader();
+
+private:
+    QString createBinImage(const QString& directory);
+    bool createSparseFile(const QString& fileName, qint64 size, const QByteArray& header = QByteArray());
+    bool writeFile(const QString& fileName, const QByteArray& data);
+    QByteArray readHeader(const QString& fileName, qint64 size);
+
+    QTemporaryDir m_directory;
+};
+
+void TestLargeImage::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+}
+
+bool TestLargeImage::createSparseFile(const QString &fileName, qint64 size, const QByteArray &header)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    // Growing the file with ftruncate leaves a hole instead of writing zeros
+    return (file.write(header) == header.size()) && file.resize(size);
+}
+
+bool TestLargeImage::writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && (file.write(data) == data.size());
+}
+
+QString TestLargeImage::createBinImage(const QString &directory)
+{
+    // Data track, then an audio track starting past 4 GiB in the BIN file and ending past 4 GiB of samples
+    QDir output(directory);
+
+    if (!output.mkpath(QStringLiteral(".")) || !createSparseFile(output.filePath(QStringLiteral("image.bin")), BIN_SECTORS * CDROM_SECTOR_SIZE))
+        return QString();
+
+    bool written = writeFile(output.filePath(QStringLiteral("image.cue")),
+                             "FILE \"image.bin\" BINARY\n"
+                             "  TRACK 01 MODE1/2352\n"
+                             "    INDEX 01 00:00:00\n"
+                             "  TRACK 02 AUDIO\n"
+                             "    INDEX 00 444:24:50\n"
+                             "    INDEX 01 444:26:50\n");
+
+    return written ? output.filePath(QStringLiteral("image.cue")) : QString();
+}
+
+QByteArray TestLargeImage::readHeader(const QString &fileName, qint64 size)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return file.read(size);
+}
+
+void TestLargeImage::binOffsets()
+{
+    QString cueFile = createBinImage(m_directory.path());
+    QVERIFY(!cueFile.isEmpty());
+
+    CdromToc toc;
+    QVERIFY(toc.loadCueSheet(cueFile));
+
+    QCOMPARE(toc.fileList().size(), 1);
+    QCOMPARE(toc.fileList().at(0).fileSize, BIN_SECTORS * CDROM_SECTOR_SIZE);
+
+    const CdromToc::Entry* data = toc.findTocEntry(TrackIndex{1, 1});
+    const CdromToc::Entry* pregap = toc.findTocEntry(TrackIndex{2, 0});
+    const CdromToc::Entry* audio = toc.findTocEntry(TrackIndex{2, 1});
+    QVERIFY(data && pregap && audio);
+
+    QCOMPARE(data->fileOffset, qint64(0));
+    QCOMPARE(data->trackLength, TRACK2_PREGAP);
+
+    QCOMPARE(pregap->fileOffset, TRACK2_PREGAP * CDROM_SECTOR_SIZE);
+    QCOMPARE(pregap->trackLength, TRACK2_POSITION - TRACK2_PREGAP);
+
+    // Both offsets are past 4 GiB, the last length comes from the file size
+    QVERIFY(audio->fileOffset > qint64(std::numeric_limits<uint32_t>::max()));
+    QCOMPARE(audio->fileOffset, TRACK2_POSITION * CDROM_SECTOR_SIZE);
+    QCOMPARE(audio->trackLength, BIN_SECTORS - TRACK2_POSITION);
+
+    QCOMPARE(toc.totalSectors(), BIN_SECTORS);
+}
+
+void TestLargeImage::wavOffsets()
+{
+    QString wavFileName = m_directory.filePath(QStringLiteral("audio.wav"));
+    qint64 dataSize = WAV_SECTORS * CDROM_SECTOR_SIZE;
+
+    // The RF64 header comes from the export, followed by a hole for the samples
+    {
+        LargeImageWorker worker;
+        OutputFile out;
+
+        QVERIFY(out.open(wavFileName, 0));
+        worker.writeWaveHeader(out, true, dataSize);
+        out.close();
+    }
+
+    QByteArray header = readHeader(wavFileName, LargeImageWorker::waveHeaderSize(true));
+    QVERIFY(createSparseFile(wavFileName, LargeImageWorker::waveHeaderSize(true) + dataSize, header));
+
+    QVERIFY(writeFile(m_directory.filePath(QStringLiteral("audio.cue")),
+                      "FILE \"audio.wav\" WAVE\n"
+                      "  TRACK 01 AUDIO\n"
+                      "    INDEX 01 00:00:00\n"
+                      "  TRACK 02 AUDIO\n"
+                      "    INDEX 01 444:26:50\n"));
+
+    CdromToc toc;
+    QVERIFY(toc.loadCueSheet(m_directory.filePath(QStringLiteral("audio.cue"))));
+
+    QCOMPARE(toc.fileList().at(0).fileSize, dataSize);
+
+    const CdromToc::Entry* first = toc.findTocEntry(TrackIndex{1, 1});
+    const CdromToc::Entry* second = toc.findTocEntry(TrackIndex{2, 1});
+    QVERIFY(first && second);
+
+    QCOMPARE(first->trackLength, TRACK2_POSITION);
+    QCOMPARE(second->fileOffset, TRACK2_POSITION * CDROM_SECTOR_SIZE);
+    QCOMPARE(second->trackLength, WAV_SECTORS - TRACK2_POSITION);
+}
+
+void TestLargeImage::exportImage()
+{
+    QString inputDirectory = m_directory.filePath(QStringLiteral("export-input"));
+    QString outputDirectory = m_directory.filePath(QStringLiteral("export-output"));
+
+    QString cueFile = createBinImage(inputDirectory);
+    QVERIFY(!cueFile.isEmpty());
+    QVERIFY(QDir().mkpath(outputDirectory));
+
+    CdromToc toc;
+    QVERIFY(toc.loadImage(cueFile));
+
+    // The zeros of the image are left as holes in the outputs too, silence is never measured for its byte order
+    ExportOptions options;
+    options.sparseOutput = true;
+    options.detectByteOrder = false;
+    options.prefetchFiles = 0;
+
+    LargeImageWorker worker;
+    worker.setOptions(options);
+    worker.start(outputDirectory, QStringLiteral("image"), &toc);
+
+    QVERIFY(worker.succeeded());
+
+    QString isoFileName = LargeImageWorker::buildTrackOutputPath(outputDirectory, TrackIndex{1, 1}, QStringLiteral("image"), QStringLiteral("iso"));
+    QString wavFileName = LargeImageWorker::buildTrackOutputPath(outputDirectory, TrackIndex{2, 1}, QStringLiteral("image"), QStringLiteral("wav"));
+
+    // The audio track holds its pregap, more than 4 GiB of samples
+    qint64 dataSize = (BIN_SECTORS - TRACK2_PREGAP) * CDROM_SECTOR_SIZE;
+    qint64 wavSize = LargeImageWorker::waveHeaderSize(true) + dataSize;
+
+    QCOMPARE(QFileInfo(isoFileName).size(), TRACK2_PREGAP * qint64(2048));
+    QCOMPARE(QFileInfo(wavFileName).size(), wavSize);
+
+    QByteArray header = readHeader(wavFileName, LargeImageWorker::waveHeaderSize(true));
+    QCOMPARE(qint64(header.size()), LargeImageWorker::waveHeaderSize(true));
+    QCOMPARE(header.left(4), QByteArray("RF64"));
+    QCOMPARE(header.mid(12, 4), QByteArray("ds64"));
+
+    WaveRiffHeader riff;
+    WaveChunkHeader ds64Header;
+    WaveDs64Chunk ds64;
+
+    const char* data = header.constData();
+    std::memcpy(&riff, data, sizeof(riff));
+    std::memcpy(&ds64Header, data + sizeof(riff), sizeof(ds64Header));
+    std::memcpy(&ds64, data + sizeof(riff) + sizeof(ds64Header), sizeof(ds64));
+
+    QCOMPARE(uint32_t(LITTLE_ENDIAN_DWORD(riff.fileSize)), uint32_t(0xffffffff));
+    QCOMPARE(uint64_t(LITTLE_ENDIAN_QWORD(ds64.riffSize)), uint64_t(wavSize - 8));
+    QCOMPARE(uint64_t(LITTLE_ENDIAN_QWORD(ds64.dataSize)), uint64_t(dataSize));
+    QCOMPARE(uint64_t(LITTLE_ENDIAN_QWORD(ds64.sampleCount)), uint64_t(dataSize / 4));
+}
+
+void TestLargeImage::progressScaling()
+{
+    constexpr qint64 intMax = std::numeric_limits<int>::max();
+
+    QCOMPARE(LargeImageWorker::progressShift(0), 0);
+    QCOMPARE(LargeImageWorker::progressShift(BIN_SECTORS), 0);
+    QCOMPARE(LargeImageWorker::progressShift(intMax), 0);
+    QCOMPARE(LargeImageWorker::progressShift(intMax + 1), 1);
+    QCOMPARE(LargeImageWorker::progressShift(std::numeric_limits<uint32_t>::max()), 1);
+    QCOMPARE(LargeImageWorker::progressShift(qint64(1) << 40), 10);
+
+    // The scaled range always fits the progress signals, and keeps as much precision as it can
+    const qint64 totals[] = { intMax, intMax + 1, std::numeric_limits<uint32_t>::max(), qint64(1) << 40, (qint64(1) << 40) + 12345 };
+    for(qint64 total : totals)
+    {
+        int shift = LargeImageWorker::progressShift(total);
+
+        QVERIFY((total >> shift) <= intMax);
+        QVERIFY(!shift || ((total >> (shift - 1)) > intMax));
+    }
+}
+
+void TestLargeImage::rf64Tracks()
+{
+    // RIFF sizes stop just below 4 GiB, leaving room for the header and trailer
+    constexpr uint32_t riffSectors = static_cast<uint32_t>((0xffffffffLL - 64 * 1024) / CDROM_SECTOR_SIZE);
+
+    QVERIFY(!LargeImageWorker::isRf64Track(0));
+    QVERIFY(!LargeImageWorker::isRf64Track(TRACK2_POSITION - TRACK2_PREGAP));
+    QVERIFY(!LargeImageWorker::isRf64Track(riffSectors));
+    QVERIFY(LargeImageWorker::isRf64Track(riffSectors + 1));
+    QVERIFY(LargeImageWorker::isRf64Track(BIN_SECTORS - TRACK2_PREGAP));
+    QVERIFY(LargeImageWorker::isRf64Track(std::numeric_limits<uint32_t>::max()));
+}
+
+void TestLargeImage::rf64Header()
+{
+    QString fileName = m_directory.filePath(QStringLiteral("rf64.wav"));
+    qint64 dataSize = (BIN_SECTORS - TRACK2_PREGAP) * CDROM_SECTOR_SIZE;
+    uint32_t trailerSize = 128;
+
+    {
+        LargeImageWorker worker;
+        OutputFile out;
+
+        QVERIFY(out.open(fileName, 0));
+        worker.writeWaveHeader(out, true, dataSize, trailerSize);
+        QCOMPARE(out.pos(), LargeImageWorker::waveHeaderSize(true));
+        out.close();
+    }
+
+    QByteArray header = readHeader(fileName, 1024);
+    QCOMPARE(qint64(header.size()), LargeImageWorker::waveHeaderSize(true));
+
+    WaveRiffHeader riff;
+    WaveChunkHeader ds64Header;
+    WaveDs64Chunk ds64;
+    WaveChunkHeader dataHeader;
+
+    const char* data = header.constData();
+    std::memcpy(&riff, data, sizeof(riff));
+    std::memcpy(&ds64Header, data + sizeof(riff), sizeof(ds64Header));
+    std::memcpy(&ds64, data + sizeof(riff) + sizeof(ds64Header), sizeof(ds64));
+    std::memcpy(&dataHeader, data + header.size() - sizeof(dataHeader), sizeof(dataHeader));
+
+    // The 32-bit sizes are all set, the actual ones are in the ds64 chunk which comes first
+    QCOMPARE(header.left(4), QByteArray("RF64"));
+    QCOMPARE(header.mid(8, 4), QByteArray("WAVE"));
+    QCOMPARE(header.mid(12, 4), QByteArray("ds64"));
+    QCOMPARE(header.mid(header.size() - 8, 4), QByteArray("data"));
+
+    QCOMPARE(uint32_t(LITTLE_ENDIAN_DWORD(riff.fileSize)), uint32_t(0xffffffff));
+    QCOMPARE(uint32_t(LITTLE_ENDIAN_DWORD(ds64Header.dataSize)), uint32_t(sizeof(WaveDs64Chunk)));
+    QCOMPARE(uint32_t(LITTLE_ENDIAN_DWORD(dataHeader.dataSize)), uint32_t(0xffffffff));
+
+    QCOMPARE(uint64_t(LITTLE_ENDIAN_QWORD(ds64.dataSize)), uint64_t(dataSize));
+    QCOMPARE(uint64_t(LITTLE_ENDIAN_QWORD(ds64.riffSize)), uint64_t(LargeImageWorker::waveHeaderSize(true) - 8 + dataSize + trailerSize));
+    QCOMPARE(uint64_t(LITTLE_ENDIAN_QWORD(ds64.sampleCount)), uint64_t(dataSize / 4));
+    QCOMPARE(uint32_t(LITTLE_ENDIAN_DWORD(ds64.tableLength)), uint32_t(0));
+}
+
+void TestLargeImage::riffHeader()
+{
+    QString fileName = m_directory.filePath(QStringLiteral("riff.wav"));
+    qint64 dataSize = (TRACK2_POSITION - TRACK2_PREGAP) * CDROM_SECTOR_SIZE;
+
+    {
+        LargeImageWorker worker;
+        OutputFile out;
+
+        QVERIFY(out.open(fileName, 0));
+        worker.writeWaveHeader(out, false, dataSize);
+        out.close();
+    }
+
+    QByteArray header = readHeader(fileName, 1024);
+    QCOMPARE(qint64(header.size()), LargeImageWorker::waveHeaderSize(false));
+    QCOMPARE(header.left(4), QByteArray("RIFF"));
+    QCOMPARE(header.mid(12, 4), QByteArray("fmt "));
+
+    WaveRiffHeader riff;
+    std::memcpy(&riff, header.constData(), sizeof(riff));
+    QCOMPARE(qint64(LITTLE_ENDIAN_DWORD(riff.fileSize)), LargeImageWorker::waveHeaderSize(false) - 8 + dataSize);
+}
+
+QTEST_GUILESS_MAIN(TestLargeImage)
+
+#include "tst_largeimage.moc"
@@ -0,0 +1,12 @@
+#-------------------------------------------------
+#
+# Tests of the core library, run with "make check".
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += largeimage \
+           ecm \
+           byteorder \
+           binscanner
@@ -4,20 +4,54 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+    #include <sys/mman.h>
+#endif
+
+// Identifiers of the RIFF headers and chunks
+constexpr uint32_t RIFF_MAGIC = 0x46464952;
+constexpr uint32_t RF64_MAGIC = 0x34364652;
+constexpr uint32_t BW64_MAGIC = 0x34365742;
+constexpr uint32_t WAVE_MAGIC = 0x45564157;
+constexpr uint32_t CHUNK_FMT = 0x20746d66;
+constexpr uint32_t CHUNK_DATA = 0x61746164;
+constexpr uint32_t CHUNK_DS64 = 0x34367364;
+
+// Size of a chunk whose actual size is in the ds64 chunk
+constexpr uint32_t LARGE_CHUNK_SIZE = 0xffffffff;
+
+// Format codes of the fmt chunk
+constexpr uint16_t WAVE_FORMAT_PCM = 1;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xfffe;
+
+constexpr qint64 CD_FRAME_SIZE = 4;
+
+// Granularity of the mapping when pages are released
+constexpr quintptr MAP_PAGE_SIZE = 4096;
 
 WavFile::WavFile() :
     m_file(nullptr),
+    m_map(nullptr),
+    m_fileSize(0),
     m_currentPosition(0),
     m_dataStart(0),
-    m_dataSize(0)
+    m_dataSize(0),
+    m_chunks(),
+    m_converter(),
+    m_inputBuffer(),
+    m_allocations(0)
 {
 }
 
 WavFile::~WavFile()
 {
+    cleanup();
 }
 
-bool WavFile::initialize(QFile *file)
+bool WavFile::initialize(InputFile *file)
 {
     cleanup();
 
@@ -26,64 +60,71 @@ bool WavFile::initialize(QFile *file)
     if (!m_file->isOpen())
         return false;
 
-    WaveRiffHeader waveHeader;
-    WaveChunkHeader chunkHeader;
-    WaveFmtChunk fmtHeader;
+    m_fileSize = m_file->size();
 
-    // First read in the header
-    if (file->read(reinterpret_cast<char*>(&waveHeader), sizeof(waveHeader)) < static_cast<qint64>(sizeof(waveHeader)))
+    // Mapping fails for files larger than the address space, headers and audio are then read from the file
+    if (m_fileSize > 0)
+        m_map = m_file->map(0, m_fileSize);
+
+    if (!scanChunks())
         return false;
 
-    // ... and check that indeed it is a WAVE file
-    if ((waveHeader.magic != LITTLE_ENDIAN_DWORD(0x46464952)) || (waveHeader.formatId != LITTLE_ENDIAN_DWORD(0x45564157)))
+    const Chunk* fmtChunk = findChunk(CHUNK_FMT);
+    const Chunk* dataChunk = findChunk(CHUNK_DATA);
+
+    if (!fmtChunk || !dataChunk || (fmtChunk->size < static_cast<qint64>(sizeof(WaveFmtChunk))))
         return false;
 
-    size_t fileSize = LITTLE_ENDIAN_DWORD(waveHeader.fileSize) + 8;
-    qint64 fmtHeaderPos = 0;
-    qint64 dataPos = 0;
-    qint64 dataSize = 0;
+    // Read in the fmt chunk
+    WaveFmtChunk fmtHeader;
+    if (!readAt(fmtChunk->offset, &fmtHeader, sizeof(fmtHeader)))
+        return false;
+
+    uint16_t audioFormat = LITTLE_ENDIAN_WORD(fmtHeader.audioFormat);
+    uint16_t bitsPerSample = LITTLE_ENDIAN_WORD(fmtHeader.bitsPerSample);
 
-    // Next, scan all chunks in the WAVE file looking for two specific chunks: fmt and data
-    do
+    // Extensible files keep the actual format code in the extension
+    if (audioFormat == WAVE_FORMAT_EXTENSIBLE)
     {
-        if (file->read(reinterpret_cast<char*>(&chunkHeader), sizeof(chunkHeader)) < static_cast<qint64>(sizeof(chunkHeader)))
+        WaveFmtExtension extension;
+        if ((fmtChunk->size < static_cast<qint64>(sizeof(fmtHeader) + sizeof(extension)))
+                || !readAt(fmtChunk->offset + static_cast<qint64>(sizeof(fmtHeader)), &extension, sizeof(extension)))
             return false;
 
-        qint64 currentPosition = file->pos();
-        if (currentPosition < 0)
-            return false;
+        audioFormat = LITTLE_ENDIAN_WORD(extension.subFormat);
+    }
 
-        if (static_cast<size_t>(currentPosition) + LITTLE_ENDIAN_DWORD(chunkHeader.dataSize) > fileSize)
-            return false;
-
-        if (chunkHeader.magic == LITTLE_ENDIAN_DWORD(0x20746d66))
-            fmtHeaderPos = currentPosition;
-        else if (chunkHeader.magic == LITTLE_ENDIAN_DWORD(0x61746164))
-        {
-            dataPos = currentPosition;
-            dataSize = LITTLE_ENDIAN_DWORD(chunkHeader.dataSize);
-        }
+    // ... and check that the audio can be converted to CD audio
+    SampleConverter::SampleFormat format;
 
-        file->skip(LITTLE_ENDIAN_DWORD(chunkHeader.dataSize));
-    } while((dataPos == 0) || (fmtHeaderPos == 0));
+    if ((audioFormat == WAVE_FORMAT_PCM) && (bitsPerSample == 8))
+        format = SampleConverter::SampleFormat::UInt8;
+    else if ((audioFormat == WAVE_FORMAT_PCM) && (bitsPerSample == 16))
+        format = SampleConverter::SampleFormat::Int16;
+    else if ((audioFormat == WAVE_FORMAT_PCM) && (bitsPerSample == 24))
+        format = SampleConverter::SampleFormat::Int24;
+    else if ((audioFormat == WAVE_FORMAT_PCM) && (bitsPerSample == 32))
+        format = SampleConverter::SampleFormat::Int32;
+    else if ((audioFormat == WAVE_FORMAT_IEEE_FLOAT) && (bitsPerSample == 32))
+        format = SampleConverter::SampleFormat::Float32;
+    else if ((audioFormat == WAVE_FORMAT_IEEE_FLOAT) && (bitsPerSample == 64))
+        format = SampleConverter::SampleFormat::Float64;
+    else
+        return false;
 
-    // Read in the fmt chunk
-    file->seek(fmtHeaderPos);
-    if (file->read(reinterpret_cast<char*>(&fmtHeader), sizeof(fmtHeader)) < static_cast<qint64>(sizeof(fmtHeader)))
+    if (!m_converter.setFormat(format, LITTLE_ENDIAN_WORD(fmtHeader.channelCount), LITTLE_ENDIAN_DWORD(fmtHeader.sampleRate)))
         return false;
 
-    // ... and check that the audio has the desired format
-    if ((fmtHeader.audioFormat != LITTLE_ENDIAN_WORD(1))
-            || (fmtHeader.bitsPerSample != LITTLE_ENDIAN_WORD(16))
-            || (fmtHeader.sampleRate != LITTLE_ENDIAN_DWORD(44100)))
+    if (LITTLE_ENDIAN_WORD(fmtHeader.bytesPerBlock) != m_converter.inputFrameSize())
         return false;
 
     // All ok!
     m_currentPosition = 0;
-    m_dataStart = dataPos;
-    m_dataSize = dataSize;
+    m_dataStart = dataChunk->offset;
+    m_dataSize = dataChunk->size;
 
-    file->seek(m_dataStart);
+    if (!m_map)
+        m_file->seek(m_dataStart);
 
     return true;
 }
@@ -93,21 +134,67 @@ qint64 WavFile::read(char *data, qint64 size)
     if ((!m_file) || (m_dataSize <= 0))
         return 0;
 
+    if (isConverted())
+        return readConverted(data, size);
+
     qint64 available = m_dataSize - m_currentPosition;
     qint64 slice = std::min(size, available);
+    qint64 done;
 
-    qint64 done = m_file->read(data, slice);
+    if (m_map)
+    {
+        std::memcpy(data, m_map + m_dataStart + m_currentPosition, static_cast<size_t>(slice));
+        done = slice;
+    }
+    else
+        done = m_file->read(data, slice);
 
     m_currentPosition += done;
 
     return done;
 }
 
+qint64 WavFile::view(const char *&data, qint64 size)
+{
+    if (!m_map || isConverted())
+        return -1;
+
+    qint64 slice = std::min(size, m_dataSize - m_currentPosition);
+
+    data = reinterpret_cast<const char*>(m_map + m_dataStart + m_currentPosition);
+    m_currentPosition += slice;
+
+    return slice;
+}
+
+void WavFile::releaseView(const char *data, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    // Only the pages fully inside the view are released, the others may still be needed by the next view
+    quintptr start = (reinterpret_cast<quintptr>(data) + MAP_PAGE_SIZE - 1) & ~(MAP_PAGE_SIZE - 1);
+    quintptr end = (reinterpret_cast<quintptr>(data) + static_cast<quintptr>(size)) & ~(MAP_PAGE_SIZE - 1);
+
+    if (m_map && (end > start))
+        madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+#endif
+}
+
 bool WavFile::seek(qint64 position)
 {
+    // Converted data is read from the matching input position on every read
+    if (isConverted())
+    {
+        m_currentPosition = std::min(position, length());
+        return true;
+    }
+
     m_currentPosition = std::min(position, m_dataSize);
 
-    m_file->seek(m_currentPosition + m_dataStart);
+    if (!m_map)
+        return m_file->seek(m_currentPosition + m_dataStart);
 
     return true;
 }
@@ -117,12 +204,200 @@ qint64 WavFile::length()
     if ((!m_file) || (m_dataSize <= 0))
         return 0;
 
+    if (isConverted())
+        return m_converter.outputFrames(m_dataSize / m_converter.inputFrameSize()) * CD_FRAME_SIZE;
+
     return m_dataSize;
 }
 
 void WavFile::cleanup()
 {
+    if (m_file && m_map)
+        m_file->unmap(m_map, m_fileSize);
+
+    m_file = nullptr;
+    m_map = nullptr;
+    m_fileSize = 0;
     m_currentPosition = 0;
     m_dataStart = 0;
     m_dataSize = 0;
+    m_chunks.clear();
+    m_converter.setFormat(SampleConverter::SampleFormat::Int16, 2, 44100);
+    m_inputBuffer.clear();
+}
+
+const WavFile::Chunk *WavFile::findChunk(uint32_t magic) const
+{
+    for(const Chunk& chunk : m_chunks)
+    {
+        if (chunk.magic == magic)
+            return &chunk;
+    }
+
+    return nullptr;
+}
+
+qint64 WavFile::takeAllocations()
+{
+    qint64 count = m_allocations;
+    m_allocations = 0;
+    return count + m_converter.takeAllocations();
+}
+
+bool WavFile::scanChunks()
+{
+    WaveRiffHeader waveHeader;
+
+    // First read in the header
+    if (!readAt(0, &waveHeader, sizeof(waveHeader)))
+        return false;
+
+    uint32_t magic = LITTLE_ENDIAN_DWORD(waveHeader.magic);
+
+    // ... and check that indeed it is a WAVE file
+    if (((magic != RIFF_MAGIC) && (magic != RF64_MAGIC) && (magic != BW64_MAGIC)) || (LITTLE_ENDIAN_DWORD(waveHeader.formatId) != WAVE_MAGIC))
+        return false;
+
+    bool isLarge = (magic != RIFF_MAGIC);
+    qint64 end = m_fileSize;
+
+    if (!isLarge)
+        end = std::min(end, static_cast<qint64>(LITTLE_ENDIAN_DWORD(waveHeader.fileSize)) + 8);
+
+    // Sizes of the large chunks, from the ds64 chunk
+    qint64 dataSize = -1;
+    QVector<WaveDs64TableEntry> largeSizes;
+
+    qint64 offset = sizeof(waveHeader);
+
+    // Next, index all chunks of the file
+    while(offset + static_cast<qint64>(sizeof(WaveChunkHeader)) <= end)
+    {
+        WaveChunkHeader chunkHeader;
+        if (!readAt(offset, &chunkHeader, sizeof(chunkHeader)))
+            return false;
+
+        offset += sizeof(chunkHeader);
+
+        Chunk chunk = { LITTLE_ENDIAN_DWORD(chunkHeader.magic), offset, LITTLE_ENDIAN_DWORD(chunkHeader.dataSize) };
+
+        // The ds64 chunk has to come first in RF64 and BW64 files
+        if (isLarge && m_chunks.isEmpty())
+        {
+            WaveDs64Chunk ds64;
+            if ((chunk.magic != CHUNK_DS64) || (chunk.size < static_cast<qint64>(sizeof(ds64))) || !readAt(offset, &ds64, sizeof(ds64)))
+                return false;
+
+            end = std::min(end, static_cast<qint64>(LITTLE_ENDIAN_QWORD(ds64.riffSize)) + 8);
+            dataSize = static_cast<qint64>(LITTLE_ENDIAN_QWORD(ds64.dataSize));
+
+            qint64 tablePosition = offset + static_cast<qint64>(sizeof(ds64));
+            uint32_t tableLength = LITTLE_ENDIAN_DWORD(ds64.tableLength);
+
+            if (tablePosition + tableLength * static_cast<qint64>(sizeof(WaveDs64TableEntry)) > offset + chunk.size)
+                return false;
+
+            largeSizes.resize(static_cast<int>(tableLength));
+            if (!readAt(tablePosition, largeSizes.data(), tableLength * static_cast<qint64>(sizeof(WaveDs64TableEntry))))
+                return false;
+        }
+        else if (isLarge && (chunk.size == LARGE_CHUNK_SIZE))
+        {
+            if (chunk.magic == CHUNK_DATA)
+                chunk.size = dataSize;
+            else
+            {
+                auto i = std::find_if(largeSizes.cbegin(), largeSizes.cend(), [&chunk](const WaveDs64TableEntry& entry) {
+                    return LITTLE_ENDIAN_DWORD(entry.magic) == chunk.magic;
+                });
+
+                if (i == largeSizes.cend())
+                    return false;
+
+                chunk.size = static_cast<qint64>(LITTLE_ENDIAN_QWORD(i->dataSize));
+            }
+        }
+
+        if ((chunk.size < 0) || (offset + chunk.size > end))
+            return false;
+
+        m_chunks.push_back(chunk);
+
+        // Chunks are padded to an even size
+        offset += chunk.size + (chunk.size & 1);
+    }
+
+    return true;
+}
+
+bool WavFile::readAt(qint64 offset, void *data, qint64 size)
+{
+    if ((offset < 0) || (offset + size > m_fileSize))
+        return false;
+
+    if (m_map)
+    {
+        std::memcpy(data, m_map + offset, static_cast<size_t>(size));
+        return true;
+    }
+
+    return m_file->seek(offset) && (m_file->read(static_cast<char*>(data), size) == size);
+}
+
+qint64 WavFile::readConverted(char *data, qint64 size)
+{
+    qint64 outputFrame = m_currentPosition / CD_FRAME_SIZE;
+    qint64 count = std::min(size, length() - m_currentPosition) / CD_FRAME_SIZE;
+
+    if (count <= 0)
+        return 0;
+
+    qint64 first;
+    qint64 last;
+    m_converter.inputRange(outputFrame, count, first, last);
+
+    int frameSize = m_converter.inputFrameSize();
+    qint64 inputFrames = m_dataSize / frameSize;
+
+    // Filter history before the start or after the end of the data is silence
+    qint64 readFirst = std::max(first, qint64(0));
+    qint64 readLast = std::min(last, inputFrames);
+    const char* input;
+
+    if (m_map && (readFirst == first) && (readLast == last))
+    {
+        // The whole range is in the mapped data, it is converted without staging
+        input = reinterpret_cast<const char*>(m_map + m_dataStart + first * frameSize);
+    }
+    else
+    {
+        // The buffer only grows, so steady state reads do not allocate
+        qint64 bufferSize = (last - first) * frameSize;
+        if (m_inputBuffer.size() < bufferSize)
+        {
+            m_inputBuffer.resize(static_cast<int>(bufferSize));
+            ++m_allocations;
+        }
+
+        if (readLast <= readFirst)
+            std::memset(m_inputBuffer.data(), 0, static_cast<size_t>(bufferSize));
+        else
+        {
+            qint64 head = (readFirst - first) * frameSize;
+            qint64 bytes = (readLast - readFirst) * frameSize;
+
+            std::memset(m_inputBuffer.data(), 0, static_cast<size_t>(head));
+            std::memset(m_inputBuffer.data() + head + bytes, 0, static_cast<size_t>(bufferSize - head - bytes));
+
+            if (!readAt(m_dataStart + readFirst * frameSize, m_inputBuffer.data() + head, bytes))
+                return -1;
+        }
+
+        input = m_inputBuffer.constData();
+    }
+
+    m_converter.convert(input, outputFrame, count, data);
+    m_currentPosition += count * CD_FRAME_SIZE;
+
+    return count * CD_FRAME_SIZE;
 }
@@ -1,11 +1,33 @@
 #ifndef WAVFILE_H
 #define WAVFILE_H
 
-#include <QFile>
+#include <QByteArray>
+#include <QVector>
+
+#include "inputfile.h"
+#include "sampleconverter.h"
+
+// Audio data of a WAV file, as CD audio.
+// The file is memory mapped and its chunks are indexed with a single scan of the headers. RIFF, RF64 and BW64
+// files are supported, the last two carrying 64-bit chunk sizes in a ds64 chunk.
+// Files in other formats (8 to 32-bit integer, float, mono, other sample rates) are converted while
+// they are read; positions and lengths are then those of the converted audio.
 
 class WavFile
 {
 public:
+    struct Chunk
+    {
+        /// Chunk identifier, as a little endian value read from the file
+        uint32_t magic;
+
+        /// Offset of the chunk data in the file
+        qint64 offset;
+
+        /// Size of the chunk data, taken from the ds64 chunk for large chunks
+        qint64 size;
+    };
+
     WavFile();
     ~WavFile();
 
@@ -15,21 +37,98 @@ public:
     // Non copyable
     WavFile& operator=(const WavFile&) = delete;
 
-    bool initialize(QFile* file);
+    bool initialize(InputFile* file);
 
     qint64 read(char *data, qint64 size);
 
+    /**
+     * @brief Return the next bytes of audio straight from the mapped file, without copying them.
+     * @param data Set to the start of the audio, valid until cleanup() is called.
+     * @param size Maximum number of bytes wanted.
+     * @return Number of bytes available at data, or -1 if the audio can not be viewed and read() must be used.
+     */
+    qint64 view(const char*& data, qint64 size);
+
+    /**
+     * @brief Unmap the pages of a view once they are not needed anymore, so they can leave the page cache.
+     */
+    void releaseView(const char* data, qint64 size);
+
     bool seek(qint64 position);
 
     qint64 length();
 
     void cleanup();
 
+    inline InputFile* file() const
+    {
+        return m_file;
+    }
+
+    /**
+     * @brief Offset of the audio data in the file.
+     */
+    inline qint64 dataOffset() const
+    {
+        return m_dataStart;
+    }
+
+    /**
+     * @brief Current position in the audio data.
+     */
+    inline qint64 position() const
+    {
+        return m_currentPosition;
+    }
+
+    /**
+     * @brief Check if the audio is converted while read, in which case the file data can not be copied as is.
+     */
+    inline bool isConverted() const
+    {
+        return !m_converter.isPassthrough();
+    }
+
+    inline bool isMapped() const
+    {
+        return m_map != Q_NULLPTR;
+    }
+
+    inline void setDither(bool dither)
+    {
+        m_converter.setDither(dither);
+    }
+
+    /**
+     * @brief All chunks of the file, in file order.
+     */
+    inline const QVector<Chunk>& chunks() const
+    {
+        return m_chunks;
+    }
+
+    const Chunk* findChunk(uint32_t magic) const;
+
+    /**
+     * @brief Return the number of heap allocations done by the conversion since the last call, for statistics.
+     */
+    qint64 takeAllocations();
+
 protected:
-    QFile* m_file;
+    bool scanChunks();
+    bool readAt(qint64 offset, void* data, qint64 size);
+    qint64 readConverted(char *data, qint64 size);
+
+    InputFile* m_file;
+    uchar* m_map;
+    qint64 m_fileSize;
     qint64 m_currentPosition;
     qint64 m_dataStart;
     qint64 m_dataSize;
+    QVector<Chunk> m_chunks;
+    SampleConverter m_converter;
+    QByteArray m_inputBuffer;
+    qint64 m_allocations;
 };
 
 #endif // WAVFILE_H
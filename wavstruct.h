@@ -30,6 +30,17 @@ struct PACKED WaveFmtChunk
 
 static_assert(sizeof(WaveFmtChunk) == 16, "Struct Wave Format Header should be exactly 16 bytes!");
 
+struct PACKED WaveFmtExtension
+{
+    uint16_t extensionSize;
+    uint16_t validBitsPerSample;
+    uint32_t channelMask;
+    uint16_t subFormat;
+    uint8_t subFormatGuid[14];
+};
+
+static_assert(sizeof(WaveFmtExtension) == 24, "Struct Wave Format Extension should be exactly 24 bytes!");
+
 struct PACKED WaveChunkHeader
 {
     uint32_t magic;
@@ -38,6 +49,24 @@ struct PACKED WaveChunkHeader
 
 static_assert(sizeof(WaveChunkHeader) == 8, "Struct Wave Chunk Header should be exactly 8 bytes!");
 
+struct PACKED WaveDs64Chunk
+{
+    uint64_t riffSize;
+    uint64_t dataSize;
+    uint64_t sampleCount;
+    uint32_t tableLength;
+};
+
+static_assert(sizeof(WaveDs64Chunk) == 28, "Struct Wave ds64 Chunk should be exactly 28 bytes!");
+
+struct PACKED WaveDs64TableEntry
+{
+    uint32_t magic;
+    uint64_t dataSize;
+};
+
+static_assert(sizeof(WaveDs64TableEntry) == 12, "Struct Wave ds64 Table Entry should be exactly 12 bytes!");
+
 #ifdef _MSC_VER
     #pragma pack(pop)
 #endif